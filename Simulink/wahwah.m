@@ -32,45 +32,51 @@ maxf=3000;
 Fw = 2000;
 
 
-% change in centre frequency per sample (Hz)
-delta = Fw/Fs;
-
-% create triangle wave of centre frequency values
-Fc=minf:delta:maxf;
-
-while(length(Fc) < length(x) )
-    Fc= [ Fc (maxf:-delta:minf) ];
-    Fc= [ Fc (minf:delta:maxf) ];
-end
-
-% trim tri wave to size of input
-Fc = Fc(1:length(x));
-
-
-%difference equation coefficients
-% must be recalculated each time Fc changes
-F1 = 2*sin((pi*Fc(1))/Fs);
-
-
-% this dictates size of the pass bands
-Q1 = 2*damp;
-yh=zeros(size(x));          % create emptly out vectors
-yb=zeros(size(x));
-yl=zeros(size(x));
-
-% first sample, to avoid referencing of negative signals
-yh(1) = x(1);
-yb(1) = F1*yh(1);
-yl(1) = F1*yb(1);
-
-
-% apply difference equation to the sample
-%fc = minf; % inicializacion de fc
-for n=2:length(x),
-    yh(n) = x(n) - yl(n-1) - Q1*yb(n-1);
-    yb(n) = F1*yh(n) + yb(n-1);
-    yl(n) = F1*yb(n) + yl(n-1);
-    F1 = 2*sin((pi*Fc(n))/Fs);
+% compiled version of the loop below (engine/wahwahMex.c), same yb;
+% build it with mkoctfile --mex or mex and put it on the path
+if exist('wahwahMex') == 3
+    yb = wahwahMex(x, Fs, damp, minf, maxf, Fw);
+else
+    % change in centre frequency per sample (Hz)
+    delta = Fw/Fs;
+
+    % create triangle wave of centre frequency values
+    Fc=minf:delta:maxf;
+
+    while(length(Fc) < length(x) )
+        Fc= [ Fc (maxf:-delta:minf) ];
+        Fc= [ Fc (minf:delta:maxf) ];
+    end
+
+    % trim tri wave to size of input
+    Fc = Fc(1:length(x));
+
+
+    %difference equation coefficients
+    % must be recalculated each time Fc changes
+    F1 = 2*sin((pi*Fc(1))/Fs);
+
+
+    % this dictates size of the pass bands
+    Q1 = 2*damp;
+    yh=zeros(size(x));          % create emptly out vectors
+    yb=zeros(size(x));
+    yl=zeros(size(x));
+
+    % first sample, to avoid referencing of negative signals
+    yh(1) = x(1);
+    yb(1) = F1*yh(1);
+    yl(1) = F1*yb(1);
+
+
+    % apply difference equation to the sample
+    %fc = minf; % inicializacion de fc
+    for n=2:length(x),
+        yh(n) = x(n) - yl(n-1) - Q1*yb(n-1);
+        yb(n) = F1*yh(n) + yb(n-1);
+        yl(n) = F1*yb(n) + yl(n-1);
+        F1 = 2*sin((pi*Fc(n))/Fs);
+    end
 end
 
 %normalise
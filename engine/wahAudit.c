@@ -0,0 +1,164 @@
+/*-------------------------------------------------------------------------
+ * Description:  Real-time audit of the audio thread (debug builds).
+ *-------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wahAudit.h"
+
+// glibc's own allocator, under the names it exports for replacements.
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t count, size_t n);
+extern void *__libc_realloc(void *ptr, size_t n);
+extern void *__libc_memalign(size_t align, size_t n);
+extern void __libc_free(void *ptr);
+
+static __thread int inRt;
+static int fatal = 1;
+static uint64_t violations;
+static const char *firstViolation;
+
+/*
+ * say() - Write to stderr without anything that could be audited itself.
+ */
+static void say(const char *s){
+	syscall(SYS_write, 2, s, strlen(s));
+}
+
+/*
+ * check() - Record a call to @fn if it came from inside the brackets.
+ */
+static void check(const char *fn){
+	if (!inRt)
+		return;
+	if (__atomic_fetch_add(&violations, 1, __ATOMIC_RELAXED) == 0)
+		__atomic_store_n(&firstViolation, fn, __ATOMIC_RELAXED);
+	if (fatal) {
+		say("wahAudit: ");
+		say(fn);
+		say(" called on the audio thread\n");
+		abort();
+	}
+}
+
+/*
+ * wah_audit_begin() - The calling thread is in its real-time section.
+ */
+void wah_audit_begin(void)
+{
+	inRt = 1;
+}
+
+/*
+ * wah_audit_end() - The calling thread has left its real-time section.
+ */
+void wah_audit_end(void)
+{
+	inRt = 0;
+}
+
+/*
+ * wah_audit_set_fatal() - Abort at the first violation (the default), or
+ * only count them.
+ */
+void wah_audit_set_fatal(int on)
+{
+	fatal = on;
+}
+
+/*
+ * wah_audit_violations() - Violations so far on any thread.
+ * @first: If not NULL, receives the function of the first one, or NULL.
+ */
+uint64_t wah_audit_violations(const char **first)
+{
+	if (first)
+		*first = __atomic_load_n(&firstViolation, __ATOMIC_RELAXED);
+	return __atomic_load_n(&violations, __ATOMIC_RELAXED);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Replacements                                                          */
+/*-----------------------------------------------------------------------*/
+void *malloc(size_t n)
+{
+	check("malloc");
+	return __libc_malloc(n);
+}
+
+void *calloc(size_t count, size_t n)
+{
+	check("calloc");
+	return __libc_calloc(count, n);
+}
+
+void *realloc(void *ptr, size_t n)
+{
+	check("realloc");
+	return __libc_realloc(ptr, n);
+}
+
+void *aligned_alloc(size_t align, size_t n)
+{
+	check("aligned_alloc");
+	return __libc_memalign(align, n);
+}
+
+void *memalign(size_t align, size_t n)
+{
+	check("memalign");
+	return __libc_memalign(align, n);
+}
+
+int posix_memalign(void **ptr, size_t align, size_t n)
+{
+	check("posix_memalign");
+	if (align < sizeof(void *) || (align & (align - 1)))
+		return 22;	// EINVAL, without touching errno's thread slot
+	*ptr = __libc_memalign(align, n);
+	return *ptr ? 0 : 12;	// ENOMEM
+}
+
+void free(void *ptr)
+{
+	check("free");
+	__libc_free(ptr);
+}
+
+/*
+ * The rest forward to the next definition, looked up on first use; the
+ * lookup itself is outside any real-time section in practice, since the
+ * host's setup makes these calls before its first block.
+ */
+#define FORWARD(ret, name, params, args) \
+	ret name params \
+	{ \
+		static ret (*next) params; \
+		\
+		check(#name); \
+		if (next == NULL) \
+			next = (ret (*) params)dlsym(RTLD_NEXT, #name); \
+		return next args; \
+	}
+
+FORWARD(int, pthread_mutex_lock, (pthread_mutex_t *m), (m))
+FORWARD(int, pthread_cond_wait, (pthread_cond_t *c, pthread_mutex_t *m), (c, m))
+FORWARD(int, pthread_cond_timedwait, (pthread_cond_t *c, pthread_mutex_t *m,
+	const struct timespec *t), (c, m, t))
+FORWARD(int, sem_wait, (sem_t *s), (s))
+FORWARD(int, nanosleep, (const struct timespec *t, struct timespec *rem), (t, rem))
+FORWARD(int, clock_nanosleep, (clockid_t id, int flags, const struct timespec *t,
+	struct timespec *rem), (id, flags, t, rem))
+FORWARD(int, usleep, (useconds_t us), (us))
+FORWARD(int, sched_yield, (void), ())
+FORWARD(ssize_t, read, (int fd, void *buf, size_t n), (fd, buf, n))
+FORWARD(ssize_t, write, (int fd, const void *buf, size_t n), (fd, buf, n))
@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ * Description:  Real-time audit of the audio thread (debug builds).
+ *
+ *               Nothing the audio thread calls per block may allocate,
+ *               lock or sleep: the engine, limiter, chain, oversampler,
+ *               resampler and voice pool take every buffer, the event
+ *               queue and the ramp state at init, and the parameter block
+ *               is lock-free. This checks it. Built with -DWAH_AUDIT and
+ *               linked with wahAudit.c, a host brackets its process calls
+ *               with WAH_AUDIT_BEGIN() and WAH_AUDIT_END(); wahAudit.c
+ *               replaces the C library's malloc family, pthread mutex and
+ *               condition waits, semaphores, sleeps, read and write, and
+ *               any of them called between the two on that thread is a
+ *               violation. By default the first one prints the function
+ *               and aborts, so a core or debugger shows who called it.
+ *
+ *               Only calls through those library entry points are seen;
+ *               a raw syscall() or a lock inside another library is not.
+ *               Without -DWAH_AUDIT the brackets compile to nothing.
+ *
+ * Build:        add -DWAH_AUDIT and wahAudit.c -ldl to the host's build
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_AUDIT_H
+#define WAH_AUDIT_H
+
+#include <stdint.h>
+
+void wah_audit_begin(void);
+void wah_audit_end(void);
+void wah_audit_set_fatal(int fatal);
+uint64_t wah_audit_violations(const char **first);
+
+#ifdef WAH_AUDIT
+#define WAH_AUDIT_BEGIN() wah_audit_begin()
+#define WAH_AUDIT_END() wah_audit_end()
+#else
+#define WAH_AUDIT_BEGIN() do { } while (0)
+#define WAH_AUDIT_END() do { } while (0)
+#endif
+
+#endif
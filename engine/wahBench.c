@@ -0,0 +1,692 @@
+/*-------------------------------------------------------------------------
+ * Description:  Throughput benchmarks for the software wah engine.
+ *
+ *                 wahBench [-s seconds] [-b block] [-c MHz] [benchmark ...]
+ *
+ *               With no benchmark names every benchmark runs. Results are
+ *               in Msamples/s of single-channel 48 kHz audio, so 1.0 means
+ *               about 20x real time. Given the core clock with -c, cycles
+ *               per sample are shown too (on the HPS, 800 MHz).
+ *
+ * Build:        gcc -O3 -march=native -o wahBench wahBench.c wahEngine.c wahCycle.c
+ *                   wahLimit.c wahResample.c wahOversample.c wahChain.c wahVoices.c
+ *                   wahNeon.c wahFloat.c -lm
+ *               (for the HPS: arm-linux-gnueabihf-gcc -O3 -mcpu=cortex-a9
+ *                   -mfpu=neon -mfloat-abi=hard)
+ *-------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wahChain.h"
+#include "wahCycle.h"
+#include "wahEngine.h"
+#include "wahFloat.h"
+#include "wahLimit.h"
+#include "wahNeon.h"
+#include "wahOversample.h"
+#include "wahResample.h"
+#include "wahVoices.h"
+
+/* Benchmark input: a little over a second of a 440 Hz tone             */
+#define BENCH_SAMPLES (1 << 16)
+
+static double bench_seconds = 1.0;
+static size_t bench_block = 256;
+static double bench_mhz;
+static int32_t *bench_in, *bench_out;
+
+static double now_s(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, uint64_t samples, double seconds){
+	printf("%-32s %8.2f Msamples/s  %7.2f ns/sample", name,
+		samples / seconds * 1e-6, seconds * 1e9 / samples);
+	if (bench_mhz > 0)
+		printf("  %7.1f cycles/sample", seconds * bench_mhz * 1e6 / samples);
+	printf("\n");
+}
+
+/*-----------------------------------------------------------------------*/
+/* Sample-accurate events                                                */
+/*-----------------------------------------------------------------------*/
+/*
+ * Blocks of bench_block samples with 0, 1 and many volume/wetDry/minf
+ * events spread evenly across each block.
+ */
+static void bench_events(void){
+	static const unsigned counts[] = { 0, 1, 8, 64 };
+	static const struct wah_event changes[] = {
+		{ 0, WAH_VOLUME, 40000 }, { 0, WAH_WETDRY, 30000 }, { 0, WAH_MINF, 150 },
+		{ 0, WAH_VOLUME, 50000 }, { 0, WAH_WETDRY, 40000 }, { 0, WAH_MAXF, 2500 },
+	};
+	struct wah_engine eng;
+	struct wah_params p;
+	unsigned c, e;
+
+	wah_params_default(&p);
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		uint64_t samples = 0, iter;
+		double t0 = now_s(), t;
+		size_t pos = 0;
+		char name[64];
+
+		wah_engine_init(&eng, &p);
+		for (iter = 0;; iter++) {
+			for (e = 0; e < counts[c]; e++) {
+				const struct wah_event *ev = &changes[e % 6];
+
+				wah_engine_schedule(&eng, (uint32_t)(e * bench_block / counts[c]),
+					ev->param, ev->value);
+			}
+			wah_engine_process(&eng, bench_in + pos, bench_out + pos, bench_block);
+			samples += bench_block;
+			pos = (pos + bench_block) % (BENCH_SAMPLES - bench_block);
+			if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+				break;
+		}
+
+		snprintf(name, sizeof(name), "events/%u per block", counts[c]);
+		report(name, samples, t);
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* Volume and wetDry ramps                                               */
+/*-----------------------------------------------------------------------*/
+/*
+ * New volume and wetDry targets every block with a ramp as long as the
+ * block, so the mixer is always ramping; compared with the same changes
+ * switched instantly.
+ */
+static void bench_ramp(void){
+	static const struct {
+		const char *name;
+		unsigned shape;
+		int ramp;
+	} modes[] = {
+		{ "ramp/constant", WAH_RAMP_LINEAR, 0 },
+		{ "ramp/linear", WAH_RAMP_LINEAR, 1 },
+		{ "ramp/exponential", WAH_RAMP_EXP, 1 },
+	};
+	struct wah_engine eng;
+	struct wah_params p;
+	unsigned m;
+
+	wah_params_default(&p);
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		uint64_t samples = 0, iter;
+		double t0 = now_s(), t;
+		size_t pos = 0;
+
+		wah_engine_init(&eng, &p);
+		wah_engine_set_ramp(&eng, modes[m].shape, modes[m].ramp ? bench_block : 0);
+		for (iter = 0;; iter++) {
+			wah_engine_set(&eng, WAH_VOLUME, (iter & 1) ? 20000 : 60000);
+			wah_engine_set(&eng, WAH_WETDRY, (iter & 1) ? 50000 : 10000);
+			wah_engine_process(&eng, bench_in + pos, bench_out + pos, bench_block);
+			samples += bench_block;
+			pos = (pos + bench_block) % (BENCH_SAMPLES - bench_block);
+			if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+				break;
+		}
+		report(modes[m].name, samples, t);
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* Mixing from a wet stem                                                */
+/*-----------------------------------------------------------------------*/
+/*
+ * The full datapath against mixing a precomputed wet signal, which is
+ * what the renderer does for enable/volume/wetDry-only changes; a plain
+ * copy of the same amount of audio is the floor.
+ */
+static void bench_mix(void){
+	struct wah_engine eng;
+	struct wah_params p;
+	int32_t *wet = malloc(BENCH_SAMPLES * sizeof(*wet));
+	unsigned m;
+
+	wah_params_default(&p);
+	wah_engine_init(&eng, &p);
+	wah_engine_filter(&eng, bench_in, wet, BENCH_SAMPLES);
+
+	for (m = 0; m < 3; m++) {
+		static const char *names[] = { "mix/full datapath", "mix/from wet stem", "mix/memcpy" };
+		uint64_t samples = 0, iter;
+		double t0 = now_s(), t;
+		size_t pos = 0;
+
+		wah_engine_init(&eng, &p);
+		for (iter = 0;; iter++) {
+			if (m == 0)
+				wah_engine_process(&eng, bench_in + pos, bench_out + pos, bench_block);
+			else if (m == 1)
+				wah_engine_mix(&eng, bench_in + pos, wet + pos, bench_out + pos, bench_block);
+			else
+				memcpy(bench_out + pos, wet + pos, bench_block * sizeof(*wet));
+			samples += bench_block;
+			pos = (pos + bench_block) % (BENCH_SAMPLES - bench_block);
+			if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+				break;
+		}
+		report(names[m], samples, t);
+	}
+	free(wet);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Output limiter                                                        */
+/*-----------------------------------------------------------------------*/
+/*
+ * The limiter on its own, driven 12 dB into the ceiling so it is always
+ * working, with sample and true peak detection; then after the engine.
+ */
+static void bench_limit(void){
+	static const struct {
+		const char *name;
+		int truePeak;
+		int engine;
+	} modes[] = {
+		{ "limit/sample peak", 0, 0 },
+		{ "limit/true peak", 1, 0 },
+		{ "limit/engine + true peak", 1, 1 },
+	};
+	struct wah_limit_config cfg;
+	struct wah_engine eng;
+	struct wah_limit l;
+	struct wah_params p;
+	unsigned m;
+
+	wah_params_default(&p);
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		uint64_t samples = 0, iter;
+		double t0 = now_s(), t;
+		size_t pos = 0;
+		char name[64];
+
+		wah_limit_config_default(&cfg, WAH_SAMPLE_RATE);
+		cfg.gain = 4 << 16;
+		cfg.truePeak = modes[m].truePeak;
+		if (wah_limit_init(&l, 1, &cfg) < 0)
+			return;
+		wah_engine_init(&eng, &p);
+		for (iter = 0;; iter++) {
+			const int32_t *in = bench_in + pos;
+			int32_t *out = bench_out + pos;
+
+			if (modes[m].engine) {
+				wah_engine_process(&eng, in, out, bench_block);
+				in = out;
+			}
+			wah_limit_process(&l, &in, &out, bench_block);
+			samples += bench_block;
+			pos = (pos + bench_block) % (BENCH_SAMPLES - bench_block);
+			if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+				break;
+		}
+		snprintf(name, sizeof(name), "%s (%u frames)", modes[m].name, wah_limit_latency(&l));
+		report(name, samples, t);
+		wah_limit_free(&l);
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* Chunked chain                                                         */
+/*-----------------------------------------------------------------------*/
+/*
+ * wah, mixer, volume and limiter run one after another over the whole
+ * block, each through a block-sized buffer, against the same stages
+ * compiled into a chain; then the chain again with per-kernel timing.
+ * The two should stay level at any -b: a chain only has to keep up.
+ */
+static void bench_chain(void){
+	static const char *const modes[] = {
+		"chain/separate passes", "chain/chunked", "chain/chunked, timed",
+	};
+	struct wah_limit_config cfg;
+	struct wah_chain ch;
+	struct wah_engine eng;
+	struct wah_limit l;
+	struct wah_params p;
+	int32_t *wet;
+	unsigned m, k;
+
+	wah_params_default(&p);
+	wah_limit_config_default(&cfg, WAH_SAMPLE_RATE);
+	wet = malloc(bench_block * sizeof(*wet));
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		uint64_t samples = 0, iter;
+		double t0 = now_s(), t;
+		size_t pos = 0;
+
+		wah_engine_init(&eng, &p);
+		if (wah_limit_init(&l, 1, &cfg) < 0 ||
+		    wah_chain_init(&ch, "wah,mixer,volume,limit", 1, &p, &cfg) < 0)
+			break;
+		ch.timing = m == 2;
+		for (iter = 0;; iter++) {
+			const int32_t *in = bench_in + pos;
+			int32_t *out = bench_out + pos;
+
+			if (m == 0) {
+				wah_engine_filter(&eng, in, wet, bench_block);
+				wah_engine_mix(&eng, in, wet, out, bench_block);
+				wah_limit_process(&l, (const int32_t *const *)&out, &out, bench_block);
+			} else {
+				wah_chain_process(&ch, &in, &out, bench_block);
+			}
+			samples += bench_block;
+			pos = (pos + bench_block) % (BENCH_SAMPLES - bench_block);
+			if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+				break;
+		}
+		report(modes[m], samples, t);
+		for (k = 0; ch.timing && k < ch.kernels; k++) {
+			char name[64];
+
+			snprintf(name, sizeof(name), "  %s", ch.kernel[k].name);
+			report(name, samples, ch.kernel[k].ns * 1e-9);
+		}
+		wah_chain_free(&ch);
+		wah_limit_free(&l);
+	}
+	free(wet);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Oversampling                                                          */
+/*-----------------------------------------------------------------------*/
+/*
+ * The whole effect at each oversampling factor, with maxf where 48 kHz
+ * is still fine and where it isn't; the cost doesn't depend on it, the
+ * second set is there to show that.
+ */
+static void bench_oversample(void){
+	static const unsigned factors[] = { 1, 2, 4 };
+	static const uint32_t maxfs[] = { 3000, 15000 };
+	struct wah_params p;
+	struct wah_os os;
+	unsigned f, m;
+
+	wah_params_default(&p);
+	for (m = 0; m < sizeof(maxfs) / sizeof(maxfs[0]); m++) {
+		p.maxf = maxfs[m];
+		for (f = 0; f < sizeof(factors) / sizeof(factors[0]); f++) {
+			uint64_t samples = 0, iter;
+			double t0 = now_s(), t;
+			size_t pos = 0;
+			char name[64];
+
+			wah_os_init(&os, factors[f], &p);
+			for (iter = 0;; iter++) {
+				wah_os_process(&os, bench_in + pos, bench_out + pos, bench_block);
+				samples += bench_block;
+				pos = (pos + bench_block) % (BENCH_SAMPLES - bench_block);
+				if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+					break;
+			}
+			snprintf(name, sizeof(name), "oversample/%ux maxf %u (%u frames)",
+				factors[f], maxfs[m], wah_os_latency(&os));
+			report(name, samples, t);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* Sample rate conversion                                                */
+/*-----------------------------------------------------------------------*/
+/*
+ * The converter on its own for the common ratios, then 44.1 kHz material
+ * through the engine and back. Rates are per input sample.
+ */
+static void bench_resample(void){
+	static const struct {
+		const char *name;
+		uint32_t from, to;
+		int engine;
+	} modes[] = {
+		{ "resample/44.1k -> 48k", 44100, 48000, 0 },
+		{ "resample/48k -> 44.1k", 48000, 44100, 0 },
+		{ "resample/88.2k -> 48k", 88200, 48000, 0 },
+		{ "resample/96k -> 48k", 96000, 48000, 0 },
+		{ "resample/44.1k engine round trip", 44100, 48000, 1 },
+	};
+	struct wah_resample up, down;
+	struct wah_engine eng;
+	struct wah_params p;
+	int32_t *mid;
+	unsigned m;
+
+	wah_params_default(&p);
+	mid = malloc((2 * bench_block + 2) * sizeof(*mid));
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		uint64_t samples = 0, iter;
+		double t0 = now_s(), t;
+		size_t pos = 0, n;
+
+		if (wah_resample_init(&up, 1, modes[m].from, modes[m].to) < 0 ||
+		    wah_resample_init(&down, 1, modes[m].to, modes[m].from) < 0)
+			break;
+		wah_engine_init(&eng, &p);
+		for (iter = 0;; iter++) {
+			const int32_t *in = bench_in + pos;
+			int32_t *out = bench_out + pos;
+
+			if (modes[m].engine) {
+				n = wah_resample_process(&up, &in, bench_block, &mid);
+				wah_engine_process(&eng, mid, mid, n);
+				wah_resample_process(&down, (const int32_t *const *)&mid, n, &out);
+			} else {
+				wah_resample_process(&up, &in, bench_block, &mid);
+			}
+			samples += bench_block;
+			pos = (pos + bench_block) % (BENCH_SAMPLES - bench_block);
+			if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+				break;
+		}
+		report(modes[m].name, samples, t);
+		wah_resample_free(&up);
+		wah_resample_free(&down);
+	}
+	free(mid);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Many instances                                                        */
+/*-----------------------------------------------------------------------*/
+/*
+ * 1 to 4096 instances, each on its own stream with its own registers, as
+ * a pool against one wah_engine apiece from the heap. Samples count every
+ * instance, so a flat ns/sample is a flat cost per instance. The two take
+ * turns a block at a time, so a noisy neighbour on the machine slows both
+ * alike instead of whichever happened to be running.
+ */
+static void bench_voices(void){
+	static const uint32_t counts[] = { 1, 64, 512, 4096 };
+	struct wah_engine **eng;
+	struct wah_voices v;
+	struct wah_params p;
+	int32_t *in, *out;
+	uint32_t c, k, m;
+
+	wah_params_default(&p);
+	in = malloc(counts[3] * bench_block * sizeof(*in));
+	out = malloc(counts[3] * bench_block * sizeof(*out));
+	eng = calloc(counts[3], sizeof(*eng));
+	for (k = 0; k < counts[3]; k++)
+		memcpy(in + k * bench_block, bench_in + k * 7 % (BENCH_SAMPLES - bench_block),
+			bench_block * sizeof(*in));
+
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		double t[2] = { 0, 0 }, t0;
+		uint64_t samples = 0, iter;
+		char name[64];
+
+		if (wah_voices_init(&v, counts[c]) < 0)
+			break;
+		for (k = 0; k < counts[c]; k++) {
+			p.minf = 300 + k % 200;
+			p.delta = 1 + k % 3;
+			wah_voice_create(&v, &p);
+			eng[k] = malloc(sizeof(**eng));
+			wah_engine_init(eng[k], &p);
+		}
+		for (iter = 0;; iter++) {
+			t0 = now_s();
+			wah_voices_process(&v, in, out, bench_block, bench_block);
+			t[0] += now_s() - t0;
+			t0 = now_s();
+			for (k = 0; k < counts[c]; k++)
+				wah_engine_process(eng[k], in + k * bench_block,
+					out + k * bench_block, bench_block);
+			t[1] += now_s() - t0;
+			samples += (uint64_t)counts[c] * bench_block;
+			if ((iter & 63) == 63 && t[0] + t[1] >= 2 * bench_seconds)
+				break;
+		}
+		for (m = 0; m < 2; m++) {
+			snprintf(name, sizeof(name), "voices/%u %s", counts[c],
+				m == 0 ? "pooled" : "engines");
+			report(name, samples, t[m]);
+		}
+		for (k = 0; k < counts[c]; k++)
+			free(eng[k]);
+		wah_voices_free(&v);
+	}
+	free(eng);
+	free(in);
+	free(out);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Stereo engine                                                         */
+/*-----------------------------------------------------------------------*/
+/*
+ * The stereo engine of wahNeon.c against one engine per channel. Samples
+ * count both channels; at 48 kHz stereo the share of one core the effect
+ * takes is 96000 samples/s over the rate shown.
+ */
+static void bench_neon(void){
+	static const char *const modes[] = {
+		"stereo/two engines", "stereo/wah_neon",
+	};
+	struct wah_engine eng[2];
+	struct wah_params p;
+	struct wah_neon s;
+	unsigned m;
+
+	wah_params_default(&p);
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		uint64_t samples = 0, iter;
+		double t0 = now_s(), t;
+		size_t pos = 0;
+
+		wah_engine_init(&eng[0], &p);
+		wah_engine_init(&eng[1], &p);
+		wah_neon_init(&s, &p);
+		for (iter = 0;; iter++) {
+			const int32_t *in[2] = { bench_in + pos, bench_in + pos + 1 };
+			int32_t *out[2] = { bench_out + pos, bench_out + pos + bench_block };
+
+			if (m == 0) {
+				wah_engine_process(&eng[0], in[0], out[0], bench_block);
+				wah_engine_process(&eng[1], in[1], out[1], bench_block);
+			} else {
+				wah_neon_process(&s, in, out, bench_block);
+			}
+			samples += 2 * bench_block;
+			pos = (pos + bench_block) % (BENCH_SAMPLES - 2 * bench_block + 1);
+			if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+				break;
+		}
+		report(modes[m], samples, t);
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* Float32 engine                                                        */
+/*-----------------------------------------------------------------------*/
+/*
+ * wahFloat.c on 1, 2, 4 and 8 channels against one fixed-point engine per
+ * channel. Samples count every channel.
+ */
+static void bench_float(void){
+	static const unsigned counts[] = { 1, 2, 4, WAH_FLOAT_LANES };
+	struct wah_engine eng[WAH_FLOAT_LANES];
+	struct wah_float f;
+	struct wah_params p;
+	float *fin = malloc(BENCH_SAMPLES * sizeof(*fin));
+	float *fout = malloc(WAH_FLOAT_LANES * bench_block * sizeof(*fout));
+	int32_t *out = malloc(WAH_FLOAT_LANES * bench_block * sizeof(*out));
+	char name[64];
+	unsigned c, m, k;
+	size_t i;
+
+	for (i = 0; i < BENCH_SAMPLES; i++)
+		fin[i] = bench_in[i] * (1.0f / 8388608);
+	wah_params_default(&p);
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+		for (m = 0; m < 2; m++) {
+			uint64_t samples = 0, iter;
+			double t0 = now_s(), t;
+			size_t pos = 0;
+
+			for (k = 0; k < counts[c]; k++)
+				wah_engine_init(&eng[k], &p);
+			wah_float_init(&f, counts[c], &p);
+			for (iter = 0;; iter++) {
+				const float *in[WAH_FLOAT_LANES];
+				float *o[WAH_FLOAT_LANES];
+
+				for (k = 0; k < counts[c]; k++) {
+					in[k] = fin + pos + k;
+					o[k] = fout + k * bench_block;
+					if (m == 0)
+						wah_engine_process(&eng[k], bench_in + pos + k,
+							out + k * bench_block, bench_block);
+				}
+				if (m == 1)
+					wah_float_process(&f, in, o, bench_block);
+				samples += counts[c] * bench_block;
+				pos = (pos + bench_block) %
+					(BENCH_SAMPLES - bench_block - WAH_FLOAT_LANES + 1);
+				if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+					break;
+			}
+			snprintf(name, sizeof(name), "float/%u channels %s", counts[c],
+				m == 0 ? "fixed" : "float32");
+			report(name, samples, t);
+		}
+	free(fin);
+	free(fout);
+	free(out);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Cycle tables                                                          */
+/*-----------------------------------------------------------------------*/
+/*
+ * One engine stepping Fc and F1 every sample against one replaying them
+ * from a cycle table (wahCycle.c), for the default sweep (a 2.4 s period)
+ * and a fast one (0.12 s). The table is built before the clock starts.
+ */
+static void bench_cycle(void){
+	static const struct {
+		const char *name;
+		uint32_t delta;
+	} sweeps[] = {
+		{ "default", 3277 },
+		{ "fast", 65535 },
+	};
+	struct wah_engine eng;
+	struct wah_params p;
+	char name[64];
+	unsigned s, m;
+
+	wah_params_default(&p);
+	for (s = 0; s < sizeof(sweeps) / sizeof(sweeps[0]); s++) {
+		p.delta = sweeps[s].delta;
+		if (wah_cycle_get(p.minf, p.maxf, p.delta, -(int64_t)p.delta) == NULL) {
+			printf("cycle/%s: no table\n", sweeps[s].name);
+			continue;
+		}
+		for (m = 0; m < 2; m++) {
+			uint64_t samples = 0, iter;
+			double t0 = now_s(), t;
+			size_t pos = 0;
+
+			wah_engine_init(&eng, &p);
+			wah_engine_set_cycles(&eng, m);
+			for (iter = 0;; iter++) {
+				wah_engine_process(&eng, bench_in + pos, bench_out + pos, bench_block);
+				samples += bench_block;
+				pos = (pos + bench_block) % (BENCH_SAMPLES - bench_block + 1);
+				if ((iter & 63) == 63 && (t = now_s() - t0) >= bench_seconds)
+					break;
+			}
+			snprintf(name, sizeof(name), "cycle/%s %s", sweeps[s].name,
+				m == 0 ? "stepped" : "replayed");
+			report(name, samples, t);
+		}
+	}
+	printf("cycle tables: %.1f kB\n", wah_cycles_size() / 1024.0);
+	wah_cycles_free();
+}
+
+/*-----------------------------------------------------------------------*/
+/* Driver                                                                */
+/*-----------------------------------------------------------------------*/
+static const struct {
+	const char *name;
+	void (*run)(void);
+} benches[] = {
+	{ "events", bench_events },
+	{ "ramp", bench_ramp },
+	{ "mix", bench_mix },
+	{ "limit", bench_limit },
+	{ "resample", bench_resample },
+	{ "oversample", bench_oversample },
+	{ "chain", bench_chain },
+	{ "voices", bench_voices },
+	{ "neon", bench_neon },
+	{ "float", bench_float },
+	{ "cycle", bench_cycle },
+};
+
+int main(int argc, char **argv){
+	unsigned i, j;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:b:c:h")) != -1) {
+		switch (opt) {
+		case 's':
+			bench_seconds = strtod(optarg, NULL);
+			break;
+		case 'b':
+			bench_block = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			bench_mhz = strtod(optarg, NULL);
+			break;
+		default:
+			printf("usage: %s [-s seconds] [-b block] [-c MHz] [benchmark ...]\n",
+				argv[0]);
+			for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+				printf("  %s\n", benches[i].name);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (bench_block == 0 || bench_block > BENCH_SAMPLES / 2) {
+		printf("block size must be between 1 and %d\n", BENCH_SAMPLES / 2);
+		exit(1);
+	}
+
+	bench_in = malloc(BENCH_SAMPLES * sizeof(*bench_in));
+	bench_out = malloc(BENCH_SAMPLES * sizeof(*bench_out));
+	for (i = 0; i < BENCH_SAMPLES; i++)
+		bench_in[i] = (int32_t)(0.5 * sin(2 * M_PI * 440 * i / WAH_SAMPLE_RATE) * (1 << 23));
+
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		int wanted = optind == argc;
+
+		for (j = optind; j < (unsigned)argc; j++)
+			if (strcmp(argv[j], benches[i].name) == 0)
+				wanted = 1;
+		if (wanted)
+			benches[i].run();
+	}
+
+	free(bench_in);
+	free(bench_out);
+	return 0;
+}
@@ -0,0 +1,324 @@
+/*-------------------------------------------------------------------------
+ * Description:  Content-addressed on-disk cache of finished renders.
+ *-------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wahCache.h"
+
+/* Trimming stops at this fraction of the limit, so it doesn't run on
+ * every insertion once the cache is full                                */
+#define CACHE_TRIM_NUM 9
+#define CACHE_TRIM_DEN 10
+
+/*-----------------------------------------------------------------------*/
+/* Hashing                                                               */
+/*-----------------------------------------------------------------------*/
+/* XXH64 primes                                                          */
+#define P1 0x9e3779b185ebca87ULL
+#define P2 0xc2b2ae3d27d4eb4fULL
+#define P3 0x165667b19e3779f9ULL
+#define P4 0x85ebca77c2b2ae63ULL
+#define P5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t rotl(uint64_t x, int r){
+	return x << r | x >> (64 - r);
+}
+
+static inline uint64_t get64(const uint8_t *p){
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t get32(const uint8_t *p){
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t v){
+	return rotl(acc + v * P2, 31) * P1;
+}
+
+static inline uint64_t merge64(uint64_t h, uint64_t v){
+	return (h ^ round64(0, v)) * P1 + P4;
+}
+
+/*
+ * wah_hash64() - XXH64 of @len bytes.
+ *
+ * Four independent lanes keep hashing well above disk speed, so keying
+ * the cache by content costs next to nothing next to a render.
+ */
+uint64_t wah_hash64(const void *data, size_t len, uint64_t seed)
+{
+	const uint8_t *p = data, *end = p + len;
+	uint64_t h;
+
+	if (len >= 32) {
+		uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+
+		do {
+			v1 = round64(v1, get64(p));
+			v2 = round64(v2, get64(p + 8));
+			v3 = round64(v3, get64(p + 16));
+			v4 = round64(v4, get64(p + 24));
+			p += 32;
+		} while (end - p >= 32);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = merge64(h, v1);
+		h = merge64(h, v2);
+		h = merge64(h, v3);
+		h = merge64(h, v4);
+	} else {
+		h = seed + P5;
+	}
+	h += len;
+
+	for (; end - p >= 8; p += 8)
+		h = rotl(h ^ round64(0, get64(p)), 27) * P1 + P4;
+	if (end - p >= 4) {
+		h = rotl(h ^ (get32(p) * P1), 23) * P2 + P3;
+		p += 4;
+	}
+	for (; p < end; p++)
+		h = rotl(h ^ (*p * P5), 11) * P1;
+
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+	h *= P3;
+	h ^= h >> 32;
+	return h;
+}
+
+/*
+ * wah_cache_key() - Entry name for a render.
+ * @key: At least WAH_CACHE_KEY_MAX bytes.
+ * @input_hash: wah_hash64() of the input audio and its format.
+ */
+void wah_cache_key(char *key, uint64_t input_hash, const struct wah_params *p)
+{
+	snprintf(key, WAH_CACHE_KEY_MAX, "%016llx-%u-%u-%u-%u-%u-%u-%u-v%u.wav",
+		(unsigned long long)input_hash, p->enable, p->volume, p->damp,
+		p->minf, p->maxf, p->delta, p->wetDry, WAH_ENGINE_VERSION);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Cache directory                                                       */
+/*-----------------------------------------------------------------------*/
+struct entry {
+	char *name;
+	uint64_t size;
+	struct timespec used;
+};
+
+static int is_entry(const char *name){
+	size_t len = strlen(name);
+
+	return len > 4 && strcmp(name + len - 4, ".wav") == 0;
+}
+
+static int by_use(const void *a, const void *b){
+	const struct entry *x = a, *y = b;
+
+	if (x->used.tv_sec != y->used.tv_sec)
+		return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+	return x->used.tv_nsec < y->used.tv_nsec ? -1 : x->used.tv_nsec > y->used.tv_nsec;
+}
+
+/*
+ * trim() - Rescan the directory; evict least recently used entries if
+ * over the limit. Called with c->lock held.
+ */
+static void trim(struct wah_cache *c)
+{
+	struct entry *e = NULL;
+	size_t n = 0, cap = 0, i;
+	uint64_t total = 0, target;
+	struct dirent *d;
+	struct stat st;
+	DIR *dir;
+	int dfd;
+
+	dir = opendir(c->dir);
+	if (dir == NULL)
+		return;
+	dfd = dirfd(dir);
+	while ((d = readdir(dir)) != NULL) {
+		if (!is_entry(d->d_name) || fstatat(dfd, d->d_name, &st, 0) < 0)
+			continue;
+		if (n == cap) {
+			cap = cap ? 2 * cap : 256;
+			e = realloc(e, cap * sizeof(*e));
+		}
+		e[n].name = strdup(d->d_name);
+		e[n].size = st.st_size;
+		e[n].used = st.st_mtim;
+		total += st.st_size;
+		n++;
+	}
+
+	if (c->limit && total > c->limit) {
+		target = c->limit / CACHE_TRIM_DEN * CACHE_TRIM_NUM;
+		qsort(e, n, sizeof(*e), by_use);
+		for (i = 0; i < n && total > target; i++) {
+			if (unlinkat(dfd, e[i].name, 0) == 0 || errno == ENOENT) {
+				total -= e[i].size;
+				c->evictions++;
+			}
+		}
+	}
+	c->used = total;
+
+	for (i = 0; i < n; i++)
+		free(e[i].name);
+	free(e);
+	closedir(dir);
+}
+
+/*
+ * wah_cache_open() - Open (creating if needed) a cache directory.
+ * @limit: Size limit in bytes, 0 for none; applied straight away.
+ *
+ * Return: 0 on success, -1 with errno set.
+ */
+int wah_cache_open(struct wah_cache *c, const char *dir, uint64_t limit)
+{
+	memset(c, 0, sizeof(*c));
+	if (mkdir(dir, 0777) < 0 && errno != EEXIST)
+		return -1;
+	c->dir = strdup(dir);
+	c->limit = limit;
+	pthread_mutex_init(&c->lock, NULL);
+	trim(c);
+	return 0;
+}
+
+void wah_cache_close(struct wah_cache *c)
+{
+	pthread_mutex_destroy(&c->lock);
+	free(c->dir);
+	c->dir = NULL;
+}
+
+/*
+ * wah_cache_get() - Map the entry for @key.
+ * @size: Set to the entry size on a hit.
+ *
+ * Marks the entry as just used. Release the mapping with
+ * wah_cache_release().
+ *
+ * Return: The mapped file, or NULL on a miss.
+ */
+const void *wah_cache_get(struct wah_cache *c, const char *key, size_t *size)
+{
+	char path[4096];
+	void *map = MAP_FAILED;
+	struct stat st;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", c->dir, key);
+	fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			*size = st.st_size;
+		}
+		// Entries never change, so mtime is free to mean "last used".
+		futimens(fd, NULL);
+		close(fd);
+	}
+
+	pthread_mutex_lock(&c->lock);
+	if (map == MAP_FAILED)
+		c->misses++;
+	else
+		c->hits++;
+	pthread_mutex_unlock(&c->lock);
+	return map == MAP_FAILED ? NULL : map;
+}
+
+void wah_cache_release(const void *map, size_t size)
+{
+	munmap((void *)map, size);
+}
+
+/*
+ * wah_cache_put() - Copy the finished render at @path in as @key.
+ *
+ * Return: 0 on success, -1 with errno set.
+ */
+int wah_cache_put(struct wah_cache *c, const char *key, const char *path)
+{
+	char final[4096], part[4096 + 64];
+	struct stat st;
+	off_t left;
+	int in, out, err = 0;
+
+	in = open(path, O_RDONLY);
+	if (in < 0)
+		return -1;
+	snprintf(final, sizeof(final), "%s/%s", c->dir, key);
+	snprintf(part, sizeof(part), "%s.%d.%lx.part", final, (int)getpid(),
+		(unsigned long)pthread_self());
+	out = open(part, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (out < 0 || fstat(in, &st) < 0) {
+		err = errno;
+		goto done;
+	}
+
+	for (left = st.st_size; left > 0;) {
+		ssize_t r = copy_file_range(in, NULL, out, NULL, left, 0);
+
+		if (r <= 0) {
+			err = r < 0 ? errno : EIO;
+			break;
+		}
+		left -= r;
+	}
+	if (close(out) < 0 && !err)
+		err = errno;
+	out = -1;
+	if (!err && rename(part, final) < 0)
+		err = errno;
+
+done:
+	if (out >= 0)
+		close(out);
+	close(in);
+	if (err) {
+		unlink(part);
+		errno = err;
+		return -1;
+	}
+
+	pthread_mutex_lock(&c->lock);
+	c->used += st.st_size;
+	if (c->limit && c->used > c->limit)
+		trim(c);
+	pthread_mutex_unlock(&c->lock);
+	return 0;
+}
+
+/*
+ * wah_cache_trim() - Recount the cache and evict down to the limit.
+ */
+void wah_cache_trim(struct wah_cache *c)
+{
+	pthread_mutex_lock(&c->lock);
+	trim(c);
+	pthread_mutex_unlock(&c->lock);
+}
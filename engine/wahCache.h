@@ -0,0 +1,51 @@
+/*-------------------------------------------------------------------------
+ * Description:  Content-addressed on-disk cache of finished renders.
+ *
+ *               An entry is a rendered WAV file named after everything its
+ *               samples depend on: a hash of the input audio, the seven
+ *               register values and WAH_ENGINE_VERSION. Entries never
+ *               change once written, so a hit is simply mapped and handed
+ *               out, and the file modification time doubles as the
+ *               last-used stamp for LRU eviction when the cache grows past
+ *               its size limit.
+ *
+ *               Several processes may share a cache directory: entries
+ *               appear by rename() and a mapping survives eviction.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_CACHE_H
+#define WAH_CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahEngine.h"
+
+/* Longest entry name wah_cache_key() produces, with the terminator      */
+#define WAH_CACHE_KEY_MAX 96
+
+/*
+ * struct wah_cache - An open cache directory.
+ * @limit: Size limit (bytes); 0 for none.
+ * @used: Bytes in entries, as of the last scan plus own insertions.
+ */
+struct wah_cache {
+	char *dir;
+	uint64_t limit;
+	uint64_t used;
+	pthread_mutex_t lock;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+};
+
+uint64_t wah_hash64(const void *data, size_t len, uint64_t seed);
+void wah_cache_key(char *key, uint64_t input_hash, const struct wah_params *p);
+int wah_cache_open(struct wah_cache *c, const char *dir, uint64_t limit);
+void wah_cache_close(struct wah_cache *c);
+const void *wah_cache_get(struct wah_cache *c, const char *key, size_t *size);
+void wah_cache_release(const void *map, size_t size);
+int wah_cache_put(struct wah_cache *c, const char *key, const char *path);
+void wah_cache_trim(struct wah_cache *c);
+
+#endif
@@ -0,0 +1,333 @@
+/*-------------------------------------------------------------------------
+ * Description:  Effect chain built from a description, run a chunk at a
+ *               time.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wahChain.h"
+
+/* Stage names as descriptions use them                                  */
+const char *const wah_stage_names[WAH_STAGE_COUNT] = {
+	"wah", "mixer", "volume", "limit",
+};
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * parse() - Split @desc (names separated by commas or spaces) into
+ * @ch->stage.
+ *
+ * Return: 0, or -1 for an unknown or repeated name, a mixer with no wah
+ * ahead of it or with the limiter in between (its delay would pull wet
+ * and dry apart), or an empty description.
+ */
+static int parse(struct wah_chain *ch, const char *desc)
+{
+	const unsigned wah = 1u << WAH_STAGE_WAH;
+	unsigned seen = 0, split = 0, i;
+
+	ch->count = 0;
+	while (*desc) {
+		size_t len = strcspn(desc, ", ");
+
+		if (len) {
+			for (i = 0; i < WAH_STAGE_COUNT; i++)
+				if (strlen(wah_stage_names[i]) == len &&
+				    strncmp(desc, wah_stage_names[i], len) == 0)
+					break;
+			if (i == WAH_STAGE_COUNT || (seen & (1u << i)) ||
+			    (i == WAH_STAGE_MIXER && (!(seen & wah) || split)))
+				return -1;
+			if (i == WAH_STAGE_LIMIT && (seen & wah))
+				split = 1;
+			seen |= 1u << i;
+			ch->stage[ch->count++] = i;
+		}
+		desc += len + (desc[len] != '\0');
+	}
+	return ch->count ? 0 : -1;
+}
+
+/*
+ * plan() - Group the stages into kernels.
+ */
+static void plan(struct wah_chain *ch)
+{
+	unsigned i, j;
+
+	ch->kernels = 0;
+	for (i = 0; i < ch->count; i += ch->kernel[ch->kernels++].stages) {
+		struct wah_kernel *k = &ch->kernel[ch->kernels];
+
+		k->first = i;
+		k->stages = 1;
+		if (ch->stage[i] == WAH_STAGE_MIXER && i + 1 < ch->count &&
+		    ch->stage[i + 1] == WAH_STAGE_VOLUME)
+			k->stages = 2;
+		k->ns = 0;
+		k->name[0] = '\0';
+		for (j = 0; j < k->stages; j++) {
+			if (j)
+				strcat(k->name, "+");
+			strcat(k->name, wah_stage_names[ch->stage[i + j]]);
+		}
+	}
+}
+
+/*
+ * wah_chain_init() - Compile @desc for @channels channels.
+ * @p: Registers for wah, mixer and volume.
+ * @limit: Limiter settings; NULL for wah_limit_config_default().
+ *
+ * Return: 0 on success, -1 with errno set (EINVAL for a bad description
+ * or limiter settings).
+ */
+int wah_chain_init(struct wah_chain *ch, const char *desc, unsigned channels,
+	const struct wah_params *p, const struct wah_limit_config *limit)
+{
+	struct wah_limit_config cfg;
+	unsigned c, i;
+
+	memset(ch, 0, sizeof(*ch));
+	if (channels == 0 || parse(ch, desc) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	ch->channels = channels;
+	plan(ch);
+
+	for (i = 0; i < ch->count; i++)
+		if (ch->stage[i] == WAH_STAGE_LIMIT) {
+			if (limit == NULL)
+				wah_limit_config_default(&cfg, WAH_SAMPLE_RATE);
+			if (wah_limit_init(&ch->limit, channels, limit ? limit : &cfg) < 0)
+				return -1;
+		}
+
+	ch->eng = malloc(channels * sizeof(*ch->eng));
+	ch->work = calloc(channels, sizeof(int32_t *));
+	ch->keep = calloc(channels, sizeof(int32_t *));
+	ch->dry = calloc(channels, sizeof(int32_t *));
+	ch->src = calloc(channels, sizeof(int32_t *));
+	ch->dst = calloc(channels, sizeof(int32_t *));
+	if (ch->eng == NULL || ch->work == NULL || ch->keep == NULL || ch->dry == NULL ||
+	    ch->src == NULL || ch->dst == NULL)
+		goto nomem;
+	for (c = 0; c < channels; c++) {
+		wah_engine_init(&ch->eng[c], p);
+		ch->work[c] = malloc(WAH_CHAIN_CHUNK * sizeof(int32_t));
+		ch->keep[c] = malloc(WAH_CHAIN_CHUNK * sizeof(int32_t));
+		if (ch->work[c] == NULL || ch->keep[c] == NULL)
+			goto nomem;
+	}
+	return 0;
+
+nomem:
+	wah_chain_free(ch);
+	errno = ENOMEM;
+	return -1;
+}
+
+void wah_chain_free(struct wah_chain *ch)
+{
+	unsigned c;
+
+	for (c = 0; c < ch->channels; c++) {
+		if (ch->work)
+			free(ch->work[c]);
+		if (ch->keep)
+			free(ch->keep[c]);
+	}
+	wah_limit_free(&ch->limit);
+	free(ch->eng);
+	free(ch->work);
+	free(ch->keep);
+	free(ch->dry);
+	free(ch->src);
+	free(ch->dst);
+	memset(ch, 0, sizeof(*ch));
+}
+
+/*
+ * wah_chain_latency() - Frames the output lags the input (the limiter's
+ * delay, if there is one).
+ */
+unsigned wah_chain_latency(const struct wah_chain *ch)
+{
+	return ch->limit.hist ? wah_limit_latency(&ch->limit) : 0;
+}
+
+/*
+ * wah_chain_schedule() - Change a register on every channel at an exact
+ * frame.
+ *
+ * Like wah_engine_schedule(), @offset counts from the next
+ * wah_chain_process() call; it applies at the input of the chain, so
+ * stages after a limiter see it the limiter's delay early.
+ */
+int wah_chain_schedule(struct wah_chain *ch, uint32_t offset, unsigned param, uint32_t value)
+{
+	// Channel 0 keeps the queue; the others are set along with it.
+	return wah_engine_schedule(&ch->eng[0], offset, param, value);
+}
+
+/*
+ * stage_mixer() - The mixer on its own: the full-width mix is sliced
+ * straight back to sfix24_En23.
+ */
+static void stage_mixer(struct wah_engine *eng, const int32_t *dry, const int32_t *wet,
+	int32_t *out, size_t n)
+{
+	struct wah_ramp *r = &eng->wetDry;
+	size_t i, j, len;
+
+	for (i = 0; i < n; i += len) {
+		const int64_t wd = r->cur, inc = r->inc;
+
+		len = n - i;
+		if (r->left && r->left < len)
+			len = r->left;
+		if (!eng->params.enable)
+			memmove(out + i, dry + i, len * sizeof(int32_t));
+		else
+			for (j = 0; j < len; j++) {
+				uint32_t w = (uint32_t)((wd + (int64_t)j * inc) >> WAH_RAMP_FRAC);
+
+				out[i + j] = wah_wrap24(wah_mix(dry[i + j], wet[i + j], w) >> 16);
+			}
+		wah_ramp_advance(r, (uint32_t)len);
+	}
+}
+
+/*
+ * stage_volume() - The volume stage on its own, as with enable off.
+ */
+static void stage_volume(struct wah_engine *eng, const int32_t *in, int32_t *out, size_t n)
+{
+	struct wah_ramp *r = &eng->volume;
+	size_t i, j, len;
+
+	for (i = 0; i < n; i += len) {
+		const int64_t vol = r->cur, inc = r->inc;
+
+		len = n - i;
+		if (r->left && r->left < len)
+			len = r->left;
+		for (j = 0; j < len; j++) {
+			uint32_t v = (uint32_t)((vol + (int64_t)j * inc) >> WAH_RAMP_FRAC);
+
+			out[i + j] = wah_output(in[i + j], 0, 0, v);
+		}
+		wah_ramp_advance(r, (uint32_t)len);
+	}
+}
+
+/*
+ * run_kernel() - One kernel over @n frames on every channel, from
+ * @ch->src to @ch->dst.
+ */
+static void run_kernel(struct wah_chain *ch, const struct wah_kernel *k, size_t n)
+{
+	unsigned c;
+
+	switch (ch->stage[k->first]) {
+	case WAH_STAGE_WAH:
+		for (c = 0; c < ch->channels; c++) {
+			// The chain's input stays put for the chunk; scratch doesn't.
+			ch->dry[c] = ch->src[c];
+			if (ch->src[c] == ch->work[c]) {
+				memcpy(ch->keep[c], ch->src[c], n * sizeof(int32_t));
+				ch->dry[c] = ch->keep[c];
+			}
+			wah_engine_filter(&ch->eng[c], ch->src[c], ch->dst[c], n);
+		}
+		break;
+	case WAH_STAGE_MIXER:
+		for (c = 0; c < ch->channels; c++)
+			if (k->stages == 2)
+				wah_engine_mix(&ch->eng[c], ch->dry[c], ch->src[c], ch->dst[c], n);
+			else
+				stage_mixer(&ch->eng[c], ch->dry[c], ch->src[c], ch->dst[c], n);
+		break;
+	case WAH_STAGE_VOLUME:
+		for (c = 0; c < ch->channels; c++)
+			stage_volume(&ch->eng[c], ch->src[c], ch->dst[c], n);
+		break;
+	case WAH_STAGE_LIMIT:
+		wah_limit_process(&ch->limit, ch->src, ch->dst, n);
+		break;
+	}
+}
+
+/*
+ * render() - Run a segment with constant register values, one chunk
+ * through every kernel at a time.
+ */
+static void render(struct wah_chain *ch, const int32_t *const *in, int32_t *const *out,
+	size_t pos, size_t n)
+{
+	size_t end = pos + n, len;
+	unsigned c, k;
+
+	for (; pos < end; pos += len) {
+		len = end - pos < WAH_CHAIN_CHUNK ? end - pos : WAH_CHAIN_CHUNK;
+
+		for (c = 0; c < ch->channels; c++)
+			ch->src[c] = in[c] + pos;
+		for (k = 0; k < ch->kernels; k++) {
+			struct wah_kernel *kn = &ch->kernel[k];
+			uint64_t t0 = ch->timing ? now_ns() : 0;
+
+			for (c = 0; c < ch->channels; c++)
+				ch->dst[c] = k == ch->kernels - 1 ? out[c] + pos : ch->work[c];
+			run_kernel(ch, kn, len);
+			for (c = 0; c < ch->channels; c++)
+				ch->src[c] = ch->dst[c];
+			if (ch->timing)
+				kn->ns += now_ns() - t0;
+		}
+	}
+}
+
+/*
+ * wah_chain_process() - Run @n frames through the chain.
+ * @in, @out: One buffer per channel; @out may be @in.
+ *
+ * Scheduled events split the block as in wah_engine_process().
+ */
+void wah_chain_process(struct wah_chain *ch, const int32_t *const *in, int32_t *const *out,
+	size_t n)
+{
+	struct wah_event_queue *q = &ch->eng[0].events;
+	size_t pos = 0;
+	uint32_t i, j;
+	unsigned c;
+
+	for (i = 0; i < q->count && q->ev[i].offset < n; i++) {
+		size_t at = q->ev[i].offset;
+
+		if (at > pos) {
+			render(ch, in, out, pos, at - pos);
+			pos = at;
+		}
+		for (c = 0; c < ch->channels; c++)
+			wah_engine_set(&ch->eng[c], q->ev[i].param, q->ev[i].value);
+	}
+	if (pos < n)
+		render(ch, in, out, pos, n - pos);
+
+	for (j = 0; i < q->count; i++, j++) {
+		q->ev[j] = q->ev[i];
+		q->ev[j].offset -= n;
+	}
+	q->count = j;
+	ch->frames += n;
+}
@@ -0,0 +1,116 @@
+/*-------------------------------------------------------------------------
+ * Description:  Effect chain built from a description, run a chunk at a
+ *               time.
+ *
+ *               The board chain is register-controlled blocks in series
+ *               (soc_system_passthrough.qsys, the wahWahEffectProcessor
+ *               IP). A chain here is the same idea in software: stages
+ *               named in order, e.g. "wah,mixer,volume,limit", that share
+ *               one set of registers.
+ *
+ *                 wah     Fc, F1 and the state variable filter (wet)
+ *                 mixer   wet/dry mixer and enable switch; the dry
+ *                         signal is what went into wah, so a limit
+ *                         can't sit between the two
+ *                 volume  volume stage
+ *                 limit   lookahead limiter (wahLimit.c)
+ *
+ *               The description is compiled once into kernels, one per
+ *               stage, except that mixer followed by volume is a single
+ *               wah_engine_mix(), which keeps the full-width mixer
+ *               output, so "wah,mixer,volume" is exactly
+ *               wah_engine_process(). The kernels then run in turn over
+ *               each WAH_CHAIN_CHUNK frames, so whatever passes between
+ *               stages is a few hundred bytes that stay in L1, rather
+ *               than a whole block written out by one effect and read
+ *               back by the next.
+ *
+ *               That keeps a chain from getting slower than its stages
+ *               with large blocks; it does not make it faster. wahBench
+ *               chain puts the chain within noise of the same stages run
+ *               one after another (about 19-22 ns/sample either way on
+ *               the x86 build machine, -b 4096), nearly all of it in the
+ *               filter recursion and the limiter, which are serial and
+ *               block-based respectively, so there is nothing for a
+ *               single per-sample loop over all the stages to win.
+ *
+ *               With timing on, each kernel's time is added up, to see
+ *               what every stage costs in place.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_CHAIN_H
+#define WAH_CHAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahEngine.h"
+#include "wahLimit.h"
+
+/* Frames each kernel runs at a time: 1 KiB per buffer, well inside L1   */
+#define WAH_CHAIN_CHUNK 256
+
+enum wah_stage {
+	WAH_STAGE_WAH,
+	WAH_STAGE_MIXER,
+	WAH_STAGE_VOLUME,
+	WAH_STAGE_LIMIT,
+};
+
+#define WAH_STAGE_COUNT 4
+
+extern const char *const wah_stage_names[WAH_STAGE_COUNT];
+
+/*
+ * struct wah_kernel - One stage, or mixer and volume together.
+ * @first: Index of its first stage in the description.
+ * @stages: Number of stages it covers.
+ * @ns: Time spent in it with timing on.
+ * @name: Its stages joined with '+'.
+ */
+struct wah_kernel {
+	unsigned first;
+	unsigned stages;
+	uint64_t ns;
+	char name[32];
+};
+
+/*
+ * struct wah_chain - A compiled chain.
+ * @stage: enum wah_stage, in order; each at most once.
+ * @kernel: @stage grouped into what runs.
+ * @eng: One engine per channel, holding the registers, ramps and
+ *       scheduled events for wah, mixer and volume.
+ * @limit: Valid if the chain has a limit stage.
+ * @work, @keep: Per channel, one chunk of scratch and a copy of the input
+ *               of wah when that was scratch too.
+ * @dry: Per channel, the input of wah for the mixer.
+ * @src, @dst: Per channel, where the kernel being run reads and writes.
+ * @timing: Add up per-kernel times.
+ * @frames: Frames processed.
+ */
+struct wah_chain {
+	unsigned channels;
+	unsigned count;
+	unsigned stage[WAH_STAGE_COUNT];
+	unsigned kernels;
+	struct wah_kernel kernel[WAH_STAGE_COUNT];
+	struct wah_engine *eng;
+	struct wah_limit limit;
+	int32_t **work;
+	int32_t **keep;
+	const int32_t **dry;
+	const int32_t **src;
+	int32_t **dst;
+	int timing;
+	uint64_t frames;
+};
+
+int wah_chain_init(struct wah_chain *ch, const char *desc, unsigned channels,
+	const struct wah_params *p, const struct wah_limit_config *limit);
+void wah_chain_free(struct wah_chain *ch);
+unsigned wah_chain_latency(const struct wah_chain *ch);
+int wah_chain_schedule(struct wah_chain *ch, uint32_t offset, unsigned param, uint32_t value);
+void wah_chain_process(struct wah_chain *ch, const int32_t *const *in, int32_t *const *out,
+	size_t n);
+
+#endif
@@ -0,0 +1,81 @@
+/*-------------------------------------------------------------------------
+ * Description:  Show or change the parameters of a software engine through
+ *               its shared parameter block, the way effectShow does for the
+ *               wahWahEffectProcessor registers.
+ *
+ *                 wahCtl /wah0                    print the values
+ *                 wahCtl -c /wah0 minf=200 maxf=4000
+ *                 wahCtl -r /wah0 ...             unlock a block whose
+ *                                                 writer was killed
+ *
+ * Build:        gcc -O2 -o wahCtl wahCtl.c wahParamBlock.c wahEngine.c wahCycle.c
+ *                   -lrt -lm
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wahParamBlock.h"
+
+int main(int argc, char **argv){
+	struct wah_param_block *blk;
+	struct wah_params p;
+	uint32_t *regs = (uint32_t *)&p;
+	int opt, create = 0, recover = 0, changed = 0, i, j;
+
+	while ((opt = getopt(argc, argv, "crh")) != -1) {
+		switch (opt) {
+		case 'c':
+			create = 1;
+			break;
+		case 'r':
+			recover = 1;
+			break;
+		default:
+			printf("usage: %s [-c] [-r] /shm_name [field=value ...]\n", argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (optind >= argc) {
+		printf("missing shared memory name\n");
+		exit(1);
+	}
+
+	blk = wah_param_block_open(argv[optind], create);
+	if (blk == NULL) {
+		printf("failed to open parameter block %s\n", argv[optind]);
+		exit(1);
+	}
+
+	if (recover && wah_param_block_recover(blk))
+		printf("unlocked %s; its values may be half updated\n", argv[optind]);
+	if (wah_param_block_read(blk, &p) < 0) {
+		printf("parameter block %s is locked: %s (-r unlocks it)\n",
+			argv[optind], strerror(errno));
+		exit(1);
+	}
+	for (i = optind + 1; i < argc; i++) {
+		char *eq = strchr(argv[i], '=');
+
+		j = eq ? wah_param_lookup(argv[i], eq - argv[i]) : -1;
+		if (j < 0) {
+			printf("unknown setting %s\n", argv[i]);
+			exit(1);
+		}
+		regs[j] = strtoul(eq + 1, NULL, 0);
+		changed = 1;
+	}
+	if (changed && wah_param_block_write(blk, &p) < 0) {
+		printf("failed to write %s: %s\n", argv[optind], strerror(errno));
+		exit(1);
+	}
+
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		printf("%s=%u%c", wah_param_names[i], regs[i], i + 1 < WAH_PARAM_COUNT ? ' ' : '\n');
+
+	wah_param_block_close(blk);
+	return 0;
+}
@@ -0,0 +1,202 @@
+/*-------------------------------------------------------------------------
+ * Description:  Shared tables of one Fc period of F1 values.
+ *-------------------------------------------------------------------------*/
+#include <stdlib.h>
+
+#include "wahCycle.h"
+
+/* Published tables, newest first                                        */
+static const struct wah_cycle *cycles;
+/* Bytes they take                                                       */
+static size_t cyclesSize;
+
+/*
+ * wah_f1_wave() - F1 for every sine phase, wah_f1_at() unfolded; filled
+ * on first use.
+ *
+ * Replaying a table then costs two loads a sample and no folding.
+ */
+const int64_t *wah_f1_wave(void)
+{
+	static int64_t f1[4096];
+	static int state;	// 0 empty, 1 being filled, 2 ready
+	int expected = 0;
+	unsigned ph;
+
+	if (__atomic_load_n(&state, __ATOMIC_ACQUIRE) == 2)
+		return f1;
+	if (__atomic_compare_exchange_n(&state, &expected, 1, 0, __ATOMIC_ACQUIRE,
+			__ATOMIC_RELAXED)) {
+		for (ph = 0; ph < 4096; ph++)
+			f1[ph] = wah_f1_at(ph);
+		__atomic_store_n(&state, 2, __ATOMIC_RELEASE);
+	}
+	// Another thread is filling it; 4096 entries take a few microseconds.
+	while (__atomic_load_n(&state, __ATOMIC_ACQUIRE) != 2)
+		;
+	return f1;
+}
+
+static int matches(const struct wah_cycle *c, uint32_t minf, uint32_t maxf, uint32_t delta,
+	int64_t start)
+{
+	return c->minf == minf && c->maxf == maxf && c->delta == delta && c->start == start;
+}
+
+/*
+ * wah_cycle_find() - The published table for these registers and
+ * @start (see wah_cycle_start()).
+ *
+ * Never locks or allocates; safe on a real-time thread.
+ *
+ * Return: The table, or NULL if none has been built.
+ */
+const struct wah_cycle *wah_cycle_find(uint32_t minf, uint32_t maxf, uint32_t delta,
+	int64_t start)
+{
+	const struct wah_cycle *c;
+
+	for (c = __atomic_load_n(&cycles, __ATOMIC_ACQUIRE); c != NULL; c = c->next)
+		if (matches(c, minf, maxf, delta, start))
+			return c;
+	return NULL;
+}
+
+/*
+ * wah_cycle_get() - The table for these registers and @start, built and
+ * published if there is none yet.
+ *
+ * The table is filled by stepping wah_lfo_step() through the period, and
+ * every state on the way is checked against the two straight phases that
+ * wah_cycle_index() assumes, so replaying it gives exactly what stepping
+ * would. Two threads building the same table at once both build it; the
+ * second to publish drops its copy and returns the first.
+ *
+ * Return: The table, or NULL for delta 0, a @start that isn't in
+ * [-delta, -1], a period longer than WAH_CYCLE_MAX, tables over
+ * WAH_CYCLE_BUDGET or no memory.
+ */
+const struct wah_cycle *wah_cycle_get(uint32_t minf, uint32_t maxf, uint32_t delta,
+	int64_t start)
+{
+	const int64_t w = ((int64_t)maxf - (int64_t)minf) << 16, d = delta;
+	const struct wah_cycle *c = wah_cycle_find(minf, maxf, delta, start), *head;
+	struct wah_lfo lfo = { start, 1 };
+	struct wah_cycle *n;
+	int64_t top = 0;
+	uint32_t up = 0, len = 0, j;
+	size_t size;
+	int32_t dir;
+
+	if (c != NULL || d == 0 || start < -d || start >= 0)
+		return c;
+	// An up and a down phase of about w / delta steps each.
+	if (w / d >= WAH_CYCLE_MAX / 2)
+		return NULL;
+
+	do {
+		dir = lfo.dir;
+		wah_lfo_step(&lfo, minf, maxf, delta);
+		if (++len > WAH_CYCLE_MAX)
+			return NULL;
+		if (dir && !lfo.dir) {
+			up = len;
+			top = lfo.acc;
+		}
+	} while (dir || !lfo.dir);
+	if (up == 0 || lfo.acc != start)
+		return NULL;
+
+	size = sizeof(*n) + (size_t)len * sizeof(n->phase[0]);
+	if (__atomic_add_fetch(&cyclesSize, size, __ATOMIC_RELAXED) > WAH_CYCLE_BUDGET)
+		goto over;
+	n = malloc(size);
+	if (n == NULL)
+		goto over;
+	n->minf = minf;
+	n->maxf = maxf;
+	n->delta = delta;
+	n->start = start;
+	n->top = top;
+	n->up = up;
+	n->len = len;
+	n->wave = wah_f1_wave();
+
+	lfo.acc = start;
+	lfo.dir = 1;
+	for (j = 0; j < len; j++) {
+		if (lfo.acc != (j < up ? start + j * d : top - (j - up) * d) || !lfo.dir != !(j < up)) {
+			free(n);
+			goto over;
+		}
+		n->phase[j] = (uint16_t)wah_f1_phase(wah_lfo_step(&lfo, minf, maxf, delta));
+	}
+
+	head = __atomic_load_n(&cycles, __ATOMIC_ACQUIRE);
+	do {
+		for (c = head; c != NULL; c = c->next)
+			if (matches(c, minf, maxf, delta, start)) {
+				free(n);
+				__atomic_sub_fetch(&cyclesSize, size, __ATOMIC_RELAXED);
+				return c;
+			}
+		n->next = head;
+	} while (!__atomic_compare_exchange_n(&cycles, &head, n, 0, __ATOMIC_RELEASE,
+			__ATOMIC_ACQUIRE));
+	return n;
+
+over:
+	__atomic_sub_fetch(&cyclesSize, size, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+/*
+ * wah_cycle_index() - Where on @c the triangle state @lfo is.
+ *
+ * Return: The index whose sample is stepped next, or -1 if @lfo is not on
+ * the cycle (still on its way in after a register change).
+ */
+int64_t wah_cycle_index(const struct wah_cycle *c, const struct wah_lfo *lfo)
+{
+	int64_t k = lfo->dir ? lfo->acc - c->start : c->top - lfo->acc;
+
+	if (k < 0 || k % c->delta != 0)
+		return -1;
+	k /= c->delta;
+	if (lfo->dir)
+		return k < c->up ? k : -1;
+	return k < c->len - c->up ? c->up + k : -1;
+}
+
+/*
+ * wah_cycle_state() - The triangle state at @index of @c, the inverse of
+ * wah_cycle_index().
+ */
+void wah_cycle_state(const struct wah_cycle *c, uint32_t index, struct wah_lfo *lfo)
+{
+	lfo->dir = index < c->up;
+	lfo->acc = lfo->dir ? c->start + (int64_t)index * c->delta :
+		c->top - (int64_t)(index - c->up) * c->delta;
+}
+
+/* Bytes all published tables take                                       */
+size_t wah_cycles_size(void)
+{
+	return __atomic_load_n(&cyclesSize, __ATOMIC_RELAXED);
+}
+
+/*
+ * wah_cycles_free() - Free every table.
+ *
+ * Only with no engine running that might still hold one.
+ */
+void wah_cycles_free(void)
+{
+	const struct wah_cycle *c = __atomic_exchange_n(&cycles, NULL, __ATOMIC_ACQ_REL), *next;
+
+	for (; c != NULL; c = next) {
+		next = c->next;
+		free((void *)c);
+	}
+	__atomic_store_n(&cyclesSize, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,89 @@
+/*-------------------------------------------------------------------------
+ * Description:  Shared tables of one Fc period of F1 values.
+ *
+ *               With minf, maxf and delta held, the Fc triangle repeats
+ *               exactly once it has turned upwards from just below minf
+ *               (see wah_lfo_advance()), and F1 with it: about
+ *               2 * (maxf - minf) / delta samples, 2.4 s with the
+ *               createSimParams.m settings. A cycle table holds one such
+ *               period as the 12-bit sine phases F1.vhd looks up, two
+ *               bytes a sample, so an engine on the cycle reads each F1
+ *               off the table in order instead of stepping Fc and folding
+ *               the quarter-wave table every sample. Q1 is constant for a
+ *               given damp and needs no table.
+ *
+ *               Where a period starts depends on where the triangle was
+ *               when the registers were written: it turns up at acc
+ *               @start in [-delta, -1], which is acc modulo delta and
+ *               never changes while the registers hold. Engines started
+ *               from reset all have @start -delta, so they share a table.
+ *
+ *               Tables live in one list per process and are shared by
+ *               every engine with the same settings. Once published a
+ *               table never changes and is not freed until
+ *               wah_cycles_free(), which a tool calls at exit with no
+ *               engine running; an engine keeps a plain pointer, and
+ *               copying an engine copies the pointer. Looking a table up
+ *               never locks or allocates. Building one allocates and runs
+ *               through the whole period once, so it stays off real-time
+ *               threads unless the table is built ahead.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_CYCLE_H
+#define WAH_CYCLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahFixed.h"
+
+/* Longest period kept, in samples (43.7 s at 48 kHz, 4 MB)               */
+#define WAH_CYCLE_MAX (1 << 21)
+/* Most memory all tables together may take                              */
+#define WAH_CYCLE_BUDGET ((size_t)32 << 20)
+
+/*
+ * struct wah_cycle - One period of the Fc triangle.
+ * @next: Next table in the process-wide list.
+ * @minf, @maxf, @delta: Registers the table is for.
+ * @start: acc at index 0, just after the upward turn (dir 1).
+ * @top: acc at index @up, just after the downward turn (dir 0).
+ * @up: Samples in the up phase.
+ * @len: Samples in the period.
+ * @wave: F1 for each of the 4096 phases.
+ * @phase: wah_f1_phase() of the sample stepped from each index.
+ */
+struct wah_cycle {
+	const struct wah_cycle *next;
+	uint32_t minf;
+	uint32_t maxf;
+	uint32_t delta;
+	int64_t start;
+	int64_t top;
+	uint32_t up;
+	uint32_t len;
+	const int64_t *wave;
+	uint16_t phase[];
+};
+
+/*
+ * wah_cycle_start() - The @start of the period a triangle at @acc runs
+ * in, for @delta > 0.
+ */
+static inline int64_t wah_cycle_start(int64_t acc, uint32_t delta)
+{
+	int64_t r = acc % (int64_t)delta;
+
+	return (r < 0 ? r + delta : r) - (int64_t)delta;
+}
+
+const int64_t *wah_f1_wave(void);
+const struct wah_cycle *wah_cycle_find(uint32_t minf, uint32_t maxf, uint32_t delta,
+	int64_t start);
+const struct wah_cycle *wah_cycle_get(uint32_t minf, uint32_t maxf, uint32_t delta,
+	int64_t start);
+int64_t wah_cycle_index(const struct wah_cycle *c, const struct wah_lfo *lfo);
+void wah_cycle_state(const struct wah_cycle *c, uint32_t index, struct wah_lfo *lfo);
+size_t wah_cycles_size(void);
+void wah_cycles_free(void);
+
+#endif
@@ -0,0 +1,474 @@
+/*-------------------------------------------------------------------------
+ * Description:  Software wah engine, sample loop.
+ *-------------------------------------------------------------------------*/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wahEngine.h"
+
+/* Register names as the tools print and parse them                      */
+const char *const wah_param_names[WAH_PARAM_COUNT] = {
+	"enable", "volume", "damp", "minf", "maxf", "delta", "wetDry",
+};
+
+/*
+ * wah_params_default() - The settings createSimParams.m simulates with.
+ */
+void wah_params_default(struct wah_params *p)
+{
+	p->enable = 1;
+	p->volume = 0xffff;	// 1.0 saturates to the largest ufix16_En16
+	p->damp = 1966;		// 0.03
+	p->minf = 100;
+	p->maxf = 3000;
+	p->delta = 3277;	// 0.05 Hz per sample
+	p->wetDry = 32768;	// 0.5
+}
+
+void wah_engine_init(struct wah_engine *eng, const struct wah_params *p)
+{
+	memset(eng, 0, sizeof(*eng));
+	wah_engine_set_params(eng, p);
+	wah_ramp_jump(&eng->volume, eng->params.volume);
+	wah_ramp_jump(&eng->wetDry, eng->params.wetDry);
+}
+
+/*
+ * wah_engine_reset() - Clear the filter and LFO as a hardware reset would.
+ */
+void wah_engine_reset(struct wah_engine *eng)
+{
+	memset(&eng->lfo, 0, sizeof(eng->lfo));
+	memset(&eng->svf, 0, sizeof(eng->svf));
+}
+
+/*
+ * wah_engine_seek() - Jump to sample @index of a render started at reset.
+ *
+ * The Fc triangle lands exactly where it would have been with the
+ * current registers (wah_lfo_advance()). The filter restarts from
+ * silence, pending events are dropped and ramps settle on their targets;
+ * the filter state converges on the serial one within a few thousand
+ * samples of the same input.
+ */
+void wah_engine_seek(struct wah_engine *eng, uint64_t index)
+{
+	wah_engine_reset(eng);
+	wah_lfo_advance(&eng->lfo, eng->params.minf, eng->params.maxf, eng->params.delta, index);
+	wah_ramp_jump(&eng->volume, eng->params.volume);
+	wah_ramp_jump(&eng->wetDry, eng->params.wetDry);
+	eng->events.count = 0;
+}
+
+/*
+ * wah_engine_set_params() - Load new register values.
+ *
+ * Values are cut to the register widths the HDL sees, so writing the
+ * same 32-bit words as effectHardware.c gives the same result.
+ */
+void wah_engine_set_params(struct wah_engine *eng, const struct wah_params *p)
+{
+	const uint32_t *regs = (const uint32_t *)p;
+	unsigned i;
+
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		wah_engine_set(eng, i, regs[i]);
+}
+
+/*
+ * wah_params_set() - Set one register of @p by id, masked to its width.
+ */
+void wah_params_set(struct wah_params *p, unsigned param, uint32_t value)
+{
+	uint32_t *regs = (uint32_t *)p;
+
+	if (param >= WAH_PARAM_COUNT)
+		return;
+	regs[param] = value & (param == WAH_ENABLE ? 0x1 : 0xffff);
+}
+
+/*
+ * wah_param_lookup() - Parameter id of the first @len characters of @name.
+ *
+ * Return: enum wah_param_id, or -1 if no register has that name.
+ */
+int wah_param_lookup(const char *name, size_t len)
+{
+	int i;
+
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		if (strlen(wah_param_names[i]) == len && strncmp(name, wah_param_names[i], len) == 0)
+			return i;
+	return -1;
+}
+
+/*
+ * wah_engine_set() - Set one register; volume and wetDry ramp if enabled.
+ */
+void wah_engine_set(struct wah_engine *eng, unsigned param, uint32_t value)
+{
+	const struct wah_params old = eng->params;
+
+	wah_params_set(&eng->params, param, value);
+
+	if (param == WAH_VOLUME)
+		wah_ramp_start(&eng->volume, eng->params.volume, eng->rampShape,
+			eng->rampSamples, eng->rampCoef);
+	else if (param == WAH_WETDRY)
+		wah_ramp_start(&eng->wetDry, eng->params.wetDry, eng->rampShape,
+			eng->rampSamples, eng->rampCoef);
+	else if (eng->params.minf != old.minf || eng->params.maxf != old.maxf ||
+		 eng->params.delta != old.delta)
+		eng->still = 0;
+}
+
+/*
+ * wah_engine_set_ramp() - Ramp future volume and wetDry changes.
+ * @shape: WAH_RAMP_LINEAR or WAH_RAMP_EXP.
+ * @samples: Ramp time. Linear ramps arrive after exactly this many
+ *           samples; exponential ones are within 1/1000 (-60 dB) of the
+ *           distance by then and settle once within an LSB.
+ *           0 restores the hardware's instant switching.
+ */
+void wah_engine_set_ramp(struct wah_engine *eng, unsigned shape, uint32_t samples)
+{
+	eng->rampShape = shape;
+	eng->rampSamples = samples;
+	eng->rampCoef = 0;
+	if (samples)
+		eng->rampCoef = (int64_t)(exp(-log(1000.0) * WAH_RAMP_CHUNK / samples) *
+			(1 << WAH_RAMP_COEF_BITS));
+}
+
+/*
+ * wah_engine_set_cycles() - Replay F1 from cycle tables (wahCycle.h).
+ *
+ * With minf, maxf and delta held, wah_engine_filter() then takes F1 from
+ * the shared table for the settings once the triangle is on its cycle,
+ * with exactly the same output. A table another engine already built is
+ * used straight away. Otherwise the engine builds it itself once the
+ * settings have held for a period, so a sweep being morphed or a knob
+ * being turned never pays for tables it wouldn't replay; building
+ * allocates, so a real-time host builds with wah_cycle_get() ahead.
+ *
+ * Off by default: the coefficients run alongside the filter recursion,
+ * so the gain is largest where they don't, on in-order cores such as the
+ * HPS Cortex-A9 (wahBench cycle).
+ */
+void wah_engine_set_cycles(struct wah_engine *eng, int on)
+{
+	eng->cycles = on != 0;
+	eng->cycle = NULL;
+}
+
+/*
+ * wah_engine_schedule() - Change a parameter at an exact sample.
+ * @offset: Sample index relative to the start of the next
+ *          wah_engine_process() call; may lie beyond that block.
+ *
+ * Return: 0 on success, -1 if the queue is full or @param is unknown.
+ */
+int wah_engine_schedule(struct wah_engine *eng, uint32_t offset, unsigned param,
+	uint32_t value)
+{
+	struct wah_event_queue *q = &eng->events;
+	uint32_t i;
+
+	if (q->count == WAH_EVENT_MAX || param >= WAH_PARAM_COUNT)
+		return -1;
+
+	// Events nearly always arrive in order, making this an append.
+	for (i = q->count; i > 0 && q->ev[i - 1].offset > offset; i--)
+		q->ev[i] = q->ev[i - 1];
+	q->ev[i].offset = offset;
+	q->ev[i].param = param;
+	q->ev[i].value = value;
+	q->count++;
+	return 0;
+}
+
+/*
+ * lfo_phase() - Steps until the Fc triangle next turns, from @lfo.
+ *
+ * Up: acc climbs by delta until fc reaches maxf, i.e. acc >= w. Down: it
+ * falls until fc drops below minf, i.e. acc < 0. The step that turns is
+ * part of the phase, so a phase is never shorter than one step.
+ */
+static int64_t lfo_phase(const struct wah_lfo *lfo, int64_t w, int64_t d)
+{
+	int64_t k = lfo->dir ? (w - lfo->acc + d - 1) / d : (lfo->acc + d) / d;
+
+	return k > 1 ? k : 1;
+}
+
+/*
+ * wah_lfo_advance() - Move the Fc triangle @n samples on in O(1).
+ *
+ * Gives exactly the state @n calls of wah_lfo_step() would leave, so
+ * renders can seek, start in the middle and resume without replaying the
+ * sweep sample by sample.
+ *
+ * Once the triangle has turned upwards from just below minf (acc in
+ * [-delta, -1]) it retraces the same values every up and down phase, so
+ * whole periods are skipped with one modulo. Saturation of the 34-bit
+ * accumulator can only happen on the single turning step of a phase,
+ * which is taken with wah_sat() like the HDL; everything in between is
+ * plain arithmetic. fc itself may saturate only where the comparison
+ * against maxf or minf gives the same answer either way.
+ */
+void wah_lfo_advance(struct wah_lfo *lfo, uint32_t minf, uint32_t maxf, uint32_t delta,
+	uint64_t n)
+{
+	const int64_t w = ((int64_t)maxf - (int64_t)minf) << 16, d = delta;
+	int cycled = 0;
+
+	if (d == 0) {
+		// No movement: dir settles after a step, or alternates.
+		struct wah_lfo next = *lfo;
+
+		if (n == 0)
+			return;
+		wah_lfo_step(&next, minf, maxf, 0);
+		if (n > 1 && !(n & 1)) {
+			struct wah_lfo again = next;
+
+			wah_lfo_step(&again, minf, maxf, 0);
+			next = again;
+		}
+		*lfo = next;
+		return;
+	}
+
+	while (n) {
+		int64_t k = lfo_phase(lfo, w, d);
+
+		if ((uint64_t)k > n) {
+			lfo->acc += lfo->dir ? (int64_t)n * d : -(int64_t)n * d;
+			return;
+		}
+		lfo->acc = wah_sat(lfo->acc + (lfo->dir ? k * d : -k * d), 34);
+		lfo->dir = !lfo->dir;
+		n -= k;
+
+		if (!cycled && lfo->dir && lfo->acc >= -d) {
+			struct wah_lfo top = *lfo;
+			int64_t up = lfo_phase(lfo, w, d);
+
+			top.acc += up * d;
+			top.dir = 0;
+			n %= (uint64_t)(up + lfo_phase(&top, w, d));
+			cycled = 1;
+		}
+	}
+}
+
+/*
+ * engine_cycle() - The cycle table @eng can replay from here.
+ * @index: Receives the position of the triangle on it.
+ *
+ * Return: The table, or NULL to step the triangle instead: delta 0, no
+ * table yet, or the triangle still on its way onto the cycle.
+ */
+static const struct wah_cycle *engine_cycle(struct wah_engine *eng, int64_t *index)
+{
+	const struct wah_params *p = &eng->params;
+	const struct wah_cycle *c = eng->cycle;
+	int64_t start;
+
+	if (p->delta == 0)
+		return NULL;
+	start = wah_cycle_start(eng->lfo.acc, p->delta);
+	if (c == NULL || c->minf != p->minf || c->maxf != p->maxf || c->delta != p->delta ||
+	    c->start != start) {
+		c = wah_cycle_find(p->minf, p->maxf, p->delta, start);
+		// A period is about twice the span over delta.
+		if (c == NULL && eng->still / 2 > (uint64_t)abs((int)p->maxf - (int)p->minf) *
+				WAH_ONE_EN16 / p->delta) {
+			c = wah_cycle_get(p->minf, p->maxf, p->delta, start);
+			if (c == NULL)
+				eng->still = 0;		// try again a period later
+		}
+		eng->cycle = c;
+		if (c == NULL)
+			return NULL;
+	}
+	*index = wah_cycle_index(c, &eng->lfo);
+	return *index < 0 ? NULL : c;
+}
+
+/*
+ * wah_engine_filter() - Fc, F1 and the state variable filter; produces
+ * the wet signal.
+ * @in: sfix24_En23 input samples.
+ * @wet: sfix24_En23 wet samples, ahead of the mixer.
+ *
+ * This is the serial part of the datapath: every sample depends on the
+ * previous one. Together with wah_engine_mix() it makes up
+ * wah_engine_process() for a block without scheduled events; the wet
+ * signal depends on damp, minf, maxf and delta only, so it can be kept
+ * and mixed again for other enable, volume and wetDry settings. With
+ * wah_engine_set_cycles() on, Fc and F1 come from a cycle table where
+ * one applies.
+ */
+void wah_engine_filter(struct wah_engine *eng, const int32_t *in, int32_t *wet, size_t n)
+{
+	const struct wah_params p = eng->params;
+	const int64_t q1 = wah_q1(p.damp);
+	struct wah_lfo lfo = eng->lfo;
+	struct wah_svf svf = eng->svf;
+	const struct wah_cycle *c;
+	int64_t index;
+	size_t i;
+
+	if (eng->cycles && (c = engine_cycle(eng, &index)) != NULL) {
+		const uint16_t *phase = c->phase;
+		const int64_t *f1 = c->wave;
+		const uint32_t len = c->len;
+		uint32_t pos = (uint32_t)index;
+
+		for (i = 0; i < n; i++) {
+			wet[i] = wah_wet(wah_svf_step(&svf, in[i], f1[phase[pos]], q1));
+			if (++pos == len)
+				pos = 0;
+		}
+		wah_cycle_state(c, pos, &eng->lfo);
+		eng->svf = svf;
+		eng->still += n;
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		int64_t f1 = wah_f1(wah_lfo_step(&lfo, p.minf, p.maxf, p.delta));
+
+		wet[i] = wah_wet(wah_svf_step(&svf, in[i], f1, q1));
+	}
+
+	eng->lfo = lfo;
+	eng->svf = svf;
+	eng->still += n;
+}
+
+/*
+ * mix() - Wet/dry mixer, enable switch and volume over one ramp piece.
+ * @wd, @wdInc: wetDry at the first sample and its per-sample step.
+ * @vol, @volInc: Same for volume.
+ *
+ * Constant settings are just a zero step, so ramping costs one add per
+ * sample and the loop has no data-dependent branches to stop the
+ * compiler from vectorising it.
+ */
+static void mix(const int32_t *dry, const int32_t *wet, int32_t *out, size_t n,
+	int64_t wd, int64_t wdInc, int64_t vol, int64_t volInc, uint32_t enable)
+{
+	uint32_t w0 = (uint32_t)(wd >> WAH_RAMP_FRAC), v0 = (uint32_t)(vol >> WAH_RAMP_FRAC);
+	size_t i;
+
+	// Settled settings, the common case: nothing but the datapath
+	// arithmetic per sample, which keeps stem mixing near copy speed.
+	if (wdInc == 0 && volInc == 0) {
+		for (i = 0; i < n; i++)
+			out[i] = wah_output(dry[i], wah_mix(dry[i], wet[i], w0), enable, v0);
+		return;
+	}
+
+	if (enable) {
+		for (i = 0; i < n; i++) {
+			uint32_t w = (uint32_t)((wd + (int64_t)i * wdInc) >> WAH_RAMP_FRAC);
+			uint32_t v = (uint32_t)((vol + (int64_t)i * volInc) >> WAH_RAMP_FRAC);
+
+			out[i] = wah_output(dry[i], wah_mix(dry[i], wet[i], w), 1, v);
+		}
+	} else {
+		for (i = 0; i < n; i++) {
+			uint32_t v = (uint32_t)((vol + (int64_t)i * volInc) >> WAH_RAMP_FRAC);
+
+			out[i] = wah_output(dry[i], 0, 0, v);
+		}
+	}
+}
+
+/*
+ * wah_engine_mix() - Wet/dry mixer and volume stage over @n samples.
+ * @dry: The input samples the wet signal was filtered from.
+ * @wet: wah_engine_filter() output.
+ * @out: sfix24_En23 output samples; may alias @dry.
+ *
+ * Runs the volume and wetDry ramps; the loops are split where a ramp
+ * piece ends.
+ */
+void wah_engine_mix(struct wah_engine *eng, const int32_t *dry, const int32_t *wet,
+	int32_t *out, size_t n)
+{
+	size_t i, len;
+
+	for (i = 0; i < n; i += len) {
+		len = n - i;
+		if (eng->volume.left && eng->volume.left < len)
+			len = eng->volume.left;
+		if (eng->wetDry.left && eng->wetDry.left < len)
+			len = eng->wetDry.left;
+
+		mix(dry + i, wet + i, out + i, len,
+			eng->wetDry.cur, eng->wetDry.inc,
+			eng->volume.cur, eng->volume.inc, eng->params.enable);
+		wah_ramp_advance(&eng->volume, (uint32_t)len);
+		wah_ramp_advance(&eng->wetDry, (uint32_t)len);
+	}
+}
+
+/*
+ * render() - Run a segment with constant register values.
+ *
+ * The inner loops have no parameter checks; wah_engine_process() cuts the
+ * block at every event instead.
+ */
+static void render(struct wah_engine *eng, const int32_t *in, int32_t *out, size_t n)
+{
+	int32_t wet[WAH_CHUNK];
+	size_t pos, c;
+
+	for (pos = 0; pos < n; pos += c) {
+		c = n - pos < WAH_CHUNK ? n - pos : WAH_CHUNK;
+		wah_engine_filter(eng, in + pos, wet, c);
+		wah_engine_mix(eng, in + pos, wet, out + pos, c);
+	}
+}
+
+/*
+ * wah_engine_process() - Run @n samples through the effect.
+ * @in: sfix24_En23 input samples.
+ * @out: sfix24_En23 output samples; may alias @in.
+ *
+ * Scheduled events that fall inside the block split it into segments of
+ * constant parameters; events for later blocks stay queued.
+ */
+void wah_engine_process(struct wah_engine *eng, const int32_t *in, int32_t *out, size_t n)
+{
+	struct wah_event_queue *q = &eng->events;
+	size_t pos = 0;
+	uint32_t i = 0, j;
+
+	if (q->count == 0) {
+		render(eng, in, out, n);
+		return;
+	}
+
+	for (; i < q->count && q->ev[i].offset < n; i++) {
+		size_t at = q->ev[i].offset;
+
+		if (at > pos) {
+			render(eng, in + pos, out + pos, at - pos);
+			pos = at;
+		}
+		wah_engine_set(eng, q->ev[i].param, q->ev[i].value);
+	}
+	if (pos < n)
+		render(eng, in + pos, out + pos, n - pos);
+
+	for (j = 0; i < q->count; i++, j++) {
+		q->ev[j] = q->ev[i];
+		q->ev[j].offset -= n;
+	}
+	q->count = j;
+}
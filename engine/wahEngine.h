@@ -0,0 +1,140 @@
+/*-------------------------------------------------------------------------
+ * Description:  Software wah engine.
+ *
+ *               Runs the wahWahEffectSystem datapath on the CPU, driven by
+ *               the same seven register values as the wahWahEffectProcessor
+ *               component (see linux/wahWahEffectProcessor.c). Audio is
+ *               sfix24_En23 held in int32_t, one channel per engine.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_ENGINE_H
+#define WAH_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahCycle.h"
+#include "wahFixed.h"
+#include "wahRamp.h"
+
+/* Sample rate the datapath is designed for (createModelParams.m)        */
+#define WAH_SAMPLE_RATE 48000
+
+/* Output revision: bump whenever any setting renders differently, so
+ * cached renders (wahCache.c) from older builds stop matching           */
+#define WAH_ENGINE_VERSION 1
+
+/*
+ * struct wah_params - Register values, in register map order.
+ * @enable: REG0, ufix1.
+ * @volume: REG1, ufix16_En16.
+ * @damp: REG2, ufix16_En16.
+ * @minf: REG3, uint16 (Hz).
+ * @maxf: REG4, uint16 (Hz).
+ * @delta: REG5, ufix16_En16 (Hz per sample).
+ * @wetDry: REG6, ufix16_En16.
+ */
+struct wah_params {
+	uint32_t enable;
+	uint32_t volume;
+	uint32_t damp;
+	uint32_t minf;
+	uint32_t maxf;
+	uint32_t delta;
+	uint32_t wetDry;
+};
+
+#define WAH_PARAM_COUNT 7
+
+/* Parameter ids, the register number of each field of struct wah_params */
+enum wah_param_id {
+	WAH_ENABLE,
+	WAH_VOLUME,
+	WAH_DAMP,
+	WAH_MINF,
+	WAH_MAXF,
+	WAH_DELTA,
+	WAH_WETDRY,
+};
+
+extern const char *const wah_param_names[WAH_PARAM_COUNT];
+
+/* Pending parameter changes an engine can hold                         */
+#define WAH_EVENT_MAX 256
+
+/*
+ * struct wah_event - A parameter change at an exact sample.
+ * @offset: Sample index, counted from the start of the next process call.
+ * @param: enum wah_param_id.
+ * @value: New register value.
+ */
+struct wah_event {
+	uint32_t offset;
+	uint32_t param;
+	uint32_t value;
+};
+
+/*
+ * struct wah_event_queue - Pending events, sorted by offset.
+ * @count: Number of entries in @ev.
+ * @ev: Events; equal offsets keep their scheduling order.
+ */
+struct wah_event_queue {
+	uint32_t count;
+	struct wah_event ev[WAH_EVENT_MAX];
+};
+
+/* Samples the filter and mixer stages hand over at a time               */
+#define WAH_CHUNK 64
+
+/*
+ * struct wah_engine - One channel of the effect.
+ * @params: Current register values, already masked to register width.
+ *          For ramped registers this is the target.
+ * @lfo: Fc triangle state.
+ * @svf: State variable filter state.
+ * @volume: Ramp feeding the volume stage.
+ * @wetDry: Ramp feeding the wet/dry mixer.
+ * @rampShape: enum wah_ramp_shape for new ramps.
+ * @rampSamples: Ramp length; 0 switches at once like the hardware.
+ * @rampCoef: Exponential decay per WAH_RAMP_CHUNK samples (Q30).
+ * @events: Parameter changes still to be applied.
+ * @cycles: Replay F1 from a shared cycle table (wahCycle.h) where one
+ *          applies; see wah_engine_set_cycles().
+ * @cycle: The table last used, or NULL.
+ * @still: Samples filtered since minf, maxf or delta last changed.
+ */
+struct wah_engine {
+	struct wah_params params;
+	struct wah_lfo lfo;
+	struct wah_svf svf;
+	struct wah_ramp volume;
+	struct wah_ramp wetDry;
+	uint32_t rampShape;
+	uint32_t rampSamples;
+	int64_t rampCoef;
+	struct wah_event_queue events;
+	uint32_t cycles;
+	const struct wah_cycle *cycle;
+	uint64_t still;
+};
+
+void wah_params_default(struct wah_params *p);
+void wah_engine_init(struct wah_engine *eng, const struct wah_params *p);
+void wah_engine_reset(struct wah_engine *eng);
+void wah_engine_seek(struct wah_engine *eng, uint64_t index);
+void wah_engine_set_params(struct wah_engine *eng, const struct wah_params *p);
+void wah_params_set(struct wah_params *p, unsigned param, uint32_t value);
+int wah_param_lookup(const char *name, size_t len);
+void wah_engine_set(struct wah_engine *eng, unsigned param, uint32_t value);
+void wah_engine_set_ramp(struct wah_engine *eng, unsigned shape, uint32_t samples);
+void wah_engine_set_cycles(struct wah_engine *eng, int on);
+int wah_engine_schedule(struct wah_engine *eng, uint32_t offset, unsigned param,
+	uint32_t value);
+void wah_lfo_advance(struct wah_lfo *lfo, uint32_t minf, uint32_t maxf, uint32_t delta,
+	uint64_t n);
+void wah_engine_filter(struct wah_engine *eng, const int32_t *in, int32_t *wet, size_t n);
+void wah_engine_mix(struct wah_engine *eng, const int32_t *dry, const int32_t *wet,
+	int32_t *out, size_t n);
+void wah_engine_process(struct wah_engine *eng, const int32_t *in, int32_t *out, size_t n);
+
+#endif
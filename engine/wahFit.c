@@ -0,0 +1,854 @@
+/*-------------------------------------------------------------------------
+ * Description:  Recovers register settings from a before/after pair.
+ *
+ *                 wahFit [options] before.wav after.wav
+ *
+ *               Searches damp, minf, maxf, delta and wetDry for the
+ *               setting whose render of before.wav sounds most like
+ *               after.wav, and prints the seven register values, ready
+ *               for wahCtl or the device:
+ *
+ *                 wahFit ../Simulink/wav/before.wav ../Simulink/wav/after.wav
+ *                 ...
+ *                 enable=1 volume=65535 damp=3558 minf=117 maxf=2915 delta=2636 wetDry=65535
+ *
+ *               The loss is spectral: both signals are cut into Hann
+ *               windowed FFT frames, the power of each frame is summed
+ *               into log-spaced bands, and the loss is the squared dB
+ *               difference over all bands and frames. The volume register
+ *               is not searched; a gain only shifts every dB value, so the
+ *               best gain for a candidate is the mean difference, solved
+ *               in closed form. Only the volume printed is capped at
+ *               unity: a target that is louder than that (after.wav is
+ *               normalized to full scale) still fits on its shape, and
+ *               the tool says how much level is missing.
+ *
+ *               Candidates are scored on a few short excerpts (-e, -l)
+ *               spread over the recording rather than the whole file.
+ *               Each one seeks the engine's Fc triangle straight to its
+ *               excerpt (wah_engine_seek()), since after.wav was made
+ *               with the triangle running from the start of the file,
+ *               and runs the filter over a short preroll (-P) first.
+ *               Excerpts are scored one at a time, and a candidate is
+ *               dropped as soon as its loss so far can no longer beat the
+ *               worst of the current elites: the loss over some excerpts,
+ *               gain solved for those alone, never exceeds the loss over
+ *               all of them, so early rejection never drops a candidate
+ *               that would have been kept.
+ *
+ *               The search is an evolution strategy over the registers
+ *               scaled to [0, 1] (log scale for frequencies and damp; the
+ *               sweep's half period in place of delta, see to_params()):
+ *               a random first generation (-i), then generations (-g) of
+ *               children (-n), each an elite (-m) with one register moved
+ *               by that register's step. A step grows while more than a
+ *               fifth of the children that moved it beat their parent and
+ *               shrinks otherwise (the 1/5th success rule), so each
+ *               register settles at its own scale and a step only shrinks
+ *               once the search stops gaining with it. A child close to
+ *               an elite competes with that elite alone, so the elites
+ *               stay spread over several basins rather than all falling
+ *               into the first one found.
+ *
+ *               The sweep's phase error grows along the recording, so
+ *               over all of it only a sweep rate right to a fraction of a
+ *               percent scores well, a target no random start hits, while
+ *               over its first second the basin is wide. Generations
+ *               therefore score the excerpts from the start only, adding
+ *               the later ones in turn until all are in two thirds of the
+ *               way through; the elites are scored again each time.
+ *
+ *               Each candidate is a task on a work-stealing pool
+ *               (wahPool.c) of -j threads. The candidates a seed produces
+ *               don't depend on the thread count, and neither does the
+ *               result, up to exact ties. One core scores some 900
+ *               candidates a second with the defaults, most of them
+ *               rejected after one or two excerpts.
+ *
+ *               The acceptance check is a round trip: render before.wav
+ *               with known registers and fit the result with the
+ *               defaults, e.g.
+ *
+ *                 wahStream before.wav rt.wav damp=9000 minf=250 maxf=2500
+ *                     delta=4000 wetDry=50000
+ *                 wahFit before.wav rt.wav
+ *
+ *               must land in the basin of the true setting: delta within
+ *               5% with the right sweep period, the other registers
+ *               within 15%, under 1 dB over the whole file. The default
+ *               seed gives damp=9412 minf=273 maxf=2532 delta=4016
+ *               wetDry=50120 at 0.50 dB, and seeds 2-8 do as well. The
+ *               last fraction of a dB is out of reach: only the exact
+ *               registers reproduce the sweep sample for sample, and one
+ *               unit off in delta already costs 0.8 dB.
+ *
+ *               -p pins a register to a value and -r changes a search
+ *               range, both in register units; -p volume=... turns off
+ *               the gain fit. At the end the best setting is scored over
+ *               the whole overlap of the two files as a check on the
+ *               excerpts.
+ *
+ * Build:        gcc -O3 -march=native -pthread -o wahFit wahFit.c wahPool.c wahWav.c
+ *                   wahEngine.c wahCycle.c -lm
+ *-------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wahEngine.h"
+#include "wahPool.h"
+#include "wahWav.h"
+
+/* Default excerpts, their length and filter preroll (ms)                */
+#define FIT_EXCERPTS 8
+#define FIT_EXCERPT_MS 250
+#define FIT_PREROLL_MS 100
+/* Default search: first generation, generations, children, elites      */
+#define FIT_INITIAL 2048
+#define FIT_GENERATIONS 30
+#define FIT_CHILDREN 512
+#define FIT_ELITES 32
+/* Step of each register in the first generation of children; after
+ * that it grows or shrinks by FIT_STEP_ADAPT a generation as more or
+ * fewer than a fifth of the children that moved it beat their parent
+ * (the 1/5th success rule). The smallest step is under one unit of
+ * delta at 4000.                                                        */
+#define FIT_STEP 0.15
+#define FIT_STEP_ADAPT 0.82
+#define FIT_STEP_MIN 1e-5
+#define FIT_STEP_MAX 0.5
+/* Elites closer than this in the unit cube are one basin              */
+#define FIT_NICHE 0.05
+/* Half periods of the Fc sweep searched (s)                              */
+#define FIT_SWEEP_MIN 0.05
+#define FIT_SWEEP_MAX 30.0
+/* Spectrum: FFT length (power of two), bands from FIT_BAND_LO Hz to
+ * Nyquist, and the floor under band powers (dB full scale)              */
+#define FIT_FFT 1024
+#define FIT_BANDS 40
+#define FIT_BAND_LO 50.0
+#define FIT_FLOOR_DB -100.0
+
+/*
+ * struct range - Search range of a register.
+ * @pinned: Not searched; always @lo.
+ * @log: Searched on a log scale.
+ */
+struct range {
+	double lo;
+	double hi;
+	int log;
+	int pinned;
+};
+
+/*
+ * struct excerpt - A stretch of the recording candidates are scored on.
+ * @start: First scored frame.
+ * @preroll: Frames filtered before @start.
+ * @len: Scored frames; a whole number of FFT frames.
+ * @target: after.wav band powers (dB), FIT_BANDS per FFT frame.
+ */
+struct excerpt {
+	uint64_t start;
+	size_t preroll;
+	size_t len;
+	double *target;
+};
+
+/*
+ * struct loss - Running sums of the dB differences of a candidate.
+ * @sum, @sum2: Sum and sum of squares of target - render.
+ * @n: Differences summed.
+ */
+struct loss {
+	double sum;
+	double sum2;
+	double n;
+};
+
+/*
+ * struct cand - A candidate setting.
+ * @u: Position in the unit cube, per register.
+ * @p: Register values; @p.volume is filled in from the gain fit.
+ * @loss: Over the excerpts scored, or where it was rejected.
+ * @parent: Loss of the elite it was drawn around; INFINITY if random.
+ * @reg: Register moved from the parent.
+ * @rejected: Dropped early.
+ */
+struct cand {
+	double u[WAH_PARAM_COUNT];
+	struct wah_params p;
+	double loss;
+	double parent;
+	unsigned reg;
+	int rejected;
+};
+
+/* Per-worker scratch buffers                                           */
+struct scratch {
+	int32_t *out;
+	double *re;
+	double *im;
+	double *bands;
+};
+
+static struct range ranges[WAH_PARAM_COUNT] = {
+	[WAH_ENABLE] = { 1, 1, 0, 1 },
+	[WAH_VOLUME] = { 0, 0xffff, 0, 0 },
+	[WAH_DAMP] = { 328, 32768, 1, 0 },
+	[WAH_MINF] = { 30, 2000, 1, 0 },
+	[WAH_MAXF] = { 200, 10000, 1, 0 },
+	[WAH_DELTA] = { 137, 27307, 1, 0 },
+	[WAH_WETDRY] = { 0, 0xffff, 0, 0 },
+};
+
+static int32_t *source, *reference;
+static uint64_t frames;
+static struct excerpt *excerpts;
+static unsigned excerpt_count = FIT_EXCERPTS, horizon;
+static size_t excerpt_len = FIT_EXCERPT_MS * WAH_SAMPLE_RATE / 1000;
+static size_t preroll = FIT_PREROLL_MS * WAH_SAMPLE_RATE / 1000;
+static unsigned workers;
+static struct scratch *scratch;
+
+static double window[FIT_FFT];
+static double twiddle_re[FIT_FFT / 2], twiddle_im[FIT_FFT / 2];
+static unsigned band_edge[FIT_BANDS + 1];
+
+// Search state: elites sorted by loss, the loss a candidate has to beat
+// to join them (the worst elite's once there are enough) and, per
+// register, the children of this generation that moved it and did
+// better than their parent.
+static struct cand *elites;
+static unsigned elite_count, elite_max = FIT_ELITES;
+static double bound = INFINITY;
+static pthread_mutex_t elite_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t scored, rejected, excerpts_run, successes[WAH_PARAM_COUNT];
+
+static double now_s(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t xorshift(uint64_t *s){
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static double uniform(uint64_t *s){
+	return (xorshift(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gauss(uint64_t *s){
+	double a = uniform(s), b = uniform(s);
+
+	return sqrt(-2 * log(a > 0 ? a : 1e-300)) * cos(2 * M_PI * b);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Spectrum                                                              */
+/*-----------------------------------------------------------------------*/
+static void spectrum_init(void)
+{
+	const double nyquist = WAH_SAMPLE_RATE / 2.0;
+	unsigned i, b;
+
+	for (i = 0; i < FIT_FFT; i++)
+		window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / FIT_FFT);
+	for (i = 0; i < FIT_FFT / 2; i++) {
+		twiddle_re[i] = cos(2 * M_PI * i / FIT_FFT);
+		twiddle_im[i] = -sin(2 * M_PI * i / FIT_FFT);
+	}
+	// Log-spaced edges in bins, at least one bin per band.
+	for (b = 0; b <= FIT_BANDS; b++) {
+		double f = FIT_BAND_LO * pow(nyquist / FIT_BAND_LO, (double)b / FIT_BANDS);
+		unsigned k = (unsigned)lround(f * FIT_FFT / WAH_SAMPLE_RATE);
+
+		if (b > 0 && k <= band_edge[b - 1])
+			k = band_edge[b - 1] + 1;
+		band_edge[b] = k;
+	}
+	band_edge[FIT_BANDS] = FIT_FFT / 2;
+}
+
+/*
+ * fft() - In-place radix-2 FFT of FIT_FFT points.
+ */
+static void fft(double *re, double *im)
+{
+	unsigned i, j, len, k;
+
+	for (i = 1, j = 0; i < FIT_FFT; i++) {
+		unsigned bit = FIT_FFT >> 1;
+
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j |= bit;
+		if (i < j) {
+			double t = re[i];
+
+			re[i] = re[j];
+			re[j] = t;
+			t = im[i];
+			im[i] = im[j];
+			im[j] = t;
+		}
+	}
+	for (len = 2; len <= FIT_FFT; len <<= 1) {
+		unsigned step = FIT_FFT / len;
+
+		for (i = 0; i < FIT_FFT; i += len)
+			for (k = 0; k < len / 2; k++) {
+				double wr = twiddle_re[k * step], wi = twiddle_im[k * step];
+				double *ar = re + i + k, *ai = im + i + k;
+				double *br = ar + len / 2, *bi = ai + len / 2;
+				double tr = *br * wr - *bi * wi, ti = *br * wi + *bi * wr;
+
+				*br = *ar - tr;
+				*bi = *ai - ti;
+				*ar += tr;
+				*ai += ti;
+			}
+	}
+}
+
+/*
+ * bands() - Band powers (dB full scale) of @n samples, FIT_BANDS per FFT
+ * frame, into @db.
+ */
+static void bands(const int32_t *x, size_t n, struct scratch *s, double *db)
+{
+	const double scale = 1.0 / (8388608.0 * FIT_FFT / 4);
+	const double floor = pow(10, FIT_FLOOR_DB / 10);
+	size_t f;
+	unsigned i, b;
+
+	for (f = 0; f + FIT_FFT <= n; f += FIT_FFT, db += FIT_BANDS) {
+		for (i = 0; i < FIT_FFT; i++) {
+			s->re[i] = x[f + i] * scale * window[i];
+			s->im[i] = 0;
+		}
+		fft(s->re, s->im);
+		for (b = 0; b < FIT_BANDS; b++) {
+			double p = floor;
+
+			for (i = band_edge[b]; i < band_edge[b + 1]; i++)
+				p += s->re[i] * s->re[i] + s->im[i] * s->im[i];
+			db[b] = 10 * log10(p);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* Scoring                                                               */
+/*-----------------------------------------------------------------------*/
+/*
+ * gain_db() - The gain that best fits the sums so far: their mean, or
+ * 0 dB when the volume is pinned (it is already in the render).
+ */
+static double gain_db(const struct loss *l){
+	return ranges[WAH_VOLUME].pinned || l->n == 0 ? 0 : l->sum / l->n;
+}
+
+/*
+ * loss_value() - Squared dB error with the best gain for the sums so far.
+ */
+static double loss_value(const struct loss *l){
+	double g = gain_db(l);
+
+	return l->sum2 - 2 * g * l->sum + l->n * g * g;
+}
+
+static uint32_t gain_volume(const struct loss *l){
+	double g = gain_db(l);
+
+	if (ranges[WAH_VOLUME].pinned)
+		return (uint32_t)ranges[WAH_VOLUME].lo;
+	return g >= 0 ? 0xffff : (uint32_t)lround(0xffff * pow(10, g / 20));
+}
+
+/*
+ * score_excerpt() - Render @x with @p and add its dB differences to @l.
+ */
+static void score_excerpt(const struct excerpt *x, const struct wah_params *p,
+	struct scratch *s, struct loss *l)
+{
+	struct wah_engine eng;
+	const size_t n = x->preroll + x->len;
+	const double *t = x->target;
+	double *db = s->bands;
+	size_t i;
+
+	wah_engine_init(&eng, p);
+	wah_engine_seek(&eng, x->start - x->preroll);
+	wah_engine_process(&eng, source + x->start - x->preroll, s->out, n);
+	bands(s->out + x->preroll, x->len, s, db);
+	for (i = 0; i < x->len / FIT_FFT * FIT_BANDS; i++) {
+		double d = t[i] - db[i];
+
+		l->sum += d;
+		l->sum2 += d * d;
+	}
+	l->n += (double)(x->len / FIT_FFT * FIT_BANDS);
+}
+
+/*
+ * to_params() - Register values of a point of the unit cube.
+ *
+ * The delta coordinate is the half period of the Fc sweep, log scaled
+ * from FIT_SWEEP_MIN to FIT_SWEEP_MAX, rather than delta itself: the
+ * period is what the loss pins down, to a fraction of a percent over a
+ * long recording, and searched as delta it would tie minf, maxf and
+ * delta to a thin diagonal ridge that steps along the axes can't follow.
+ * delta follows from the period and minf and maxf, within its range.
+ */
+static void to_params(const double *u, struct wah_params *p)
+{
+	uint32_t *regs = (uint32_t *)p;
+	unsigned i;
+
+	for (i = 0; i < WAH_PARAM_COUNT; i++) {
+		const struct range *r = &ranges[i];
+		double v;
+
+		if (r->pinned)
+			v = r->lo;
+		else if (r->log)
+			v = r->lo * pow(r->hi / r->lo, u[i]);
+		else
+			v = r->lo + u[i] * (r->hi - r->lo);
+		regs[i] = (uint32_t)lround(v);
+	}
+	regs[WAH_VOLUME] = ranges[WAH_VOLUME].pinned ? regs[WAH_VOLUME] : 0xffff;
+	if (!ranges[WAH_MAXF].pinned && !ranges[WAH_MINF].pinned) {
+		const struct range *r = &ranges[WAH_MAXF];
+		double lo = r->lo > p->minf ? r->lo : p->minf;
+
+		p->maxf = (uint32_t)lround(lo < r->hi ? lo * pow(r->hi / lo, u[WAH_MAXF]) : r->hi);
+	}
+	if (p->maxf < p->minf) {
+		uint32_t t = p->minf;
+
+		p->minf = p->maxf;
+		p->maxf = t;
+	}
+	if (!ranges[WAH_DELTA].pinned) {
+		const struct range *r = &ranges[WAH_DELTA];
+		double half = FIT_SWEEP_MIN * pow(FIT_SWEEP_MAX / FIT_SWEEP_MIN, u[WAH_DELTA]);
+		double v = (p->maxf - p->minf) * 65536.0 / (half * WAH_SAMPLE_RATE);
+
+		p->delta = (uint32_t)lround(v < r->lo ? r->lo : v > r->hi ? r->hi : v);
+	}
+}
+
+/* Registers the search moves: volume comes from the gain fit          */
+static int searched(unsigned reg){
+	return !ranges[reg].pinned && reg != WAH_VOLUME;
+}
+
+/*
+ * elite_add() - Keep @c if it is among the best elite_max so far.
+ *
+ * Within FIT_NICHE of an elite, @c only competes with that elite, so one
+ * basin holds one elite and the rest stay spread over others.
+ */
+static void elite_add(const struct cand *c)
+{
+	unsigned i, k, slot = elite_count, near = elite_count;
+	double best = FIT_NICHE * FIT_NICHE;
+
+	pthread_mutex_lock(&elite_lock);
+	for (i = 0; i < elite_count; i++) {
+		double d = 0;
+
+		for (k = 0; k < WAH_PARAM_COUNT; k++)
+			if (searched(k))
+				d += (elites[i].u[k] - c->u[k]) * (elites[i].u[k] - c->u[k]);
+		if (d < best) {
+			best = d;
+			near = i;
+		}
+	}
+	if (near < elite_count)
+		slot = c->loss < elites[near].loss ? near : elite_max;
+	else if (elite_count < elite_max)
+		slot = elite_count++;
+	else if (c->loss < elites[elite_count - 1].loss)
+		slot = elite_count - 1;
+	else
+		slot = elite_max;
+	if (slot < elite_max) {
+		for (i = slot; i > 0 && elites[i - 1].loss > c->loss; i--)
+			elites[i] = elites[i - 1];
+		elites[i] = *c;
+		if (elite_count == elite_max)
+			__atomic_store(&bound, &elites[elite_count - 1].loss, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&elite_lock);
+}
+
+/*
+ * evaluate() - Pool task: score a candidate excerpt by excerpt, over
+ * the first @horizon.
+ */
+static void evaluate(struct wah_pool *pool, void *arg, unsigned worker)
+{
+	struct cand *c = arg;
+	struct loss l = { 0, 0, 0 };
+	unsigned e;
+	double b;
+
+	(void)pool;
+	to_params(c->u, &c->p);
+	for (e = 0; e < horizon; e++) {
+		score_excerpt(&excerpts[e], &c->p, &scratch[worker], &l);
+		__atomic_fetch_add(&excerpts_run, 1, __ATOMIC_RELAXED);
+		c->loss = loss_value(&l);
+		__atomic_load(&bound, &b, __ATOMIC_RELAXED);
+		if (c->loss >= b) {
+			c->rejected = 1;
+			__atomic_fetch_add(&rejected, 1, __ATOMIC_RELAXED);
+			break;
+		}
+	}
+	__atomic_fetch_add(&scored, 1, __ATOMIC_RELAXED);
+	if (!c->rejected) {
+		if (c->loss < c->parent)
+			__atomic_fetch_add(&successes[c->reg], 1, __ATOMIC_RELAXED);
+		c->p.volume = gain_volume(&l);
+		elite_add(c);
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* Setup                                                                 */
+/*-----------------------------------------------------------------------*/
+static int32_t *load(const char *path, unsigned channel, uint64_t *n)
+{
+	struct wah_wav w;
+	int32_t **ch, *keep;
+	unsigned c;
+
+	if (wah_wav_open(&w, path) < 0) {
+		printf("failed to open %s: %s\n", path,
+			errno == EINVAL ? "not a supported WAV file" : strerror(errno));
+		exit(1);
+	}
+	if (w.rate != WAH_SAMPLE_RATE) {
+		printf("%s: %u Hz, the engine runs at %d Hz\n", path, w.rate, WAH_SAMPLE_RATE);
+		exit(1);
+	}
+	if (channel >= w.channels)
+		channel = 0;
+	ch = malloc(w.channels * sizeof(*ch));
+	for (c = 0; c < w.channels; c++)
+		ch[c] = malloc((w.frames ? w.frames : 1) * sizeof(int32_t));
+	wah_wav_decode(&w, 0, w.frames, ch);
+	keep = ch[channel];
+	for (c = 0; c < w.channels; c++)
+		if (c != channel)
+			free(ch[c]);
+	free(ch);
+	*n = w.frames;
+	wah_wav_close(&w);
+	return keep;
+}
+
+/*
+ * make_excerpts() - Spread the excerpts evenly over the recording and work
+ * out their target spectra.
+ */
+static void make_excerpts(void)
+{
+	const size_t len = excerpt_len / FIT_FFT * FIT_FFT;
+	unsigned e;
+
+	if (len == 0 || frames < len) {
+		printf("recordings too short for %zu-frame excerpts\n", excerpt_len);
+		exit(1);
+	}
+	excerpts = calloc(excerpt_count, sizeof(*excerpts));
+	for (e = 0; e < excerpt_count; e++) {
+		struct excerpt *x = &excerpts[e];
+
+		x->start = (frames - len) * (2 * e + 1) / (2 * excerpt_count);
+		x->preroll = x->start < preroll ? x->start : preroll;
+		x->len = len;
+		x->target = malloc(len / FIT_FFT * FIT_BANDS * sizeof(double));
+		bands(reference + x->start, len, &scratch[0], x->target);
+	}
+}
+
+static void set_range(const char *arg, int pin)
+{
+	const char *eq = strchr(arg, '=');
+	int id = eq ? wah_param_lookup(arg, eq - arg) : -1;
+	struct range *r;
+	char *end;
+
+	if (id < 0) {
+		printf("unknown register in %s\n", arg);
+		exit(1);
+	}
+	r = &ranges[id];
+	r->lo = strtod(eq + 1, &end);
+	r->hi = r->lo;
+	if (!pin && *end == ':')
+		r->hi = strtod(end + 1, &end);
+	if (*end != '\0' || r->lo < 0 || r->hi < r->lo || r->hi > 0xffff ||
+	    (r->log && r->lo <= 0)) {
+		printf("bad value in %s\n", arg);
+		exit(1);
+	}
+	r->pinned = pin || r->lo == r->hi;
+}
+
+/*
+ * horizon_at() - Excerpts scored in generation @g: the first one to
+ * begin with, all of them from two thirds of the way on.
+ */
+static unsigned horizon_at(unsigned g, unsigned generations){
+	const unsigned ramp = generations * 2 / 3;
+
+	if (g >= ramp)
+		return excerpt_count;
+	return 1 + (excerpt_count - 1) * g / ramp;
+}
+
+static void print_params(const struct wah_params *p){
+	const uint32_t *regs = (const uint32_t *)p;
+	unsigned i;
+
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		printf("%s%s=%u", i ? " " : "", wah_param_names[i], regs[i]);
+	printf("\n");
+}
+
+/*-----------------------------------------------------------------------*/
+/* Driver                                                                */
+/*-----------------------------------------------------------------------*/
+static void usage(const char *prog){
+	printf("usage: %s [-j threads] [-e excerpts] [-l ms] [-P ms] [-i initial] [-g generations]\n",
+		prog);
+	printf("       [-n children] [-m elites] [-s seed] [-c channel] [-p reg=value] [-r reg=lo:hi]\n");
+	printf("       [-q] before.wav after.wav\n");
+	printf("  -j  worker threads (default: one per CPU)\n");
+	printf("  -e  excerpts scored per candidate (default: %d)\n", FIT_EXCERPTS);
+	printf("  -l  excerpt length in ms (default: %d)\n", FIT_EXCERPT_MS);
+	printf("  -P  filter preroll before each excerpt in ms (default: %d)\n", FIT_PREROLL_MS);
+	printf("  -i  random candidates in the first generation (default: %d)\n", FIT_INITIAL);
+	printf("  -g  generations after the first (default: %d)\n", FIT_GENERATIONS);
+	printf("  -n  children per generation (default: %d)\n", FIT_CHILDREN);
+	printf("  -m  elites children are drawn around (default: %d)\n", FIT_ELITES);
+	printf("  -s  random seed (default: 1)\n");
+	printf("  -c  channel of before.wav to filter (default: 0, left)\n");
+	printf("  -p  pin a register, e.g. -p wetDry=65535; can be repeated\n");
+	printf("  -r  search a register over lo:hi, in register units; can be repeated\n");
+	printf("  -q  no progress output\n");
+}
+
+int main(int argc, char **argv){
+	struct wah_pool pool;
+	struct cand *gen;
+	struct scratch full;
+	struct excerpt whole;
+	struct loss l = { 0, 0, 0 };
+	uint64_t seed = 1, refFrames;
+	unsigned initial = FIT_INITIAL, generations = FIT_GENERATIONS, children = FIT_CHILDREN;
+	unsigned channel = 0, g, i, j, k, count;
+	double step[WAH_PARAM_COUNT], t0, t;
+	unsigned regs[WAH_PARAM_COUNT], nregs = 0, tries[WAH_PARAM_COUNT];
+	int opt, quiet = 0;
+
+	while ((opt = getopt(argc, argv, "j:e:l:P:i:g:n:m:s:c:p:r:qh")) != -1) {
+		switch (opt) {
+		case 'j':
+			workers = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			excerpt_count = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			excerpt_len = strtoull(optarg, NULL, 0) * WAH_SAMPLE_RATE / 1000;
+			break;
+		case 'P':
+			preroll = strtoull(optarg, NULL, 0) * WAH_SAMPLE_RATE / 1000;
+			break;
+		case 'i':
+			initial = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			generations = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			children = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			elite_max = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			channel = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+		case 'r':
+			set_range(optarg, opt == 'p');
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (optind != argc - 2) {
+		usage(argv[0]);
+		exit(1);
+	}
+	if (excerpt_count == 0 || elite_max == 0 || initial == 0 || seed == 0) {
+		printf("excerpts, elites, initial candidates and seed must not be 0\n");
+		exit(1);
+	}
+	if (workers == 0)
+		workers = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+
+	source = load(argv[optind], channel, &frames);
+	reference = load(argv[optind + 1], 0, &refFrames);
+	if (refFrames < frames)
+		frames = refFrames;
+
+	spectrum_init();
+	scratch = calloc(workers, sizeof(*scratch));
+	for (i = 0; i < workers; i++) {
+		scratch[i].out = malloc((preroll + excerpt_len) * sizeof(int32_t));
+		scratch[i].re = malloc(FIT_FFT * sizeof(double));
+		scratch[i].im = malloc(FIT_FFT * sizeof(double));
+		scratch[i].bands = malloc((excerpt_len / FIT_FFT + 1) * FIT_BANDS * sizeof(double));
+	}
+	make_excerpts();
+
+	count = initial > children ? initial : children;
+	gen = malloc((count + elite_max) * sizeof(*gen));
+	elites = malloc(elite_max * sizeof(*elites));
+	if (wah_pool_start(&pool, workers) < 0) {
+		printf("failed to start %u workers: %s\n", workers, strerror(errno));
+		exit(1);
+	}
+	if (!quiet)
+		printf("%u excerpts of %zu frames, %u threads\n", excerpt_count,
+			excerpts[0].len, workers);
+
+	for (k = 0; k < WAH_PARAM_COUNT; k++) {
+		step[k] = FIT_STEP;
+		if (searched(k))
+			regs[nregs++] = k;
+	}
+	t0 = now_s();
+	for (g = 0; g <= generations; g++) {
+		unsigned n = g == 0 ? initial : children;
+		unsigned parents = elite_count, h = horizon_at(g, generations);
+
+		// Children are drawn from the elites as they stood at the end of
+		// the last generation; the workers only add to them. Each moves
+		// one register, so a success says which step was right.
+		memset(tries, 0, sizeof(tries));
+		for (i = 0; i < n; i++) {
+			struct cand *c = &gen[i];
+
+			memset(c, 0, sizeof(*c));
+			c->parent = INFINITY;
+			if (g == 0 || parents == 0 || nregs == 0) {
+				for (k = 0; k < WAH_PARAM_COUNT; k++)
+					c->u[k] = uniform(&seed);
+			} else {
+				const struct cand *p = &elites[xorshift(&seed) % parents];
+				double u;
+
+				memcpy(c->u, p->u, sizeof(c->u));
+				k = regs[xorshift(&seed) % nregs];
+				u = p->u[k] + step[k] * gauss(&seed);
+				c->u[k] = u < 0 ? 0 : u > 1 ? 1 : u;
+				c->reg = k;
+				c->parent = p->loss;
+				tries[k]++;
+			}
+		}
+		// A loss over more excerpts doesn't compare with one over fewer:
+		// the elites are scored again alongside their children, and
+		// nobody counts as beating a parent this generation.
+		if (h != horizon) {
+			for (j = 0; j < parents; j++, n++) {
+				gen[n] = elites[j];
+				gen[n].rejected = 0;
+				gen[n].parent = INFINITY;
+			}
+			for (i = 0; i < n; i++)
+				gen[i].parent = INFINITY;
+			elite_count = 0;
+			bound = INFINITY;
+			horizon = h;
+		}
+		memset(successes, 0, sizeof(successes));
+		for (i = 0; i < n; i++)
+			if (wah_pool_submit(&pool, -1, evaluate, &gen[i]) < 0) {
+				printf("failed to queue candidates: %s\n", strerror(errno));
+				exit(1);
+			}
+		wah_pool_wait(&pool, 0);
+		for (k = 0; k < WAH_PARAM_COUNT && gen[0].parent != INFINITY; k++) {
+			if (tries[k] == 0)
+				continue;
+			step[k] *= successes[k] * 5 > tries[k] ? 1 / FIT_STEP_ADAPT : FIT_STEP_ADAPT;
+			step[k] = step[k] < FIT_STEP_MIN ? FIT_STEP_MIN :
+				step[k] > FIT_STEP_MAX ? FIT_STEP_MAX : step[k];
+		}
+
+		if (!quiet) {
+			t = now_s() - t0;
+			printf("generation %2u: loss %9.4f dB over %u  %6.0f candidates/s  ", g,
+				sqrt(elites[0].loss / (horizon * (excerpts[0].len / FIT_FFT) *
+					FIT_BANDS)), horizon, scored / t);
+			print_params(&elites[0].p);
+			fflush(stdout);
+		}
+	}
+	t = now_s() - t0;
+	wah_pool_stop(&pool);
+
+	// Check the winner over everything the two files have in common.
+	whole.start = 0;
+	whole.preroll = 0;
+	whole.len = frames / FIT_FFT * FIT_FFT;
+	whole.target = malloc(whole.len / FIT_FFT * FIT_BANDS * sizeof(double));
+	full.out = malloc((whole.len ? whole.len : 1) * sizeof(int32_t));
+	full.re = scratch[0].re;
+	full.im = scratch[0].im;
+	full.bands = malloc((whole.len / FIT_FFT + 1) * FIT_BANDS * sizeof(double));
+	bands(reference, whole.len, &full, whole.target);
+	elites[0].p.volume = ranges[WAH_VOLUME].pinned ? elites[0].p.volume : 0xffff;
+	score_excerpt(&whole, &elites[0].p, &full, &l);
+	elites[0].p.volume = gain_volume(&l);
+
+	printf("%llu candidates in %.2fs (%.0f/s), %llu rejected early, %llu excerpt renders\n",
+		(unsigned long long)scored, t, scored / t, (unsigned long long)rejected,
+		(unsigned long long)excerpts_run);
+	printf("rms error %.4f dB over the excerpts, %.4f dB over %.1fs\n",
+		sqrt(elites[0].loss / (excerpt_count * (excerpts[0].len / FIT_FFT) * FIT_BANDS)),
+		l.n > 0 ? sqrt(loss_value(&l) / l.n) : 0.0, (double)whole.len / WAH_SAMPLE_RATE);
+	if (gain_db(&l) > 0)
+		printf("after.wav is %.1f dB louder than full volume; volume capped\n", gain_db(&l));
+	print_params(&elites[0].p);
+	return 0;
+}
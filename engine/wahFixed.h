@@ -0,0 +1,227 @@
+/*-------------------------------------------------------------------------
+ * Description:  Fixed-point primitives of the wah datapath.
+ *
+ *               Each helper mirrors one block of the generated VHDL in
+ *               Quartus/ip/wahWahEffect at sample rate (the enb-rate
+ *               pipeline registers only balance delays inside a sample):
+ *
+ *                 Fc.vhd                  wah_lfo_step()
+ *                 F1.vhd + Sine_HDL_...   wah_f1()
+ *                 Q1.vhd                  wah_q1()
+ *                 stateVariableFilter.vhd wah_svf_step()
+ *                 wahWahEffectSystem.vhd  wah_wet(), wah_output()
+ *                 wetDryMixer.vhd         wah_mix()
+ *
+ *               Formats follow the HDL: audio is sfix24_En23 in an int32,
+ *               fc is sfix34_En16, F1 and the SVF state are En48. The HDL
+ *               keeps the SVF state in 69/70 bits; here it lives in 64, so
+ *               results match until |yb| or |yl| reaches 2^15, a level only
+ *               an already unstable filter gets to.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_FIXED_H
+#define WAH_FIXED_H
+
+#include <stdint.h>
+
+#include "wahSineTable.h"
+
+/*-----------------------------------------------------------------------*/
+/* DEFINE STATEMENTS                                                     */
+/*-----------------------------------------------------------------------*/
+/* F1.vhd: fc * 44739 (ufix32_En32, ~1/96000) gives sin() its turns      */
+#define WAH_F1_SCALE 44739
+/* wahWahEffectSystem.vhd: wet gain 0x4CCD (ufix16_En16, ~0.3)           */
+#define WAH_WET_GAIN 0x4CCD
+/* Unity for the ufix16_En16 registers (volume, damp, delta, wetDry)     */
+#define WAH_ONE_EN16 65536
+
+/*
+ * struct wah_lfo - Fc.vhd state.
+ * @acc: Delay register, offset of fc from minf (sfix34_En16).
+ * @dir: Delay1 register; 1 while sweeping up towards maxf.
+ */
+struct wah_lfo {
+	int64_t acc;
+	int32_t dir;
+};
+
+/*
+ * struct wah_svf - stateVariableFilter.vhd state.
+ * @yb: Band-pass delay register (En48).
+ * @yl: Low-pass delay register (En48).
+ */
+struct wah_svf {
+	int64_t yb;
+	int64_t yl;
+};
+
+/*-----------------------------------------------------------------------*/
+/* Arithmetic helpers                                                    */
+/*-----------------------------------------------------------------------*/
+/*
+ * wah_mul_shr() - floor(a * b / 2^s) for 0 < s < 64, low 64 bits kept.
+ *
+ * The HDL takes bit slices of full-width products, which is exactly an
+ * arithmetic shift of the 128-bit product.
+ */
+static inline int64_t wah_mul_shr(int64_t a, int64_t b, unsigned s)
+{
+#ifdef __SIZEOF_INT128__
+	return (int64_t)(((__int128)a * b) >> s);
+#else
+	// 32-bit targets (the HPS Cortex-A9): build the 128-bit product
+	// from 32x32 partial products.
+	uint64_t ua = (uint64_t)a, ub = (uint64_t)b;
+	uint64_t al = (uint32_t)ua, ah = ua >> 32;
+	uint64_t bl = (uint32_t)ub, bh = ub >> 32;
+	uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+	uint64_t lo = (mid << 32) | (uint32_t)ll;
+	uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+
+	if (a < 0)
+		hi -= ub;
+	if (b < 0)
+		hi -= ua;
+	return (int64_t)((lo >> s) | (hi << (64 - s)));
+#endif
+}
+
+/* Saturate @v to a signed @bits wide value (bits < 64)                   */
+static inline int64_t wah_sat(int64_t v, unsigned bits)
+{
+	const int64_t max = ((int64_t)1 << (bits - 1)) - 1;
+
+	if (v > max)
+		return max;
+	if (v < -max - 1)
+		return -max - 1;
+	return v;
+}
+
+/*
+ * wah_sat_add() - a + b, saturated to 64 bits.
+ *
+ * Written as a select rather than an early return: after a branch GCC
+ * forgets the sum is a plain int64_t and widens the wah_mul_shr() that
+ * follows into a three-multiply 128x128 product.
+ */
+static inline int64_t wah_sat_add(int64_t a, int64_t b)
+{
+	const int64_t sat = (a >> 63) ^ INT64_MAX;	// INT64_MIN for a < 0
+	int64_t r;
+
+	return __builtin_add_overflow(a, b, &r) ? sat : r;
+}
+
+/* Keep the low 24 bits of @v as a signed sfix24 sample                  */
+static inline int32_t wah_wrap24(int64_t v)
+{
+	return (int32_t)((uint32_t)v << 8) >> 8;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Coefficients                                                          */
+/*-----------------------------------------------------------------------*/
+/*
+ * wah_lfo_step() - Advance the Fc triangle by one sample.
+ *
+ * Return: The centre frequency for this sample (sfix34_En16).
+ */
+static inline int64_t wah_lfo_step(struct wah_lfo *lfo, uint32_t minf,
+	uint32_t maxf, uint32_t delta)
+{
+	int64_t acc = wah_sat(lfo->acc + (lfo->dir ? (int64_t)delta : -(int64_t)delta), 34);
+	int64_t fc = wah_sat(acc + ((int64_t)minf << 16), 34);
+
+	lfo->dir = fc < ((int64_t)(lfo->dir ? maxf : minf) << 16);
+	lfo->acc = acc;
+	return fc;
+}
+
+/*
+ * wah_f1_phase() - The 12-bit sine phase F1.vhd looks up for @fc.
+ *
+ * Only bits 47..36 of the sfix66_En48 phase reach the table.
+ */
+static inline unsigned wah_f1_phase(int64_t fc)
+{
+	return (unsigned)((fc * WAH_F1_SCALE) >> 36) & 0xfff;
+}
+
+/* F1 for a wah_f1_phase() value, folded onto the quarter-wave table     */
+static inline int64_t wah_f1_at(unsigned phase)
+{
+	unsigned half = phase > 2048 ? phase - 2048 : phase;
+	unsigned k = half <= 1024 ? half : 2048 - half;
+	int64_t s = wah_sine_table[k > 1023 ? 1023 : k];
+
+	return 2 * (phase > 2048 ? -s : s);
+}
+
+/*
+ * wah_f1() - F1 = 2*sin(pi*fc/fs) through the HDL quarter-wave table.
+ * @fc: Centre frequency (sfix34_En16).
+ *
+ * Return: F1 as sfix69_En48 (fits comfortably in 64 bits).
+ */
+static inline int64_t wah_f1(int64_t fc)
+{
+	return wah_f1_at(wah_f1_phase(fc));
+}
+
+/* Q1 = 2*damp (ufix18_En16)                                             */
+static inline int64_t wah_q1(uint32_t damp)
+{
+	return 2 * (int64_t)damp;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Signal path                                                           */
+/*-----------------------------------------------------------------------*/
+/*
+ * wah_svf_step() - One sample of the Chamberlin state variable filter.
+ *
+ *   yh = x - yl(n-1) - Q1*yb(n-1)
+ *   yb = F1*yh + yb(n-1)
+ *   yl = F1*yb + yl(n-1)
+ *
+ * Return: yb (En48).
+ */
+static inline int64_t wah_svf_step(struct wah_svf *s, int32_t x, int64_t f1, int64_t q1)
+{
+	int64_t yh = wah_sat_add(((int64_t)x << 25) - s->yl, wah_mul_shr(-q1, s->yb, 16));
+	int64_t yb = wah_sat_add(wah_mul_shr(f1, yh, 48), s->yb);
+	int64_t yl = wah_sat_add(wah_mul_shr(f1, yb, 48), s->yl);
+
+	s->yb = yb;
+	s->yl = yl;
+	return yb;
+}
+
+/* Wet signal: 0.3*yb, sliced back to sfix24_En23                        */
+static inline int32_t wah_wet(int64_t yb)
+{
+	return wah_wrap24(wah_mul_shr(yb, WAH_WET_GAIN, 41));
+}
+
+/* wetDryMixer.vhd: dry*(1 - wetDry) + wet*wetDry (sfix43_En39)          */
+static inline int64_t wah_mix(int32_t dry, int32_t wet, uint32_t wetDry)
+{
+	return (int64_t)dry * (WAH_ONE_EN16 - (int64_t)wetDry) + (int64_t)wet * wetDry;
+}
+
+/*
+ * wah_output() - Enable switch and volume stage.
+ * @mix: Mixer output (sfix43_En39).
+ *
+ * Return: The output sample (sfix24_En23).
+ */
+static inline int32_t wah_output(int32_t dry, int64_t mix, uint32_t enable, uint32_t volume)
+{
+	int64_t v = enable ? mix : (int64_t)dry << 16;
+
+	return wah_wrap24((v * volume) >> 32);
+}
+
+#endif
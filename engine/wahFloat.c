@@ -0,0 +1,295 @@
+/*-------------------------------------------------------------------------
+ * Description:  Float32 engine for previews and bulk rendering.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "wahFloat.h"
+
+#define L WAH_FLOAT_LANES
+
+// One sample of every lane
+typedef float vfloat __attribute__((vector_size(L * sizeof(float))));
+typedef int32_t vint __attribute__((vector_size(L * sizeof(int32_t))));
+
+/*
+ * wah_float_init() - Set up @channels channels with registers @p.
+ *
+ * Return: 0, or -1 with errno EINVAL for 0 or more than WAH_FLOAT_LANES
+ * channels.
+ */
+int wah_float_init(struct wah_float *f, unsigned channels, const struct wah_params *p)
+{
+	if (channels == 0 || channels > L) {
+		errno = EINVAL;
+		return -1;
+	}
+	wah_engine_init(&f->eng, p);
+	f->channels = channels;
+	f->wraps = 0;
+	memset(f->yb, 0, sizeof(f->yb));
+	memset(f->yl, 0, sizeof(f->yl));
+	return 0;
+}
+
+/*
+ * wah_float_reset() - Clear the Fc triangle and the filters.
+ */
+void wah_float_reset(struct wah_float *f)
+{
+	wah_engine_reset(&f->eng);
+	memset(f->yb, 0, sizeof(f->yb));
+	memset(f->yl, 0, sizeof(f->yl));
+}
+
+/*
+ * next_f1() - Step the Fc triangle and return F1 for the new sample.
+ *
+ * The triangle and the sine table are the integer ones of the HDL, so F1
+ * is exact up to its rounding to float. A true sine would be smoother
+ * than the table's 12-bit phase, but a narrow filter turns that
+ * difference into a different sound.
+ */
+static inline float next_f1(struct wah_lfo *lfo, const struct wah_params *p,
+	const int64_t *wave)
+{
+	return (float)wave[wah_f1_phase(wah_lfo_step(lfo, p->minf, p->maxf, p->delta))] *
+		(1.0f / 281474976710656.0f);
+}
+
+/*
+ * filter() - The state variable filter over @n frames of @x, a frame
+ * being one sample of each of @lanes lanes, into @wet.
+ *
+ * F1 is stepped in the same loop: the triangle and the filter are two
+ * independent dependency chains, which the core overlaps. With all
+ * WAH_FLOAT_LANES lanes the recursion is one vector (GCC vector
+ * extensions); fewer lanes run as that many scalar recursions. yh
+ * subtracts yl last, as yl is the last state to be ready.
+ *
+ * Return: Wet samples past full scale.
+ */
+static inline __attribute__((always_inline)) uint32_t filter(struct wah_float *f,
+	const float *x, float *wet, size_t n, unsigned lanes)
+{
+	const struct wah_params p = f->eng.params;
+	const int64_t *wave = wah_f1_wave();
+	const float q1 = (float)wah_q1(p.damp) * (1.0f / WAH_ONE_EN16);
+	const float gain = (float)WAH_WET_GAIN * (1.0f / WAH_ONE_EN16);
+	struct wah_lfo lfo = f->eng.lfo;
+	uint32_t sum = 0;
+	size_t i;
+	unsigned k;
+
+	if (lanes == L) {
+		vfloat yb, yl, yh, w;
+		vint over = { 0 };
+
+		memcpy(&yb, f->yb, sizeof(yb));
+		memcpy(&yl, f->yl, sizeof(yl));
+		for (i = 0; i < n; i++) {
+			const float f1 = next_f1(&lfo, &p, wave);
+
+			memcpy(&yh, x + i * L, sizeof(yh));
+			yh = (yh - q1 * yb) - yl;
+			yb += f1 * yh;
+			yl += f1 * yb;
+			w = gain * yb;
+			memcpy(wet + i * L, &w, sizeof(w));
+			over -= (w >= 1.0f) | (w <= -1.0f);
+		}
+		memcpy(f->yb, &yb, sizeof(yb));
+		memcpy(f->yl, &yl, sizeof(yl));
+		for (k = 0; k < L; k++)
+			sum += (uint32_t)over[k];
+	} else {
+		float yb[L], yl[L];
+
+		for (k = 0; k < lanes; k++) {
+			yb[k] = f->yb[k];
+			yl[k] = f->yl[k];
+		}
+		for (i = 0; i < n; i++) {
+			const float f1 = next_f1(&lfo, &p, wave);
+
+			for (k = 0; k < lanes; k++) {
+				const float yh = (x[i * lanes + k] - q1 * yb[k]) - yl[k];
+				float w;
+
+				yb[k] += f1 * yh;
+				yl[k] += f1 * yb[k];
+				w = gain * yb[k];
+				wet[i * lanes + k] = w;
+				sum += (w >= 1.0f) | (w <= -1.0f);
+			}
+		}
+		for (k = 0; k < lanes; k++) {
+			f->yb[k] = yb[k];
+			f->yl[k] = yl[k];
+		}
+	}
+	f->eng.lfo = lfo;
+	return sum;
+}
+
+/*
+ * mix() - Mixer and volume over @n frames of @lanes lanes, wetDry and
+ * volume ramping linearly from @wd and @vol (register << WAH_RAMP_FRAC).
+ *
+ * Return: Output samples past full scale.
+ */
+static inline __attribute__((always_inline)) uint32_t mix(const float *x, const float *wet,
+	float *y, size_t n, int64_t wd, int64_t wdInc, int64_t vol, int64_t volInc,
+	uint32_t enable, unsigned lanes)
+{
+	const float scale = 1.0f / ((float)WAH_ONE_EN16 * (1 << WAH_RAMP_FRAC));
+	const float w0 = wd * scale, wi = wdInc * scale, v0 = vol * scale, vi = volInc * scale;
+	uint32_t over = 0;
+	size_t i;
+	unsigned k;
+
+	for (i = 0; i < n; i++) {
+		const float w = enable ? w0 + (float)i * wi : 0, v = v0 + (float)i * vi;
+
+		for (k = 0; k < lanes; k++) {
+			y[i * lanes + k] = (x[i * lanes + k] * (1 - w) + wet[i * lanes + k] * w) * v;
+			over += fabsf(y[i * lanes + k]) >= 1.0f;
+		}
+	}
+	return over;
+}
+
+/*
+ * render() - Run a segment with constant register values on @lanes lanes,
+ * a chunk at a time, splitting the mixer where a ramp changes course as
+ * wah_engine_mix() does.
+ */
+static inline __attribute__((always_inline)) void render(struct wah_float *f,
+	const float *const *in, float *const *out, size_t pos, size_t n, unsigned lanes)
+{
+	float x[WAH_CHUNK * L] __attribute__((aligned(32)));
+	float wet[WAH_CHUNK * L] __attribute__((aligned(32)));
+	float y[WAH_CHUNK * L] __attribute__((aligned(32)));
+	struct wah_engine *eng = &f->eng;
+	size_t end = pos + n, c, i, len;
+	uint32_t wraps;
+	unsigned k;
+
+	// Lanes past the last channel filter silence.
+	if (f->channels < lanes)
+		memset(x, 0, sizeof(x));
+	for (; pos < end; pos += c) {
+		// Mono needs no interleaving: straight from @in to @out.
+		const float *xc = lanes == 1 ? in[0] + pos : x;
+		float *yc = lanes == 1 ? out[0] + pos : y;
+
+		c = end - pos < WAH_CHUNK ? end - pos : WAH_CHUNK;
+		for (k = 0; lanes > 1 && k < f->channels; k++)
+			for (i = 0; i < c; i++)
+				x[i * lanes + k] = in[k][pos + i];
+		wraps = filter(f, xc, wet, c, lanes);
+		// The wet signal only matters where it is mixed in.
+		if (eng->params.enable && (eng->wetDry.cur || eng->wetDry.target))
+			f->wraps += wraps;
+		for (i = 0; i < c; i += len) {
+			len = c - i;
+			if (eng->volume.left && eng->volume.left < len)
+				len = eng->volume.left;
+			if (eng->wetDry.left && eng->wetDry.left < len)
+				len = eng->wetDry.left;
+			f->wraps += mix(xc + i * lanes, wet + i * lanes, yc + i * lanes, len,
+				eng->wetDry.cur, eng->wetDry.inc, eng->volume.cur, eng->volume.inc,
+				eng->params.enable, lanes);
+			wah_ramp_advance(&eng->volume, (uint32_t)len);
+			wah_ramp_advance(&eng->wetDry, (uint32_t)len);
+		}
+		for (k = 0; lanes > 1 && k < f->channels; k++)
+			for (i = 0; i < c; i++)
+				out[k][pos + i] = y[i * lanes + k];
+	}
+}
+
+/* render() as wide as the channel count needs: 1, 2, 4 or 8 lanes       */
+static void render_lanes(struct wah_float *f, const float *const *in, float *const *out,
+	size_t pos, size_t n)
+{
+	if (f->channels == 1)
+		render(f, in, out, pos, n, 1);
+	else if (f->channels == 2)
+		render(f, in, out, pos, n, 2);
+	else if (f->channels <= 4)
+		render(f, in, out, pos, n, 4);
+	else
+		render(f, in, out, pos, n, L);
+}
+
+/*
+ * wah_float_process() - Run @n frames of every channel through the effect.
+ * @in, @out: One buffer per channel; @out may be @in.
+ */
+void wah_float_process(struct wah_float *f, const float *const *in, float *const *out,
+	size_t n)
+{
+	struct wah_event_queue *q = &f->eng.events;
+	size_t pos = 0;
+	uint32_t i = 0, j;
+
+	for (; i < q->count && q->ev[i].offset < n; i++) {
+		size_t at = q->ev[i].offset;
+
+		if (at > pos) {
+			render_lanes(f, in, out, pos, at - pos);
+			pos = at;
+		}
+		wah_engine_set(&f->eng, q->ev[i].param, q->ev[i].value);
+	}
+	if (pos < n)
+		render_lanes(f, in, out, pos, n - pos);
+
+	for (j = 0; i < q->count; i++, j++) {
+		q->ev[j] = q->ev[i];
+		q->ev[j].offset -= n;
+	}
+	q->count = j;
+}
+
+/*
+ * to_s24() - Float sample to sfix24_En23, saturating; NaN becomes 0.
+ */
+static inline int32_t to_s24(float v)
+{
+	v *= 8388608.0f;
+	if (!(v > -8388608.0f))
+		return v != v ? 0 : -8388608;
+	if (v >= 8388607.0f)
+		return 8388607;
+	return (int32_t)lrintf(v);
+}
+
+/*
+ * wah_float_process_s24() - wah_float_process() on sfix24_En23 buffers.
+ *
+ * Converted a chunk at a time; results saturate to 24 bits where the
+ * fixed-point engine would wrap.
+ */
+void wah_float_process_s24(struct wah_float *f, const int32_t *const *in, int32_t *const *out,
+	size_t n)
+{
+	float buf[L][WAH_CHUNK], *ch[L];
+	size_t pos, c, i;
+	unsigned k;
+
+	for (k = 0; k < L; k++)
+		ch[k] = buf[k];
+	for (pos = 0; pos < n; pos += c) {
+		c = n - pos < WAH_CHUNK ? n - pos : WAH_CHUNK;
+		for (k = 0; k < f->channels; k++)
+			for (i = 0; i < c; i++)
+				buf[k][i] = in[k][pos + i] * (1.0f / 8388608);
+		wah_float_process(f, (const float *const *)ch, ch, c);
+		for (k = 0; k < f->channels; k++)
+			for (i = 0; i < c; i++)
+				out[k][pos + i] = to_s24(buf[k][i]);
+	}
+}
@@ -0,0 +1,70 @@
+/*-------------------------------------------------------------------------
+ * Description:  Float32 engine for previews and bulk rendering.
+ *
+ *               The same effect as wah_engine_process(), in single
+ *               precision instead of the HDL's fixed-point formats, for
+ *               when speed matters more than matching the hardware bit
+ *               for bit: previews, and generating training data. Audio is
+ *               float with full scale at +-1.0 (sfix24_En23 / 2^23).
+ *
+ *               Channels share the registers, so one Fc triangle and one
+ *               F1 per sample serve them all, stepped with the integer
+ *               steps of Fc.vhd and the HDL's sine table: the table's
+ *               12-bit phase moves a narrow filter audibly, so a true sine
+ *               would not be a good preview. F1 is stepped in the filter
+ *               loop, where it overlaps with the recursion. The work is
+ *               sized to the channel count: eight channels run the
+ *               recursion as the lanes of one vector (WAH_FLOAT_LANES, 8
+ *               with AVX), fewer run as 1, 2 or 4 scalar recursions side
+ *               by side, and the mixer and volume stage run vectorized
+ *               over time on as many lanes. On the x86 build machine
+ *               (wahBench float) that is about 7 ns/sample mono against 9
+ *               for the fixed-point engine, 4.5 stereo and 1.4 on eight
+ *               channels.
+ *
+ *               Unlike the HDL nothing wraps at 24 bits: samples where
+ *               the wet signal or the output pass full scale are counted
+ *               instead, since that is where a render stops sounding like
+ *               the hardware, and the int32 entry point saturates.
+ *
+ *               How far this is from the fixed-point engine is measured by
+ *               wahFloatCheck.c (max and RMS deviation, SNR). wahStream -f
+ *               renders with it.
+ *
+ *               Registers, ramps and scheduled events go through @eng as
+ *               with a single engine.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_FLOAT_H
+#define WAH_FLOAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahEngine.h"
+
+/* Channels one engine runs side by side: a 256-bit vector of floats     */
+#define WAH_FLOAT_LANES 8
+
+/*
+ * struct wah_float - A float32 engine for up to WAH_FLOAT_LANES channels.
+ * @eng: Registers, Fc triangle, ramps and events; its filter is unused.
+ * @channels: Channels processed.
+ * @yb, @yl: Filter state per lane; lanes past @channels stay at 0.
+ * @wraps: Samples where the HDL would have wrapped around at 24 bits.
+ */
+struct wah_float {
+	struct wah_engine eng;
+	unsigned channels;
+	uint64_t wraps;
+	float yb[WAH_FLOAT_LANES] __attribute__((aligned(32)));
+	float yl[WAH_FLOAT_LANES] __attribute__((aligned(32)));
+};
+
+int wah_float_init(struct wah_float *f, unsigned channels, const struct wah_params *p);
+void wah_float_reset(struct wah_float *f);
+void wah_float_process(struct wah_float *f, const float *const *in, float *const *out,
+	size_t n);
+void wah_float_process_s24(struct wah_float *f, const int32_t *const *in, int32_t *const *out,
+	size_t n);
+
+#endif
@@ -0,0 +1,372 @@
+/*-------------------------------------------------------------------------
+ * Description:  Error report of the float32 engine against the fixed-point
+ *               datapath.
+ *
+ *                 wahFloatCheck [-n seconds] [file.wav ...]
+ *
+ *               Renders every signal of a test corpus with a set of
+ *               register settings through wahFloat.c and through
+ *               wah_engine_process(), and reports per pair how far the
+ *               float output is from the bit-exact one, in dB full scale:
+ *
+ *                 max   largest |float - fixed|
+ *                 rms   RMS of float - fixed
+ *                 snr   fixed-point signal power over the error power
+ *                 wrap  share of samples where the HDL wraps around
+ *                       (wah_float.wraps)
+ *
+ *               Where the wet signal or the output goes past full scale (a
+ *               narrow filter ringing on a loud input) the fixed-point
+ *               datapath wraps around at 24 bits, as the HDL does, and the
+ *               float engine does not, so those runs are far apart by
+ *               design. The
+ *               summary gives the worst cases of the runs that stay in
+ *               range, which are what to quote when picking the float
+ *               path, and of everything.
+ *
+ *               The corpus is the given recordings (every channel, at
+ *               48 kHz), or without any a synthetic one: white noise, a
+ *               log sweep, decaying chords, clicks and quiet noise. The
+ *               settings cover the createSimParams.m defaults, narrow and
+ *               wide filters, a high fast sweep, a slow one, bypass, and
+ *               register events with ramps.
+ *
+ * Build:        gcc -O3 -march=native -o wahFloatCheck wahFloatCheck.c wahFloat.c wahWav.c
+ *                   wahEngine.c wahCycle.c -lm
+ *-------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wahFloat.h"
+#include "wahWav.h"
+
+/* Frames per process call                                               */
+#define CHECK_BLOCK 4096
+/* Frames between register events in the "events" setting                */
+#define CHECK_EVENT_EVERY 2400
+
+/*
+ * struct signal - A corpus entry, sfix24_En23, one buffer per channel.
+ */
+struct signal {
+	char name[64];
+	unsigned channels;
+	size_t frames;
+	int32_t *ch[WAH_FLOAT_LANES];
+};
+
+/*
+ * struct setting - Registers for a run; @events adds register events and
+ * ramps along the way.
+ */
+struct setting {
+	const char *name;
+	struct wah_params p;
+	int events;
+};
+
+/*
+ * struct error - Deviation sums of a run.
+ * @wraps: Samples where the HDL wraps around.
+ */
+struct error {
+	double max;
+	double sum2;
+	double ref2;
+	uint64_t n;
+	uint64_t wraps;
+};
+
+/*
+ * struct worst - Worst case of each measure over a set of runs.
+ */
+struct worst {
+	double max;
+	double rms;
+	double snr;
+	unsigned runs;
+};
+
+static struct signal *corpus;
+static unsigned corpus_count;
+
+static uint64_t xorshift(uint64_t *s){
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static double db(double v){
+	return v > 0 ? 10 * log10(v) : -INFINITY;
+}
+
+static struct signal *add_signal(const char *name, unsigned channels, size_t frames)
+{
+	struct signal *s;
+	unsigned c;
+
+	corpus = realloc(corpus, (corpus_count + 1) * sizeof(*corpus));
+	s = &corpus[corpus_count++];
+	snprintf(s->name, sizeof(s->name), "%s", name);
+	s->channels = channels;
+	s->frames = frames;
+	for (c = 0; c < channels; c++)
+		s->ch[c] = calloc(frames ? frames : 1, sizeof(int32_t));
+	return s;
+}
+
+/*
+ * synthesize() - The built-in corpus, @frames long, in stereo.
+ */
+static void synthesize(size_t frames)
+{
+	static const double chord[] = { 82.41, 123.47, 164.81, 207.65, 246.94, 329.63 };
+	struct signal *s;
+	uint64_t seed = 1;
+	double ph = 0;
+	size_t i;
+	unsigned c, k;
+
+	s = add_signal("noise", 2, frames);
+	for (c = 0; c < 2; c++)
+		for (i = 0; i < frames; i++)
+			s->ch[c][i] = (int32_t)(xorshift(&seed) >> 41) - (1 << 22);
+
+	s = add_signal("sweep", 2, frames);
+	for (i = 0; i < frames; i++) {
+		double f = 20 * pow(1000, (double)i / frames);
+
+		ph += 2 * M_PI * f / WAH_SAMPLE_RATE;
+		s->ch[0][i] = s->ch[1][i] = (int32_t)(0.7 * sin(ph) * (1 << 23));
+	}
+
+	// A strummed chord every second, decaying, right a little later.
+	s = add_signal("chords", 2, frames);
+	for (c = 0; c < 2; c++)
+		for (i = 0; i < frames; i++) {
+			size_t at = (i + WAH_SAMPLE_RATE - c * 480) % WAH_SAMPLE_RATE;
+			double t = (double)at / WAH_SAMPLE_RATE, v = 0;
+
+			for (k = 0; k < 6; k++)
+				v += sin(2 * M_PI * chord[k] * (1 + 0.5 * (k & 1)) * t) *
+					exp(-3 * t) / 6;
+			s->ch[c][i] = (int32_t)(0.8 * v * (1 << 23));
+		}
+
+	s = add_signal("clicks", 2, frames);
+	for (c = 0; c < 2; c++)
+		for (i = c * 100; i < frames; i += 12000)
+			s->ch[c][i] = (1 << 23) - 1;
+
+	s = add_signal("quiet", 2, frames);
+	for (c = 0; c < 2; c++)
+		for (i = 0; i < frames; i++)
+			s->ch[c][i] = (int32_t)(xorshift(&seed) >> 51) - (1 << 12);
+}
+
+static void load(const char *path, size_t frames)
+{
+	struct wah_wav w;
+	struct signal *s;
+	const char *base = strrchr(path, '/');
+
+	if (wah_wav_open(&w, path) < 0) {
+		printf("failed to open %s: %s\n", path,
+			errno == EINVAL ? "not a supported WAV file" : strerror(errno));
+		exit(1);
+	}
+	if (w.rate != WAH_SAMPLE_RATE || w.channels > WAH_FLOAT_LANES) {
+		printf("%s: need %d Hz and at most %d channels\n", path, WAH_SAMPLE_RATE,
+			WAH_FLOAT_LANES);
+		exit(1);
+	}
+	if (frames == 0 || frames > w.frames)
+		frames = w.frames;
+	s = add_signal(base ? base + 1 : path, w.channels, frames);
+	wah_wav_decode(&w, 0, frames, s->ch);
+	wah_wav_close(&w);
+}
+
+static void settings_init(struct setting *set, unsigned *count)
+{
+	unsigned n = 0;
+
+	set[n].name = "default";
+	wah_params_default(&set[n++].p);
+	set[n] = set[0];
+	set[n].name = "narrow";
+	set[n++].p.damp = 328;
+	set[n] = set[0];
+	set[n].name = "wide";
+	set[n++].p.damp = 26214;
+	set[n] = set[0];
+	set[n].name = "high-fast";
+	set[n].p.minf = 1000;
+	set[n].p.maxf = 12000;
+	set[n++].p.delta = 27307;
+	set[n] = set[0];
+	set[n].name = "slow";
+	set[n++].p.delta = 137;
+	set[n] = set[0];
+	set[n].name = "wet-half-vol";
+	set[n].p.wetDry = 0xffff;
+	set[n++].p.volume = 0x8000;
+	set[n] = set[0];
+	set[n].name = "bypass";
+	set[n++].p.enable = 0;
+	set[n] = set[0];
+	set[n].name = "events";
+	set[n++].events = 1;
+	*count = n;
+}
+
+/*
+ * schedule() - The same register event for both engines.
+ */
+static void schedule(struct wah_engine *eng, unsigned channels, struct wah_float *f,
+	uint32_t at, unsigned param, uint32_t value)
+{
+	unsigned c;
+
+	for (c = 0; c < channels; c++)
+		wah_engine_schedule(&eng[c], at, param, value);
+	wah_engine_schedule(&f->eng, at, param, value);
+}
+
+/*
+ * run() - Render @s with @set both ways and sum up the deviation.
+ */
+static void run(const struct signal *s, const struct setting *set, struct error *e)
+{
+	static int32_t fixed[WAH_FLOAT_LANES][CHECK_BLOCK];
+	static float in[WAH_FLOAT_LANES][CHECK_BLOCK], out[WAH_FLOAT_LANES][CHECK_BLOCK];
+	struct wah_engine eng[WAH_FLOAT_LANES];
+	struct wah_float f;
+	const float *inp[WAH_FLOAT_LANES];
+	float *outp[WAH_FLOAT_LANES];
+	uint64_t seed = 7;
+	size_t pos, n, i;
+	unsigned c;
+
+	memset(e, 0, sizeof(*e));
+	wah_float_init(&f, s->channels, &set->p);
+	for (c = 0; c < s->channels; c++) {
+		wah_engine_init(&eng[c], &set->p);
+		inp[c] = in[c];
+		outp[c] = out[c];
+	}
+	if (set->events) {
+		for (c = 0; c < s->channels; c++)
+			wah_engine_set_ramp(&eng[c], WAH_RAMP_EXP, 960);
+		wah_engine_set_ramp(&f.eng, WAH_RAMP_EXP, 960);
+	}
+
+	for (pos = 0; pos < s->frames; pos += n) {
+		n = s->frames - pos < CHECK_BLOCK ? s->frames - pos : CHECK_BLOCK;
+		if (set->events)
+			for (i = pos % CHECK_EVENT_EVERY ? CHECK_EVENT_EVERY - pos % CHECK_EVENT_EVERY : 0;
+			     i < n; i += CHECK_EVENT_EVERY) {
+				uint64_t r = xorshift(&seed);
+
+				schedule(eng, s->channels, &f, (uint32_t)i, WAH_WETDRY, (uint32_t)r & 0xffff);
+				schedule(eng, s->channels, &f, (uint32_t)i, WAH_VOLUME,
+					0x4000 + (uint32_t)(r >> 16) % 0xc000);
+				schedule(eng, s->channels, &f, (uint32_t)i, WAH_MINF,
+					100 + (uint32_t)(r >> 32) % 400);
+			}
+		for (c = 0; c < s->channels; c++) {
+			wah_engine_process(&eng[c], s->ch[c] + pos, fixed[c], n);
+			for (i = 0; i < n; i++)
+				in[c][i] = s->ch[c][pos + i] * (1.0f / 8388608);
+		}
+		wah_float_process(&f, inp, outp, n);
+
+		for (c = 0; c < s->channels; c++)
+			for (i = 0; i < n; i++) {
+				double ref = fixed[c][i] * (1.0 / 8388608), d = out[c][i] - ref;
+
+				if (fabs(d) > e->max)
+					e->max = fabs(d);
+				e->sum2 += d * d;
+				e->ref2 += ref * ref;
+			}
+		e->n += n * s->channels;
+	}
+	e->wraps = f.wraps;
+}
+
+static void worst_add(struct worst *w, const struct error *e, double rms, double snr){
+	if (w->runs++ == 0) {
+		w->max = 0;
+		w->rms = -INFINITY;
+		w->snr = INFINITY;
+	}
+	if (e->max > w->max)
+		w->max = e->max;
+	if (rms > w->rms)
+		w->rms = rms;
+	// Silence in, silence out has no signal to measure against.
+	if (e->ref2 > 0 && snr < w->snr)
+		w->snr = snr;
+}
+
+static void worst_print(const char *what, const struct worst *w){
+	if (w->runs == 0)
+		return;
+	printf("%s (%u runs): max %.1f dBFS (%.0f LSB of sfix24), rms %.1f dBFS, snr %.1f dB\n",
+		what, w->runs, 2 * db(w->max), w->max * 8388608, w->rms, w->snr);
+}
+
+int main(int argc, char **argv){
+	struct setting set[16];
+	struct error e;
+	struct worst inRange = { 0, 0, 0, 0 }, all = { 0, 0, 0, 0 };
+	double seconds = 10;
+	unsigned settings, i, j;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			seconds = strtod(optarg, NULL);
+			break;
+		default:
+			printf("usage: %s [-n seconds] [file.wav ...]\n", argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (!(seconds > 0)) {
+		printf("need a positive length\n");
+		exit(1);
+	}
+	if (optind == argc)
+		synthesize((size_t)(seconds * WAH_SAMPLE_RATE));
+	for (i = optind; i < (unsigned)argc; i++)
+		load(argv[i], (size_t)(seconds * WAH_SAMPLE_RATE));
+	settings_init(set, &settings);
+
+	printf("%-24s %-14s %10s %10s %10s %8s\n", "signal", "setting", "max dB", "rms dB",
+		"snr dB", "wrap %");
+	for (i = 0; i < corpus_count; i++)
+		for (j = 0; j < settings; j++) {
+			double rms, snr;
+
+			run(&corpus[i], &set[j], &e);
+			rms = db(e.n ? e.sum2 / e.n : 0);
+			snr = e.sum2 > 0 ? db(e.ref2 / e.sum2) : INFINITY;
+			printf("%-24s %-14s %10.1f %10.1f %10.1f %8.3f\n", corpus[i].name, set[j].name,
+				2 * db(e.max), rms, snr, e.n ? 100.0 * e.wraps / e.n : 0.0);
+			if (e.wraps == 0)
+				worst_add(&inRange, &e, rms, snr);
+			worst_add(&all, &e, rms, snr);
+		}
+	worst_print("worst in range", &inRange);
+	worst_print("worst overall", &all);
+	return 0;
+}
@@ -0,0 +1,304 @@
+/*-------------------------------------------------------------------------
+ * Description:  Streaming lookahead peak limiter for the engine output.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wahLimit.h"
+
+// Gains must not depend on the build: with FMA (-march=native) the
+// interpolator's acc += cf * x would otherwise round once, not twice.
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/* Largest gain before limiting: 16x (+24 dB), so gained samples still
+ * fit int32_t with room for the output multiply                        */
+#define LIMIT_GAIN_MAX (16 << 16)
+/* Interpolator taps per phase                                           */
+#define TP_TAPS 12
+
+/* Plain compare, unlike fmaxf(), so the loops vectorize                 */
+static inline float max_f(float a, float b){
+	return a > b ? a : b;
+}
+
+/* ITU-R BS.1770-4 Annex 2 true peak interpolator, one row per phase    */
+static const float tp_coef[4][TP_TAPS] = {
+	{  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+	  -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+	   0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+	{ -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+	  -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+	   0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+	{ -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+	  -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+	   0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+	{ -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+	  -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+	   0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+
+/*
+ * wah_limit_config_default() - -1 dBTP ceiling, unity gain, 2 ms
+ * lookahead, 50 ms release.
+ */
+void wah_limit_config_default(struct wah_limit_config *cfg, uint32_t rate)
+{
+	cfg->ceiling = (uint32_t)(0x7fffff * pow(10.0, -1.0 / 20));
+	cfg->gain = 1 << 16;
+	cfg->lookahead = rate / 500;
+	cfg->release = rate / 20;
+	cfg->truePeak = 1;
+}
+
+/*
+ * wah_limit_init() - Allocate and reset a limiter for @channels channels.
+ *
+ * Return: 0 on success, -1 with errno set (EINVAL for settings out of
+ * range).
+ */
+int wah_limit_init(struct wah_limit *l, unsigned channels, const struct wah_limit_config *cfg)
+{
+	unsigned c;
+
+	memset(l, 0, sizeof(*l));
+	if (channels == 0 || cfg->ceiling == 0 || cfg->ceiling > 0x7fffff ||
+	    cfg->gain > LIMIT_GAIN_MAX || cfg->lookahead < WAH_LIMIT_LOOKAHEAD_MIN) {
+		errno = EINVAL;
+		return -1;
+	}
+	l->cfg = *cfg;
+	l->channels = channels;
+	l->delay = cfg->lookahead - 1 + (cfg->truePeak ? WAH_LIMIT_TP_DELAY : 0);
+	l->boxRecip = (uint32_t)((1ULL << 32) / cfg->lookahead);
+	l->relCoef = cfg->release ?
+		(int32_t)(WAH_LIMIT_ONE * -expm1(-1.0 / cfg->release)) : WAH_LIMIT_ONE;
+	if (l->relCoef == 0)
+		l->relCoef = 1;
+
+	l->hist = calloc(channels, sizeof(int32_t *));
+	l->minVal = malloc(cfg->lookahead * sizeof(int32_t));
+	l->minPos = malloc(cfg->lookahead * sizeof(uint64_t));
+	l->box = malloc(cfg->lookahead * sizeof(int32_t));
+	if (l->hist == NULL || l->minVal == NULL || l->minPos == NULL || l->box == NULL)
+		goto nomem;
+	for (c = 0; c < channels; c++) {
+		l->hist[c] = malloc((l->delay + WAH_LIMIT_BLOCK) * sizeof(int32_t));
+		if (l->hist[c] == NULL)
+			goto nomem;
+	}
+	wah_limit_reset(l);
+	return 0;
+
+nomem:
+	wah_limit_free(l);
+	errno = ENOMEM;
+	return -1;
+}
+
+void wah_limit_free(struct wah_limit *l)
+{
+	unsigned c;
+
+	for (c = 0; l->hist && c < l->channels; c++)
+		free(l->hist[c]);
+	free(l->hist);
+	free(l->minVal);
+	free(l->minPos);
+	free(l->box);
+	memset(l, 0, sizeof(*l));
+}
+
+/*
+ * wah_limit_reset() - Back to silence and unity gain.
+ */
+void wah_limit_reset(struct wah_limit *l)
+{
+	unsigned c, i;
+
+	for (c = 0; c < l->channels; c++)
+		memset(l->hist[c], 0, l->delay * sizeof(int32_t));
+	for (i = 0; i < l->cfg.lookahead; i++)
+		l->box[i] = WAH_LIMIT_ONE;
+	l->boxSum = (int64_t)l->cfg.lookahead * WAH_LIMIT_ONE;
+	l->boxPos = 0;
+	l->minHead = 0;
+	l->minCount = 0;
+	l->release = WAH_LIMIT_ONE;
+	l->prevPeak = 0;
+	l->frame = 0;
+}
+
+/*
+ * wah_limit_latency() - Frames the output lags the input.
+ *
+ * Frames that go in come out this much later; feed this many frames of
+ * silence at the end of a stream to get all of it back.
+ */
+unsigned wah_limit_latency(const struct wah_limit *l)
+{
+	return l->delay;
+}
+
+/*
+ * block_peaks() - Peak of each of the @n new frames, over all channels.
+ *
+ * With true peak on, @peak[i] is for the frame WAH_LIMIT_TP_DELAY before
+ * frame i: the larger of that sample and the interpolated values on
+ * either side of it.
+ */
+static void block_peaks(struct wah_limit *l, size_t n, float *peak)
+{
+	const unsigned d = l->delay;
+	float tp[WAH_LIMIT_BLOCK], acc[WAH_LIMIT_BLOCK], x[TP_TAPS - 1 + WAH_LIMIT_BLOCK];
+	unsigned c, k, j;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		peak[i] = tp[i] = 0;
+
+	for (c = 0; c < l->channels; c++) {
+		const int32_t *h = l->hist[c] + d;
+
+		if (!l->cfg.truePeak) {
+			for (i = 0; i < n; i++)
+				peak[i] = max_f(peak[i], fabsf((float)h[i]));
+			continue;
+		}
+		for (i = 0; i < n; i++)
+			peak[i] = max_f(peak[i], fabsf((float)h[(ptrdiff_t)i - WAH_LIMIT_TP_DELAY]));
+
+		// x[j + i] is h[i - (TP_TAPS - 1) + j], converted once
+		for (i = 0; i < TP_TAPS - 1 + n; i++)
+			x[i] = (float)h[(ptrdiff_t)i - (TP_TAPS - 1)];
+		for (k = 0; k < 4; k++) {
+			for (i = 0; i < n; i++)
+				acc[i] = 0;
+			for (j = 0; j < TP_TAPS; j++) {
+				const float cf = tp_coef[k][j];
+				const float *xs = x + TP_TAPS - 1 - j;
+
+				for (i = 0; i < n; i++)
+					acc[i] += cf * xs[i];
+			}
+			for (i = 0; i < n; i++)
+				tp[i] = max_f(tp[i], fabsf(acc[i]));
+		}
+	}
+
+	if (l->cfg.truePeak) {
+		// tp[i] covers the stretch between frames i - 6 and i - 5, so
+		// frame i - 6 takes the larger of tp[i - 1] and tp[i].
+		peak[0] = max_f(peak[0], max_f(tp[0], l->prevPeak));
+		for (i = 1; i < n; i++)
+			peak[i] = max_f(peak[i], max_f(tp[i], tp[i - 1]));
+		l->prevPeak = tp[n - 1];
+	}
+}
+
+/*
+ * block_gains() - Turn @n frame peaks into output gains (Q30).
+ */
+static void block_gains(struct wah_limit *l, size_t n, const float *peak, int32_t *gain)
+{
+	const float ceiling = (float)l->cfg.ceiling;
+	const unsigned la = l->cfg.lookahead;
+	int32_t need[WAH_LIMIT_BLOCK];
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		need[i] = peak[i] > ceiling ?
+			(int32_t)(ceiling / peak[i] * (float)WAH_LIMIT_ONE) : WAH_LIMIT_ONE;
+
+	for (i = 0; i < n; i++, l->frame++) {
+		unsigned back;
+		int32_t hold, r;
+
+		// Running minimum of need over the last lookahead frames.
+		if (l->minCount && l->minPos[l->minHead] + la <= l->frame) {
+			if (++l->minHead == la)
+				l->minHead = 0;
+			l->minCount--;
+		}
+		while (l->minCount) {
+			back = l->minHead + l->minCount - 1;
+			if (back >= la)
+				back -= la;
+			if (l->minVal[back] < need[i])
+				break;
+			l->minCount--;
+		}
+		back = l->minHead + l->minCount;
+		if (back >= la)
+			back -= la;
+		l->minVal[back] = need[i];
+		l->minPos[back] = l->frame;
+		l->minCount++;
+		hold = l->minVal[l->minHead];
+
+		// Drop at once, recover at the release rate; never above hold.
+		r = l->release;
+		if (hold <= r)
+			r = hold;
+		else
+			r += (int32_t)(((int64_t)(hold - r) * l->relCoef) >> 30);
+		l->release = r;
+
+		// Average over the lookahead: every frame of a ramp that ends on
+		// a peak is at most that peak's gain.
+		l->boxSum += r - l->box[l->boxPos];
+		l->box[l->boxPos] = r;
+		if (++l->boxPos == la)
+			l->boxPos = 0;
+		// Rounds down, which only ever limits a little more.
+		gain[i] = (int32_t)((uint64_t)l->boxSum * l->boxRecip >> 32);
+	}
+}
+
+/*
+ * wah_limit_process() - Limit @n frames.
+ * @in, @out: One buffer per channel; @out may be @in.
+ *
+ * Output lags input by wah_limit_latency() frames.
+ */
+void wah_limit_process(struct wah_limit *l, const int32_t *const *in, int32_t *const *out,
+	size_t n)
+{
+	const unsigned d = l->delay;
+	const int64_t ceiling = l->cfg.ceiling, g = l->cfg.gain;
+	float peak[WAH_LIMIT_BLOCK];
+	int32_t gain[WAH_LIMIT_BLOCK];
+	size_t done, m, i;
+	unsigned c;
+
+	for (done = 0; done < n; done += m) {
+		m = n - done < WAH_LIMIT_BLOCK ? n - done : WAH_LIMIT_BLOCK;
+
+		for (c = 0; c < l->channels; c++) {
+			const int32_t *s = in[c] + done;
+			int32_t *h = l->hist[c] + d;
+
+			for (i = 0; i < m; i++)
+				h[i] = (int32_t)((s[i] * g) >> 16);
+		}
+		block_peaks(l, m, peak);
+		block_gains(l, m, peak, gain);
+
+		for (c = 0; c < l->channels; c++) {
+			int32_t *h = l->hist[c], *o = out[c] + done;
+
+			for (i = 0; i < m; i++) {
+				int64_t v = ((int64_t)h[i] * gain[i] + (1 << 29)) >> 30;
+
+				v = v > ceiling ? ceiling : v;
+				o[i] = (int32_t)(v < -ceiling ? -ceiling : v);
+			}
+			memmove(h, h + m, d * sizeof(int32_t));
+		}
+	}
+}
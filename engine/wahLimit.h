@@ -0,0 +1,98 @@
+/*-------------------------------------------------------------------------
+ * Description:  Streaming lookahead peak limiter for the engine output.
+ *
+ *               wahwah.m normalizes the filtered signal with a second pass
+ *               over the whole output (yb = yb / max(abs(yb))), which needs
+ *               all of it in memory. This stage instead keeps the output
+ *               under a ceiling as it streams, with a fixed delay.
+ *
+ *               Per frame the required gain is ceiling / peak, the peak
+ *               being the largest sample of any channel or, with true
+ *               peak on, the largest value of the ITU-R BS.1770 4x
+ *               oversampling interpolator around it. A running minimum
+ *               over the lookahead holds the gain down for lookahead
+ *               frames after a peak, a one-pole release lets it recover,
+ *               and a moving average over the lookahead turns the steps
+ *               into ramps. The audio is delayed so that each ramp is
+ *               complete before its peak comes out. All channels share
+ *               one gain, so the stereo image doesn't move.
+ *
+ *               Audio is sfix24_En23 in int32_t, as in the engine, and the
+ *               gain is Q30, so output is identical on every machine. The
+ *               per-block loops (interpolator, gain and output) vectorize;
+ *               only the minimum and release recursions run per frame.
+ *               Nothing is allocated after wah_limit_init(), so
+ *               wah_limit_process() is safe on an audio thread.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_LIMIT_H
+#define WAH_LIMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Frames handled per inner pass                                        */
+#define WAH_LIMIT_BLOCK 64
+/* Delay of the true peak interpolator (frames)                         */
+#define WAH_LIMIT_TP_DELAY 6
+/* Shortest lookahead: the delay line also feeds the interpolator       */
+#define WAH_LIMIT_LOOKAHEAD_MIN 12
+#define WAH_LIMIT_ONE (1 << 30)
+
+/*
+ * struct wah_limit_config - Limiter settings.
+ * @ceiling: Largest output magnitude (sfix24_En23 LSBs, at most 0x7fffff).
+ * @gain: Gain before limiting (Q16; 65536 is unity).
+ * @lookahead: Attack and lookahead (frames).
+ * @release: Release time constant (frames).
+ * @truePeak: Limit inter-sample peaks too.
+ */
+struct wah_limit_config {
+	uint32_t ceiling;
+	uint32_t gain;
+	uint32_t lookahead;
+	uint32_t release;
+	int truePeak;
+};
+
+/*
+ * struct wah_limit - Limiter state.
+ * @delay: Frames the output lags the input; see wah_limit_latency().
+ * @hist: Per channel, @delay frames of history then one block of input.
+ * @minVal, @minPos: Running minimum of the required gain (monotonic deque
+ *                   of @lookahead entries).
+ * @box: Last @lookahead released gains, for the moving average.
+ * @boxSum: Sum of @box.
+ * @boxRecip: 2^32 / @lookahead, for the average.
+ * @release: Current released gain (Q30).
+ * @relCoef: Release step per frame (Q30).
+ * @prevPeak: Interpolator peak of the frame before.
+ * @frame: Frames processed.
+ */
+struct wah_limit {
+	struct wah_limit_config cfg;
+	unsigned channels;
+	unsigned delay;
+	int32_t **hist;
+	int32_t *minVal;
+	uint64_t *minPos;
+	unsigned minHead;
+	unsigned minCount;
+	int32_t *box;
+	unsigned boxPos;
+	int64_t boxSum;
+	uint32_t boxRecip;
+	int32_t release;
+	int32_t relCoef;
+	float prevPeak;
+	uint64_t frame;
+};
+
+void wah_limit_config_default(struct wah_limit_config *cfg, uint32_t rate);
+int wah_limit_init(struct wah_limit *l, unsigned channels, const struct wah_limit_config *cfg);
+void wah_limit_free(struct wah_limit *l);
+void wah_limit_reset(struct wah_limit *l);
+unsigned wah_limit_latency(const struct wah_limit *l);
+void wah_limit_process(struct wah_limit *l, const int32_t *const *in, int32_t *const *out,
+	size_t n);
+
+#endif
@@ -0,0 +1,793 @@
+/*-------------------------------------------------------------------------
+ * Description:  Real-time host: the engine live, without the FPGA and
+ *               without an audio server.
+ *
+ *                 wahLive [-i source] [-o sink] [-b frames] [-p periods] [-c channels]
+ *                         [-n seconds] [-P /shm_name] [-q] [field=value ...]
+ *                 wahLive -L [-b frames,...] [-p periods] [-c channels] [-n seconds]
+ *
+ *               Two threads, the way a sound card driver and an audio
+ *               callback split the work. The I/O thread is the device: it
+ *               wakes on an absolute clock once per block of -b frames at
+ *               48 kHz, takes a captured block from the source and pushes
+ *               it into the input ring, and pops a processed block from
+ *               the output ring and hands it to the sink. The DSP thread
+ *               sleeps on the input ring, runs one engine per channel over
+ *               each block and pushes the result into the output ring.
+ *               The rings (wahRing.h) are lock-free single-producer/
+ *               single-consumer, so neither thread ever waits for the
+ *               other. The output ring starts with -p - 1 blocks of
+ *               silence, which is the DSP thread's time budget; -p 2 (the
+ *               default) gives it one block.
+ *
+ *               Sources: gen (default), a generated noise signal, the host
+ *               looping back on itself with no device behind it; a WAV
+ *               file at 48 kHz, read as if it were being recorded; or
+ *               raw interleaved S32_LE from a pipe, - for stdin or a
+ *               FIFO, e.g. from ffmpeg -f s32le. Sinks: null (default);
+ *               a WAV file; or raw S32_LE to - or a FIFO, e.g. into aplay
+ *               -f S32_LE. The sink gets what a sound card would have
+ *               played, silence in the first blocks and in underruns
+ *               included.
+ *
+ *               Xruns are counted by kind: overruns (input ring full, so
+ *               a captured block is dropped), underruns (output ring
+ *               empty, silence is played), late ticks (the I/O thread
+ *               woke up a whole block late) and short reads (less than a
+ *               block waiting in the input pipe). After an underrun the
+ *               late block would add a block of latency for good, so the
+ *               I/O thread drops blocks until the output ring is back at
+ *               its starting fill.
+ *
+ *               Every block carries its capture time through both rings,
+ *               and the I/O thread records the input-to-output latency
+ *               (capture of its last frame to playout of its first, plus
+ *               the block itself: what a frame going in and coming out
+ *               again sees) and the time the DSP thread spent on it.
+ *               -L sweeps block sizes (16, 32, 64, 128, 256 frames unless
+ *               -b lists others) with the gen source and prints the
+ *               percentiles of both for each; otherwise they are printed
+ *               at the end of the run (over at least the last minute).
+ *
+ *               The threads ask for SCHED_FIFO and the memory is locked;
+ *               without the privileges for that the host still runs and
+ *               says so. -P creates or opens a shared parameter block
+ *               that wahCtl changes the registers through while the host
+ *               runs.
+ *
+ * Build:        gcc -O2 -pthread -o wahLive wahLive.c wahRing.c wahParamBlock.c
+ *                   wahWav.c wahEngine.c wahCycle.c -lrt -lm
+ *               (add -DWAH_AUDIT and wahAudit.c -ldl to audit the DSP thread)
+ *-------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wahAudit.h"
+#include "wahEngine.h"
+#include "wahParamBlock.h"
+#include "wahRing.h"
+#include "wahWav.h"
+
+/* Block sizes and channels the host takes                               */
+#define LIVE_MIN_BLOCK 16
+#define LIVE_MAX_BLOCK 4096
+#define LIVE_MAX_CHANNELS 8
+/* Blocks of statistics kept: the last minute at the smallest block      */
+#define LIVE_STATS (60 * WAH_SAMPLE_RATE / LIVE_MIN_BLOCK)
+/* How long the DSP thread sleeps before it looks at the stop flag again */
+#define LIVE_WAIT_NS 50000000
+/* SCHED_FIFO priorities: the device above the DSP, as with ALSA/JACK    */
+#define LIVE_IO_PRIORITY 80
+#define LIVE_DSP_PRIORITY 70
+
+/* Sources and sinks; gen is only a source and null only a sink         */
+enum live_kind {
+	LIVE_GEN,
+	LIVE_NULL = LIVE_GEN,
+	LIVE_WAV,
+	LIVE_RAW,
+};
+
+/*
+ * struct block - Header of every ring slot; the planar samples follow.
+ * @captured: When the last frame came in (CLOCK_MONOTONIC ns).
+ * @started, @done: The DSP thread's process call.
+ * @silent: Prefill, not a captured block.
+ */
+struct block {
+	uint64_t captured;
+	uint64_t started;
+	uint64_t done;
+	uint32_t silent;
+} __attribute__((aligned(64)));
+
+/*
+ * struct samples - The last @cap values of a statistic.
+ */
+struct samples {
+	uint64_t *v;
+	size_t cap;
+	uint64_t n;
+};
+
+/*
+ * struct live - One run of the host.
+ *
+ * Set up by main(): @block to @p.
+ * The I/O thread owns @inFrame to @rawFill and the counters; the DSP
+ * thread owns @eng and @seen; @pushed and @processed are how the two tell
+ * when everything has been played.
+ */
+struct live {
+	size_t block;
+	unsigned periods;
+	unsigned channels;
+	uint64_t ticks;
+	enum live_kind src, sink;
+	int inFd, outFd;
+	struct wah_wav wav;
+	struct wah_param_block *blk;
+	struct wah_params p;
+
+	struct wah_ring in, out;
+	uint64_t inFrame;
+	uint64_t seed;
+	uint8_t *raw;
+	size_t rawFill;
+	uint8_t *scratch;
+	uint64_t outFrames;
+	int eof;
+	volatile int stop;
+	uint64_t pushed;
+	uint64_t processed;
+
+	struct wah_engine eng[LIVE_MAX_CHANNELS];
+	uint32_t seen;
+
+	uint64_t played, overruns, underruns, late, shortReads, dropped, writeErrors;
+	struct samples latency, dsp;
+	int rt;
+};
+
+static volatile sig_atomic_t interrupted;
+
+static void on_signal(int sig){
+	(void)sig;
+	interrupted = 1;
+}
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t xorshift(uint64_t *s){
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static void samples_add(struct samples *s, uint64_t v){
+	s->v[s->n++ % s->cap] = v;
+}
+
+static int cmp_u64(const void *a, const void *b){
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * samples_sort() - Sort the kept values in place.
+ *
+ * Return: How many there are.
+ */
+static size_t samples_sort(struct samples *s){
+	size_t n = s->n < s->cap ? (size_t)s->n : s->cap;
+
+	qsort(s->v, n, sizeof(uint64_t), cmp_u64);
+	return n;
+}
+
+/*
+ * quantile() - Value below which a fraction @q of sorted @v lies.
+ */
+static double quantile(const uint64_t *v, size_t n, double q){
+	size_t i = (size_t)(q * n);
+
+	if (n == 0)
+		return 0;
+	return (double)v[i < n ? i : n - 1];
+}
+
+/*
+ * planes() - The channel buffers of a ring slot.
+ */
+static void planes(const struct live *lv, void *slot, int32_t **ch){
+	int32_t *x = (int32_t *)((uint8_t *)slot + sizeof(struct block));
+	unsigned c;
+
+	for (c = 0; c < lv->channels; c++)
+		ch[c] = x + c * lv->block;
+}
+
+/*
+ * period_ns() - When tick @k is due, relative to the first.
+ */
+static uint64_t period_ns(const struct live *lv, uint64_t k){
+	return k * lv->block * 1000000000 / WAH_SAMPLE_RATE;
+}
+
+/*---------------------------------------------------------------------*/
+/* I/O thread                                                            */
+/*---------------------------------------------------------------------*/
+/*
+ * read_raw() - Take one block of S32_LE from the input pipe into @ch.
+ *
+ * Never blocks. With less than a block waiting the block stays short and
+ * is counted; what did arrive is kept for the next tick.
+ *
+ * Return: 1 for a block, 0 for a short read, -1 at the end of the input.
+ */
+static int read_raw(struct live *lv, int32_t **ch){
+	const size_t bytes = lv->block * lv->channels * sizeof(int32_t);
+	const int32_t *x = (const int32_t *)lv->raw;
+	ssize_t got;
+	unsigned c;
+	size_t i;
+
+	while (lv->rawFill < bytes) {
+		got = read(lv->inFd, lv->raw + lv->rawFill, bytes - lv->rawFill);
+		if (got > 0)
+			lv->rawFill += got;
+		else if (got < 0 && errno == EINTR)
+			continue;
+		else if (got < 0 && errno == EAGAIN)
+			return 0;
+		else
+			break;
+	}
+	if (lv->rawFill == 0)
+		return -1;
+	// A partial last block at the end of the input is padded.
+	memset(lv->raw + lv->rawFill, 0, bytes - lv->rawFill);
+	for (c = 0; c < lv->channels; c++)
+		for (i = 0; i < lv->block; i++)
+			ch[c][i] = x[i * lv->channels + c] >> 8;
+	lv->rawFill = 0;
+	return 1;
+}
+
+/*
+ * capture() - The block that came in during the last period.
+ */
+static void capture(struct live *lv, uint64_t t){
+	void *slot = wah_ring_write_slot(&lv->in);
+	struct block *b = slot ? slot : (void *)lv->scratch;
+	int32_t *ch[LIVE_MAX_CHANNELS];
+	unsigned c;
+	size_t i, n;
+	int got;
+
+	planes(lv, b, ch);
+	switch (lv->src) {
+	case LIVE_GEN:
+		// Noise at -20 dBFS
+		for (c = 0; c < lv->channels; c++)
+			for (i = 0; i < lv->block; i++)
+				ch[c][i] = (int32_t)(xorshift(&lv->seed) >> 40) / 10 - (1 << 23) / 10;
+		break;
+	case LIVE_WAV:
+		n = lv->wav.frames - lv->inFrame;
+		if (n == 0) {
+			lv->eof = 1;
+			return;
+		}
+		n = n < lv->block ? n : lv->block;
+		wah_wav_decode(&lv->wav, lv->inFrame, n, ch);
+		for (c = 0; c < lv->channels; c++)
+			memset(ch[c] + n, 0, (lv->block - n) * sizeof(int32_t));
+		lv->inFrame += n;
+		break;
+	case LIVE_RAW:
+		got = read_raw(lv, ch);
+		if (got < 0) {
+			lv->eof = 1;
+			return;
+		}
+		if (got == 0) {
+			lv->shortReads++;
+			return;
+		}
+		break;
+	}
+
+	// Whatever came in was read, even if there's no room for it.
+	if (slot == NULL) {
+		lv->overruns++;
+		return;
+	}
+	b->captured = t;
+	b->silent = 0;
+	wah_ring_push(&lv->in);
+	lv->pushed++;
+}
+
+/*
+ * emit() - Hand a block to the sink.
+ */
+static void emit(struct live *lv, void *slot){
+	int32_t *ch[LIVE_MAX_CHANNELS];
+	int32_t *x = (int32_t *)lv->raw;
+	size_t bytes = 0, i;
+	unsigned c;
+
+	planes(lv, slot, ch);
+	if (lv->sink == LIVE_RAW) {
+		for (c = 0; c < lv->channels; c++)
+			for (i = 0; i < lv->block; i++)
+				x[i * lv->channels + c] = (int32_t)((uint32_t)ch[c][i] << 8);
+		bytes = lv->block * lv->channels * sizeof(int32_t);
+	} else if (lv->sink == LIVE_WAV) {
+		wah_wav_encode((const int32_t *const *)ch, lv->channels, lv->block, lv->raw);
+		bytes = lv->block * lv->channels * WAH_WAV_OUT_BYTES;
+	}
+	if (bytes && write(lv->outFd, lv->raw, bytes) != (ssize_t)bytes)
+		lv->writeErrors++;
+	lv->outFrames += lv->block;
+}
+
+/*
+ * play() - Hand the next processed block to the sink.
+ *
+ * Return: 1 once the input has ended and everything is out.
+ */
+static int play(struct live *lv, uint64_t t){
+	struct block *b;
+
+	while (wah_ring_fill(&lv->out) > lv->periods - 1) {
+		wah_ring_pop(&lv->out);
+		lv->dropped++;
+	}
+	b = wah_ring_read_slot(&lv->out);
+	if (b == NULL) {
+		if (lv->eof && __atomic_load_n(&lv->processed, __ATOMIC_ACQUIRE) == lv->pushed)
+			return 1;
+		lv->underruns++;
+		memset(lv->scratch, 0, lv->out.size);
+		emit(lv, lv->scratch);
+		return 0;
+	}
+	if (!b->silent) {
+		samples_add(&lv->latency, t - b->captured + period_ns(lv, 1));
+		samples_add(&lv->dsp, b->done - b->started);
+		lv->played++;
+	}
+	emit(lv, b);
+	wah_ring_pop(&lv->out);
+	return 0;
+}
+
+/*
+ * io() - The I/O thread: one capture and one playout per tick.
+ */
+static void *io(void *arg){
+	struct live *lv = arg;
+	struct timespec ts;
+	uint64_t start = now_ns(), k, due, t;
+
+	for (k = 1; !lv->stop && !interrupted; k++) {
+		due = start + period_ns(lv, k);
+		ts.tv_sec = due / 1000000000;
+		ts.tv_nsec = due % 1000000000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+		t = now_ns();
+		// Ticks slept through are blocks the device lost.
+		while (start + period_ns(lv, k + 1) <= t) {
+			lv->late++;
+			k++;
+		}
+
+		if (!lv->eof)
+			capture(lv, t);
+		if (play(lv, t) || (lv->ticks && k >= lv->ticks))
+			break;
+	}
+	lv->stop = 1;
+	return NULL;
+}
+
+/*---------------------------------------------------------------------*/
+/* DSP thread                                                            */
+/*---------------------------------------------------------------------*/
+/*
+ * dsp() - The DSP thread: every block through one engine per channel.
+ *
+ * Nothing between WAH_AUDIT_BEGIN() and WAH_AUDIT_END() may allocate,
+ * lock or sleep. The thread only sleeps in wah_ring_wait(), between
+ * blocks.
+ */
+static void *dsp(void *arg){
+	struct live *lv = arg;
+	int32_t *x[LIVE_MAX_CHANNELS], *y[LIVE_MAX_CHANNELS];
+	struct wah_params p;
+	struct block *src, *dst;
+	unsigned c;
+
+	while (!lv->stop) {
+		if (!wah_ring_wait(&lv->in, LIVE_WAIT_NS))
+			continue;
+		while ((src = wah_ring_read_slot(&lv->in)) != NULL) {
+			dst = wah_ring_write_slot(&lv->out);
+			if (dst == NULL) {
+				// The I/O thread trims the output ring at its next
+				// tick; this block would be dropped there.
+				wah_ring_pop(&lv->in);
+				__atomic_fetch_add(&lv->processed, 1, __ATOMIC_RELEASE);
+				continue;
+			}
+			dst->started = now_ns();
+			WAH_AUDIT_BEGIN();
+			if (lv->blk && wah_param_block_poll(lv->blk, &lv->seen, &p))
+				for (c = 0; c < lv->channels; c++)
+					wah_engine_set_params(&lv->eng[c], &p);
+			planes(lv, src, x);
+			planes(lv, dst, y);
+			for (c = 0; c < lv->channels; c++)
+				wah_engine_process(&lv->eng[c], x[c], y[c], lv->block);
+			WAH_AUDIT_END();
+			dst->done = now_ns();
+			dst->captured = src->captured;
+			dst->silent = 0;
+			wah_ring_push(&lv->out);
+			wah_ring_pop(&lv->in);
+			__atomic_fetch_add(&lv->processed, 1, __ATOMIC_RELEASE);
+		}
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------*/
+/* Runs                                                                  */
+/*---------------------------------------------------------------------*/
+/*
+ * start_thread() - Start @fn at SCHED_FIFO @priority, or normally if
+ * that isn't allowed (clears @lv->rt).
+ */
+static int start_thread(struct live *lv, pthread_t *th, void *(*fn)(void *), int priority){
+	struct sched_param sp = { .sched_priority = priority };
+	pthread_attr_t attr;
+	int err;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &sp);
+	err = pthread_create(th, &attr, fn, lv);
+	pthread_attr_destroy(&attr);
+	if (err == EPERM) {
+		lv->rt = 0;
+		err = pthread_create(th, NULL, fn, lv);
+	}
+	return err;
+}
+
+/*
+ * run() - Set up the rings and engines, run until the input ends, the
+ * time is up or SIGINT, and take everything down again.
+ *
+ * Return: 0, or -1 with errno set.
+ */
+static int run(struct live *lv){
+	const size_t slot = sizeof(struct block) + lv->channels * lv->block * sizeof(int32_t);
+	pthread_t ioThread, dspThread;
+	struct block *b;
+	unsigned c, i;
+
+	if (wah_ring_init(&lv->in, lv->periods, slot) < 0 ||
+	    wah_ring_init(&lv->out, lv->periods, slot) < 0)
+		return -1;
+	lv->scratch = aligned_alloc(64, lv->out.size);
+	lv->raw = malloc(lv->block * lv->channels * sizeof(int32_t));
+	// Kept for the next run of a sweep
+	if (lv->latency.v == NULL) {
+		lv->latency.v = malloc(LIVE_STATS * sizeof(uint64_t));
+		lv->dsp.v = malloc(LIVE_STATS * sizeof(uint64_t));
+	}
+	if (lv->scratch == NULL || lv->raw == NULL || lv->latency.v == NULL || lv->dsp.v == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	lv->latency.cap = lv->dsp.cap = LIVE_STATS;
+	lv->latency.n = lv->dsp.n = 0;
+	lv->played = lv->overruns = lv->underruns = lv->late = lv->shortReads = 0;
+	lv->dropped = lv->writeErrors = lv->outFrames = lv->pushed = lv->processed = 0;
+	lv->eof = lv->stop = 0;
+	lv->rawFill = 0;
+	lv->seen = 0;
+	lv->seed = 0x9e3779b97f4a7c15ULL;
+	for (c = 0; c < lv->channels; c++)
+		wah_engine_init(&lv->eng[c], &lv->p);
+
+	for (i = 0; i + 1 < lv->periods; i++) {
+		b = wah_ring_write_slot(&lv->out);
+		memset(b, 0, lv->out.size);
+		b->silent = 1;
+		wah_ring_push(&lv->out);
+	}
+
+	lv->rt = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+	if (start_thread(lv, &dspThread, dsp, LIVE_DSP_PRIORITY) ||
+	    start_thread(lv, &ioThread, io, LIVE_IO_PRIORITY)) {
+		errno = EAGAIN;
+		return -1;
+	}
+	pthread_join(ioThread, NULL);
+	pthread_join(dspThread, NULL);
+	munlockall();
+
+	wah_ring_free(&lv->in);
+	wah_ring_free(&lv->out);
+	free(lv->scratch);
+	free(lv->raw);
+	return 0;
+}
+
+static void print_latency(FILE *f, struct live *lv){
+	size_t n = samples_sort(&lv->latency), m = samples_sort(&lv->dsp);
+	const uint64_t *v = lv->latency.v, *d = lv->dsp.v;
+
+	fprintf(f, "%6zu %7.3f %6llu %6llu %6llu %6llu %7.3f %7.3f %7.3f %7.3f %7.3f %7.1f %7.1f %7.1f\n",
+		lv->block, period_ns(lv, 1) * 1e-6, (unsigned long long)lv->overruns,
+		(unsigned long long)lv->underruns, (unsigned long long)lv->late,
+		(unsigned long long)lv->dropped, quantile(v, n, 0.5) * 1e-6,
+		quantile(v, n, 0.9) * 1e-6, quantile(v, n, 0.99) * 1e-6,
+		quantile(v, n, 0.999) * 1e-6, n ? v[n - 1] * 1e-6 : 0, quantile(d, m, 0.5) * 1e-3,
+		quantile(d, m, 0.99) * 1e-3, m ? d[m - 1] * 1e-3 : 0);
+}
+
+static void print_header(FILE *f){
+	fprintf(f, "%6s %7s %6s %6s %6s %6s %7s %7s %7s %7s %7s %7s %7s %7s\n", "", "period",
+		"", "", "", "", "latency", "", "", "", "", "dsp", "", "");
+	fprintf(f, "%6s %7s %6s %6s %6s %6s %7s %7s %7s %7s %7s %7s %7s %7s\n", "frames", "ms",
+		"over", "under", "late", "drop", "p50 ms", "p90", "p99", "p99.9", "max",
+		"p50 us", "p99", "max");
+}
+
+static void usage(const char *prog){
+	printf("usage: %s [-i source] [-o sink] [-b frames] [-p periods] [-c channels]\n", prog);
+	printf("       [-n seconds] [-P /shm_name] [-q] [field=value ...]\n");
+	printf("       %s -L [-b frames,...] [-p periods] [-c channels] [-n seconds]\n", prog);
+	printf("  -i  gen, a 48 kHz WAV file, or raw S32_LE from - or a FIFO (default: gen)\n");
+	printf("  -o  null, a WAV file, or raw S32_LE to - or a FIFO (default: null)\n");
+	printf("  -b  frames per block, %d to %d (default: 64)\n", LIVE_MIN_BLOCK,
+		LIVE_MAX_BLOCK);
+	printf("  -p  blocks of buffering, at least 2 (default: 2)\n");
+	printf("  -c  channels of gen and raw sources (default: 2)\n");
+	printf("  -n  stop after this many seconds (default: at the end of the input;\n");
+	printf("      5 per block size with -L)\n");
+	printf("  -P  shared parameter block to take the registers from (see wahCtl)\n");
+	printf("  -L  measure latency over a range of block sizes\n");
+	printf("  -q  no summary\n");
+}
+
+/*
+ * open_end() - Open a source or sink argument.
+ *
+ * Return: Its kind; -, FIFOs and character devices are raw, files WAV.
+ * Exits on failure.
+ */
+static enum live_kind open_end(struct live *lv, const char *arg, int output){
+	struct stat st;
+	int fd;
+
+	if (strcmp(arg, output ? "null" : "gen") == 0)
+		return LIVE_GEN;
+	if (strcmp(arg, "-") == 0)
+		fd = output ? STDOUT_FILENO : STDIN_FILENO;
+	else if (output)
+		fd = open(arg, O_WRONLY | O_CREAT | (stat(arg, &st) == 0 && S_ISFIFO(st.st_mode) ?
+			0 : O_TRUNC), 0666);
+	else
+		fd = open(arg, O_RDONLY | O_NONBLOCK);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		printf("failed to open %s: %s\n", arg, strerror(errno));
+		exit(1);
+	}
+	if (output) {
+		lv->outFd = fd;
+		return S_ISREG(st.st_mode) && fd != STDOUT_FILENO ? LIVE_WAV : LIVE_RAW;
+	}
+	lv->inFd = fd;
+	if (!S_ISREG(st.st_mode) || fd == STDIN_FILENO) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		return LIVE_RAW;
+	}
+	close(fd);
+	if (wah_wav_open(&lv->wav, arg) < 0) {
+		printf("failed to open %s: %s\n", arg,
+			errno == EINVAL ? "not a supported WAV file" : strerror(errno));
+		exit(1);
+	}
+	if (lv->wav.rate != WAH_SAMPLE_RATE || lv->wav.channels > LIVE_MAX_CHANNELS) {
+		printf("%s: the host runs at %d Hz with at most %d channels\n", arg,
+			WAH_SAMPLE_RATE, LIVE_MAX_CHANNELS);
+		exit(1);
+	}
+	return LIVE_WAV;
+}
+
+int main(int argc, char **argv){
+	static struct live lv;
+	uint8_t hdr[WAH_WAV_HEADER];
+	uint32_t *regs = (uint32_t *)&lv.p;
+	const char *source = "gen", *sink = "null", *sizes = NULL, *shm = NULL;
+	double seconds = -1;
+	int opt, sweep = 0, quiet = 0, set = 0, i, j;
+	char *end;
+
+	lv.periods = 2;
+	lv.channels = 2;
+	while ((opt = getopt(argc, argv, "i:o:b:p:c:n:P:Lqh")) != -1) {
+		switch (opt) {
+		case 'i':
+			source = optarg;
+			break;
+		case 'o':
+			sink = optarg;
+			break;
+		case 'b':
+			sizes = optarg;
+			break;
+		case 'p':
+			lv.periods = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			lv.channels = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			seconds = strtod(optarg, NULL);
+			break;
+		case 'P':
+			shm = optarg;
+			break;
+		case 'L':
+			sweep = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (lv.periods < 2 || lv.periods > 64 || lv.channels == 0 ||
+	    lv.channels > LIVE_MAX_CHANNELS) {
+		printf("-p takes 2 to 64 blocks, -c 1 to %d channels\n", LIVE_MAX_CHANNELS);
+		exit(1);
+	}
+
+	wah_params_default(&lv.p);
+	for (i = optind; i < argc; i++) {
+		char *eq = strchr(argv[i], '=');
+
+		j = eq ? wah_param_lookup(argv[i], eq - argv[i]) : -1;
+		if (j < 0) {
+			printf("unknown setting %s\n", argv[i]);
+			exit(1);
+		}
+		regs[j] = strtoul(eq + 1, NULL, 0);
+		set = 1;
+	}
+	if (shm) {
+		lv.blk = wah_param_block_open(shm, 1);
+		if (lv.blk == NULL) {
+			printf("failed to open %s: %s\n", shm, strerror(errno));
+			exit(1);
+		}
+		if ((set ? wah_param_block_write(lv.blk, &lv.p) :
+			   wah_param_block_read(lv.blk, &lv.p)) < 0) {
+			printf("failed to %s %s: %s (wahCtl -r unlocks it)\n",
+				set ? "write" : "read", shm, strerror(errno));
+			exit(1);
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (sweep) {
+		if (seconds < 0)
+			seconds = 5;
+		if (sizes == NULL)
+			sizes = "16,32,64,128,256";
+		print_header(stdout);
+		for (end = (char *)sizes; *end && !interrupted; end += *end == ',') {
+			lv.block = strtoul(end, &end, 0);
+			if (lv.block < LIVE_MIN_BLOCK || lv.block > LIVE_MAX_BLOCK) {
+				printf("block sizes go from %d to %d frames\n", LIVE_MIN_BLOCK,
+					LIVE_MAX_BLOCK);
+				exit(1);
+			}
+			lv.ticks = (uint64_t)(seconds * WAH_SAMPLE_RATE / lv.block);
+			if (run(&lv) < 0) {
+				printf("failed to start: %s\n", strerror(errno));
+				exit(1);
+			}
+			print_latency(stdout, &lv);
+		}
+		if (!lv.rt)
+			printf("(no SCHED_FIFO or locked memory: run with CAP_SYS_NICE and "
+				"CAP_IPC_LOCK for real-time figures)\n");
+		return 0;
+	}
+
+	lv.block = sizes ? strtoul(sizes, NULL, 0) : 64;
+	if (lv.block < LIVE_MIN_BLOCK || lv.block > LIVE_MAX_BLOCK) {
+		printf("block sizes go from %d to %d frames\n", LIVE_MIN_BLOCK, LIVE_MAX_BLOCK);
+		exit(1);
+	}
+	lv.ticks = seconds > 0 ? (uint64_t)(seconds * WAH_SAMPLE_RATE / lv.block) : 0;
+	lv.src = open_end(&lv, source, 0);
+	if (lv.src == LIVE_WAV)
+		lv.channels = lv.wav.channels;
+	lv.sink = open_end(&lv, sink, 1);
+	if (lv.sink == LIVE_WAV) {
+		// Rewritten with the real length at the end
+		wah_wav_header(hdr, WAH_SAMPLE_RATE, lv.channels, 0);
+		if (write(lv.outFd, hdr, sizeof(hdr)) != sizeof(hdr)) {
+			printf("failed to write %s: %s\n", sink, strerror(errno));
+			exit(1);
+		}
+	}
+
+	if (run(&lv) < 0) {
+		printf("failed to start: %s\n", strerror(errno));
+		exit(1);
+	}
+	if (lv.sink == LIVE_WAV) {
+		wah_wav_header(hdr, WAH_SAMPLE_RATE, lv.channels, lv.outFrames);
+		if (pwrite(lv.outFd, hdr, sizeof(hdr), 0) != sizeof(hdr))
+			lv.writeErrors++;
+	}
+	if (lv.sink != LIVE_NULL && lv.outFd != STDOUT_FILENO && close(lv.outFd) < 0)
+		lv.writeErrors++;
+	if (lv.src == LIVE_WAV)
+		wah_wav_close(&lv.wav);
+	if (lv.writeErrors)
+		printf("%s: %llu blocks failed to write\n", sink,
+			(unsigned long long)lv.writeErrors);
+
+	// The summary goes to stderr when the audio goes to stdout.
+	if (!quiet) {
+		FILE *f = lv.sink == LIVE_RAW && lv.outFd == STDOUT_FILENO ? stderr : stdout;
+
+		fprintf(f, "%llu blocks of %zu frames x %u channels, %u blocks buffered, %s; "
+			"%llu short reads\n", (unsigned long long)lv.played, lv.block,
+			lv.channels, lv.periods, lv.rt ? "SCHED_FIFO" : "no real-time priority",
+			(unsigned long long)lv.shortReads);
+		print_header(f);
+		print_latency(f, &lv);
+	}
+	if (lv.blk)
+		wah_param_block_close(lv.blk);
+	return lv.writeErrors ? 1 : 0;
+}
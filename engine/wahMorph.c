@@ -0,0 +1,415 @@
+/*-------------------------------------------------------------------------
+ * Description:  Presets and morphs between them, on the device or through
+ *               the software engine.
+ *
+ *                 wahMorph [-f store] -l                        list the presets
+ *                 wahMorph [-f store] -s name [-d] [field=value ...]
+ *                 wahMorph [-f store] -x name                   delete a preset
+ *                 wahMorph [-f store] [-t ms] [-S ms] [-n] [from] to
+ *                 wahMorph [-f store] [-t ms] [-S ms] [-a seconds] -r in.wav out.wav from to
+ *
+ *               The store (wahPreset.h) is $WAH_PRESETS, or ~/.wahpresets.
+ *               -s saves a preset from the given fields on top of its old
+ *               values, or the createSimParams.m defaults for a new one;
+ *               -d starts from what the device holds instead.
+ *
+ *               A morph moves all seven registers from one preset to
+ *               another over -t ms (default 500) in steps of -S ms
+ *               (default 1, or as fine as still fits the driver's
+ *               4096 updates). The whole trajectory is planned first. On
+ *               the device it goes to the driver in a single write, which
+ *               plays it from a kernel timer; without a from preset the
+ *               morph starts from the device's current values. A driver
+ *               without stream support gets the same updates written
+ *               from here on an absolute clock instead. -n prints the
+ *               trajectory and leaves the device alone.
+ *
+ *               -r renders in.wav (48 kHz) through one engine per channel
+ *               starting at from, with the morph starting -a seconds in,
+ *               every update on its exact sample: a preview of the switch
+ *               without the board.
+ *
+ * Build:        gcc -O2 -o wahMorph wahMorph.c wahPreset.c wahWav.c wahEngine.c
+ *                   wahCycle.c -lm
+ *-------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wahEngine.h"
+#include "wahPreset.h"
+#include "wahWav.h"
+
+#define MORPH_DEVICE "/dev/wahWahEffectProcessor"
+/* Where the driver takes timed register streams, and how long they get  */
+#define MORPH_STREAM_OFFSET 0x100
+#define MORPH_STREAM_MAX 4096
+/* Frames per block when rendering                                      */
+#define MORPH_BLOCK 4096
+
+/*
+ * struct stream_write - One update of a driver register stream; see
+ * linux/wahWahEffectProcessor.c.
+ */
+struct stream_write {
+	uint32_t at_us;
+	uint32_t offset;
+	uint32_t value;
+};
+
+static const char *store_path;
+static struct wah_presets store;
+
+static void usage(const char *prog){
+	printf("usage: %s [-f store] -l\n", prog);
+	printf("       %s [-f store] -s name [-d] [field=value ...]\n", prog);
+	printf("       %s [-f store] -x name\n", prog);
+	printf("       %s [-f store] [-t ms] [-S ms] [-n] [from] to\n", prog);
+	printf("       %s [-f store] [-t ms] [-S ms] [-a seconds] -r in.wav out.wav from to\n",
+		prog);
+	printf("  -f  preset store (default: $WAH_PRESETS or ~/.wahpresets)\n");
+	printf("  -l  list the presets\n");
+	printf("  -s  save a preset; -d starts from the device's values\n");
+	printf("  -x  delete a preset\n");
+	printf("  -t  morph time in ms (default: 500)\n");
+	printf("  -S  step in ms (default: 1, longer if the morph wouldn't fit the driver)\n");
+	printf("  -n  print the trajectory instead of sending it\n");
+	printf("  -r  render a WAV file through the engine instead\n");
+	printf("  -a  start the morph this far into the file (default: 0)\n");
+}
+
+static void print_params(const char *name, const struct wah_params *p){
+	const uint32_t *regs = (const uint32_t *)p;
+	int r;
+
+	printf("%-16s", name);
+	for (r = 0; r < WAH_PARAM_COUNT; r++)
+		printf(" %s=%u", wah_param_names[r], regs[r]);
+	printf("\n");
+}
+
+static const struct wah_params *preset(const char *name){
+	const struct wah_preset *pr = wah_preset_find(&store, name);
+
+	if (pr == NULL) {
+		printf("no preset %s in %s\n", name, store_path);
+		exit(1);
+	}
+	return &pr->p;
+}
+
+/*
+ * device_read() - The device's current register values.
+ *
+ * The driver hands out one register per read.
+ */
+static void device_read(int fd, struct wah_params *p){
+	uint32_t *regs = (uint32_t *)p;
+	int r;
+
+	for (r = 0; r < WAH_PARAM_COUNT; r++)
+		if (pread(fd, &regs[r], 4, r * 4) != 4) {
+			printf("failed to read %s: %s\n", MORPH_DEVICE, strerror(errno));
+			exit(1);
+		}
+}
+
+static int device_open(void){
+	int fd = open(MORPH_DEVICE, O_RDWR);
+
+	if (fd < 0) {
+		printf("failed to open %s: %s\n", MORPH_DEVICE, strerror(errno));
+		exit(1);
+	}
+	return fd;
+}
+
+/*
+ * device_play() - Write stream @w from user space on an absolute clock,
+ * for drivers that don't take streams.
+ */
+static void device_play(int fd, const struct stream_write *w, uint32_t n){
+	struct timespec t0, ts;
+	uint64_t at;
+	uint32_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < n; i++) {
+		at = t0.tv_nsec + (uint64_t)w[i].at_us * 1000;
+		ts.tv_sec = t0.tv_sec + at / 1000000000;
+		ts.tv_nsec = at % 1000000000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+		if (pwrite(fd, &w[i].value, 4, w[i].offset) != 4) {
+			printf("failed to write %s: %s\n", MORPH_DEVICE, strerror(errno));
+			exit(1);
+		}
+	}
+}
+
+/*
+ * morph_device() - Send trajectory @ev to the device as one stream,
+ * jumping to @from first if it was named.
+ */
+static void morph_device(int fd, const struct wah_params *from, const struct wah_event *ev,
+	uint32_t count, uint32_t ms){
+	const uint32_t *regs = (const uint32_t *)from;
+	struct stream_write w[MORPH_STREAM_MAX];
+	uint32_t n = 0, i;
+	ssize_t sent;
+	int r;
+
+	if (count + (from ? WAH_PARAM_COUNT : 0) > MORPH_STREAM_MAX) {
+		printf("%u updates are more than the driver takes (%d); use a longer step\n",
+			count, MORPH_STREAM_MAX);
+		exit(1);
+	}
+	for (r = 0; from && r < WAH_PARAM_COUNT; r++, n++) {
+		w[n].at_us = 0;
+		w[n].offset = r * 4;
+		w[n].value = regs[r];
+	}
+	for (i = 0; i < count; i++, n++) {
+		w[n].at_us = (uint32_t)(((uint64_t)ev[i].offset * 1000000 + WAH_SAMPLE_RATE / 2) /
+			WAH_SAMPLE_RATE);
+		w[n].offset = ev[i].param * 4;
+		w[n].value = ev[i].value;
+	}
+	if (n == 0) {
+		printf("nothing to change\n");
+		return;
+	}
+
+	sent = pwrite(fd, w, n * sizeof(w[0]), MORPH_STREAM_OFFSET);
+	if (sent == (ssize_t)(n * sizeof(w[0]))) {
+		printf("queued %u updates over %u ms\n", n, ms);
+		return;
+	}
+	if (sent != 0) {
+		printf("failed to queue the morph: %s\n", strerror(errno));
+		exit(1);
+	}
+	// Drivers from before register streams ignore writes past the
+	// registers.
+	printf("driver takes no register streams; writing %u updates over %u ms\n", n, ms);
+	device_play(fd, w, n);
+}
+
+/*
+ * morph_render() - Render @in through the engines along trajectory @ev.
+ */
+static void morph_render(const char *in, const char *out, const struct wah_params *from,
+	const struct wah_event *ev, uint32_t count, double delay){
+	struct wah_engine *eng;
+	struct wah_morph m;
+	struct wah_wav wav;
+	int32_t **ch;
+	uint8_t hdr[WAH_WAV_HEADER], *bytes;
+	uint64_t pos;
+	size_t n;
+	unsigned c;
+	FILE *f;
+
+	if (wah_wav_open(&wav, in) < 0) {
+		printf("failed to open %s: %s\n", in,
+			errno == EINVAL ? "not a supported WAV file" : strerror(errno));
+		exit(1);
+	}
+	if (wav.rate != WAH_SAMPLE_RATE) {
+		printf("%s: the engine runs at %d Hz\n", in, WAH_SAMPLE_RATE);
+		exit(1);
+	}
+	eng = malloc(wav.channels * sizeof(*eng));
+	ch = malloc(wav.channels * sizeof(*ch));
+	bytes = malloc((size_t)wav.channels * MORPH_BLOCK * WAH_WAV_OUT_BYTES);
+	for (c = 0; c < wav.channels; c++) {
+		wah_engine_init(&eng[c], from);
+		ch[c] = malloc(MORPH_BLOCK * sizeof(int32_t));
+	}
+
+	f = fopen(out, "wb");
+	wah_wav_header(hdr, WAH_SAMPLE_RATE, wav.channels, wav.frames);
+	if (f == NULL || fwrite(hdr, sizeof(hdr), 1, f) != 1) {
+		printf("failed to write %s: %s\n", out, strerror(errno));
+		exit(1);
+	}
+	wah_morph_start(&m, ev, count, (uint64_t)(delay * WAH_SAMPLE_RATE));
+	for (pos = 0; pos < wav.frames; pos += n) {
+		n = wav.frames - pos < MORPH_BLOCK ? wav.frames - pos : MORPH_BLOCK;
+		wah_wav_decode(&wav, pos, n, ch);
+		wah_morph_run(&m, eng, wav.channels, (const int32_t *const *)ch, ch, n);
+		wah_wav_encode((const int32_t *const *)ch, wav.channels, n, bytes);
+		if (fwrite(bytes, wav.channels * WAH_WAV_OUT_BYTES, n, f) != n) {
+			printf("failed to write %s: %s\n", out, strerror(errno));
+			exit(1);
+		}
+	}
+	if (fclose(f) != 0) {
+		printf("failed to write %s: %s\n", out, strerror(errno));
+		exit(1);
+	}
+	if (m.next < m.count)
+		printf("%s ends before the morph: %u of %u updates applied\n", in, m.next, m.count);
+
+	for (c = 0; c < wav.channels; c++)
+		free(ch[c]);
+	free(ch);
+	free(eng);
+	free(bytes);
+	wah_wav_close(&wav);
+}
+
+int main(int argc, char **argv){
+	static struct wah_event ev[MORPH_STREAM_MAX];
+	const char *save = NULL, *drop = NULL, *render = NULL, *home;
+	const struct wah_params *from = NULL, *to;
+	struct wah_params base;
+	char path[4096];
+	double ms = 500, stepMs = 0, delay = 0;
+	uint32_t count, i;
+	int opt, list = 0, fromDevice = 0, dryRun = 0, fd = -1, j, args;
+
+	store_path = getenv("WAH_PRESETS");
+	while ((opt = getopt(argc, argv, "f:ls:dx:t:S:nr:a:h")) != -1) {
+		switch (opt) {
+		case 'f':
+			store_path = optarg;
+			break;
+		case 'l':
+			list = 1;
+			break;
+		case 's':
+			save = optarg;
+			break;
+		case 'd':
+			fromDevice = 1;
+			break;
+		case 'x':
+			drop = optarg;
+			break;
+		case 't':
+			ms = strtod(optarg, NULL);
+			break;
+		case 'S':
+			stepMs = strtod(optarg, NULL);
+			break;
+		case 'n':
+			dryRun = 1;
+			break;
+		case 'r':
+			render = optarg;
+			break;
+		case 'a':
+			delay = strtod(optarg, NULL);
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (store_path == NULL) {
+		home = getenv("HOME");
+		snprintf(path, sizeof(path), "%s/.wahpresets", home ? home : ".");
+		store_path = path;
+	}
+	if (wah_presets_load(&store, store_path) < 0) {
+		printf("failed to load %s: %s\n", store_path,
+			errno == EINVAL ? "not a preset store" : strerror(errno));
+		exit(1);
+	}
+	// -r takes out.wav and always both presets.
+	if (render)
+		optind++;
+	args = argc - optind;
+
+	if (list) {
+		for (i = 0; i < store.count; i++)
+			print_params(store.preset[i].name, &store.preset[i].p);
+		return 0;
+	}
+
+	if (save || drop) {
+		if (drop && wah_preset_remove(&store, drop) < 0) {
+			printf("no preset %s in %s\n", drop, store_path);
+			exit(1);
+		}
+		if (save) {
+			if (fromDevice) {
+				fd = device_open();
+				device_read(fd, &base);
+				close(fd);
+			} else if (wah_preset_find(&store, save)) {
+				base = *preset(save);
+			} else {
+				wah_params_default(&base);
+			}
+			for (j = optind; j < argc; j++) {
+				char *eq = strchr(argv[j], '=');
+				int r = eq ? wah_param_lookup(argv[j], eq - argv[j]) : -1;
+
+				if (r < 0) {
+					printf("unknown setting %s\n", argv[j]);
+					exit(1);
+				}
+				wah_params_set(&base, r, strtoul(eq + 1, NULL, 0));
+			}
+			if (wah_preset_put(&store, save, &base) < 0) {
+				printf("bad preset name %s\n", save);
+				exit(1);
+			}
+			print_params(save, &base);
+		}
+		if (wah_presets_save(&store, store_path) < 0) {
+			printf("failed to save %s: %s\n", store_path, strerror(errno));
+			exit(1);
+		}
+		return 0;
+	}
+
+	if (args < 1 || args > 2 || (render && args != 2) || optind > argc || ms < 0 ||
+	    stepMs < 0) {
+		usage(argv[0]);
+		exit(1);
+	}
+	if (args == 2)
+		from = preset(argv[optind]);
+	to = preset(argv[argc - 1]);
+	if (from == NULL) {
+		fd = device_open();
+		device_read(fd, &base);
+		from = &base;
+	}
+
+	// 1 ms steps, or as fine as still fits one stream
+	if (stepMs == 0)
+		stepMs = ms * WAH_PARAM_COUNT / MORPH_STREAM_MAX > 1 ?
+			ms * WAH_PARAM_COUNT / MORPH_STREAM_MAX : 1;
+	count = wah_morph_plan(from, to, (uint32_t)(ms * WAH_SAMPLE_RATE / 1000),
+		(uint32_t)(stepMs * WAH_SAMPLE_RATE / 1000), ev, MORPH_STREAM_MAX);
+	if (count > MORPH_STREAM_MAX) {
+		printf("%u updates are more than the driver takes (%d); use a longer step\n",
+			count, MORPH_STREAM_MAX);
+		exit(1);
+	}
+
+	if (dryRun) {
+		for (i = 0; i < count; i++)
+			printf("%9.3f ms %-6s %u\n", ev[i].offset * 1000.0 / WAH_SAMPLE_RATE,
+				wah_param_names[ev[i].param], ev[i].value);
+	} else if (render) {
+		morph_render(render, argv[optind - 1], from, ev, count, delay);
+	} else {
+		if (fd < 0)
+			fd = device_open();
+		morph_device(fd, args == 2 ? from : NULL, ev, count, (uint32_t)ms);
+	}
+	if (fd >= 0)
+		close(fd);
+	wah_presets_free(&store);
+	return 0;
+}
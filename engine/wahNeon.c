@@ -0,0 +1,225 @@
+/*-------------------------------------------------------------------------
+ * Description:  Stereo engine for the DE10-Nano's Cortex-A9 (ARMv7 NEON).
+ *-------------------------------------------------------------------------*/
+#include <string.h>
+
+#include "wahNeon.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#elif defined(WAH_NEON_MODEL)
+#include "wahNeonModel.h"
+#endif
+
+void wah_neon_init(struct wah_neon *s, const struct wah_params *p)
+{
+	wah_engine_init(&s->eng, p);
+	memset(&s->right, 0, sizeof(s->right));
+}
+
+/*
+ * wah_neon_reset() - Clear the Fc triangle and both filters.
+ */
+void wah_neon_reset(struct wah_neon *s)
+{
+	wah_engine_reset(&s->eng);
+	memset(&s->right, 0, sizeof(s->right));
+}
+
+#if defined(__ARM_NEON) || defined(WAH_NEON_MODEL)
+/*
+ * mul_shr2() - wah_mul_shr(@a, @b, @s) on both lanes of @b.
+ *
+ * The unsigned 128-bit product from four vmull.u32, then a subtracted
+ * from the high half for each negative operand, as in wah_mul_shr().
+ */
+static inline int64x2_t mul_shr2(int64_t a, int64x2_t b, unsigned s)
+{
+	const uint64_t ua = (uint64_t)a;
+	const uint32x2_t al = vdup_n_u32((uint32_t)ua), ah = vdup_n_u32((uint32_t)(ua >> 32));
+	const uint64x2_t ub = vreinterpretq_u64_s64(b), low = vdupq_n_u64(0xffffffff);
+	const uint32x2_t bl = vmovn_u64(ub), bh = vshrn_n_u64(ub, 32);
+	uint64x2_t ll = vmull_u32(al, bl), lh = vmull_u32(al, bh);
+	uint64x2_t hl = vmull_u32(ah, bl), hh = vmull_u32(ah, bh);
+	uint64x2_t mid, lo, hi;
+
+	mid = vaddq_u64(vaddq_u64(vshrq_n_u64(ll, 32), vandq_u64(lh, low)), vandq_u64(hl, low));
+	lo = vorrq_u64(vshlq_n_u64(mid, 32), vandq_u64(ll, low));
+	hi = vaddq_u64(vaddq_u64(hh, vshrq_n_u64(lh, 32)),
+		vaddq_u64(vshrq_n_u64(hl, 32), vshrq_n_u64(mid, 32)));
+	if (a < 0)
+		hi = vsubq_u64(hi, ub);
+	hi = vsubq_u64(hi, vandq_u64(vreinterpretq_u64_s64(vshrq_n_s64(b, 63)), vdupq_n_u64(ua)));
+	return vreinterpretq_s64_u64(vorrq_u64(vshlq_u64(lo, vdupq_n_s64(-(int64_t)s)),
+		vshlq_u64(hi, vdupq_n_s64(64 - (int64_t)s))));
+}
+
+/* wah_wrap24() on both lanes                                            */
+static inline int32x2_t wrap24x2(int64x2_t v){
+	return vshr_n_s32(vshl_n_s32(vmovn_s64(v), 8), 8);
+}
+
+/*
+ * filter2() - The filter core over @n interleaved frames of @x into @wet.
+ */
+static void filter2(struct wah_neon *s, const int32_t *x, int32_t *wet, size_t n)
+{
+	const struct wah_params p = s->eng.params;
+	const int64_t q1 = wah_q1(p.damp);
+	struct wah_lfo lfo = s->eng.lfo;
+	int64x2_t yb = vcombine_s64(vcreate_s64((uint64_t)s->eng.svf.yb),
+		vcreate_s64((uint64_t)s->right.yb));
+	int64x2_t yl = vcombine_s64(vcreate_s64((uint64_t)s->eng.svf.yl),
+		vcreate_s64((uint64_t)s->right.yl));
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		int64_t f1 = wah_f1(wah_lfo_step(&lfo, p.minf, p.maxf, p.delta));
+		int64x2_t x2 = vshlq_n_s64(vmovl_s32(vld1_s32(x + 2 * i)), 25);
+		int64x2_t yh = vqaddq_s64(vsubq_s64(x2, yl), mul_shr2(-q1, yb, 16));
+
+		yb = vqaddq_s64(mul_shr2(f1, yh, 48), yb);
+		yl = vqaddq_s64(mul_shr2(f1, yb, 48), yl);
+		vst1_s32(wet + 2 * i, wrap24x2(mul_shr2(WAH_WET_GAIN, yb, 41)));
+	}
+
+	s->eng.lfo = lfo;
+	s->eng.svf.yb = vgetq_lane_s64(yb, 0);
+	s->eng.svf.yl = vgetq_lane_s64(yl, 0);
+	s->right.yb = vgetq_lane_s64(yb, 1);
+	s->right.yl = vgetq_lane_s64(yl, 1);
+}
+
+/*
+ * mix2() - Mixer and volume over @n interleaved frames, wetDry and volume
+ * ramping linearly from @wd and @vol (WAH_RAMP_FRAC).
+ *
+ * (v * volume) >> 32 with v up to 48 bits is split at bit 32, so both
+ * halves are 32x32 products: hi * volume + (lo * volume >> 32).
+ */
+static void mix2(const int32_t *x, const int32_t *wet, int32_t *y, size_t n,
+	int64_t wd, int64_t wdInc, int64_t vol, int64_t volInc, uint32_t enable)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		int32_t w = (int32_t)(uint32_t)((wd + (int64_t)i * wdInc) >> WAH_RAMP_FRAC);
+		int32_t v = (int32_t)(uint32_t)((vol + (int64_t)i * volInc) >> WAH_RAMP_FRAC);
+		int32x2_t dry = vld1_s32(x + 2 * i);
+		int64x2_t m;
+
+		if (enable)
+			m = vmlal_s32(vmull_s32(dry, vdup_n_s32(WAH_ONE_EN16 - w)),
+				vld1_s32(wet + 2 * i), vdup_n_s32(w));
+		else
+			m = vshll_n_s32(dry, 16);
+		m = vaddq_s64(vmull_s32(vshrn_n_s64(m, 32), vdup_n_s32(v)),
+			vreinterpretq_s64_u64(vshrq_n_u64(vmull_u32(
+				vmovn_u64(vreinterpretq_u64_s64(m)), vdup_n_u32((uint32_t)v)), 32)));
+		vst1_s32(y + 2 * i, wrap24x2(m));
+	}
+}
+#else
+static void filter2(struct wah_neon *s, const int32_t *x, int32_t *wet, size_t n)
+{
+	const struct wah_params p = s->eng.params;
+	const int64_t q1 = wah_q1(p.damp);
+	struct wah_lfo lfo = s->eng.lfo;
+	struct wah_svf l = s->eng.svf, r = s->right;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		int64_t f1 = wah_f1(wah_lfo_step(&lfo, p.minf, p.maxf, p.delta));
+
+		wet[2 * i] = wah_wet(wah_svf_step(&l, x[2 * i], f1, q1));
+		wet[2 * i + 1] = wah_wet(wah_svf_step(&r, x[2 * i + 1], f1, q1));
+	}
+
+	s->eng.lfo = lfo;
+	s->eng.svf = l;
+	s->right = r;
+}
+
+static void mix2(const int32_t *x, const int32_t *wet, int32_t *y, size_t n,
+	int64_t wd, int64_t wdInc, int64_t vol, int64_t volInc, uint32_t enable)
+{
+	size_t i;
+
+	for (i = 0; i < 2 * n; i++) {
+		uint32_t w = (uint32_t)((wd + (int64_t)(i / 2) * wdInc) >> WAH_RAMP_FRAC);
+		uint32_t v = (uint32_t)((vol + (int64_t)(i / 2) * volInc) >> WAH_RAMP_FRAC);
+
+		y[i] = wah_output(x[i], wah_mix(x[i], wet[i], w), enable, v);
+	}
+}
+#endif
+
+/*
+ * render() - Run a segment with constant register values.
+ *
+ * The channels are interleaved for the lanes a chunk at a time, and the
+ * mixer is split where a ramp changes course, as in wah_engine_mix().
+ */
+static void render(struct wah_neon *s, const int32_t *const *in, int32_t *const *out,
+	size_t pos, size_t n)
+{
+	int32_t x[2 * WAH_CHUNK], wet[2 * WAH_CHUNK], y[2 * WAH_CHUNK];
+	struct wah_engine *eng = &s->eng;
+	size_t end = pos + n, c, i, len;
+
+	for (; pos < end; pos += c) {
+		c = end - pos < WAH_CHUNK ? end - pos : WAH_CHUNK;
+
+		for (i = 0; i < c; i++) {
+			x[2 * i] = in[0][pos + i];
+			x[2 * i + 1] = in[1][pos + i];
+		}
+		filter2(s, x, wet, c);
+		for (i = 0; i < c; i += len) {
+			len = c - i;
+			if (eng->volume.left && eng->volume.left < len)
+				len = eng->volume.left;
+			if (eng->wetDry.left && eng->wetDry.left < len)
+				len = eng->wetDry.left;
+			mix2(x + 2 * i, wet + 2 * i, y + 2 * i, len, eng->wetDry.cur,
+				eng->wetDry.inc, eng->volume.cur, eng->volume.inc,
+				eng->params.enable);
+			wah_ramp_advance(&eng->volume, (uint32_t)len);
+			wah_ramp_advance(&eng->wetDry, (uint32_t)len);
+		}
+		for (i = 0; i < c; i++) {
+			out[0][pos + i] = y[2 * i];
+			out[1][pos + i] = y[2 * i + 1];
+		}
+	}
+}
+
+/*
+ * wah_neon_process() - wah_engine_process() for two channels.
+ * @in, @out: Left and right buffers; @out may be @in.
+ */
+void wah_neon_process(struct wah_neon *s, const int32_t *const *in, int32_t *const *out,
+	size_t n)
+{
+	struct wah_event_queue *q = &s->eng.events;
+	size_t pos = 0;
+	uint32_t i = 0, j;
+
+	for (; i < q->count && q->ev[i].offset < n; i++) {
+		size_t at = q->ev[i].offset;
+
+		if (at > pos) {
+			render(s, in, out, pos, at - pos);
+			pos = at;
+		}
+		wah_engine_set(&s->eng, q->ev[i].param, q->ev[i].value);
+	}
+	if (pos < n)
+		render(s, in, out, pos, n - pos);
+
+	for (j = 0; i < q->count; i++, j++) {
+		q->ev[j] = q->ev[i];
+		q->ev[j].offset -= n;
+	}
+	q->count = j;
+}
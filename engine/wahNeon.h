@@ -0,0 +1,63 @@
+/*-------------------------------------------------------------------------
+ * Description:  Stereo engine for the DE10-Nano's Cortex-A9 (ARMv7 NEON).
+ *
+ *               A fallback for when the wahWahEffectSystem bitstream
+ *               isn't loaded, or for a second effect instance beside it:
+ *               the HPS runs the datapath in software, with the HDL's
+ *               fixed-point formats, bit-exact with wah_engine_process()
+ *               on every channel.
+ *
+ *               Both channels share registers and the Fc triangle, so F1
+ *               is worked out once per sample and the two filters run as
+ *               the two lanes of NEON 64-bit vectors. The En48 products
+ *               are built from 32x32 partial products (vmull.u32) with
+ *               the sign corrections of wah_mul_shr()'s 32-bit path, the
+ *               saturating adds are vqadd.s64 and the filter state never
+ *               leaves the NEON registers, since moving results back to
+ *               the core stalls the A9's pipeline. The mixer and volume
+ *               stage run on the same lanes. Without NEON (x86, or ARM
+ *               built without -mfpu=neon) the same API runs the portable
+ *               datapath, which is what the NEON build is checked against.
+ *               With -DWAH_NEON_MODEL the NEON code instead builds on any
+ *               host against wahNeonModel.h, a scalar model of the
+ *               intrinsics, so wahNeonCheck can test its arithmetic where
+ *               there is no ARM toolchain.
+ *
+ *               Not yet timed on the A9. Counting the loop by hand gives
+ *               about 140 NEON instructions a stereo frame, most of them
+ *               two-cycle Q operations on the A9's 64-bit NEON datapath,
+ *               so some 300-400 cycles a frame (150-200 a sample) with
+ *               the serial yb/yl chain's stalls: 2-2.5% of one 800 MHz
+ *               core at 48 kHz. wahBench -c 800 neon on the board gives
+ *               the real figure.
+ *
+ *               Registers, ramps and scheduled events go through @eng as
+ *               with a single engine.
+ *
+ * Build (HPS):  arm-linux-gnueabihf-gcc -O3 -mcpu=cortex-a9 -mfpu=neon
+ *                   -mfloat-abi=hard ...
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_NEON_H
+#define WAH_NEON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahEngine.h"
+
+/*
+ * struct wah_neon - A stereo engine.
+ * @eng: Registers, Fc triangle, ramps, events and the left filter.
+ * @right: The right filter.
+ */
+struct wah_neon {
+	struct wah_engine eng;
+	struct wah_svf right;
+};
+
+void wah_neon_init(struct wah_neon *s, const struct wah_params *p);
+void wah_neon_reset(struct wah_neon *s);
+void wah_neon_process(struct wah_neon *s, const int32_t *const *in, int32_t *const *out,
+	size_t n);
+
+#endif
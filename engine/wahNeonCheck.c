@@ -0,0 +1,153 @@
+/*-------------------------------------------------------------------------
+ * Description:  Bit-exactness check of the stereo NEON engine.
+ *
+ *                 wahNeonCheck [-n seconds] [-s seed]
+ *
+ *               Renders noise on the left and a swept tone on the right
+ *               through wahNeon.c and through two wah_engine instances in
+ *               blocks of random size, with random register events and
+ *               ramp changes along the way, and compares every sample.
+ *               The output hash depends only on the seed and length, so
+ *               the same run on x86 and on the Cortex-A9 (or under
+ *               qemu-user) must print the same line:
+ *
+ *                 gcc -O2 -o wahNeonCheck wahNeonCheck.c wahNeon.c wahEngine.c
+ *                     wahCycle.c -lm
+ *                 arm-linux-gnueabihf-gcc -O3 -mcpu=cortex-a9 -mfpu=neon
+ *                     -mfloat-abi=hard -static -o wahNeonCheck.arm
+ *                     wahNeonCheck.c wahNeon.c wahEngine.c wahCycle.c -lm
+ *                 qemu-arm ./wahNeonCheck.arm
+ *
+ *               Without either, -DWAH_NEON_MODEL runs the NEON code on the
+ *               host through wahNeonModel.h and must print the hash of the
+ *               portable build:
+ *
+ *                 gcc -O2 -DWAH_NEON_MODEL -o wahNeonCheck.model
+ *                     wahNeonCheck.c wahNeon.c wahEngine.c wahCycle.c -lm
+ *
+ *               The tool says whether it was built with NEON, so a run
+ *               that quietly fell back to the portable path shows up.
+ *-------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "wahNeon.h"
+
+/* Largest random block                                                  */
+#define CHECK_BLOCK 512
+
+static uint64_t xorshift(uint64_t *s){
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static uint32_t fnv1a(uint32_t h, const int32_t *x, size_t n){
+	size_t i;
+	unsigned b;
+
+	for (i = 0; i < n; i++)
+		for (b = 0; b < 32; b += 8) {
+			h ^= ((uint32_t)x[i] >> b) & 0xff;
+			h *= 16777619;
+		}
+	return h;
+}
+
+int main(int argc, char **argv){
+	static int32_t in[2][CHECK_BLOCK], out[2][CHECK_BLOCK], ref[2][CHECK_BLOCK];
+	int32_t *const inp[2] = { in[0], in[1] }, *const outp[2] = { out[0], out[1] };
+	struct wah_engine eng[2];
+	struct wah_neon s;
+	struct wah_params p;
+	uint64_t seed = 1, frames, pos = 0, bad = 0;
+	uint32_t hash = 2166136261u;
+	double seconds = 60, phase = 0;
+	size_t n, i;
+	int opt, c;
+
+	while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			seconds = strtod(optarg, NULL);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			printf("usage: %s [-n seconds] [-s seed]\n", argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (seed == 0) {
+		printf("seed must not be 0\n");
+		exit(1);
+	}
+
+	wah_params_default(&p);
+	wah_neon_init(&s, &p);
+	wah_engine_init(&eng[0], &p);
+	wah_engine_init(&eng[1], &p);
+	frames = (uint64_t)(seconds * WAH_SAMPLE_RATE);
+	for (pos = 0; pos < frames; pos += n) {
+		uint64_t r = xorshift(&seed);
+
+		n = 1 + r % CHECK_BLOCK;
+		if (n > frames - pos)
+			n = frames - pos;
+		// Register values near the useful range, so the filter rings
+		// rather than just saturating.
+		if (((r >> 10) & 7) == 0) {
+			unsigned param = (unsigned)(xorshift(&seed) % WAH_PARAM_COUNT);
+			uint32_t value = (uint32_t)xorshift(&seed) & 0xffff;
+			uint32_t at = (uint32_t)(xorshift(&seed) % (2 * n));
+
+			if (param == WAH_MINF || param == WAH_MAXF)
+				value = 100 + value % 4000;
+			else if (param == WAH_DELTA)
+				value = 1 + value % 8;
+			wah_engine_schedule(&s.eng, at, param, value);
+			for (c = 0; c < 2; c++)
+				wah_engine_schedule(&eng[c], at, param, value);
+		}
+		if (((r >> 16) & 63) == 0) {
+			unsigned shape = (r >> 22) & 1;
+			uint32_t samples = (uint32_t)((r >> 24) % 4800);
+
+			wah_engine_set_ramp(&s.eng, shape, samples);
+			for (c = 0; c < 2; c++)
+				wah_engine_set_ramp(&eng[c], shape, samples);
+		}
+
+		for (i = 0; i < n; i++) {
+			in[0][i] = (int32_t)(xorshift(&seed) >> 41) - (1 << 22);
+			in[1][i] = (int32_t)(0.9 * sin(phase) * (1 << 23));
+			phase += 2 * M_PI * (50 + 4000.0 * (pos + i) / frames) / WAH_SAMPLE_RATE;
+		}
+		for (c = 0; c < 2; c++)
+			wah_engine_process(&eng[c], in[c], ref[c], n);
+		wah_neon_process(&s, (const int32_t *const *)inp, outp, n);
+
+		for (c = 0; c < 2; c++) {
+			for (i = 0; i < n; i++)
+				bad += out[c][i] != ref[c][i];
+			hash = fnv1a(hash, ref[c], n);
+		}
+	}
+
+#ifdef __ARM_NEON
+	printf("neon: ");
+#elif defined(WAH_NEON_MODEL)
+	printf("neon model: ");
+#else
+	printf("portable: ");
+#endif
+	printf("%llu frames, %llu samples differ, hash %08x\n", (unsigned long long)frames,
+		(unsigned long long)bad, hash);
+	return bad ? 1 : 0;
+}
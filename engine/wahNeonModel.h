@@ -0,0 +1,248 @@
+/*-------------------------------------------------------------------------
+ * Description:  Scalar model of the NEON intrinsics wahNeon.c uses.
+ *
+ *               Built with -DWAH_NEON_MODEL on a host without NEON,
+ *               wahNeon.c compiles its __ARM_NEON datapath against these
+ *               instead of <arm_neon.h>, so wahNeonCheck can run the
+ *               vector code (partial products, sign corrections, shift
+ *               counts, saturation, narrowing) on x86 when no ARM
+ *               toolchain or qemu-arm is at hand:
+ *
+ *                 gcc -O2 -DWAH_NEON_MODEL -o wahNeonCheck wahNeonCheck.c
+ *                     wahNeon.c wahEngine.c wahCycle.c -lm
+ *
+ *               Each function follows the lane semantics of the ARMv7
+ *               instruction it stands for (ARM DDI 0406C, A8.8); only the
+ *               forms wahNeon.c needs are modelled. It says nothing about
+ *               timing, and the real NEON build still has to be run on
+ *               the A9 or under qemu-arm.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_NEON_MODEL_H
+#define WAH_NEON_MODEL_H
+
+#include <stdint.h>
+
+typedef struct { int32_t v[2]; } int32x2_t;
+typedef struct { uint32_t v[2]; } uint32x2_t;
+typedef struct { int64_t v[1]; } int64x1_t;
+typedef struct { int64_t v[2]; } int64x2_t;
+typedef struct { uint64_t v[2]; } uint64x2_t;
+
+/*-----------------------------------------------------------------------*/
+/* Moves                                                                 */
+/*-----------------------------------------------------------------------*/
+static inline int32x2_t vld1_s32(const int32_t *p)
+{
+	return (int32x2_t){ { p[0], p[1] } };
+}
+
+static inline void vst1_s32(int32_t *p, int32x2_t a)
+{
+	p[0] = a.v[0];
+	p[1] = a.v[1];
+}
+
+static inline int32x2_t vdup_n_s32(int32_t x)
+{
+	return (int32x2_t){ { x, x } };
+}
+
+static inline uint32x2_t vdup_n_u32(uint32_t x)
+{
+	return (uint32x2_t){ { x, x } };
+}
+
+static inline int64x2_t vdupq_n_s64(int64_t x)
+{
+	return (int64x2_t){ { x, x } };
+}
+
+static inline uint64x2_t vdupq_n_u64(uint64_t x)
+{
+	return (uint64x2_t){ { x, x } };
+}
+
+static inline int64x1_t vcreate_s64(uint64_t x)
+{
+	return (int64x1_t){ { (int64_t)x } };
+}
+
+static inline int64x2_t vcombine_s64(int64x1_t lo, int64x1_t hi)
+{
+	return (int64x2_t){ { lo.v[0], hi.v[0] } };
+}
+
+#define vgetq_lane_s64(a, lane) ((a).v[lane])
+
+static inline int64x2_t vreinterpretq_s64_u64(uint64x2_t a)
+{
+	return (int64x2_t){ { (int64_t)a.v[0], (int64_t)a.v[1] } };
+}
+
+static inline uint64x2_t vreinterpretq_u64_s64(int64x2_t a)
+{
+	return (uint64x2_t){ { (uint64_t)a.v[0], (uint64_t)a.v[1] } };
+}
+
+/*-----------------------------------------------------------------------*/
+/* Widening and narrowing                                                */
+/*-----------------------------------------------------------------------*/
+/* vmovl.s32                                                             */
+static inline int64x2_t vmovl_s32(int32x2_t a)
+{
+	return (int64x2_t){ { a.v[0], a.v[1] } };
+}
+
+/* vmovn.i64: the low half of each lane                                  */
+static inline int32x2_t vmovn_s64(int64x2_t a)
+{
+	return (int32x2_t){ { (int32_t)(uint32_t)a.v[0], (int32_t)(uint32_t)a.v[1] } };
+}
+
+static inline uint32x2_t vmovn_u64(uint64x2_t a)
+{
+	return (uint32x2_t){ { (uint32_t)a.v[0], (uint32_t)a.v[1] } };
+}
+
+/* vshrn.i64: shift right (arithmetic for s64), keep the low half        */
+static inline int32x2_t vshrn_n_s64(int64x2_t a, int n)
+{
+	return (int32x2_t){ { (int32_t)(uint32_t)(a.v[0] >> n),
+		(int32_t)(uint32_t)(a.v[1] >> n) } };
+}
+
+static inline uint32x2_t vshrn_n_u64(uint64x2_t a, int n)
+{
+	return (uint32x2_t){ { (uint32_t)(a.v[0] >> n), (uint32_t)(a.v[1] >> n) } };
+}
+
+/* vshll.s32: widen, then shift left                                     */
+static inline int64x2_t vshll_n_s32(int32x2_t a, int n)
+{
+	return (int64x2_t){ { (int64_t)((uint64_t)(int64_t)a.v[0] << n),
+		(int64_t)((uint64_t)(int64_t)a.v[1] << n) } };
+}
+
+/* vmull.s32, vmull.u32, vmlal.s32: full 64-bit products                 */
+static inline int64x2_t vmull_s32(int32x2_t a, int32x2_t b)
+{
+	return (int64x2_t){ { (int64_t)a.v[0] * b.v[0], (int64_t)a.v[1] * b.v[1] } };
+}
+
+static inline uint64x2_t vmull_u32(uint32x2_t a, uint32x2_t b)
+{
+	return (uint64x2_t){ { (uint64_t)a.v[0] * b.v[0], (uint64_t)a.v[1] * b.v[1] } };
+}
+
+static inline int64x2_t vmlal_s32(int64x2_t acc, int32x2_t a, int32x2_t b)
+{
+	int64x2_t p = vmull_s32(a, b);
+
+	return (int64x2_t){ { (int64_t)((uint64_t)acc.v[0] + (uint64_t)p.v[0]),
+		(int64_t)((uint64_t)acc.v[1] + (uint64_t)p.v[1]) } };
+}
+
+/*-----------------------------------------------------------------------*/
+/* Arithmetic and logic, modulo 2^64 unless saturating                   */
+/*-----------------------------------------------------------------------*/
+static inline int64x2_t vaddq_s64(int64x2_t a, int64x2_t b)
+{
+	return vreinterpretq_s64_u64((uint64x2_t){ { (uint64_t)a.v[0] + (uint64_t)b.v[0],
+		(uint64_t)a.v[1] + (uint64_t)b.v[1] } });
+}
+
+static inline uint64x2_t vaddq_u64(uint64x2_t a, uint64x2_t b)
+{
+	return (uint64x2_t){ { a.v[0] + b.v[0], a.v[1] + b.v[1] } };
+}
+
+static inline int64x2_t vsubq_s64(int64x2_t a, int64x2_t b)
+{
+	return vreinterpretq_s64_u64((uint64x2_t){ { (uint64_t)a.v[0] - (uint64_t)b.v[0],
+		(uint64_t)a.v[1] - (uint64_t)b.v[1] } });
+}
+
+static inline uint64x2_t vsubq_u64(uint64x2_t a, uint64x2_t b)
+{
+	return (uint64x2_t){ { a.v[0] - b.v[0], a.v[1] - b.v[1] } };
+}
+
+static inline uint64x2_t vandq_u64(uint64x2_t a, uint64x2_t b)
+{
+	return (uint64x2_t){ { a.v[0] & b.v[0], a.v[1] & b.v[1] } };
+}
+
+static inline uint64x2_t vorrq_u64(uint64x2_t a, uint64x2_t b)
+{
+	return (uint64x2_t){ { a.v[0] | b.v[0], a.v[1] | b.v[1] } };
+}
+
+/* vqadd.s64                                                             */
+static inline int64_t qadd64(int64_t a, int64_t b)
+{
+	int64_t r;
+
+	if (__builtin_add_overflow(a, b, &r))
+		return a < 0 ? INT64_MIN : INT64_MAX;
+	return r;
+}
+
+static inline int64x2_t vqaddq_s64(int64x2_t a, int64x2_t b)
+{
+	return (int64x2_t){ { qadd64(a.v[0], b.v[0]), qadd64(a.v[1], b.v[1]) } };
+}
+
+/*-----------------------------------------------------------------------*/
+/* Shifts                                                                */
+/*-----------------------------------------------------------------------*/
+static inline int32x2_t vshl_n_s32(int32x2_t a, int n)
+{
+	return (int32x2_t){ { (int32_t)((uint32_t)a.v[0] << n),
+		(int32_t)((uint32_t)a.v[1] << n) } };
+}
+
+static inline int32x2_t vshr_n_s32(int32x2_t a, int n)
+{
+	return (int32x2_t){ { a.v[0] >> n, a.v[1] >> n } };
+}
+
+static inline int64x2_t vshlq_n_s64(int64x2_t a, int n)
+{
+	return vreinterpretq_s64_u64((uint64x2_t){ { (uint64_t)a.v[0] << n,
+		(uint64_t)a.v[1] << n } });
+}
+
+static inline uint64x2_t vshlq_n_u64(uint64x2_t a, int n)
+{
+	return (uint64x2_t){ { a.v[0] << n, a.v[1] << n } };
+}
+
+static inline int64x2_t vshrq_n_s64(int64x2_t a, int n)
+{
+	return (int64x2_t){ { a.v[0] >> n, a.v[1] >> n } };
+}
+
+static inline uint64x2_t vshrq_n_u64(uint64x2_t a, int n)
+{
+	return (uint64x2_t){ { a.v[0] >> n, a.v[1] >> n } };
+}
+
+/*
+ * vshl.u64 by register: the signed low byte of each count lane shifts
+ * left, or right when negative; 64 or more either way clears the lane.
+ */
+static inline uint64_t shl64(uint64_t a, int64_t count)
+{
+	int8_t n = (int8_t)count;
+
+	if (n >= 64 || n <= -64)
+		return 0;
+	return n >= 0 ? a << n : a >> -n;
+}
+
+static inline uint64x2_t vshlq_u64(uint64x2_t a, int64x2_t b)
+{
+	return (uint64x2_t){ { shl64(a.v[0], b.v[0]), shl64(a.v[1], b.v[1]) } };
+}
+
+#endif
@@ -0,0 +1,298 @@
+/*-------------------------------------------------------------------------
+ * Description:  Oversampled mode of the software wah engine.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <string.h>
+
+#include "wahOversample.h"
+
+/*
+ * Half-band side taps, Q30: Kaiser-windowed (beta 7.86) sinc, scaled so
+ * the DC gain is exactly 1.
+ *
+ * Stage A (1x <-> 2x), 63 taps: flat to 20 kHz at 48 kHz, 79 dB down
+ * from 28 kHz, so the images and aliases of the audio band are gone.
+ * Stage B (2x <-> 4x), 19 taps: only has to clear 76 kHz, 77 dB down.
+ */
+#define HB_A_HALF 16
+#define HB_B_HALF 5
+
+static const int32_t hb_a[HB_A_HALF] = {
+	340479804, -110069479, 62094849, -40400209, 27695276, -19293164, 13396067, -9153018,
+	6090991, -3908622, 2391404, -1374444, 725740, -338650, 128302, -29391,
+};
+
+static const int32_t hb_b[HB_B_HALF] = {
+	326624765, -74941020, 20012349, -3361882, 101244,
+};
+
+static inline int32_t sat24(int64_t v){
+	return (int32_t)wah_sat(v, 24);
+}
+
+/*
+ * hb_init() - Set up @hb as an interpolator, or as a decimator whose
+ * output is @lag input samples later than the filter alone makes it.
+ *
+ * An interpolator delays by 2 * half - 1 samples at its output rate, a
+ * decimator by 2 * half - 2 + lag at its input rate; the lags make the
+ * whole chain a whole number of input samples.
+ */
+static void hb_init(struct wah_halfband *hb, const int32_t *coef, unsigned half, int down,
+	unsigned lag)
+{
+	hb->coef = coef;
+	hb->half = half;
+	hb->hist = down ? 4 * half - 2 + lag : 2 * half - 1;
+	memset(hb->buf, 0, sizeof(hb->buf));
+}
+
+/*
+ * hb_up() - Interpolate @n samples into 2 * @n.
+ *
+ * With history ahead, even outputs are the filter's odd taps over the
+ * window and odd outputs fall on the centre tap, a plain copy.
+ */
+static void hb_up(struct wah_halfband *hb, const int32_t *in, size_t n, int32_t *out)
+{
+	const unsigned k = hb->half;
+	int32_t *b = hb->buf;
+	int64_t acc[WAH_OS_MAX * WAH_CHUNK];
+	size_t m;
+	unsigned i;
+
+	memcpy(b + hb->hist, in, n * sizeof(int32_t));
+	for (m = 0; m < n; m++)
+		acc[m] = 0;
+	for (i = 0; i < k; i++) {
+		const int64_t cf = hb->coef[i];
+		const int32_t *x0 = b + k - 1 - i, *x1 = b + k + i;
+
+		for (m = 0; m < n; m++)
+			acc[m] += cf * (x0[m] + x1[m]);
+	}
+	// Zero stuffing halves the level; the taps are doubled back with
+	// one less bit of shift.
+	for (m = 0; m < n; m++) {
+		out[2 * m] = sat24((acc[m] + (1 << 28)) >> 29);
+		out[2 * m + 1] = b[m + k];
+	}
+	memmove(b, b + n, hb->hist * sizeof(int32_t));
+}
+
+/*
+ * hb_down() - Decimate 2 * @n samples into @n.
+ *
+ * The input is split into even and odd samples first, so every tap is
+ * a unit-stride loop: the centre tap reads the evens, the side taps
+ * the odds.
+ */
+static void hb_down(struct wah_halfband *hb, const int32_t *in, size_t n, int32_t *out)
+{
+	enum { SPLIT = (WAH_OS_HIST + WAH_OS_MAX * WAH_CHUNK) / 2 + 1 };
+	const unsigned k = hb->half;
+	const size_t len = hb->hist + 2 * n;
+	int32_t *b = hb->buf, ev[SPLIT], od[SPLIT];
+	int64_t acc[WAH_OS_MAX * WAH_CHUNK];
+	size_t m;
+	unsigned i;
+
+	memcpy(b + hb->hist, in, 2 * n * sizeof(int32_t));
+	for (m = 0; m < len / 2; m++) {
+		ev[m] = b[2 * m];
+		od[m] = b[2 * m + 1];
+	}
+	if (len & 1)
+		ev[m] = b[2 * m];
+
+	for (m = 0; m < n; m++)
+		acc[m] = (int64_t)ev[m + k] << 29;
+	for (i = 0; i < k; i++) {
+		const int64_t cf = hb->coef[i];
+		const int32_t *x0 = od + k + i, *x1 = od + k - 1 - i;
+
+		for (m = 0; m < n; m++)
+			acc[m] += cf * (x0[m] + x1[m]);
+	}
+	for (m = 0; m < n; m++)
+		out[m] = sat24((acc[m] + (1 << 29)) >> 30);
+	memmove(b, b + 2 * n, hb->hist * sizeof(int32_t));
+}
+
+/*
+ * os_f1() - F1 = 2*sin(pi*fc/(fs << shift)) from the HDL quarter-wave
+ * table.
+ *
+ * wah_f1() only has 12 bits of phase, which at 4x would step fc in
+ * 94 Hz stairs; here the next 16 bits interpolate between entries.
+ */
+static inline int64_t os_sine(unsigned phase){
+	unsigned half = phase > 2048 ? phase - 2048 : phase;
+	unsigned k = half <= 1024 ? half : 2048 - half;
+	int64_t s = wah_sine_table[k > 1023 ? 1023 : k];
+
+	return phase > 2048 ? -s : s;
+}
+
+static inline int64_t os_f1(int64_t fc, unsigned shift){
+	uint32_t p = (uint32_t)((fc * WAH_F1_SCALE) >> (20 + shift)) & 0xfffffff;
+	unsigned k = p >> 16;
+	int64_t s0 = os_sine(k), s1 = os_sine((k + 1) & 0xfff);
+
+	return 2 * (s0 + (((s1 - s0) * (int64_t)(p & 0xffff)) >> 16));
+}
+
+/*
+ * os_filter() - The filter core over @n input samples' worth of
+ * oversampled input @x; the wet signal replaces it.
+ */
+static void os_filter(struct wah_os *os, int32_t *x, size_t n)
+{
+	struct wah_engine *eng = &os->eng;
+	const struct wah_params p = eng->params;
+	const int64_t q1 = wah_q1(p.damp);
+	const unsigned r = os->factor, shift = r == 4 ? 2 : 1;
+	struct wah_lfo lfo = eng->lfo;
+	struct wah_svf svf = eng->svf;
+	size_t i;
+	unsigned j;
+
+	for (i = 0; i < n; i++, x += r) {
+		int64_t f1 = os_f1(wah_lfo_step(&lfo, p.minf, p.maxf, p.delta), shift);
+
+		for (j = 0; j < r; j++)
+			x[j] = wah_wet(wah_svf_step(&svf, x[j], f1, q1));
+	}
+
+	eng->lfo = lfo;
+	eng->svf = svf;
+}
+
+/*
+ * os_render() - Run a segment with constant register values.
+ */
+static void os_render(struct wah_os *os, const int32_t *in, int32_t *out, size_t n)
+{
+	int32_t a[WAH_OS_MAX * WAH_CHUNK], b[WAH_OS_MAX * WAH_CHUNK], wet[WAH_CHUNK];
+	const unsigned lat = os->latency;
+	size_t pos, c;
+
+	for (pos = 0; pos < n; pos += c) {
+		c = n - pos < WAH_CHUNK ? n - pos : WAH_CHUNK;
+
+		memcpy(os->dry + lat, in + pos, c * sizeof(int32_t));
+		hb_up(&os->up[0], in + pos, c, a);
+		if (os->factor == 4) {
+			hb_up(&os->up[1], a, 2 * c, b);
+			os_filter(os, b, c);
+			hb_down(&os->down[1], b, 2 * c, a);
+		} else {
+			os_filter(os, a, c);
+		}
+		hb_down(&os->down[0], a, c, wet);
+
+		wah_engine_mix(&os->eng, os->dry, wet, out + pos, c);
+		memmove(os->dry, os->dry + c, lat * sizeof(int32_t));
+	}
+}
+
+/*
+ * wah_os_init() - Set up an engine oversampled by @factor (1, 2 or 4).
+ *
+ * Return: 0 on success, -1 with errno EINVAL for another factor.
+ */
+int wah_os_init(struct wah_os *os, unsigned factor, const struct wah_params *p)
+{
+	if (factor != 1 && factor != 2 && factor != 4) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(os, 0, sizeof(*os));
+	wah_engine_init(&os->eng, p);
+	os->factor = factor;
+	hb_init(&os->up[0], hb_a, HB_A_HALF, 0, 0);
+	hb_init(&os->up[1], hb_b, HB_B_HALF, 0, 0);
+	hb_init(&os->down[1], hb_b, HB_B_HALF, 1, 1);
+	hb_init(&os->down[0], hb_a, HB_A_HALF, 1, factor == 2);
+	// 2x: 31 + 31 samples at 96 kHz. 4x: 31 + 30 at 96 kHz and
+	// 9 + 9 at 192 kHz.
+	if (factor == 2)
+		os->latency = 2 * HB_A_HALF - 1;
+	else if (factor == 4)
+		os->latency = 2 * HB_A_HALF + HB_B_HALF - 2;
+	return 0;
+}
+
+/*
+ * wah_os_reset() - Clear the filter, the LFO and the half-band history.
+ */
+void wah_os_reset(struct wah_os *os)
+{
+	unsigned i;
+
+	wah_engine_reset(&os->eng);
+	for (i = 0; i < 2; i++) {
+		memset(os->up[i].buf, 0, sizeof(os->up[i].buf));
+		memset(os->down[i].buf, 0, sizeof(os->down[i].buf));
+	}
+	memset(os->dry, 0, sizeof(os->dry));
+}
+
+/*
+ * wah_os_latency() - Samples the output lags the input; 0 at factor 1.
+ */
+unsigned wah_os_latency(const struct wah_os *os)
+{
+	return os->latency;
+}
+
+/*
+ * wah_os_schedule() - wah_engine_schedule() for the oversampled engine.
+ *
+ * The filter registers act on the input and the mixer registers on the
+ * output, which runs wah_os_latency() behind, so those are moved back
+ * by as much: an event at @offset changes the output from @offset plus
+ * the latency either way.
+ */
+int wah_os_schedule(struct wah_os *os, uint32_t offset, unsigned param, uint32_t value)
+{
+	if (param == WAH_ENABLE || param == WAH_VOLUME || param == WAH_WETDRY)
+		offset += os->latency;
+	return wah_engine_schedule(&os->eng, offset, param, value);
+}
+
+/*
+ * wah_os_process() - wah_engine_process() for the oversampled engine.
+ * @out: May alias @in.
+ *
+ * Output lags input by wah_os_latency() samples.
+ */
+void wah_os_process(struct wah_os *os, const int32_t *in, int32_t *out, size_t n)
+{
+	struct wah_event_queue *q = &os->eng.events;
+	size_t pos = 0;
+	uint32_t i = 0, j;
+
+	if (os->factor == 1) {
+		wah_engine_process(&os->eng, in, out, n);
+		return;
+	}
+
+	for (; i < q->count && q->ev[i].offset < n; i++) {
+		size_t at = q->ev[i].offset;
+
+		if (at > pos) {
+			os_render(os, in + pos, out + pos, at - pos);
+			pos = at;
+		}
+		wah_engine_set(&os->eng, q->ev[i].param, q->ev[i].value);
+	}
+	if (pos < n)
+		os_render(os, in + pos, out + pos, n - pos);
+
+	for (j = 0; i < q->count; i++, j++) {
+		q->ev[j] = q->ev[i];
+		q->ev[j].offset -= n;
+	}
+	q->count = j;
+}
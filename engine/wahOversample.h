@@ -0,0 +1,77 @@
+/*-------------------------------------------------------------------------
+ * Description:  Oversampled mode of the software wah engine.
+ *
+ *               F1 = 2*sin(pi*fc/fs) runs out of table at fc = fs/2 and
+ *               the Chamberlin filter loses accuracy, then stability, well
+ *               before that, yet effectHardware.c lets maxf go to five
+ *               times the potentiometer range. This runs the filter core
+ *               at 2x or 4x the sample rate instead, so the same registers
+ *               sweep a filter that stays accurate far higher.
+ *
+ *               The input goes up through one or two half-band
+ *               interpolators, the Fc triangle still steps once per input
+ *               sample (so it sweeps exactly as on the hardware) while F1
+ *               is taken for the higher rate and the filter runs factor
+ *               times per step, and the wet signal comes back down
+ *               through the matching decimators. The dry signal is delayed
+ *               to line up, and the mixer and volume stage run at the
+ *               input rate as usual.
+ *
+ *               The half-band filters are fixed-point (Q30 taps, 64-bit
+ *               sums) and work a block at a time in loops the compiler
+ *               vectorizes; the output is the same on every machine. It
+ *               is not the hardware's output, though: factor 1 is the
+ *               plain engine, and only it matches the HDL.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_OVERSAMPLE_H
+#define WAH_OVERSAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahEngine.h"
+
+/* Largest oversampling factor                                           */
+#define WAH_OS_MAX 4
+/* Longest history a half-band stage keeps (samples at its input rate)   */
+#define WAH_OS_HIST 64
+
+/*
+ * struct wah_halfband - One half-band interpolator or decimator.
+ * @coef: Side taps (Q30) h[c + 2i + 1] = h[c - 2i - 1] of a 4 * @half - 1
+ *        tap filter whose centre tap is 1/2.
+ * @half: Side taps on each side of the centre.
+ * @hist: Samples of history kept ahead of each block.
+ * @buf: @hist samples of history, then one block.
+ */
+struct wah_halfband {
+	const int32_t *coef;
+	unsigned half;
+	unsigned hist;
+	int32_t buf[WAH_OS_HIST + WAH_OS_MAX * WAH_CHUNK];
+};
+
+/*
+ * struct wah_os - An engine with an oversampled filter core.
+ * @eng: The engine; registers, ramps and the filter state live here.
+ * @factor: 1, 2 or 4.
+ * @latency: Samples the output lags the input.
+ * @up, @down: Half-band stages, the 2x one first.
+ * @dry: @latency samples of dry history, then one chunk.
+ */
+struct wah_os {
+	struct wah_engine eng;
+	unsigned factor;
+	unsigned latency;
+	struct wah_halfband up[2];
+	struct wah_halfband down[2];
+	int32_t dry[WAH_OS_HIST + WAH_CHUNK];
+};
+
+int wah_os_init(struct wah_os *os, unsigned factor, const struct wah_params *p);
+void wah_os_reset(struct wah_os *os);
+unsigned wah_os_latency(const struct wah_os *os);
+int wah_os_schedule(struct wah_os *os, uint32_t offset, unsigned param, uint32_t value);
+void wah_os_process(struct wah_os *os, const int32_t *in, int32_t *out, size_t n);
+
+#endif
@@ -0,0 +1,188 @@
+/*-------------------------------------------------------------------------
+ * Description:  Lock-free parameter block, control side and shared memory.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wahParamBlock.h"
+
+/* Yields to wait out an odd counter before giving up: a live
+ * writer holds it for a few stores, so only a dead one runs into this  */
+#define SPIN_TRIES 100000
+
+/*
+ * wah_param_block_init() - Publish the first set of values.
+ *
+ * The counter starts at 2 so that a reader with seen == 0 picks the
+ * initial values up on its first poll.
+ */
+void wah_param_block_init(struct wah_param_block *blk, const struct wah_params *p)
+{
+	memset(blk, 0, sizeof(*blk));
+	blk->params = *p;
+	blk->version = WAH_PARAM_BLOCK_VERSION;
+	__atomic_store_n(&blk->seq, 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&blk->magic, WAH_PARAM_BLOCK_MAGIC, __ATOMIC_RELEASE);
+}
+
+/*
+ * wah_param_block_write() - Replace all seven values (control side).
+ *
+ * Writers serialise on the odd/even state of the counter. Only writers
+ * ever spin here; the audio thread never waits for a writer. A writer
+ * killed between its two counter updates leaves the counter odd for
+ * good; see wah_param_block_recover().
+ *
+ * Return: 0, or -1 with errno ETIMEDOUT if the counter stayed odd.
+ */
+int wah_param_block_write(struct wah_param_block *blk, const struct wah_params *p)
+{
+	const uint32_t *src = (const uint32_t *)p;
+	uint32_t *dst = (uint32_t *)&blk->params;
+	uint32_t seq;
+	int i, tries = SPIN_TRIES;
+
+	for (;; sched_yield()) {
+		seq = __atomic_load_n(&blk->seq, __ATOMIC_RELAXED);
+		if (!(seq & 1) && __atomic_compare_exchange_n(&blk->seq, &seq, seq + 1,
+				0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+		if ((seq & 1) && !--tries) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+	}
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		__atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+
+	__atomic_store_n(&blk->seq, seq + 2, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*
+ * wah_param_block_read() - Consistent copy of the current values.
+ *
+ * For control code that wants to read-modify-write; may spin briefly
+ * while another writer finishes, so not for the audio thread.
+ *
+ * Return: 0, or -1 with errno ETIMEDOUT if the counter stayed odd.
+ */
+int wah_param_block_read(struct wah_param_block *blk, struct wah_params *p)
+{
+	uint32_t seen = 0;
+	int tries = SPIN_TRIES;
+
+	while (!wah_param_block_poll(blk, &seen, p)) {
+		if (!--tries) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		sched_yield();
+	}
+	return 0;
+}
+
+/*
+ * wah_param_block_recover() - Release a block a writer died writing.
+ *
+ * Makes the counter even again, so the values as the dead writer left
+ * them, possibly half updated, become current; write a full set after.
+ * Only for when no writer is running: one caught mid-write loses its
+ * update.
+ *
+ * Return: 1 if the counter was odd, 0 if there was nothing to do.
+ */
+int wah_param_block_recover(struct wah_param_block *blk)
+{
+	uint32_t seq = __atomic_load_n(&blk->seq, __ATOMIC_RELAXED);
+
+	if (!(seq & 1))
+		return 0;
+	return __atomic_compare_exchange_n(&blk->seq, &seq, seq + 1, 0, __ATOMIC_RELEASE,
+		__ATOMIC_RELAXED);
+}
+
+/*
+ * wah_param_block_open() - Map a block from POSIX shared memory.
+ * @name: shm_open() name, e.g. "/wah0".
+ * @create: Create the object (with default values) if it doesn't exist.
+ *
+ * Opening a block another process is still creating waits for it to be
+ * sized and initialised.
+ *
+ * Return: The mapped block, or NULL with errno set (EPROTO for a block
+ * that never got initialised, EINVAL for one of the wrong size).
+ */
+struct wah_param_block *wah_param_block_open(const char *name, int create)
+{
+	struct wah_param_block *blk;
+	struct stat st;
+	int fd, created = 0, tries;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0 && errno == ENOENT && create) {
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+		created = fd >= 0;
+		if (fd < 0 && errno == EEXIST)
+			fd = shm_open(name, O_RDWR, 0);
+	}
+	if (fd < 0)
+		return NULL;
+
+	if (created && ftruncate(fd, sizeof(*blk)) < 0) {
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	// The creator may not have sized a fresh object yet: until its
+	// ftruncate() the object is empty.
+	for (tries = 1000;; sched_yield()) {
+		if (fstat(fd, &st) < 0) {
+			close(fd);
+			return NULL;
+		}
+		if (st.st_size != 0 || created || !--tries)
+			break;
+	}
+	if ((size_t)st.st_size < sizeof(*blk)) {
+		close(fd);
+		errno = st.st_size ? EINVAL : EPROTO;
+		return NULL;
+	}
+
+	blk = mmap(NULL, sizeof(*blk), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (blk == MAP_FAILED)
+		return NULL;
+
+	if (created) {
+		struct wah_params p;
+
+		wah_params_default(&p);
+		wah_param_block_init(blk, &p);
+	} else {
+		// Another process may still be initialising a fresh block.
+		tries = 1000;
+		while (__atomic_load_n(&blk->magic, __ATOMIC_ACQUIRE) != WAH_PARAM_BLOCK_MAGIC &&
+		       --tries)
+			sched_yield();
+		if (!tries || blk->version != WAH_PARAM_BLOCK_VERSION) {
+			munmap(blk, sizeof(*blk));
+			errno = EPROTO;
+			return NULL;
+		}
+	}
+	return blk;
+}
+
+void wah_param_block_close(struct wah_param_block *blk)
+{
+	munmap(blk, sizeof(*blk));
+}
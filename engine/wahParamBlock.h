@@ -0,0 +1,96 @@
+/*-------------------------------------------------------------------------
+ * Description:  Lock-free parameter block between a control thread (or
+ *               process) and the audio thread.
+ *
+ *               The seven register values sit behind a sequence counter
+ *               (seqlock). Writers take turns on the counter; the audio
+ *               thread only ever reads, never waits and never enters the
+ *               kernel: if it catches a write in progress it keeps the
+ *               previous values and looks again at the next block.
+ *
+ *               The block is plain memory, so it works the same inside
+ *               one process or mapped from POSIX shared memory by several.
+ *               A writer killed halfway leaves the block locked: other
+ *               writers give up with ETIMEDOUT instead of spinning, and
+ *               wah_param_block_recover() (wahCtl -r) unlocks it.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_PARAM_BLOCK_H
+#define WAH_PARAM_BLOCK_H
+
+#include <stdint.h>
+
+#include "wahEngine.h"
+
+#define WAH_PARAM_BLOCK_MAGIC 0x31425057	/* "WPB1" */
+#define WAH_PARAM_BLOCK_VERSION 1
+
+/*
+ * struct wah_param_block - Shared parameter block.
+ * @magic: WAH_PARAM_BLOCK_MAGIC once initialised.
+ * @version: Layout version.
+ * @seq: Sequence counter; odd while a writer is storing @params.
+ * @params: Register values in register map order.
+ *
+ * @seq and @params share one cache line of their own so the audio thread
+ * touches a single line per poll.
+ */
+struct wah_param_block {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq __attribute__((aligned(64)));
+	struct wah_params params;
+} __attribute__((aligned(64)));
+
+void wah_param_block_init(struct wah_param_block *blk, const struct wah_params *p);
+int wah_param_block_write(struct wah_param_block *blk, const struct wah_params *p);
+int wah_param_block_read(struct wah_param_block *blk, struct wah_params *p);
+int wah_param_block_recover(struct wah_param_block *blk);
+struct wah_param_block *wah_param_block_open(const char *name, int create);
+void wah_param_block_close(struct wah_param_block *blk);
+
+/*
+ * wah_param_block_poll() - Fetch new values if there are any (audio side).
+ * @seen: Sequence number of the values the caller already has; start at 0.
+ * @p: Receives the new values.
+ *
+ * Wait-free: one load when nothing changed, one copy otherwise. A copy
+ * that raced with a writer is dropped and retried on the next call.
+ *
+ * Return: 1 if @p was updated, 0 otherwise.
+ */
+static inline int wah_param_block_poll(struct wah_param_block *blk, uint32_t *seen,
+	struct wah_params *p)
+{
+	const uint32_t *src = (const uint32_t *)&blk->params;
+	struct wah_params tmp;
+	uint32_t *dst = (uint32_t *)&tmp;
+	uint32_t seq = __atomic_load_n(&blk->seq, __ATOMIC_ACQUIRE);
+	int i;
+
+	if (seq == *seen || (seq & 1))
+		return 0;
+
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&blk->seq, __ATOMIC_RELAXED) != seq)
+		return 0;
+
+	*p = tmp;
+	*seen = seq;
+	return 1;
+}
+
+/*
+ * wah_engine_sync() - Pick up new block values at a block boundary.
+ */
+static inline void wah_engine_sync(struct wah_engine *eng, struct wah_param_block *blk,
+	uint32_t *seen)
+{
+	struct wah_params p;
+
+	if (wah_param_block_poll(blk, seen, &p))
+		wah_engine_set_params(eng, &p);
+}
+
+#endif
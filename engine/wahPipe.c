@@ -0,0 +1,591 @@
+/*-------------------------------------------------------------------------
+ * Description:  Streaming file pipeline for the engine tools.
+ *-------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "wahPipe.h"
+
+const char *const wah_pipe_mode_names[3] = { "uring", "read", "mmap" };
+
+/* Kinds of ring request, in the low bits of user_data                   */
+#define REQ_READ 0
+#define REQ_WRITE 1
+#define REQ_WAKE 2
+#define REQ_BITS 2
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static size_t page_round(size_t n){
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+	return (n + page - 1) & ~(page - 1);
+}
+
+static int read_all(int fd, uint8_t *p, size_t len, off_t off){
+	while (len) {
+		ssize_t r = pread(fd, p, len, off);
+
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0) {
+			if (r == 0)
+				errno = EIO;	// the input shrank under us
+			return -1;
+		}
+		p += r;
+		len -= r;
+		off += r;
+	}
+	return 0;
+}
+
+static int write_all(int fd, const uint8_t *p, size_t len, off_t off){
+	while (len) {
+		ssize_t r = pwrite(fd, p, len, off);
+
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		len -= r;
+		off += r;
+	}
+	return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Serial paths                                                          */
+/*-----------------------------------------------------------------------*/
+/*
+ * run_serial() - Read (or map), process and write one block at a time.
+ */
+static int run_serial(struct wah_pipe *p, int map){
+	uint8_t *src = NULL, *dst, *base = MAP_FAILED;
+	size_t len, n, skew = 0, size = 0;
+	uint64_t done = 0;
+	int err = 0;
+
+	dst = malloc(p->outBlock);
+	p->memory = p->outBlock;
+	if (map && p->inBytes) {
+		skew = p->inOffset & ((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+		size = p->inBytes + skew;
+		base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, p->in, p->inOffset - skew);
+		if (base == MAP_FAILED) {
+			free(dst);
+			return -1;
+		}
+		madvise(base, size, MADV_SEQUENTIAL);
+	} else if (!map) {
+		src = malloc(p->block);
+		p->memory += p->block;
+	}
+
+	do {
+		len = p->inBytes - done < p->block ? (size_t)(p->inBytes - done) : p->block;
+		if (len && map) {
+			src = base + skew + done;
+		} else if (len && read_all(p->in, src, len, p->inOffset + done) < 0) {
+			err = errno;
+			break;
+		}
+		n = p->process(p->arg, len ? src : NULL, len, dst);
+		if (write_all(p->out, dst, n, p->outOffset + p->outBytes) < 0) {
+			err = errno;
+			break;
+		}
+		p->outBytes += n;
+		done += len;
+	} while (len);
+
+	if (base != MAP_FAILED)
+		munmap(base, size);
+	else
+		free(src);
+	free(dst);
+	errno = err;
+	return err ? -1 : 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/* io_uring                                                              */
+/*-----------------------------------------------------------------------*/
+/*
+ * struct ring - An io_uring set up with raw system calls.
+ * @tail: Our copy of the submission queue tail.
+ * @submitted: Entries up to here have been passed to the kernel.
+ */
+struct ring {
+	int fd;
+	unsigned *sqHead;
+	unsigned *sqTail;
+	unsigned *sqMask;
+	unsigned *sqArray;
+	unsigned *cqHead;
+	unsigned *cqTail;
+	unsigned *cqMask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sqMap;
+	void *cqMap;
+	size_t sqSize;
+	size_t cqSize;
+	size_t sqesSize;
+	unsigned tail;
+	unsigned submitted;
+};
+
+static int ring_open(struct ring *r, unsigned entries){
+	struct io_uring_params prm;
+	uint8_t *sq, *cq;
+
+	memset(r, 0, sizeof(*r));
+	memset(&prm, 0, sizeof(prm));
+	r->fd = (int)syscall(__NR_io_uring_setup, entries, &prm);
+	if (r->fd < 0)
+		return -1;
+
+	r->sqSize = prm.sq_off.array + prm.sq_entries * sizeof(unsigned);
+	r->cqSize = prm.cq_off.cqes + prm.cq_entries * sizeof(struct io_uring_cqe);
+	if (prm.features & IORING_FEAT_SINGLE_MMAP)
+		r->sqSize = r->cqSize = r->sqSize > r->cqSize ? r->sqSize : r->cqSize;
+	r->sqesSize = prm.sq_entries * sizeof(struct io_uring_sqe);
+
+	r->sqMap = mmap(NULL, r->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		r->fd, IORING_OFF_SQ_RING);
+	if (r->sqMap == MAP_FAILED)
+		goto fail;
+	r->cqMap = prm.features & IORING_FEAT_SINGLE_MMAP ? r->sqMap :
+		mmap(NULL, r->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			r->fd, IORING_OFF_CQ_RING);
+	r->sqes = mmap(NULL, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		r->fd, IORING_OFF_SQES);
+	if (r->cqMap == MAP_FAILED || r->sqes == MAP_FAILED)
+		goto fail;
+
+	sq = r->sqMap;
+	cq = r->cqMap;
+	r->sqHead = (unsigned *)(sq + prm.sq_off.head);
+	r->sqTail = (unsigned *)(sq + prm.sq_off.tail);
+	r->sqMask = (unsigned *)(sq + prm.sq_off.ring_mask);
+	r->sqArray = (unsigned *)(sq + prm.sq_off.array);
+	r->cqHead = (unsigned *)(cq + prm.cq_off.head);
+	r->cqTail = (unsigned *)(cq + prm.cq_off.tail);
+	r->cqMask = (unsigned *)(cq + prm.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + prm.cq_off.cqes);
+	r->tail = *r->sqTail;
+	r->submitted = r->tail;
+	return 0;
+
+fail:
+	close(r->fd);
+	errno = ENOMEM;
+	return -1;
+}
+
+static void ring_close(struct ring *r){
+	if (r->sqes && r->sqes != MAP_FAILED)
+		munmap(r->sqes, r->sqesSize);
+	if (r->cqMap && r->cqMap != MAP_FAILED && r->cqMap != r->sqMap)
+		munmap(r->cqMap, r->cqSize);
+	munmap(r->sqMap, r->sqSize);
+	close(r->fd);
+}
+
+/*
+ * ring_sqe() - Next free submission entry, cleared. The ring is sized for
+ * every request the pipeline can have outstanding, so there always is one.
+ */
+static struct io_uring_sqe *ring_sqe(struct ring *r){
+	unsigned idx = r->tail & *r->sqMask;
+	struct io_uring_sqe *sqe = &r->sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	r->sqArray[idx] = idx;
+	r->tail++;
+	return sqe;
+}
+
+/*
+ * ring_enter() - Submit queued entries and wait for at least @wait
+ * completions.
+ */
+static int ring_enter(struct ring *r, unsigned wait){
+	__atomic_store_n(r->sqTail, r->tail, __ATOMIC_RELEASE);
+	for (;;) {
+		int n = (int)syscall(__NR_io_uring_enter, r->fd, r->tail - r->submitted, wait,
+			wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+		if (n >= 0) {
+			r->submitted += n;
+			if (r->submitted == r->tail)
+				return 0;
+			continue;
+		}
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+			return -1;
+	}
+}
+
+/*
+ * struct slot - One pair of buffers in the pipeline.
+ * @readBlock, @len, @got: Block being read into @src, its size and the
+ *                         bytes read so far.
+ * @writeBlock, @outLen, @put: Block being written from @dst, its size and
+ *                             the bytes written so far.
+ */
+struct slot {
+	uint8_t *src;
+	uint8_t *dst;
+	uint64_t readBlock;
+	size_t len;
+	size_t got;
+	uint64_t writeBlock;
+	uint64_t outOffset;
+	size_t outLen;
+	size_t put;
+};
+
+/*
+ * struct uring_run - State shared by the I/O thread and the caller.
+ * @blocks: Input blocks plus the flush call.
+ * @filled: Blocks read, counted in order.
+ * @processed: Blocks the callback is done with.
+ * @written: Blocks written, counted in order.
+ * @wake: eventfd the caller bumps after each block, read through the
+ *        ring so the I/O thread only ever sleeps in io_uring_enter().
+ */
+struct uring_run {
+	struct wah_pipe *p;
+	struct ring ring;
+	struct slot *slot;
+	void *buffers;
+	size_t bufferSize;
+	int fixed;
+	int wake;
+	uint64_t wakeCount;
+	uint64_t blocks;
+	uint64_t inBlocks;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint64_t filled;
+	uint64_t processed;
+	uint64_t written;
+	int err;
+};
+
+static void queue_io(struct uring_run *u, int write, struct slot *s, uint64_t block){
+	struct io_uring_sqe *sqe = ring_sqe(&u->ring);
+	const unsigned idx = (unsigned)(s - u->slot);
+
+	if (write) {
+		sqe->opcode = u->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+		sqe->fd = u->p->out;
+		sqe->addr = (uintptr_t)(s->dst + s->put);
+		sqe->len = (uint32_t)(s->outLen - s->put);
+		sqe->off = s->outOffset + s->put;
+		sqe->buf_index = (uint16_t)(u->p->depth + idx);
+	} else {
+		sqe->opcode = u->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		sqe->fd = u->p->in;
+		sqe->addr = (uintptr_t)(s->src + s->got);
+		sqe->len = (uint32_t)(s->len - s->got);
+		sqe->off = u->p->inOffset + block * u->p->block + s->got;
+		sqe->buf_index = (uint16_t)idx;
+	}
+	sqe->user_data = block << REQ_BITS | (write ? REQ_WRITE : REQ_READ);
+}
+
+static void queue_wake(struct uring_run *u){
+	struct io_uring_sqe *sqe = ring_sqe(&u->ring);
+
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = u->wake;
+	sqe->addr = (uintptr_t)&u->wakeCount;
+	sqe->len = sizeof(u->wakeCount);
+	sqe->off = (uint64_t)-1;
+	sqe->user_data = REQ_WAKE;
+}
+
+/*
+ * io_thread() - Keep reads queued into free input buffers and writes
+ * queued from processed blocks until everything is written.
+ */
+static void *io_thread(void *arg){
+	struct uring_run *u = arg;
+	struct wah_pipe *p = u->p;
+	uint64_t readIssued = 0, writeIssued = 0, written = 0, outOffset = p->outOffset;
+	uint64_t processed;
+	int err = 0, wakePending = 1, stop;
+
+	queue_wake(u);
+	for (;;) {
+		pthread_mutex_lock(&u->lock);
+		processed = u->processed;
+		stop = u->err;
+		pthread_mutex_unlock(&u->lock);
+		// The caller gave up (see run_uring()).
+		if (stop)
+			break;
+
+		// An input buffer is free once its last block has been processed.
+		for (; readIssued < u->blocks && readIssued < processed + p->depth; readIssued++) {
+			struct slot *s = &u->slot[readIssued % p->depth];
+
+			s->readBlock = readIssued;
+			s->got = 0;
+			s->len = readIssued < u->inBlocks ? p->block : 0;
+			if (readIssued + 1 == u->inBlocks)
+				s->len = (size_t)(p->inBytes - readIssued * p->block);
+			if (s->len)
+				queue_io(u, 0, s, readIssued);
+		}
+		for (; writeIssued < processed; writeIssued++) {
+			struct slot *s = &u->slot[writeIssued % p->depth];
+
+			s->writeBlock = writeIssued;
+			s->outOffset = outOffset;
+			s->put = 0;
+			outOffset += s->outLen;
+			if (s->outLen)
+				queue_io(u, 1, s, writeIssued);
+		}
+
+		pthread_mutex_lock(&u->lock);
+		while (u->filled < readIssued && u->slot[u->filled % p->depth].readBlock == u->filled &&
+		       u->slot[u->filled % p->depth].got == u->slot[u->filled % p->depth].len)
+			u->filled++;
+		while (written < writeIssued && u->slot[written % p->depth].writeBlock == written &&
+		       u->slot[written % p->depth].put == u->slot[written % p->depth].outLen)
+			written++;
+		u->written = written;
+		pthread_cond_broadcast(&u->cond);
+		pthread_mutex_unlock(&u->lock);
+
+		if (written == u->blocks && !wakePending)
+			break;
+		if (ring_enter(&u->ring, 1) < 0) {
+			err = errno;
+			break;
+		}
+
+		while (*u->ring.cqHead != __atomic_load_n(u->ring.cqTail, __ATOMIC_ACQUIRE)) {
+			unsigned head = *u->ring.cqHead;
+			const struct io_uring_cqe *cqe = &u->ring.cqes[head & *u->ring.cqMask];
+			const uint64_t block = cqe->user_data >> REQ_BITS;
+			struct slot *s = &u->slot[block % p->depth];
+			const int res = cqe->res;
+			const unsigned kind = cqe->user_data & ((1 << REQ_BITS) - 1);
+
+			__atomic_store_n(u->ring.cqHead, head + 1, __ATOMIC_RELEASE);
+			if (kind == REQ_WAKE) {
+				// Once the last block is processed no more wakes come.
+				pthread_mutex_lock(&u->lock);
+				wakePending = u->processed < u->blocks;
+				pthread_mutex_unlock(&u->lock);
+				if (wakePending)
+					queue_wake(u);
+			} else if (res <= 0) {
+				err = res < 0 ? -res : EIO;
+			} else if (kind == REQ_READ) {
+				// Short transfers are simply continued.
+				s->got += res;
+				if (s->got < s->len)
+					queue_io(u, 0, s, block);
+			} else {
+				s->put += res;
+				if (s->put < s->outLen)
+					queue_io(u, 1, s, block);
+			}
+		}
+		if (err)
+			break;
+	}
+
+	if (err) {
+		pthread_mutex_lock(&u->lock);
+		u->err = err;
+		pthread_cond_broadcast(&u->cond);
+		pthread_mutex_unlock(&u->lock);
+	}
+	return NULL;
+}
+
+static int uring_setup(struct uring_run *u, struct wah_pipe *p){
+	const size_t in = page_round(p->block), out = page_round(p->outBlock);
+	struct iovec *iov;
+	unsigned i;
+
+	memset(u, 0, sizeof(*u));
+	u->p = p;
+	u->inBlocks = (p->inBytes + p->block - 1) / p->block;
+	u->blocks = u->inBlocks + 1;
+
+	// Every read, every write and the wake read can be in flight at once.
+	if (ring_open(&u->ring, 2 * p->depth + 1) < 0)
+		return -1;
+	u->wake = eventfd(0, EFD_CLOEXEC);
+	u->bufferSize = p->depth * (in + out);
+	u->buffers = mmap(NULL, u->bufferSize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (u->wake < 0 || u->buffers == MAP_FAILED) {
+		if (u->wake >= 0)
+			close(u->wake);
+		ring_close(&u->ring);
+		return -1;
+	}
+	p->memory = u->bufferSize;
+
+	u->slot = calloc(p->depth, sizeof(*u->slot));
+	iov = calloc(2 * p->depth, sizeof(*iov));
+	if (u->slot == NULL || iov == NULL) {
+		free(u->slot);
+		free(iov);
+		munmap(u->buffers, u->bufferSize);
+		close(u->wake);
+		ring_close(&u->ring);
+		errno = ENOMEM;
+		return -1;
+	}
+	for (i = 0; i < p->depth; i++) {
+		u->slot[i].src = (uint8_t *)u->buffers + i * in;
+		u->slot[i].dst = (uint8_t *)u->buffers + p->depth * in + i * out;
+		u->slot[i].readBlock = u->slot[i].writeBlock = UINT64_MAX;
+		iov[i].iov_base = u->slot[i].src;
+		iov[i].iov_len = in;
+		iov[p->depth + i].iov_base = u->slot[i].dst;
+		iov[p->depth + i].iov_len = out;
+	}
+	// Registered buffers stay pinned, so no I/O has to map them again;
+	// fall back to plain reads and writes if the memlock limit says no.
+	u->fixed = syscall(__NR_io_uring_register, u->ring.fd, IORING_REGISTER_BUFFERS,
+		iov, 2 * p->depth) == 0;
+	free(iov);
+
+	pthread_mutex_init(&u->lock, NULL);
+	pthread_cond_init(&u->cond, NULL);
+	return 0;
+}
+
+static void uring_teardown(struct uring_run *u){
+	pthread_cond_destroy(&u->cond);
+	pthread_mutex_destroy(&u->lock);
+	ring_close(&u->ring);
+	close(u->wake);
+	munmap(u->buffers, u->bufferSize);
+	free(u->slot);
+}
+
+/*
+ * wake_io() - Bump the eventfd io_thread() sleeps on.
+ */
+static int wake_io(struct uring_run *u){
+	uint64_t one = 1;
+
+	while (write(u->wake, &one, sizeof(one)) < 0)
+		if (errno != EINTR)
+			return -1;
+	return 0;
+}
+
+/*
+ * run_uring() - Process on the calling thread while io_thread() keeps
+ * the buffers on either side of it moving.
+ */
+static int run_uring(struct wah_pipe *p){
+	struct uring_run u;
+	pthread_t io;
+	uint64_t b, t;
+	int err = 0;
+
+	if (uring_setup(&u, p) < 0)
+		return -1;
+	if ((err = pthread_create(&io, NULL, io_thread, &u)) != 0) {
+		uring_teardown(&u);
+		errno = err;
+		return -1;
+	}
+
+	for (b = 0; b < u.blocks; b++) {
+		struct slot *s = &u.slot[b % p->depth];
+		size_t n;
+
+		pthread_mutex_lock(&u.lock);
+		if (!(u.filled > b && u.written + p->depth > b) && !u.err) {
+			t = now_ns();
+			while (!(u.filled > b && u.written + p->depth > b) && !u.err)
+				pthread_cond_wait(&u.cond, &u.lock);
+			p->stalls++;
+			p->stallNs += now_ns() - t;
+		}
+		err = u.err;
+		pthread_mutex_unlock(&u.lock);
+		if (err)
+			break;
+
+		n = p->process(p->arg, b < u.inBlocks ? s->src : NULL, s->len, s->dst);
+		p->outBytes += n;
+		pthread_mutex_lock(&u.lock);
+		s->outLen = n;
+		u.processed = b + 1;
+		pthread_mutex_unlock(&u.lock);
+		if (wake_io(&u) < 0) {
+			err = errno;
+			break;
+		}
+	}
+
+	if (err) {
+		// io_thread() may be asleep waiting for the next block: tell it
+		// there is none, or the join below never returns.
+		pthread_mutex_lock(&u.lock);
+		if (!u.err)
+			u.err = err;
+		pthread_mutex_unlock(&u.lock);
+		wake_io(&u);
+	}
+	pthread_join(io, NULL);
+	if (!err)
+		err = u.err;
+	uring_teardown(&u);
+	errno = err;
+	return err ? -1 : 0;
+}
+
+/*
+ * wah_pipe_run() - Stream the input range through p->process into the
+ * output.
+ *
+ * Return: 0 on success, -1 with errno set.
+ */
+int wah_pipe_run(struct wah_pipe *p, enum wah_pipe_mode mode)
+{
+	p->outBytes = 0;
+	p->memory = 0;
+	p->stalls = 0;
+	p->stallNs = 0;
+	if (p->block == 0 || p->depth == 0 || p->block > UINT32_MAX || p->outBlock > UINT32_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (mode == WAH_PIPE_URING)
+		return run_uring(p);
+	return run_serial(p, mode == WAH_PIPE_MMAP);
+}
@@ -0,0 +1,79 @@
+/*-------------------------------------------------------------------------
+ * Description:  Streaming file pipeline for the engine tools.
+ *
+ *               Moves a byte range of one file through a processing
+ *               callback into another file a block at a time, so a render
+ *               of any length runs in a fixed amount of memory instead of
+ *               reading the whole input, processing it and writing it out
+ *               the way wahwah.m does.
+ *
+ *               WAH_PIPE_URING overlaps the three stages: an I/O thread
+ *               keeps reads and writes queued on an io_uring (raw system
+ *               calls, no liburing) over a ring of preallocated,
+ *               registered buffers, while the calling thread only runs
+ *               the callback. The callback never waits on the disk unless
+ *               the disk can't keep up. WAH_PIPE_READ (pread/pwrite) and
+ *               WAH_PIPE_MMAP (process straight from a mapping, pwrite
+ *               the result) run the stages one after the other and are
+ *               there to compare against.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_PIPE_H
+#define WAH_PIPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Default block size (bytes of input) and blocks in flight              */
+#define WAH_PIPE_BLOCK (256 << 10)
+#define WAH_PIPE_DEPTH 8
+
+enum wah_pipe_mode {
+	WAH_PIPE_URING,
+	WAH_PIPE_READ,
+	WAH_PIPE_MMAP,
+};
+
+extern const char *const wah_pipe_mode_names[3];
+
+/*
+ * struct wah_pipe - A pipeline run.
+ * @in, @out: File descriptors.
+ * @inOffset, @inBytes: Input range.
+ * @outOffset: Where output starts.
+ * @block: Input bytes per block; the callback sees whole blocks except
+ *         for the last one, so make it a multiple of the frame size.
+ * @outBlock: Most output bytes the callback produces per call.
+ * @depth: Blocks in flight (WAH_PIPE_URING only).
+ * @process: Called in order on the calling thread with each block of
+ *           input; returns the output bytes it put in @dst. A last call
+ *           with @src NULL and @len 0 flushes anything held back.
+ * @arg: Passed to @process.
+ *
+ * Filled in by wah_pipe_run():
+ * @outBytes: Bytes written.
+ * @memory: Buffer memory used; fixed by @block, @outBlock and @depth.
+ * @stalls: Blocks the callback had to wait for.
+ * @stallNs: Time it spent waiting.
+ */
+struct wah_pipe {
+	int in;
+	int out;
+	uint64_t inOffset;
+	uint64_t inBytes;
+	uint64_t outOffset;
+	size_t block;
+	size_t outBlock;
+	unsigned depth;
+	size_t (*process)(void *arg, const uint8_t *src, size_t len, uint8_t *dst);
+	void *arg;
+
+	uint64_t outBytes;
+	size_t memory;
+	uint64_t stalls;
+	uint64_t stallNs;
+};
+
+int wah_pipe_run(struct wah_pipe *p, enum wah_pipe_mode mode);
+
+#endif
@@ -0,0 +1,283 @@
+/*-------------------------------------------------------------------------
+ * Description:  Work-stealing thread pool for the offline engine tools.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wahPool.h"
+
+/* Initial deque capacity; deques grow as needed                        */
+#define POOL_DEQUE_SIZE 64
+
+static __thread int pool_worker = -1;
+
+/*
+ * deque_push() - Queue @t at the back, doubling the ring when full.
+ *
+ * Return: 0, or -1 with errno ENOMEM if the ring couldn't grow.
+ */
+static int deque_push(struct wah_pool_deque *dq, const struct wah_task *t)
+{
+	pthread_mutex_lock(&dq->lock);
+	if (dq->tail - dq->head == dq->size) {
+		struct wah_task *ring = malloc(2 * dq->size * sizeof(*ring));
+		uint32_t i;
+
+		if (ring == NULL) {
+			pthread_mutex_unlock(&dq->lock);
+			errno = ENOMEM;
+			return -1;
+		}
+		for (i = 0; i < dq->size; i++)
+			ring[i] = dq->ring[(dq->head + i) & (dq->size - 1)];
+		free(dq->ring);
+		dq->ring = ring;
+		dq->head = 0;
+		dq->tail = dq->size;
+		dq->size *= 2;
+	}
+	dq->ring[dq->tail++ & (dq->size - 1)] = *t;
+	pthread_mutex_unlock(&dq->lock);
+	return 0;
+}
+
+/*
+ * deque_take() - Pop the newest task (@back, owner) or the oldest (thief).
+ */
+static int deque_take(struct wah_pool_deque *dq, struct wah_task *t, int back)
+{
+	int found = 0;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->tail != dq->head) {
+		*t = back ? dq->ring[--dq->tail & (dq->size - 1)] :
+			dq->ring[dq->head++ & (dq->size - 1)];
+		found = 1;
+	}
+	pthread_mutex_unlock(&dq->lock);
+	return found;
+}
+
+/*
+ * find_task() - Own deque first, then steal round-robin from the others.
+ */
+static int find_task(struct wah_pool *pool, unsigned self, struct wah_task *t)
+{
+	unsigned i;
+
+	if (deque_take(&pool->deques[self], t, 1))
+		goto found;
+	for (i = 1; i < pool->workers; i++) {
+		if (deque_take(&pool->deques[(self + i) % pool->workers], t, 0)) {
+			__atomic_fetch_add(&pool->steals, 1, __ATOMIC_RELAXED);
+			goto found;
+		}
+	}
+	return 0;
+
+found:
+	__atomic_fetch_sub(&pool->queued, 1, __ATOMIC_SEQ_CST);
+	return 1;
+}
+
+struct worker_arg {
+	struct wah_pool *pool;
+	unsigned self;
+};
+
+static void *worker_main(void *arg)
+{
+	struct worker_arg *wa = arg;
+	struct wah_pool *pool = wa->pool;
+	unsigned self = wa->self;
+	struct wah_task t;
+
+	free(wa);
+	pool_worker = (int)self;
+	for (;;) {
+		if (find_task(pool, self, &t)) {
+			t.run(pool, t.arg, self);
+			if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+				pthread_mutex_lock(&pool->lock);
+				pthread_cond_broadcast(&pool->idle);
+				pthread_mutex_unlock(&pool->lock);
+			}
+			continue;
+		}
+
+		// Nothing anywhere: sleep until a submit. queued is checked
+		// under the lock a submitter takes to signal, so no wakeup is
+		// lost.
+		pthread_mutex_lock(&pool->lock);
+		while (!pool->stop && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0)
+			pthread_cond_wait(&pool->work, &pool->lock);
+		if (pool->stop) {
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+/*
+ * wah_pool_start() - Start @workers threads.
+ *
+ * Return: 0 on success, -1 with errno set.
+ */
+int wah_pool_start(struct wah_pool *pool, unsigned workers)
+{
+	unsigned i;
+
+	memset(pool, 0, sizeof(*pool));
+	if (workers == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	pool->threads = calloc(workers, sizeof(*pool->threads));
+	pool->deques = aligned_alloc(64, workers * sizeof(*pool->deques));
+	if (pool->threads == NULL || pool->deques == NULL)
+		goto fail;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+	for (i = 0; i < workers; i++) {
+		memset(&pool->deques[i], 0, sizeof(pool->deques[i]));
+		pthread_mutex_init(&pool->deques[i].lock, NULL);
+		pool->deques[i].size = POOL_DEQUE_SIZE;
+		pool->deques[i].ring = malloc(POOL_DEQUE_SIZE * sizeof(struct wah_task));
+		if (pool->deques[i].ring == NULL)
+			goto fail;
+		pool->workers = i + 1;
+	}
+
+	for (i = 0; i < workers; i++) {
+		struct worker_arg *wa = malloc(sizeof(*wa));
+		int err;
+
+		if (wa == NULL)
+			goto fail_threads;
+		wa->pool = pool;
+		wa->self = i;
+		err = pthread_create(&pool->threads[i], NULL, worker_main, wa);
+		if (err) {
+			free(wa);
+			errno = err;
+			goto fail_threads;
+		}
+	}
+	return 0;
+
+fail_threads:
+	// Let the threads that did start exit before freeing their deques.
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	while (i--)
+		pthread_join(pool->threads[i], NULL);
+fail:
+	for (i = 0; pool->deques && i < pool->workers; i++)
+		free(pool->deques[i].ring);
+	free(pool->deques);
+	free(pool->threads);
+	if (errno == 0)
+		errno = ENOMEM;
+	return -1;
+}
+
+/*
+ * wah_pool_submit() - Queue a task.
+ * @worker: Deque to queue on; -1 means the calling worker's own deque, or
+ *          round-robin when called from outside the pool.
+ *
+ * Return: 0, or -1 with errno ENOMEM if the deque was full and couldn't
+ * grow; the task is then not queued.
+ */
+int wah_pool_submit(struct wah_pool *pool, int worker, void (*run)(struct wah_pool *, void *, unsigned),
+	void *arg)
+{
+	static unsigned next;
+	struct wah_task t = { run, arg };
+
+	if (worker < 0)
+		worker = pool_worker >= 0 ? pool_worker :
+			(int)(__atomic_fetch_add(&next, 1, __ATOMIC_RELAXED) % pool->workers);
+
+	// Count first so the counters never dip below the deque contents.
+	__atomic_fetch_add(&pool->pending, 1, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&pool->queued, 1, __ATOMIC_SEQ_CST);
+	if (deque_push(&pool->deques[worker % pool->workers], &t) < 0) {
+		__atomic_fetch_sub(&pool->queued, 1, __ATOMIC_SEQ_CST);
+		// A waiter may have seen the count go up.
+		if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+			pthread_mutex_lock(&pool->lock);
+			pthread_cond_broadcast(&pool->idle);
+			pthread_mutex_unlock(&pool->lock);
+		}
+		return -1;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_signal(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+/*
+ * wah_pool_wait() - Wait for every submitted task, continuations included.
+ * @timeout_ms: Give up after this long; 0 waits for good.
+ *
+ * Return: 1 once the pool is idle, 0 on timeout.
+ */
+int wah_pool_wait(struct wah_pool *pool, unsigned timeout_ms)
+{
+	struct timespec ts;
+	int idle;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	while (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) != 0) {
+		if (timeout_ms == 0)
+			pthread_cond_wait(&pool->idle, &pool->lock);
+		else if (pthread_cond_timedwait(&pool->idle, &pool->lock, &ts) == ETIMEDOUT)
+			break;
+	}
+	idle = __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0;
+	pthread_mutex_unlock(&pool->lock);
+	return idle;
+}
+
+/*
+ * wah_pool_stop() - Stop the workers once they run out of tasks.
+ */
+void wah_pool_stop(struct wah_pool *pool)
+{
+	unsigned i;
+
+	wah_pool_wait(pool, 0);
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->workers; i++) {
+		pthread_join(pool->threads[i], NULL);
+		free(pool->deques[i].ring);
+		pthread_mutex_destroy(&pool->deques[i].lock);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->work);
+	pthread_cond_destroy(&pool->idle);
+	free(pool->deques);
+	free(pool->threads);
+}
@@ -0,0 +1,68 @@
+/*-------------------------------------------------------------------------
+ * Description:  Work-stealing thread pool for the offline engine tools.
+ *
+ *               Every worker owns a deque of tasks. A worker pushes and
+ *               pops at the back of its own deque, so a task that queues
+ *               its own continuation (the next chunk of a render) runs
+ *               next on the same core with its state still in cache. An
+ *               idle worker steals from the front of another worker's
+ *               deque, which holds the oldest, least cache-warm work.
+ *
+ *               Tasks are coarse (a chunk of audio, milliseconds of work),
+ *               so each deque is a mutex-protected ring; the lock is only
+ *               ever contended while someone is stealing.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_POOL_H
+#define WAH_POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+struct wah_pool;
+
+/*
+ * struct wah_task - A unit of work.
+ * @run: Called on a worker thread; @worker is its index, for per-worker
+ *       scratch buffers.
+ * @arg: Passed to @run.
+ */
+struct wah_task {
+	void (*run)(struct wah_pool *pool, void *arg, unsigned worker);
+	void *arg;
+};
+
+struct wah_pool_deque {
+	pthread_mutex_t lock;
+	struct wah_task *ring;
+	uint32_t size;
+	uint32_t head;
+	uint32_t tail;
+} __attribute__((aligned(64)));
+
+/*
+ * struct wah_pool - The pool.
+ * @workers: Worker threads.
+ * @queued: Tasks sitting in deques.
+ * @pending: Tasks queued or running; wah_pool_wait() returns at 0.
+ * @steals: Tasks taken from another worker's deque.
+ */
+struct wah_pool {
+	unsigned workers;
+	pthread_t *threads;
+	struct wah_pool_deque *deques;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t idle;
+	uint32_t queued;
+	uint32_t pending;
+	uint64_t steals;
+	int stop;
+};
+
+int wah_pool_start(struct wah_pool *pool, unsigned workers);
+int wah_pool_submit(struct wah_pool *pool, int worker, void (*run)(struct wah_pool *, void *, unsigned),
+	void *arg);
+int wah_pool_wait(struct wah_pool *pool, unsigned timeout_ms);
+void wah_pool_stop(struct wah_pool *pool);
+
+#endif
@@ -0,0 +1,311 @@
+/*-------------------------------------------------------------------------
+ * Description:  Preset store and morph trajectories.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wahPreset.h"
+
+/*
+ * valid_name() - Whether @name can be stored: 1 to WAH_PRESET_NAME - 1
+ * characters, none of them blank, '#' or '='.
+ */
+static int valid_name(const char *name)
+{
+	size_t n = strlen(name);
+
+	return n > 0 && n < WAH_PRESET_NAME && strcspn(name, " \t\r\n#=") == n;
+}
+
+/*
+ * wah_presets_load() - Read the store at @path into an empty @s.
+ *
+ * A file that doesn't exist is an empty store.
+ *
+ * Return: 0 on success, -1 with errno set; EINVAL for a line that isn't a
+ * name followed by field=value settings.
+ */
+int wah_presets_load(struct wah_presets *s, const char *path)
+{
+	char line[512], *tok, *eq, *save;
+	struct wah_params p;
+	FILE *f;
+	int param;
+
+	memset(s, 0, sizeof(*s));
+	f = fopen(path, "r");
+	if (f == NULL)
+		return errno == ENOENT ? 0 : -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "#")] = '\0';
+		tok = strtok_r(line, " \t\r\n", &save);
+		if (tok == NULL)
+			continue;
+		wah_params_default(&p);
+		if (!valid_name(tok))
+			goto bad;
+		while ((eq = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+			char *end, *value = strchr(eq, '=');
+
+			param = value ? wah_param_lookup(eq, value - eq) : -1;
+			if (param < 0)
+				goto bad;
+			wah_params_set(&p, param, strtoul(value + 1, &end, 0));
+			if (*end != '\0')
+				goto bad;
+		}
+		if (wah_preset_put(s, tok, &p) < 0) {
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+	return 0;
+
+bad:
+	fclose(f);
+	wah_presets_free(s);
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * wah_presets_save() - Write @s to @path.
+ *
+ * Written next to it and renamed over it, so a crash leaves either the
+ * old store or the new one.
+ *
+ * Return: 0 on success, -1 with errno set.
+ */
+int wah_presets_save(const struct wah_presets *s, const char *path)
+{
+	char tmp[4096];
+	const uint32_t *regs;
+	size_t i;
+	FILE *f;
+	int r, err;
+
+	if ((size_t)snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= sizeof(tmp)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	f = fopen(tmp, "w");
+	if (f == NULL)
+		return -1;
+	for (i = 0; i < s->count; i++) {
+		regs = (const uint32_t *)&s->preset[i].p;
+		fprintf(f, "%s", s->preset[i].name);
+		for (r = 0; r < WAH_PARAM_COUNT; r++)
+			fprintf(f, " %s=%u", wah_param_names[r], regs[r]);
+		fputc('\n', f);
+	}
+	err = ferror(f);
+	if (fclose(f) != 0 || err || rename(tmp, path) != 0) {
+		err = errno ? errno : EIO;
+		remove(tmp);
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+void wah_presets_free(struct wah_presets *s)
+{
+	free(s->preset);
+	memset(s, 0, sizeof(*s));
+}
+
+/*
+ * wah_preset_find() - The preset called @name.
+ *
+ * Return: The preset, or NULL.
+ */
+const struct wah_preset *wah_preset_find(const struct wah_presets *s, const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < s->count; i++)
+		if (strcmp(s->preset[i].name, name) == 0)
+			return &s->preset[i];
+	return NULL;
+}
+
+/*
+ * wah_preset_put() - Add preset @name, or replace the one with that name.
+ *
+ * Return: 0 on success, -1 with errno EINVAL for a bad name or ENOMEM.
+ */
+int wah_preset_put(struct wah_presets *s, const char *name, const struct wah_params *p)
+{
+	struct wah_preset *at = (struct wah_preset *)wah_preset_find(s, name), *grown;
+	size_t capacity;
+
+	if (!valid_name(name)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (at == NULL) {
+		if (s->count == s->capacity) {
+			capacity = s->capacity ? 2 * s->capacity : 16;
+			grown = realloc(s->preset, capacity * sizeof(*grown));
+			if (grown == NULL) {
+				errno = ENOMEM;
+				return -1;
+			}
+			s->preset = grown;
+			s->capacity = capacity;
+		}
+		at = &s->preset[s->count++];
+		strcpy(at->name, name);
+	}
+	at->p = *p;
+	return 0;
+}
+
+/*
+ * wah_preset_remove() - Drop preset @name.
+ *
+ * Return: 0 on success, -1 with errno ENOENT if there is none.
+ */
+int wah_preset_remove(struct wah_presets *s, const char *name)
+{
+	const struct wah_preset *at = wah_preset_find(s, name);
+	size_t i;
+
+	if (at == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	i = at - s->preset;
+	memmove(&s->preset[i], &s->preset[i + 1], (s->count - i - 1) * sizeof(s->preset[0]));
+	s->count--;
+	return 0;
+}
+
+/*
+ * morph_value() - Register @param a fraction @x of the way from @a to @b.
+ *
+ * minf, maxf and delta move geometrically, so a sweep spends as long on
+ * every octave; a 0 at either end makes that impossible, and they move
+ * linearly like the other registers.
+ */
+static uint32_t morph_value(unsigned param, uint32_t a, uint32_t b, double x)
+{
+	if (a == b)
+		return a;
+	if ((param == WAH_MINF || param == WAH_MAXF || param == WAH_DELTA) && a && b)
+		return (uint32_t)lround(a * pow((double)b / a, x));
+	return (uint32_t)lround(a + ((double)b - a) * x);
+}
+
+/*
+ * wah_morph_plan() - The register updates that take @from to @to over
+ * @samples samples, a step every @step samples.
+ * @ev: Receives the first @max updates, in time order.
+ *
+ * Each step eases along 3x^2 - 2x^3, which starts and ends without a
+ * jump in slope, and only carries the registers whose value changed
+ * since the last one. The last step, at @samples, lands exactly on @to;
+ * @samples 0 is a single switch at offset 0. enable stays on for the
+ * whole morph if either end has it on, and takes its final value at the
+ * end, so a morph to or from bypass fades through the other registers
+ * instead of cutting.
+ *
+ * Return: Updates in the whole trajectory, which can be more than @max;
+ * no more than WAH_PARAM_COUNT of them share an offset.
+ */
+uint32_t wah_morph_plan(const struct wah_params *from, const struct wah_params *to,
+	uint32_t samples, uint32_t step, struct wah_event *ev, uint32_t max)
+{
+	const uint32_t *a = (const uint32_t *)from, *b = (const uint32_t *)to;
+	uint32_t last[WAH_PARAM_COUNT], steps, k, at, v, count = 0;
+	unsigned r;
+	double x;
+
+	if (step == 0)
+		step = 1;
+	steps = samples ? (samples + step - 1) / step : 1;
+	memcpy(last, a, sizeof(last));
+	for (k = 1; k <= steps; k++) {
+		at = k == steps ? samples : k * step;
+		x = samples ? (double)at / samples : 1;
+		x = x * x * (3 - 2 * x);
+		for (r = 0; r < WAH_PARAM_COUNT; r++) {
+			if (k == steps)
+				v = b[r];
+			else if (r == WAH_ENABLE)
+				v = a[r] | b[r];
+			else
+				v = morph_value(r, a[r], b[r], x);
+			if (v == last[r])
+				continue;
+			last[r] = v;
+			if (count < max) {
+				ev[count].offset = at;
+				ev[count].param = r;
+				ev[count].value = v;
+			}
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+ * wah_morph_start() - Play trajectory @ev into the engines, starting
+ * @delay frames into the next wah_morph_run().
+ *
+ * @ev is used in place and must stay around until the morph is over.
+ */
+void wah_morph_start(struct wah_morph *m, const struct wah_event *ev, uint32_t count,
+	uint64_t delay)
+{
+	m->ev = ev;
+	m->count = count;
+	m->next = 0;
+	m->pos = -(int64_t)delay;
+}
+
+/*
+ * wah_morph_run() - Run @n frames through @engines engines (one per
+ * channel), with the updates of the morph that fall into them.
+ *
+ * The updates go into each engine's event queue, so they land on their
+ * exact sample. The queue holds WAH_EVENT_MAX, so a long block is split
+ * before the step that would overflow it; a step has at most
+ * WAH_PARAM_COUNT updates, so every piece makes progress.
+ */
+void wah_morph_run(struct wah_morph *m, struct wah_engine *eng, unsigned engines,
+	const int32_t *const *in, int32_t *const *out, size_t n)
+{
+	size_t done = 0, len;
+	uint32_t i, due;
+	unsigned e;
+
+	while (done < n) {
+		len = n - done;
+		for (i = m->next, due = 0; i < m->count && m->ev[i].offset - m->pos < (int64_t)len;
+				i++, due++)
+			if (due == WAH_EVENT_MAX) {
+				// Stop short of that offset, so nothing is left in
+				// the queues for the next round to overflow.
+				len = (size_t)(m->ev[i].offset - m->pos);
+				while (m->ev[m->next + due - 1].offset == m->ev[i].offset)
+					due--;
+				break;
+			}
+		for (e = 0; e < engines; e++) {
+			for (i = m->next; i < m->next + due; i++)
+				wah_engine_schedule(&eng[e], (uint32_t)(m->ev[i].offset - m->pos),
+					m->ev[i].param, m->ev[i].value);
+			wah_engine_process(&eng[e], in[e] + done, out[e] + done, len);
+		}
+		m->next += due;
+		m->pos += len;
+		done += len;
+	}
+}
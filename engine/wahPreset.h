@@ -0,0 +1,84 @@
+/*-------------------------------------------------------------------------
+ * Description:  Preset store and morph trajectories.
+ *
+ *               A preset is a named set of the seven register values,
+ *               kept one per line in a text file:
+ *
+ *                 # name  registers (any left out keep the createSimParams.m defaults)
+ *                 verse   enable=1 volume=65535 damp=1966 minf=500 maxf=3000 delta=3277 wetDry=32768
+ *                 solo    enable=1 volume=52000 damp=1311 minf=300 maxf=5000 delta=6554 wetDry=52429
+ *
+ *               A morph from one set to another is planned up front as a
+ *               list of register updates at exact sample offsets (struct
+ *               wah_event), one step every few samples, and then handed
+ *               over in one piece: to the driver as a timed stream it
+ *               plays from a kernel timer (see
+ *               linux/wahWahEffectProcessor.c), or to software engines
+ *               through wah_morph_run(). Rewriting the seven registers one
+ *               at a time jumps audibly; the trajectory eases along an
+ *               S-curve instead, with the frequency registers moving
+ *               geometrically (equal steps in pitch) and the rest
+ *               linearly, and a step only carries the registers whose
+ *               value changed.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_PRESET_H
+#define WAH_PRESET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahEngine.h"
+
+/* Longest preset name, with its terminating NUL                        */
+#define WAH_PRESET_NAME 32
+
+/*
+ * struct wah_preset - A named register set.
+ */
+struct wah_preset {
+	char name[WAH_PRESET_NAME];
+	struct wah_params p;
+};
+
+/*
+ * struct wah_presets - A preset store.
+ * @preset: Presets in file order.
+ * @count: Entries in @preset.
+ * @capacity: Room in @preset.
+ */
+struct wah_presets {
+	struct wah_preset *preset;
+	size_t count;
+	size_t capacity;
+};
+
+int wah_presets_load(struct wah_presets *s, const char *path);
+int wah_presets_save(const struct wah_presets *s, const char *path);
+void wah_presets_free(struct wah_presets *s);
+const struct wah_preset *wah_preset_find(const struct wah_presets *s, const char *name);
+int wah_preset_put(struct wah_presets *s, const char *name, const struct wah_params *p);
+int wah_preset_remove(struct wah_presets *s, const char *name);
+
+uint32_t wah_morph_plan(const struct wah_params *from, const struct wah_params *to,
+	uint32_t samples, uint32_t step, struct wah_event *ev, uint32_t max);
+
+/*
+ * struct wah_morph - A trajectory being played into software engines.
+ * @ev: Updates, offsets counted from the start of the morph.
+ * @count: Entries in @ev.
+ * @next: First update not yet applied.
+ * @pos: Frames run since the start of the morph; negative before it.
+ */
+struct wah_morph {
+	const struct wah_event *ev;
+	uint32_t count;
+	uint32_t next;
+	int64_t pos;
+};
+
+void wah_morph_start(struct wah_morph *m, const struct wah_event *ev, uint32_t count,
+	uint64_t delay);
+void wah_morph_run(struct wah_morph *m, struct wah_engine *eng, unsigned engines,
+	const int32_t *const *in, int32_t *const *out, size_t n);
+
+#endif
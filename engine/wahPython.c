@@ -0,0 +1,803 @@
+/*-------------------------------------------------------------------------
+ * Description:  Python bindings for the software wah engine.
+ *
+ *                 import wah, numpy as np
+ *                 eng = wah.Engine(minf=200, maxf=4000)
+ *                 eng.process(x)                    # in place
+ *                 y = eng.process(x, np.empty_like(x))
+ *                 ch = wah.Chain("wah,mixer,volume,limit", 2)
+ *                 ch.process(stereo)                # shape (2, frames)
+ *                 pool = wah.Voices(64)
+ *                 h = pool.create(delta=5000)
+ *                 pool.process(streams)             # shape (64, frames)
+ *
+ *               Buffers are anything with the buffer protocol: NumPy
+ *               arrays, array.array, memoryview. int32 buffers hold
+ *               sfix24_En23 samples and are processed where they are,
+ *               without a copy; float32 buffers (full scale +-1.0) are
+ *               converted a chunk at a time on the way through. The GIL
+ *               is released while audio is processed, so a Python thread
+ *               pool over several objects runs them in parallel; one
+ *               object is not reentrant, and using it from two threads at
+ *               once raises RuntimeError instead of corrupting it.
+ *
+ *               Engine wraps wah_engine (one channel), Chain wraps
+ *               wah_chain (channels as rows of a C-contiguous 2-D
+ *               buffer) and Voices wraps the wah_voices pool (one row per
+ *               handle, for batch processing of many streams). Registers
+ *               are keyword arguments named as in wah_param_names.
+ *
+ * Build:        gcc -O3 -march=native -shared -fPIC $(python3-config --includes)
+ *                   -o wah$(python3-config --extension-suffix) wahPython.c
+ *                   wahEngine.c wahCycle.c wahChain.c wahLimit.c wahVoices.c -lm
+ *-------------------------------------------------------------------------*/
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <math.h>
+#include <string.h>
+
+#include "wahChain.h"
+#include "wahEngine.h"
+#include "wahVoices.h"
+
+/*-----------------------------------------------------------------------*/
+/* Buffers                                                               */
+/*-----------------------------------------------------------------------*/
+/*
+ * struct io - The buffers of one process() call.
+ * @in, @out: Views; @out is @in for in-place calls.
+ * @isFloat: float32 rather than int32 samples.
+ * @rows, @frames: Shape, @rows 1 for 1-D buffers.
+ */
+struct io {
+	Py_buffer in;
+	Py_buffer out;
+	int inPlace;
+	int isFloat;
+	Py_ssize_t rows;
+	Py_ssize_t frames;
+};
+
+/*
+ * sample_kind() - 0 for int32, 1 for float32, -1 for anything else.
+ */
+static int sample_kind(const Py_buffer *b){
+	const char *f = b->format ? b->format : "B";
+
+	if (*f == '<' || *f == '=' || *f == '@')
+		f++;
+	if (b->itemsize != 4 || f[1] != '\0')
+		return -1;
+	if (*f == 'i' || (*f == 'l' && sizeof(long) == 4))
+		return 0;
+	return *f == 'f' ? 1 : -1;
+}
+
+static int get_view(PyObject *obj, Py_buffer *b, int writable, int ndim){
+	if (PyObject_GetBuffer(obj, b, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT |
+			(writable ? PyBUF_WRITABLE : 0)) < 0)
+		return -1;
+	if (sample_kind(b) < 0 || b->ndim != ndim) {
+		PyErr_Format(PyExc_ValueError, "expected a %d-D int32 or float32 buffer", ndim);
+		PyBuffer_Release(b);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * io_get() - Views of @in and @out (None for in place), both @ndim-D and
+ * of the same type and shape.
+ */
+static int io_get(struct io *io, PyObject *in, PyObject *out, int ndim)
+{
+	memset(io, 0, sizeof(*io));
+	io->inPlace = out == NULL || out == Py_None || out == in;
+	if (get_view(in, &io->in, io->inPlace, ndim) < 0)
+		return -1;
+	if (io->inPlace) {
+		io->out = io->in;
+	} else {
+		if (get_view(out, &io->out, 1, ndim) < 0) {
+			PyBuffer_Release(&io->in);
+			return -1;
+		}
+		if (sample_kind(&io->out) != sample_kind(&io->in) ||
+		    memcmp(io->out.shape, io->in.shape, ndim * sizeof(Py_ssize_t))) {
+			PyErr_SetString(PyExc_ValueError, "in and out differ in type or shape");
+			PyBuffer_Release(&io->in);
+			PyBuffer_Release(&io->out);
+			return -1;
+		}
+	}
+	io->isFloat = sample_kind(&io->in);
+	io->rows = ndim == 2 ? io->in.shape[0] : 1;
+	io->frames = io->in.shape[ndim - 1];
+	return 0;
+}
+
+static void io_release(struct io *io)
+{
+	if (!io->inPlace)
+		PyBuffer_Release(&io->out);
+	PyBuffer_Release(&io->in);
+}
+
+/*
+ * io_result() - Release the views and return the output object.
+ */
+static PyObject *io_result(struct io *io, PyObject *in, PyObject *out)
+{
+	PyObject *r = io->inPlace ? in : out;
+
+	io_release(io);
+	Py_INCREF(r);
+	return r;
+}
+
+static inline int32_t from_float(float f){
+	float v = f * 8388608.0f;
+
+	if (v != v)
+		return 0;
+	if (v >= 8388607.0f)
+		return 8388607;
+	if (v <= -8388608.0f)
+		return -8388608;
+	return (int32_t)lrintf(v);
+}
+
+static void to_fixed(const float *x, int32_t *y, size_t n){
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		y[i] = from_float(x[i]);
+}
+
+static void to_float(const int32_t *x, float *y, size_t n){
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		y[i] = x[i] * (1.0f / 8388608.0f);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Registers                                                             */
+/*-----------------------------------------------------------------------*/
+/*
+ * parse_params() - createSimParams.m defaults overridden by @kwargs.
+ */
+static int parse_params(PyObject *kwargs, struct wah_params *p)
+{
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+
+	wah_params_default(p);
+	while (kwargs && PyDict_Next(kwargs, &pos, &key, &value)) {
+		Py_ssize_t len;
+		const char *name = PyUnicode_AsUTF8AndSize(key, &len);
+		unsigned long v;
+		int id;
+
+		if (name == NULL)
+			return -1;
+		id = wah_param_lookup(name, (size_t)len);
+		if (id < 0) {
+			PyErr_Format(PyExc_TypeError, "unknown register '%s'", name);
+			return -1;
+		}
+		v = PyLong_AsUnsignedLong(value);
+		if (PyErr_Occurred())
+			return -1;
+		wah_params_set(p, (unsigned)id, (uint32_t)v);
+	}
+	return 0;
+}
+
+static int param_id(PyObject *name){
+	Py_ssize_t len;
+	const char *s = PyUnicode_AsUTF8AndSize(name, &len);
+	int id;
+
+	if (s == NULL)
+		return -1;
+	id = wah_param_lookup(s, (size_t)len);
+	if (id < 0)
+		PyErr_Format(PyExc_KeyError, "unknown register '%s'", s);
+	return id;
+}
+
+static PyObject *params_dict(const struct wah_params *p){
+	const uint32_t *regs = (const uint32_t *)p;
+	PyObject *d = PyDict_New(), *v;
+	unsigned i;
+
+	for (i = 0; d && i < WAH_PARAM_COUNT; i++) {
+		v = PyLong_FromUnsignedLong(regs[i]);
+		if (v == NULL || PyDict_SetItemString(d, wah_param_names[i], v) < 0) {
+			Py_XDECREF(v);
+			Py_DECREF(d);
+			return NULL;
+		}
+		Py_DECREF(v);
+	}
+	return d;
+}
+
+/*
+ * idle() - Check that no other thread is inside a call that dropped the
+ * GIL; every call that reads or changes an object checks first.
+ */
+static int idle(int busy){
+	if (busy) {
+		PyErr_SetString(PyExc_RuntimeError, "object is in use by another thread");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * claim() - Mark an object busy for the duration of a call that drops
+ * the GIL; taken and released with the GIL held.
+ */
+static int claim(int *busy){
+	if (idle(*busy) < 0)
+		return -1;
+	*busy = 1;
+	return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Engine                                                                */
+/*-----------------------------------------------------------------------*/
+struct py_engine {
+	PyObject_HEAD
+	struct wah_engine eng;
+	int busy;
+};
+
+static int engine_init(struct py_engine *self, PyObject *args, PyObject *kwargs)
+{
+	struct wah_params p;
+
+	if (idle(self->busy) < 0)
+		return -1;
+	if (PyTuple_GET_SIZE(args) != 0) {
+		PyErr_SetString(PyExc_TypeError, "registers are keyword arguments");
+		return -1;
+	}
+	if (parse_params(kwargs, &p) < 0)
+		return -1;
+	wah_engine_init(&self->eng, &p);
+	return 0;
+}
+
+/*
+ * engine_render() - wah_engine_process() over a whole buffer; float32 a
+ * chunk at a time through scratch on the stack.
+ */
+static void engine_render(struct wah_engine *eng, const struct io *io)
+{
+	int32_t tmp[WAH_CHUNK];
+	size_t n = (size_t)io->frames, pos, c;
+
+	if (!io->isFloat) {
+		wah_engine_process(eng, io->in.buf, io->out.buf, n);
+		return;
+	}
+	for (pos = 0; pos < n; pos += c) {
+		c = n - pos < WAH_CHUNK ? n - pos : WAH_CHUNK;
+		to_fixed((const float *)io->in.buf + pos, tmp, c);
+		wah_engine_process(eng, tmp, tmp, c);
+		to_float(tmp, (float *)io->out.buf + pos, c);
+	}
+}
+
+static PyObject *engine_process(struct py_engine *self, PyObject *args)
+{
+	PyObject *in, *out = NULL;
+	struct io io;
+
+	if (!PyArg_ParseTuple(args, "O|O:process", &in, &out) || claim(&self->busy) < 0)
+		return NULL;
+	if (io_get(&io, in, out, 1) < 0) {
+		self->busy = 0;
+		return NULL;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	engine_render(&self->eng, &io);
+	Py_END_ALLOW_THREADS
+	self->busy = 0;
+	return io_result(&io, in, out);
+}
+
+static PyObject *engine_set(struct py_engine *self, PyObject *args)
+{
+	PyObject *name;
+	unsigned long value;
+	int id;
+
+	if (idle(self->busy) < 0 || !PyArg_ParseTuple(args, "Ok:set", &name, &value) ||
+	    (id = param_id(name)) < 0)
+		return NULL;
+	wah_engine_set(&self->eng, (unsigned)id, (uint32_t)value);
+	Py_RETURN_NONE;
+}
+
+static PyObject *engine_schedule(struct py_engine *self, PyObject *args)
+{
+	PyObject *name;
+	unsigned long offset, value;
+	int id;
+
+	if (idle(self->busy) < 0 ||
+	    !PyArg_ParseTuple(args, "kOk:schedule", &offset, &name, &value) ||
+	    (id = param_id(name)) < 0)
+		return NULL;
+	if (wah_engine_schedule(&self->eng, (uint32_t)offset, (unsigned)id, (uint32_t)value) < 0) {
+		PyErr_SetString(PyExc_OverflowError, "event queue full");
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+static PyObject *engine_set_ramp(struct py_engine *self, PyObject *args)
+{
+	unsigned shape;
+	unsigned long samples;
+
+	if (idle(self->busy) < 0 || !PyArg_ParseTuple(args, "Ik:set_ramp", &shape, &samples))
+		return NULL;
+	wah_engine_set_ramp(&self->eng, shape, (uint32_t)samples);
+	Py_RETURN_NONE;
+}
+
+static PyObject *engine_reset(struct py_engine *self, PyObject *unused)
+{
+	(void)unused;
+	if (idle(self->busy) < 0)
+		return NULL;
+	wah_engine_reset(&self->eng);
+	Py_RETURN_NONE;
+}
+
+static PyObject *engine_params(struct py_engine *self, void *unused)
+{
+	(void)unused;
+	if (idle(self->busy) < 0)
+		return NULL;
+	return params_dict(&self->eng.params);
+}
+
+static PyMethodDef engine_methods[] = {
+	{ "process", (PyCFunction)engine_process, METH_VARARGS,
+	  "process(x[, out]) -> out: run a 1-D buffer; in place without out" },
+	{ "set", (PyCFunction)engine_set, METH_VARARGS,
+	  "set(name, value): change a register now" },
+	{ "schedule", (PyCFunction)engine_schedule, METH_VARARGS,
+	  "schedule(offset, name, value): change a register at a frame of the next process()" },
+	{ "set_ramp", (PyCFunction)engine_set_ramp, METH_VARARGS,
+	  "set_ramp(shape, samples): ramp later volume and wetDry changes" },
+	{ "reset", (PyCFunction)engine_reset, METH_NOARGS,
+	  "reset(): clear the filter and the Fc triangle" },
+	{ NULL }
+};
+
+static PyGetSetDef engine_getset[] = {
+	{ "params", (getter)engine_params, NULL, "register values", NULL },
+	{ NULL }
+};
+
+static PyTypeObject engine_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "wah.Engine",
+	.tp_doc = "Engine(**registers): one channel of the wah datapath",
+	.tp_basicsize = sizeof(struct py_engine),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_new = PyType_GenericNew,
+	.tp_init = (initproc)engine_init,
+	.tp_methods = engine_methods,
+	.tp_getset = engine_getset,
+};
+
+/*-----------------------------------------------------------------------*/
+/* Chain                                                                 */
+/*-----------------------------------------------------------------------*/
+/*
+ * struct py_chain - A chain, with row pointers and float32 scratch
+ * allocated once.
+ */
+struct py_chain {
+	PyObject_HEAD
+	struct wah_chain ch;
+	int ready;
+	int busy;
+	const int32_t **in;
+	int32_t **out;
+	int32_t *scratch;
+};
+
+static void chain_clear(struct py_chain *self)
+{
+	if (self->ready)
+		wah_chain_free(&self->ch);
+	PyMem_Free(self->in);
+	PyMem_Free(self->out);
+	PyMem_Free(self->scratch);
+	self->ready = 0;
+	self->in = NULL;
+	self->out = NULL;
+	self->scratch = NULL;
+}
+
+static int chain_init(struct py_chain *self, PyObject *args, PyObject *kwargs)
+{
+	const char *desc;
+	unsigned channels = 1;
+	struct wah_params p;
+
+	// Initialising again frees the chain a running process() uses.
+	if (idle(self->busy) < 0 || !PyArg_ParseTuple(args, "s|I:Chain", &desc, &channels) ||
+	    parse_params(kwargs, &p) < 0)
+		return -1;
+	chain_clear(self);
+	if (wah_chain_init(&self->ch, desc, channels, &p, NULL) < 0) {
+		PyErr_SetFromErrno(PyExc_ValueError);
+		return -1;
+	}
+	self->ready = 1;
+	self->in = PyMem_Calloc(channels, sizeof(*self->in));
+	self->out = PyMem_Calloc(channels, sizeof(*self->out));
+	self->scratch = PyMem_Calloc((size_t)channels * WAH_CHAIN_CHUNK, sizeof(int32_t));
+	if (self->in == NULL || self->out == NULL || self->scratch == NULL) {
+		chain_clear(self);
+		PyErr_NoMemory();
+		return -1;
+	}
+	return 0;
+}
+
+static void chain_dealloc(struct py_chain *self)
+{
+	chain_clear(self);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static void chain_render(struct py_chain *self, const struct io *io)
+{
+	const unsigned channels = self->ch.channels;
+	const size_t n = (size_t)io->frames;
+	size_t pos, c;
+	unsigned k;
+
+	if (!io->isFloat) {
+		for (k = 0; k < channels; k++) {
+			self->in[k] = (const int32_t *)io->in.buf + k * n;
+			self->out[k] = (int32_t *)io->out.buf + k * n;
+		}
+		wah_chain_process(&self->ch, self->in, self->out, n);
+		return;
+	}
+	for (k = 0; k < channels; k++)
+		self->in[k] = self->out[k] = self->scratch + k * WAH_CHAIN_CHUNK;
+	for (pos = 0; pos < n; pos += c) {
+		c = n - pos < WAH_CHAIN_CHUNK ? n - pos : WAH_CHAIN_CHUNK;
+		for (k = 0; k < channels; k++)
+			to_fixed((const float *)io->in.buf + k * n + pos, self->out[k], c);
+		wah_chain_process(&self->ch, self->in, self->out, c);
+		for (k = 0; k < channels; k++)
+			to_float(self->out[k], (float *)io->out.buf + k * n + pos, c);
+	}
+}
+
+static PyObject *chain_process(struct py_chain *self, PyObject *args)
+{
+	PyObject *in, *out = NULL;
+	struct io io;
+
+	if (!self->ready) {
+		PyErr_SetString(PyExc_RuntimeError, "chain not initialised");
+		return NULL;
+	}
+	if (!PyArg_ParseTuple(args, "O|O:process", &in, &out) || claim(&self->busy) < 0)
+		return NULL;
+	if (io_get(&io, in, out, 2) < 0) {
+		self->busy = 0;
+		return NULL;
+	}
+	if (io.rows != self->ch.channels) {
+		io_release(&io);
+		self->busy = 0;
+		return PyErr_Format(PyExc_ValueError, "expected %u rows, one per channel",
+			self->ch.channels);
+	}
+	Py_BEGIN_ALLOW_THREADS
+	chain_render(self, &io);
+	Py_END_ALLOW_THREADS
+	self->busy = 0;
+	return io_result(&io, in, out);
+}
+
+static PyObject *chain_schedule(struct py_chain *self, PyObject *args)
+{
+	PyObject *name;
+	unsigned long offset, value;
+	int id;
+
+	if (!self->ready) {
+		PyErr_SetString(PyExc_RuntimeError, "chain not initialised");
+		return NULL;
+	}
+	if (idle(self->busy) < 0 || !PyArg_ParseTuple(args, "kOk:schedule", &offset, &name, &value) ||
+	    (id = param_id(name)) < 0)
+		return NULL;
+	if (wah_chain_schedule(&self->ch, (uint32_t)offset, (unsigned)id, (uint32_t)value) < 0) {
+		PyErr_SetString(PyExc_OverflowError, "event queue full");
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+static PyObject *chain_latency(struct py_chain *self, void *unused)
+{
+	(void)unused;
+	return PyLong_FromUnsignedLong(self->ready ? wah_chain_latency(&self->ch) : 0);
+}
+
+static PyMethodDef chain_methods[] = {
+	{ "process", (PyCFunction)chain_process, METH_VARARGS,
+	  "process(x[, out]) -> out: run a (channels, frames) buffer" },
+	{ "schedule", (PyCFunction)chain_schedule, METH_VARARGS,
+	  "schedule(offset, name, value): change a register on every channel" },
+	{ NULL }
+};
+
+static PyGetSetDef chain_getset[] = {
+	{ "latency", (getter)chain_latency, NULL, "frames the output lags the input", NULL },
+	{ NULL }
+};
+
+static PyTypeObject chain_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "wah.Chain",
+	.tp_doc = "Chain(description, channels=1, **registers): an effect chain",
+	.tp_basicsize = sizeof(struct py_chain),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_new = PyType_GenericNew,
+	.tp_init = (initproc)chain_init,
+	.tp_dealloc = (destructor)chain_dealloc,
+	.tp_methods = chain_methods,
+	.tp_getset = chain_getset,
+};
+
+/*-----------------------------------------------------------------------*/
+/* Voices                                                                */
+/*-----------------------------------------------------------------------*/
+struct py_voices {
+	PyObject_HEAD
+	struct wah_voices v;
+	int ready;
+	int busy;
+	int32_t *scratch;
+};
+
+static void voices_clear(struct py_voices *self)
+{
+	if (self->ready)
+		wah_voices_free(&self->v);
+	PyMem_Free(self->scratch);
+	self->ready = 0;
+	self->scratch = NULL;
+}
+
+static int voices_init(struct py_voices *self, PyObject *args, PyObject *kwargs)
+{
+	static char *keywords[] = { "capacity", NULL };
+	unsigned capacity;
+
+	// Initialising again frees the arena a running process() uses.
+	if (idle(self->busy) < 0 ||
+	    !PyArg_ParseTupleAndKeywords(args, kwargs, "I:Voices", keywords, &capacity))
+		return -1;
+	voices_clear(self);
+	if (wah_voices_init(&self->v, capacity) < 0) {
+		PyErr_SetFromErrno(PyExc_ValueError);
+		return -1;
+	}
+	self->ready = 1;
+	self->scratch = PyMem_Calloc((size_t)capacity * WAH_CHUNK, sizeof(int32_t));
+	if (self->scratch == NULL) {
+		voices_clear(self);
+		PyErr_NoMemory();
+		return -1;
+	}
+	return 0;
+}
+
+static void voices_dealloc(struct py_voices *self)
+{
+	voices_clear(self);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/* Whether the pool can be used now: initialised and not processing      */
+static int voices_ready(const struct py_voices *self){
+	if (!self->ready)
+		PyErr_SetString(PyExc_RuntimeError, "pool not initialised");
+	return self->ready && idle(self->busy) == 0;
+}
+
+static PyObject *voices_create(struct py_voices *self, PyObject *args, PyObject *kwargs)
+{
+	struct wah_params p;
+	int64_t h;
+
+	if (!voices_ready(self))
+		return NULL;
+	if (PyTuple_GET_SIZE(args) != 0) {
+		PyErr_SetString(PyExc_TypeError, "registers are keyword arguments");
+		return NULL;
+	}
+	if (parse_params(kwargs, &p) < 0)
+		return NULL;
+	h = wah_voice_create(&self->v, &p);
+	if (h < 0) {
+		PyErr_SetString(PyExc_OverflowError, "pool is full");
+		return NULL;
+	}
+	return PyLong_FromLongLong(h);
+}
+
+static PyObject *voices_destroy(struct py_voices *self, PyObject *args)
+{
+	unsigned h;
+
+	if (!voices_ready(self) || !PyArg_ParseTuple(args, "I:destroy", &h))
+		return NULL;
+	wah_voice_destroy(&self->v, h);
+	Py_RETURN_NONE;
+}
+
+static PyObject *voices_set(struct py_voices *self, PyObject *args)
+{
+	PyObject *name;
+	unsigned long value;
+	unsigned h;
+	int id;
+
+	if (!voices_ready(self) || !PyArg_ParseTuple(args, "IOk:set", &h, &name, &value) ||
+	    (id = param_id(name)) < 0)
+		return NULL;
+	wah_voice_set(&self->v, h, (unsigned)id, (uint32_t)value);
+	Py_RETURN_NONE;
+}
+
+/*
+ * voices_render() - One sweep over the whole buffer; float32 rows of the
+ * active handles are converted a chunk at a time.
+ */
+static void voices_render(struct py_voices *self, const struct io *io)
+{
+	const size_t n = (size_t)io->frames;
+	size_t pos, c;
+	uint32_t d, h;
+
+	if (!io->isFloat) {
+		wah_voices_process(&self->v, io->in.buf, io->out.buf, n, n);
+		return;
+	}
+	for (pos = 0; pos < n; pos += c) {
+		c = n - pos < WAH_CHUNK ? n - pos : WAH_CHUNK;
+		for (d = 0; d < self->v.count; d++) {
+			h = self->v.handle[d];
+			to_fixed((const float *)io->in.buf + h * n + pos,
+				self->scratch + h * WAH_CHUNK, c);
+		}
+		wah_voices_process(&self->v, self->scratch, self->scratch, WAH_CHUNK, c);
+		for (d = 0; d < self->v.count; d++) {
+			h = self->v.handle[d];
+			to_float(self->scratch + h * WAH_CHUNK,
+				(float *)io->out.buf + h * n + pos, c);
+		}
+	}
+}
+
+static PyObject *voices_process(struct py_voices *self, PyObject *args)
+{
+	PyObject *in, *out = NULL;
+	struct io io;
+
+	if (!voices_ready(self) || !PyArg_ParseTuple(args, "O|O:process", &in, &out) ||
+	    claim(&self->busy) < 0)
+		return NULL;
+	if (io_get(&io, in, out, 2) < 0) {
+		self->busy = 0;
+		return NULL;
+	}
+	if (io.rows != self->v.capacity) {
+		io_release(&io);
+		self->busy = 0;
+		return PyErr_Format(PyExc_ValueError, "expected %u rows, one per handle",
+			self->v.capacity);
+	}
+	Py_BEGIN_ALLOW_THREADS
+	voices_render(self, &io);
+	Py_END_ALLOW_THREADS
+	self->busy = 0;
+	return io_result(&io, in, out);
+}
+
+static Py_ssize_t voices_len(struct py_voices *self)
+{
+	return self->ready ? self->v.count : 0;
+}
+
+static PyMethodDef voices_methods[] = {
+	{ "create", (PyCFunction)(void (*)(void))voices_create, METH_VARARGS | METH_KEYWORDS,
+	  "create(**registers) -> handle: start an instance" },
+	{ "destroy", (PyCFunction)voices_destroy, METH_VARARGS,
+	  "destroy(handle): end an instance" },
+	{ "set", (PyCFunction)voices_set, METH_VARARGS,
+	  "set(handle, name, value): change a register from the next process()" },
+	{ "process", (PyCFunction)voices_process, METH_VARARGS,
+	  "process(x[, out]) -> out: run a (capacity, frames) buffer, row h for handle h" },
+	{ NULL }
+};
+
+static PySequenceMethods voices_sequence = {
+	.sq_length = (lenfunc)voices_len,
+};
+
+static PyTypeObject voices_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "wah.Voices",
+	.tp_doc = "Voices(capacity): a pool of instances for batch processing",
+	.tp_basicsize = sizeof(struct py_voices),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_new = PyType_GenericNew,
+	.tp_init = (initproc)voices_init,
+	.tp_dealloc = (destructor)voices_dealloc,
+	.tp_methods = voices_methods,
+	.tp_as_sequence = &voices_sequence,
+};
+
+/*-----------------------------------------------------------------------*/
+/* Module                                                                */
+/*-----------------------------------------------------------------------*/
+static struct PyModuleDef wah_module = {
+	PyModuleDef_HEAD_INIT,
+	.m_name = "wah",
+	.m_doc = "Software wah engine: Engine, Chain and Voices over int32/float32 buffers",
+	.m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_wah(void)
+{
+	PyTypeObject *types[] = { &engine_type, &chain_type, &voices_type };
+	PyObject *m;
+	unsigned i;
+
+	for (i = 0; i < 3; i++)
+		if (PyType_Ready(types[i]) < 0)
+			return NULL;
+	m = PyModule_Create(&wah_module);
+	if (m == NULL)
+		return NULL;
+	for (i = 0; i < 3; i++) {
+		Py_INCREF(types[i]);
+		if (PyModule_AddObject(m, strchr(types[i]->tp_name, '.') + 1,
+				(PyObject *)types[i]) < 0) {
+			Py_DECREF(types[i]);
+			Py_DECREF(m);
+			return NULL;
+		}
+	}
+	if (PyModule_AddIntConstant(m, "SAMPLE_RATE", WAH_SAMPLE_RATE) < 0 ||
+	    PyModule_AddIntConstant(m, "RAMP_LINEAR", WAH_RAMP_LINEAR) < 0 ||
+	    PyModule_AddIntConstant(m, "RAMP_EXP", WAH_RAMP_EXP) < 0) {
+		Py_DECREF(m);
+		return NULL;
+	}
+	return m;
+}
@@ -0,0 +1,118 @@
+/*-------------------------------------------------------------------------
+ * Description:  Per-sample parameter ramps for the volume and wetDry stages.
+ *
+ *               A ramp walks a register value to its new target instead of
+ *               switching at once, which is what causes zipper noise when
+ *               the registers are updated often. Every sample still sees a
+ *               whole ufix16_En16 register value, exactly as if the register
+ *               had been written that sample, so the datapath formats don't
+ *               change.
+ *
+ *               Ramps are built from linear pieces so the mixer loop only
+ *               ever adds a constant per sample: a linear ramp is a single
+ *               piece, an exponential ramp is exact at every
+ *               WAH_RAMP_CHUNK-th sample and linear in between.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_RAMP_H
+#define WAH_RAMP_H
+
+#include <stdint.h>
+
+#include "wahFixed.h"
+
+enum wah_ramp_shape {
+	WAH_RAMP_LINEAR,
+	WAH_RAMP_EXP,
+};
+
+/* Fraction bits carried below the register LSB                          */
+#define WAH_RAMP_FRAC 16
+/* Length of the linear pieces of an exponential ramp                    */
+#define WAH_RAMP_CHUNK 32
+/* Q format of the exponential per-piece decay                           */
+#define WAH_RAMP_COEF_BITS 30
+
+/*
+ * struct wah_ramp - One ramped register.
+ * @cur: Value at the start of the current piece (register << WAH_RAMP_FRAC).
+ * @target: Value the ramp settles on.
+ * @inc: Per-sample step of the current piece.
+ * @left: Samples left in the current piece; 0 once settled.
+ * @shape: enum wah_ramp_shape.
+ * @coef: Exponential ramps: distance kept per piece (Q30).
+ */
+struct wah_ramp {
+	int64_t cur;
+	int64_t target;
+	int64_t inc;
+	uint32_t left;
+	uint32_t shape;
+	int64_t coef;
+};
+
+/* Settle on @value immediately                                          */
+static inline void wah_ramp_jump(struct wah_ramp *r, uint32_t value)
+{
+	r->cur = r->target = (int64_t)value << WAH_RAMP_FRAC;
+	r->inc = 0;
+	r->left = 0;
+}
+
+/*
+ * wah_ramp_plan() - Set up the piece that follows a finished one.
+ */
+static inline void wah_ramp_plan(struct wah_ramp *r)
+{
+	int64_t d = r->cur - r->target;
+	int64_t next;
+
+	// Linear ramps are one piece; exponential ones stop within an LSB.
+	if (r->shape == WAH_RAMP_LINEAR ||
+	    (d > -(1 << WAH_RAMP_FRAC) && d < (1 << WAH_RAMP_FRAC))) {
+		wah_ramp_jump(r, (uint32_t)(r->target >> WAH_RAMP_FRAC));
+		return;
+	}
+	next = r->target + wah_mul_shr(d, r->coef, WAH_RAMP_COEF_BITS);
+	r->inc = (next - r->cur) / WAH_RAMP_CHUNK;
+	r->left = WAH_RAMP_CHUNK;
+}
+
+/*
+ * wah_ramp_start() - Head for @value from wherever the ramp is now.
+ * @samples: Linear ramp length; 0 jumps.
+ * @coef: Exponential decay per piece (Q30); see wah_engine_set_ramp().
+ */
+static inline void wah_ramp_start(struct wah_ramp *r, uint32_t value, unsigned shape,
+	uint32_t samples, int64_t coef)
+{
+	if (samples == 0) {
+		wah_ramp_jump(r, value);
+		return;
+	}
+
+	// r->cur is always the value reached so far, so a ramp can be
+	// retargeted mid-way without a step.
+	r->target = (int64_t)value << WAH_RAMP_FRAC;
+	r->shape = shape;
+	r->coef = coef;
+	if (shape == WAH_RAMP_LINEAR) {
+		r->inc = (r->target - r->cur) / (int64_t)samples;
+		r->left = samples;
+	} else {
+		r->left = 0;
+		wah_ramp_plan(r);
+	}
+}
+
+/* Consume @n samples (@n never exceeds a non-zero r->left)              */
+static inline void wah_ramp_advance(struct wah_ramp *r, uint32_t n)
+{
+	if (!r->left)
+		return;
+	r->cur += r->inc * n;
+	r->left -= n;
+	if (!r->left)
+		wah_ramp_plan(r);
+}
+
+#endif
@@ -0,0 +1,1379 @@
+/*-------------------------------------------------------------------------
+ * Description:  Batch renderer: runs a set of recordings through the
+ *               engine for every combination of a grid of register values.
+ *
+ *                 wahRender [-j threads] [-c chunk] [-o dir] [-q] manifest
+ *
+ *               The manifest lists inputs and, per register, the values to
+ *               sweep; registers not mentioned keep the createSimParams.m
+ *               defaults. Values are register values, as a list and/or
+ *               MATLAB style first:step:last ranges:
+ *
+ *                 # two recordings, 3 x 2 x 4 = 24 renders each
+ *                 input  ../Simulink/wav/before.wav
+ *                 input  guitar.wav
+ *                 damp   1966 3277 6554
+ *                 minf   100 300
+ *                 wetDry 0:16384:65535
+ *                 output renders
+ *
+ *               Each render is written to
+ *                 <output>/<input stem>-<enable>-<volume>-<damp>-<minf>-
+ *                   <maxf>-<delta>-<wetDry>.wav
+ *               as 24-bit PCM, one engine per channel.
+ *
+ *               The wet signal only depends on damp, minf, maxf and delta;
+ *               the mixer and volume stage after it are linear. So each
+ *               input is filtered once per filter setting and every
+ *               enable/volume/wetDry combination is mixed from that one
+ *               wet stream. With -s the wet streams are also kept on disk
+ *               as stems, and a later run that only changes the mix
+ *               settings skips the filter altogether. Filter engines
+ *               replay F1 from one cycle table per filter setting
+ *               (wahCycle.c), shared by all segments and channels.
+ *
+ *               With -C finished renders also go into a content-addressed
+ *               cache (wahCache.c); asking for the same input audio and
+ *               settings again copies the cached file instead of
+ *               rendering.
+ *
+ *               Renders are cut into chunks that run as tasks on a
+ *               work-stealing pool (wahPool.c). A chunk queues the next
+ *               chunk of its render when it is done, so a long recording
+ *               moves between idle cores instead of pinning one, and
+ *               longer inputs are started first. Output is written chunk
+ *               by chunk as it is produced.
+ *
+ *               Inputs longer than a segment (-S) are also split into
+ *               segments that render side by side. Each segment jumps its
+ *               Fc triangle straight to its start and runs the filter over
+ *               a short preroll first; when the segment before it is done
+ *               the two filter states are compared, and a segment whose
+ *               preroll did not land on exactly the serial state is
+ *               rendered again. Output is bit-identical to a serial render
+ *               either way.
+ *
+ *               With -k seconds, each segment syncs the outputs it has
+ *               written that often and saves its filter state
+ *               (wahState.c) to
+ *               <output>/<input stem>-<damp>-<minf>-<maxf>-<delta>.ckpt.
+ *               Running the same manifest with -k again after an
+ *               interruption, on this machine or another one with the
+ *               same inputs and output directory, picks every segment up
+ *               from its last checkpoint. The checkpoint is removed once
+ *               the job's renders are complete. Checkpoints are off by
+ *               default, since each one costs an fdatasync() of every
+ *               output; a segment that finishes within its first interval
+ *               saves none at all.
+ *
+ * Build:        gcc -O3 -march=native -pthread -o wahRender wahRender.c wahCache.c wahPool.c
+ *                   wahState.c wahWav.c wahEngine.c wahCycle.c -lm
+ *-------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wahCache.h"
+#include "wahEngine.h"
+#include "wahPool.h"
+#include "wahState.h"
+#include "wahWav.h"
+
+/* Default chunk length (frames)                                         */
+#define RENDER_CHUNK 65536
+/* Renders in flight per worker; bounds memory and open files            */
+#define RENDER_OPEN_PER_WORKER 2
+/* Default segment length (s) for splitting long inputs across workers    */
+#define RENDER_SEGMENT_S 60
+/* Default filter preroll before a segment (ms)                          */
+#define RENDER_PREROLL_MS 3000
+/* Default render cache size limit (MB)                                  */
+#define RENDER_CACHE_MB 4096
+/* Progress line interval (ms)                                           */
+#define RENDER_PROGRESS_MS 1000
+
+/* Wet stem files: header, then one int32 sfix24_En23 plane per channel  */
+#define STEM_MAGIC 0x4d545357		/* "WSTM" */
+#define STEM_VERSION 1
+#define STEM_DATA 64
+
+/* Checkpoint files: header, then two slots per segment written in turn,
+ * so a torn write leaves the other one intact                           */
+#define CKPT_MAGIC 0x54504b57		/* "WKPT" */
+#define CKPT_VERSION 1
+#define CKPT_DATA 128
+#define CKPT_EXACT 1
+#define CKPT_DONE 2
+#define CKPT_ENTRY 4
+
+/* Registers the wet signal depends on, and the ones mixed after it      */
+static const unsigned filter_regs[] = { WAH_DAMP, WAH_MINF, WAH_MAXF, WAH_DELTA };
+static const unsigned mix_regs[] = { WAH_ENABLE, WAH_VOLUME, WAH_WETDRY };
+#define FILTER_REGS (sizeof(filter_regs) / sizeof(filter_regs[0]))
+#define MIX_REGS (sizeof(mix_regs) / sizeof(mix_regs[0]))
+
+/*
+ * struct stem_header - Start of a wet stem file.
+ * @size, @mtime_ns: Input file the stem was filtered from.
+ * @regs: damp, minf, maxf and delta.
+ */
+struct stem_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t channels;
+	uint32_t reserved;
+	uint64_t frames;
+	uint64_t size;
+	int64_t mtime_ns;
+	uint32_t regs[FILTER_REGS];
+};
+
+/*
+ * struct ckpt_header - Start of a checkpoint file.
+ * @inputHash: wah_hash64() of the input audio and its format.
+ * @outputHash: wah_hash64() chain over the settings of the job's outputs.
+ * @slotSize: Bytes per slot; see ckpt_slot_size().
+ */
+struct ckpt_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t channels;
+	uint32_t segs;
+	uint64_t frames;
+	uint64_t inputHash;
+	uint64_t outputHash;
+	uint32_t slotSize;
+	uint32_t regs[FILTER_REGS];
+};
+
+/*
+ * struct ckpt_slot - One saved segment, followed by @length bytes of
+ * wah_state_save() blobs: the filter state of each channel, then the
+ * entry states if CKPT_ENTRY is set.
+ * @seq: Save count; the slot with the higher one is the newer.
+ * @pos: Output up to here is on disk.
+ * @flags: CKPT_EXACT, CKPT_DONE, CKPT_ENTRY.
+ * @sum: wah_hash64() of everything before it, seeding the blobs' hash.
+ */
+struct ckpt_slot {
+	uint64_t seq;
+	uint64_t pos;
+	uint32_t seg;
+	uint32_t flags;
+	uint32_t length;
+	uint32_t reserved;
+	uint64_t sum;
+};
+
+struct input {
+	const char *path;
+	char stem[NAME_MAX];
+	struct wah_wav wav;
+	uint64_t size;
+	int64_t mtime_ns;
+	uint64_t hash;
+};
+
+/*
+ * struct grid - Values to sweep for each register.
+ * @values: Values per register, in register map order.
+ * @count: Number of entries in @values; never 0.
+ * @filterSets: Combinations of the filter_regs values.
+ * @mixSets: Combinations of the mix_regs values.
+ */
+struct grid {
+	uint32_t *values[WAH_PARAM_COUNT];
+	unsigned count[WAH_PARAM_COUNT];
+	uint64_t filterSets;
+	uint64_t mixSets;
+};
+
+/*
+ * struct output - One render: a mix setting of a job.
+ * @eng: Mixer state, one engine per channel. Settings never change
+ *       during a render, so the mixer has no ramp to advance and its
+ *       segments may share it.
+ */
+struct output {
+	char path[PATH_MAX];
+	char key[WAH_CACHE_KEY_MAX];
+	int fd;
+	struct wah_engine *eng;
+};
+
+/*
+ * struct segment - A stretch of a job rendered by its own chain of chunks.
+ * @start, @end: Frames written to the outputs.
+ * @pos: Next frame to filter; starts before @start while prerolling.
+ * @counted: Frames up to here are in done_samples (or resumed_samples),
+ *           so a repair that renders them again doesn't count them twice.
+ * @filter: Filter state, one engine per channel.
+ * @entry: Filter state on reaching @start, for verification.
+ * @exact: Started from the true filter state: segment 0, a stem, or a
+ *         repair.
+ * @done: Finished its last chunk.
+ * @seq: Checkpoints saved.
+ * @saved: Time of the last checkpoint (now_s()).
+ */
+struct segment {
+	struct job *job;
+	uint64_t start;
+	uint64_t end;
+	uint64_t pos;
+	uint64_t counted;
+	struct wah_engine *filter;
+	struct wah_engine *entry;
+	int exact;
+	int done;
+	uint64_t seq;
+	double saved;
+};
+
+/*
+ * struct job - One input with one filter setting, and all its mixes.
+ * @stem: Mapped wet stem when one was found, else NULL.
+ * @stemFd: Stem being written while filtering, or -1.
+ * @stemBad: Writing the stem failed; drop it at the end.
+ * @ckptFd: Checkpoint file, or -1.
+ * @ckptBad: Writing a checkpoint failed; stop saving them.
+ * @out: Renders still to be made; at most grid.mixSets.
+ * @outputs: Entries in @out.
+ * @outHash: wah_hash64() chain over the settings of @out.
+ * @seg: @segs segments covering the input.
+ * @verified: Segments known to hold exact output, counted from the start.
+ * @running: Segment chains in flight.
+ */
+struct job {
+	struct input *in;
+	struct wah_params p;
+	const int32_t *stem;
+	size_t stemSize;
+	int stemFd;
+	int stemBad;
+	char stemPath[PATH_MAX];
+	int ckptFd;
+	int ckptBad;
+	char ckptPath[PATH_MAX];
+	struct output *out;
+	unsigned outputs;
+	uint64_t outHash;
+	struct segment *seg;
+	unsigned segs;
+	unsigned verified;
+	unsigned running;
+	pthread_mutex_t lock;
+};
+
+/* Per-worker scratch buffers                                           */
+struct scratch {
+	int32_t **in;
+	int32_t **wet;
+	int32_t **out;
+	const int32_t **mixWet;
+	uint8_t *bytes;
+	uint8_t *ckpt;
+};
+
+static struct input *inputs;
+static unsigned input_count;
+static struct grid grid;
+static const char *out_dir = ".";
+static const char *stem_dir;
+static const char *cache_dir;
+static struct wah_cache cache;
+static size_t chunk = RENDER_CHUNK;
+static unsigned workers;
+static uint64_t seg_frames = RENDER_SEGMENT_S * WAH_SAMPLE_RATE;
+static uint64_t preroll = RENDER_PREROLL_MS * WAH_SAMPLE_RATE / 1000;
+static double ckpt_s;
+static struct scratch *scratch;
+
+static uint64_t next_job, total_jobs;
+static uint64_t done_jobs, done_samples, resumed_samples;
+static uint64_t stems_used, stems_written, repairs, resumed;
+static int failed;
+
+static double now_s(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Manifest                                                              */
+/*-----------------------------------------------------------------------*/
+static void grid_add(unsigned param, uint32_t value){
+	grid.values[param] = realloc(grid.values[param],
+		(grid.count[param] + 1) * sizeof(uint32_t));
+	grid.values[param][grid.count[param]++] = value;
+}
+
+/*
+ * parse_values() - Add "v", "first:last" or "first:step:last" items.
+ */
+static int parse_values(unsigned param, char *s){
+	char *tok, *end;
+
+	for (tok = strtok(s, " \t"); tok; tok = strtok(NULL, " \t")) {
+		unsigned long v[3];
+		int n = 0;
+
+		for (end = tok; n < 3; end++) {
+			v[n++] = strtoul(end, &end, 0);
+			if (*end != ':')
+				break;
+		}
+		if (*end != '\0' || n > 3)
+			return -1;
+		if (n == 1) {
+			grid_add(param, (uint32_t)v[0]);
+		} else {
+			unsigned long first = v[0], step = n == 3 ? v[1] : 1, last = v[n - 1], x;
+
+			if (step == 0 || last < first)
+				return -1;
+			for (x = first; x <= last; x += step)
+				grid_add(param, (uint32_t)x);
+		}
+	}
+	return 0;
+}
+
+static void read_manifest(const char *path){
+	struct wah_params def;
+	const uint32_t *regs = (const uint32_t *)&def;
+	char line[4096];
+	unsigned lineno = 0, i;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		printf("failed to open manifest %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char *key, *rest;
+		size_t len;
+		int param;
+
+		lineno++;
+		line[strcspn(line, "#\r\n")] = '\0';
+		key = line + strspn(line, " \t");
+		len = strcspn(key, " \t");
+		if (len == 0)
+			continue;
+		rest = key + len + strspn(key + len, " \t");
+
+		if (len == 5 && strncmp(key, "input", 5) == 0) {
+			inputs = realloc(inputs, (input_count + 1) * sizeof(*inputs));
+			inputs[input_count++].path = strdup(rest);
+		} else if (len == 6 && strncmp(key, "output", 6) == 0) {
+			out_dir = strdup(rest);
+		} else if ((param = wah_param_lookup(key, len)) >= 0) {
+			if (parse_values(param, rest) < 0) {
+				printf("%s:%u: bad value list\n", path, lineno);
+				exit(1);
+			}
+		} else {
+			printf("%s:%u: unknown key %.*s\n", path, lineno, (int)len, key);
+			exit(1);
+		}
+	}
+	fclose(f);
+
+	if (input_count == 0) {
+		printf("%s: no inputs\n", path);
+		exit(1);
+	}
+	wah_params_default(&def);
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		if (grid.count[i] == 0)
+			grid_add(i, regs[i]);
+	grid.filterSets = 1;
+	for (i = 0; i < FILTER_REGS; i++)
+		grid.filterSets *= grid.count[filter_regs[i]];
+	grid.mixSets = 1;
+	for (i = 0; i < MIX_REGS; i++)
+		grid.mixSets *= grid.count[mix_regs[i]];
+}
+
+/*
+ * grid_pick() - Set the @ids registers of @p to combination @set.
+ *
+ * Mixed-radix decode, last register fastest.
+ */
+static void grid_pick(struct wah_params *p, const unsigned *ids, unsigned nids, uint64_t set){
+	uint32_t *regs = (uint32_t *)p;
+
+	while (nids-- > 0) {
+		unsigned r = ids[nids];
+
+		regs[r] = grid.values[r][set % grid.count[r]];
+		set /= grid.count[r];
+	}
+}
+
+/* Longest first, so the long renders aren't the ones left at the end   */
+static int by_length(const void *a, const void *b){
+	const struct input *x = a, *y = b;
+
+	return x->wav.frames < y->wav.frames ? 1 : x->wav.frames > y->wav.frames ? -1 : 0;
+}
+
+static void open_inputs(void){
+	unsigned i;
+
+	for (i = 0; i < input_count; i++) {
+		struct input *in = &inputs[i];
+		const char *base = strrchr(in->path, '/');
+		char *dot;
+
+		struct stat st;
+
+		if (wah_wav_open(&in->wav, in->path) < 0 || stat(in->path, &st) < 0) {
+			printf("failed to open %s: %s\n", in->path,
+				errno == EINVAL ? "not a supported WAV file" : strerror(errno));
+			exit(1);
+		}
+		if (in->wav.rate != WAH_SAMPLE_RATE)
+			printf("warning: %s is %u Hz; the effect is tuned for %u Hz\n",
+				in->path, in->wav.rate, WAH_SAMPLE_RATE);
+
+		if (cache_dir || ckpt_s > 0) {
+			uint32_t fmt[4] = { in->wav.rate, in->wav.channels, in->wav.bits, in->wav.format };
+
+			// Key on the audio and its format, not the file, so retagging
+			// a recording keeps its renders.
+			in->hash = wah_hash64(in->wav.data,
+				in->wav.frames * in->wav.channels * (in->wav.bits / 8),
+				wah_hash64(fmt, sizeof(fmt), 0));
+		}
+		in->size = st.st_size;
+		in->mtime_ns = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+
+		snprintf(in->stem, sizeof(in->stem), "%s", base ? base + 1 : in->path);
+		dot = strrchr(in->stem, '.');
+		if (dot && dot != in->stem)
+			*dot = '\0';
+	}
+	qsort(inputs, input_count, sizeof(*inputs), by_length);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Rendering                                                             */
+/*-----------------------------------------------------------------------*/
+static void render_chunk(struct wah_pool *pool, void *arg, unsigned worker);
+
+static int write_all(int fd, const void *buf, size_t len, off_t off){
+	const uint8_t *p = buf;
+
+	while (len) {
+		ssize_t r = pwrite(fd, p, len, off);
+
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		len -= r;
+		off += r;
+	}
+	return 0;
+}
+
+static void set_failed(const char *path){
+	printf("\nfailed to write %s: %s\n", path, strerror(errno));
+	__atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * queue_chunk() - Queue the next chunk of @sg.
+ *
+ * Return: 0, or -1 after failing the run if the pool couldn't take it.
+ */
+static int queue_chunk(struct wah_pool *pool, struct segment *sg){
+	if (wah_pool_submit(pool, -1, render_chunk, sg) == 0)
+		return 0;
+	printf("\nfailed to queue %s: %s\n", sg->job->out[0].path, strerror(errno));
+	__atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+	return -1;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Wet stems                                                             */
+/*-----------------------------------------------------------------------*/
+static void stem_header_fill(struct stem_header *h, const struct job *job){
+	unsigned i;
+
+	memset(h, 0, sizeof(*h));
+	h->magic = STEM_MAGIC;
+	h->version = STEM_VERSION;
+	h->channels = job->in->wav.channels;
+	h->frames = job->in->wav.frames;
+	h->size = job->in->size;
+	h->mtime_ns = job->in->mtime_ns;
+	for (i = 0; i < FILTER_REGS; i++)
+		h->regs[i] = ((const uint32_t *)&job->p)[filter_regs[i]];
+}
+
+static void stem_part(const struct job *job, char *part){
+	sprintf(part, "%s.%d.part", job->stemPath, (int)getpid());
+}
+
+/*
+ * stem_open() - Map the job's wet stem if there is one for this exact
+ * input and filter setting; otherwise start writing one.
+ */
+static void stem_open(struct job *job){
+	struct stem_header want, have;
+	char part[PATH_MAX + 16];
+	struct stat st;
+	void *map;
+	int fd;
+
+	job->stem = NULL;
+	job->stemFd = -1;
+	if (stem_dir == NULL)
+		return;
+
+	stem_header_fill(&want, job);
+	snprintf(job->stemPath, sizeof(job->stemPath), "%s/%s-%u-%u-%u-%u.wet", stem_dir,
+		job->in->stem, want.regs[0], want.regs[1], want.regs[2], want.regs[3]);
+	job->stemSize = STEM_DATA + want.channels * want.frames * sizeof(int32_t);
+
+	fd = open(job->stemPath, O_RDONLY);
+	if (fd >= 0) {
+		if (fstat(fd, &st) == 0 && (size_t)st.st_size == job->stemSize &&
+		    pread(fd, &have, sizeof(have), 0) == sizeof(have) &&
+		    memcmp(&have, &want, sizeof(want)) == 0) {
+			map = mmap(NULL, job->stemSize, PROT_READ, MAP_SHARED, fd, 0);
+			if (map != MAP_FAILED) {
+				madvise(map, job->stemSize, MADV_SEQUENTIAL);
+				job->stem = (const int32_t *)((const uint8_t *)map + STEM_DATA);
+				__atomic_fetch_add(&stems_used, 1, __ATOMIC_RELAXED);
+			}
+		}
+		close(fd);
+		if (job->stem)
+			return;
+	}
+
+	// Written under a temporary name and renamed when complete, so a
+	// stem that exists is always whole.
+	stem_part(job, part);
+	job->stemFd = open(part, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (job->stemFd < 0)
+		printf("\nwarning: not keeping stem %s: %s\n", job->stemPath, strerror(errno));
+}
+
+/*
+ * stem_close() - Unmap a used stem, or finish (@ok) or drop a new one.
+ */
+static void stem_close(struct job *job, int ok){
+	struct stem_header h;
+	char part[PATH_MAX + 16];
+
+	if (job->stem) {
+		munmap((uint8_t *)job->stem - STEM_DATA, job->stemSize);
+		return;
+	}
+	if (job->stemFd < 0)
+		return;
+
+	stem_header_fill(&h, job);
+	ok = ok && !__atomic_load_n(&job->stemBad, __ATOMIC_RELAXED) &&
+		write_all(job->stemFd, &h, sizeof(h), 0) == 0;
+	ok = close(job->stemFd) == 0 && ok;
+	stem_part(job, part);
+	if (ok && rename(part, job->stemPath) == 0)
+		__atomic_fetch_add(&stems_written, 1, __ATOMIC_RELAXED);
+	else
+		unlink(part);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Checkpoints                                                           */
+/*-----------------------------------------------------------------------*/
+static size_t ckpt_slot_size(unsigned channels){
+	return sizeof(struct ckpt_slot) + 2 * channels * WAH_STATE_MAX;
+}
+
+static off_t ckpt_slot_offset(const struct job *job, unsigned seg, uint64_t seq){
+	return CKPT_DATA + (off_t)(2 * seg + (seq & 1)) * ckpt_slot_size(job->in->wav.channels);
+}
+
+static uint64_t ckpt_slot_sum(const struct ckpt_slot *slot){
+	return wah_hash64(slot + 1, slot->length,
+		wah_hash64(slot, offsetof(struct ckpt_slot, sum), 0));
+}
+
+static void ckpt_header_fill(struct ckpt_header *h, const struct job *job){
+	unsigned i;
+
+	memset(h, 0, sizeof(*h));
+	h->magic = CKPT_MAGIC;
+	h->version = CKPT_VERSION;
+	h->channels = job->in->wav.channels;
+	h->segs = job->segs;
+	h->frames = job->in->wav.frames;
+	h->inputHash = job->in->hash;
+	h->outputHash = job->outHash;
+	h->slotSize = (uint32_t)ckpt_slot_size(h->channels);
+	for (i = 0; i < FILTER_REGS; i++)
+		h->regs[i] = ((const uint32_t *)&job->p)[filter_regs[i]];
+}
+
+/*
+ * ckpt_save() - Save a segment that has written its output up to sg->pos.
+ * @done: This was its last chunk.
+ *
+ * The outputs are synced first, so the slot never claims output that an
+ * interruption could still lose.
+ */
+static void ckpt_save(struct segment *sg, unsigned worker, int done){
+	struct job *job = sg->job;
+	const unsigned channels = job->in->wav.channels;
+	struct ckpt_slot *slot = (struct ckpt_slot *)scratch[worker].ckpt;
+	uint8_t *p = (uint8_t *)(slot + 1);
+	size_t left = ckpt_slot_size(channels) - sizeof(*slot);
+	unsigned m, c;
+
+	sg->saved = now_s();
+	if (job->ckptFd < 0 || __atomic_load_n(&job->ckptBad, __ATOMIC_RELAXED))
+		return;
+	for (m = 0; m < job->outputs; m++)
+		if (fdatasync(job->out[m].fd) < 0)
+			goto fail;
+
+	memset(slot, 0, sizeof(*slot));
+	slot->seq = ++sg->seq;
+	slot->pos = sg->pos;
+	slot->seg = (uint32_t)(sg - job->seg);
+	slot->flags = (sg->exact ? CKPT_EXACT : CKPT_ENTRY) | (done ? CKPT_DONE : 0);
+	for (c = 0; c < channels && !job->stem; c++) {
+		size_t n = wah_state_save(&sg->filter[c], p, left);
+
+		p += n;
+		left -= n;
+		if (!sg->exact) {
+			n = wah_state_save(&sg->entry[c], p, left);
+			p += n;
+			left -= n;
+		}
+	}
+	slot->length = (uint32_t)(p - (uint8_t *)(slot + 1));
+	slot->sum = ckpt_slot_sum(slot);
+	if (write_all(job->ckptFd, slot, sizeof(*slot) + slot->length,
+			ckpt_slot_offset(job, slot->seg, slot->seq)) == 0 && fdatasync(job->ckptFd) == 0)
+		return;
+
+fail:
+	printf("\nwarning: not checkpointing %s: %s\n", job->ckptPath, strerror(errno));
+	__atomic_store_n(&job->ckptBad, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * ckpt_slot_read() - Read and check slot @ab of segment @sg into @slot.
+ *
+ * Return: The slot's sequence number, or 0 if it is missing or damaged.
+ */
+static uint64_t ckpt_slot_read(const struct segment *sg, int fd, unsigned ab,
+	struct ckpt_slot *slot){
+	const struct job *job = sg->job;
+	const size_t size = ckpt_slot_size(job->in->wav.channels);
+	const unsigned seg = (unsigned)(sg - job->seg);
+	ssize_t r = pread(fd, slot, size, ckpt_slot_offset(job, seg, ab));
+
+	if (r < (ssize_t)sizeof(*slot) || slot->seg != seg || (slot->seq & 1) != ab ||
+	    slot->length > (size_t)r - sizeof(*slot) || slot->sum != ckpt_slot_sum(slot) ||
+	    slot->pos < sg->start || slot->pos > sg->end ||
+	    ((slot->flags & CKPT_DONE) && slot->pos != sg->end) ||
+	    !(slot->flags & CKPT_EXACT) != !!(slot->flags & CKPT_ENTRY))
+		return 0;
+	return slot->seq;
+}
+
+/*
+ * ckpt_restore() - Pick a segment up from the newer of its two slots.
+ * @buf: ckpt_slot_size() bytes of scratch.
+ *
+ * Return: 1 if the segment was restored, 0 if it starts over.
+ */
+static int ckpt_restore(struct segment *sg, int fd, uint8_t *buf){
+	struct job *job = sg->job;
+	const unsigned channels = job->in->wav.channels;
+	struct ckpt_slot *slot = (struct ckpt_slot *)buf;
+	struct wah_engine *filter = NULL, *entry = NULL;
+	const uint8_t *p, *end;
+	uint64_t seq[2];
+	unsigned c;
+	int n;
+
+	seq[0] = ckpt_slot_read(sg, fd, 0, slot);
+	seq[1] = ckpt_slot_read(sg, fd, 1, slot);
+	if (seq[0] == 0 && seq[1] == 0)
+		return 0;
+	if (seq[0] > seq[1])
+		ckpt_slot_read(sg, fd, 0, slot);
+
+	p = (const uint8_t *)(slot + 1);
+	end = p + slot->length;
+	if (job->stem) {
+		if (p != end)
+			return 0;
+	} else {
+		// Decode into copies, so a bad blob leaves the segment as split.
+		filter = malloc(channels * sizeof(struct wah_engine));
+		entry = malloc(channels * sizeof(struct wah_engine));
+		for (c = 0; c < channels; c++) {
+			if ((n = wah_state_load(&filter[c], p, end - p)) < 0)
+				goto bad;
+			p += n;
+			if (slot->flags & CKPT_ENTRY) {
+				if ((n = wah_state_load(&entry[c], p, end - p)) < 0)
+					goto bad;
+				p += n;
+			}
+		}
+		if (p != end)
+			goto bad;
+		memcpy(sg->filter, filter, channels * sizeof(struct wah_engine));
+		memcpy(sg->entry, entry, channels * sizeof(struct wah_engine));
+		for (c = 0; c < channels; c++)
+			wah_engine_set_cycles(&sg->filter[c], 1);
+		free(filter);
+		free(entry);
+	}
+
+	sg->seq = slot->seq;
+	sg->pos = slot->pos;
+	sg->exact = !!(slot->flags & CKPT_EXACT);
+	sg->done = !!(slot->flags & CKPT_DONE);
+	// Written by an earlier run: progress, but not this run's throughput.
+	sg->counted = sg->pos;
+	__atomic_fetch_add(&resumed_samples, (sg->pos - sg->start) * channels * job->outputs,
+		__ATOMIC_RELAXED);
+	return 1;
+
+bad:
+	free(filter);
+	free(entry);
+	return 0;
+}
+
+static int outputs_exist(const struct job *job){
+	unsigned m;
+
+	for (m = 0; m < job->outputs; m++)
+		if (access(job->out[m].path, W_OK) < 0)
+			return 0;
+	return 1;
+}
+
+/*
+ * ckpt_open() - Resume a split job from its checkpoint file, if it has a
+ * usable one, and open the file for this run's checkpoints.
+ *
+ * A checkpoint is only used if it was taken for the same audio, filter
+ * setting, outputs and segment layout, and the outputs are still there.
+ *
+ * Return: Number of segments restored.
+ */
+static unsigned ckpt_open(struct job *job){
+	const unsigned channels = job->in->wav.channels;
+	struct ckpt_header want, have;
+	unsigned restored = 0, i;
+	uint8_t *buf;
+	int fd;
+
+	job->ckptFd = -1;
+	if (ckpt_s <= 0)
+		return 0;
+
+	ckpt_header_fill(&want, job);
+	snprintf(job->ckptPath, sizeof(job->ckptPath), "%s/%s-%u-%u-%u-%u.ckpt", out_dir,
+		job->in->stem, want.regs[0], want.regs[1], want.regs[2], want.regs[3]);
+
+	fd = open(job->ckptPath, O_RDWR);
+	if (fd >= 0 && pread(fd, &have, sizeof(have), 0) == sizeof(have) &&
+	    memcmp(&have, &want, sizeof(want)) == 0 && outputs_exist(job)) {
+		buf = malloc(ckpt_slot_size(channels));
+		for (i = 0; i < job->segs; i++)
+			restored += ckpt_restore(&job->seg[i], fd, buf);
+		free(buf);
+	}
+	if (fd >= 0 && restored == 0) {
+		close(fd);
+		fd = -1;
+	}
+
+	if (fd < 0) {
+		fd = open(job->ckptPath, O_RDWR | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0 || write_all(fd, &want, sizeof(want), 0) < 0) {
+			printf("\nwarning: not checkpointing %s: %s\n", job->ckptPath, strerror(errno));
+			if (fd >= 0)
+				close(fd);
+			fd = -1;
+		}
+	}
+	job->ckptFd = fd;
+	return restored;
+}
+
+/*
+ * ckpt_close() - Close the checkpoint file; remove it once the job is
+ * complete (@ok), keep it for the next run otherwise.
+ */
+static void ckpt_close(struct job *job, int ok){
+	if (job->ckptFd < 0)
+		return;
+	close(job->ckptFd);
+	if (ok)
+		unlink(job->ckptPath);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Jobs                                                                  */
+/*-----------------------------------------------------------------------*/
+static void finish_job(struct wah_pool *pool, struct job *job, int ok);
+
+/*
+ * serve() - Copy a cached render to @path straight from its mapping.
+ */
+static int serve(const char *path, const void *map, size_t size){
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	if (fd < 0)
+		return -1;
+	if (write_all(fd, map, size, 0) < 0) {
+		close(fd);
+		return -1;
+	}
+	return close(fd);
+}
+
+/*
+ * split_job() - Cut a job into segments that can run side by side.
+ *
+ * Segment 0 starts from reset. Every later one seeks its Fc triangle
+ * straight to preroll frames before its start (wah_lfo_advance()) and
+ * runs the filter from silence over the preroll; a fixed-point state
+ * variable filter fed the same audio falls into exactly the same state
+ * within a few thousand samples, which segment_done() checks.
+ */
+static void split_job(struct job *job){
+	const uint64_t frames = job->in->wav.frames;
+	const unsigned channels = job->in->wav.channels;
+	uint64_t len = seg_frames && !job->stem ? seg_frames : frames;
+	unsigned i, c;
+
+	job->segs = frames > len ? (unsigned)((frames + len - 1) / len) : 1;
+	if (job->stem)
+		// Mixing from a stem has no state to carry: any split is exact.
+		job->segs = frames / chunk > workers ? workers : 1;
+	job->seg = calloc(job->segs, sizeof(*job->seg));
+	len = (frames + job->segs - 1) / job->segs;
+
+	for (i = 0; i < job->segs; i++) {
+		struct segment *sg = &job->seg[i];
+
+		sg->job = job;
+		sg->start = i * len;
+		sg->end = i + 1 < job->segs ? sg->start + len : frames;
+		sg->pos = sg->counted = sg->start;
+		sg->exact = i == 0 || job->stem;
+		sg->saved = now_s();
+		if (job->stem)
+			continue;
+
+		if (!sg->exact)
+			sg->pos = sg->start > preroll ? sg->start - preroll : 0;
+		sg->filter = malloc(channels * sizeof(struct wah_engine));
+		sg->entry = calloc(channels, sizeof(struct wah_engine));
+		for (c = 0; c < channels; c++) {
+			wah_engine_init(&sg->filter[c], &job->p);
+			wah_engine_set_cycles(&sg->filter[c], 1);
+			wah_engine_seek(&sg->filter[c], sg->pos);
+		}
+	}
+}
+
+static int settle(struct wah_pool *pool, struct job *job, int *ok);
+
+/*
+ * start_job() - Open the next job that still has something to render
+ * and queue the first chunk of each of its segments.
+ *
+ * Renders found in the cache are served on the spot; a job whose renders
+ * are all cached never gets filtered at all. A job with a checkpoint
+ * queues its unfinished segments from where they got to.
+ */
+static void start_job(struct wah_pool *pool){
+	uint8_t hdr[WAH_WAV_HEADER];
+	struct input *in;
+	struct job *job;
+	uint64_t k, m;
+	unsigned c, i, restored;
+	int finished, ok;
+
+	for (;;) {
+		k = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED);
+		if (k >= total_jobs / grid.mixSets || __atomic_load_n(&failed, __ATOMIC_RELAXED))
+			return;
+
+		in = &inputs[k / grid.filterSets];
+		job = calloc(1, sizeof(*job));
+		job->in = in;
+		job->out = calloc(grid.mixSets, sizeof(*job->out));
+		job->stemFd = -1;
+		job->ckptFd = -1;
+		pthread_mutex_init(&job->lock, NULL);
+		wah_params_default(&job->p);
+		grid_pick(&job->p, filter_regs, FILTER_REGS, k % grid.filterSets);
+
+		wah_wav_header(hdr, in->wav.rate, in->wav.channels, in->wav.frames);
+		for (m = 0; m < grid.mixSets; m++) {
+			struct output *o = &job->out[job->outputs];
+			struct wah_params p = job->p;
+			const uint32_t *regs = (const uint32_t *)&p;
+			const void *map;
+			size_t size;
+
+			grid_pick(&p, mix_regs, MIX_REGS, m);
+			snprintf(o->path, sizeof(o->path), "%s/%s-%u-%u-%u-%u-%u-%u-%u.wav", out_dir,
+				in->stem, regs[0], regs[1], regs[2], regs[3], regs[4], regs[5], regs[6]);
+
+			if (cache_dir) {
+				wah_cache_key(o->key, in->hash, &p);
+				map = wah_cache_get(&cache, o->key, &size);
+				if (map) {
+					int err = serve(o->path, map, size);
+
+					wah_cache_release(map, size);
+					if (err < 0) {
+						set_failed(o->path);
+						finish_job(pool, job, 0);
+						return;
+					}
+					__atomic_fetch_add(&done_jobs, 1, __ATOMIC_RELAXED);
+					__atomic_fetch_add(&done_samples, in->wav.frames * in->wav.channels,
+						__ATOMIC_RELAXED);
+					continue;
+				}
+			}
+
+			job->outputs++;
+			job->outHash = wah_hash64(&p, sizeof(p), job->outHash);
+			o->fd = -1;
+			o->eng = malloc(in->wav.channels * sizeof(struct wah_engine));
+			for (c = 0; c < in->wav.channels; c++)
+				wah_engine_init(&o->eng[c], &p);
+		}
+		if (job->outputs == 0) {
+			finish_job(NULL, job, 1);
+			continue;
+		}
+
+		stem_open(job);
+		split_job(job);
+		restored = ckpt_open(job);
+		for (m = 0; m < job->outputs; m++) {
+			struct output *o = &job->out[m];
+
+			// A resumed render keeps what its checkpoint says is written.
+			o->fd = open(o->path, restored ? O_WRONLY : O_WRONLY | O_CREAT | O_TRUNC, 0666);
+			if (o->fd < 0 || write_all(o->fd, hdr, sizeof(hdr), 0) < 0) {
+				set_failed(o->path);
+				finish_job(pool, job, 0);
+				return;
+			}
+		}
+		if (restored && job->stemFd >= 0) {
+			// The stem's first part went with the interrupted run.
+			stem_close(job, 0);
+			job->stemFd = -1;
+		}
+		if (restored)
+			__atomic_fetch_add(&resumed, job->outputs, __ATOMIC_RELAXED);
+
+		pthread_mutex_lock(&job->lock);
+		for (i = 0; i < job->segs; i++) {
+			if (job->seg[i].done)
+				continue;
+			job->running++;
+			if (queue_chunk(pool, &job->seg[i]) < 0) {
+				job->running--;
+				break;
+			}
+		}
+		finished = settle(pool, job, &ok);
+		pthread_mutex_unlock(&job->lock);
+		if (!finished)
+			return;
+		finish_job(NULL, job, ok);
+	}
+}
+
+static void finish_job(struct wah_pool *pool, struct job *job, int ok){
+	unsigned m, i;
+
+	stem_close(job, ok);
+	ckpt_close(job, ok);
+	for (m = 0; m < job->outputs; m++) {
+		struct output *o = &job->out[m];
+
+		if (o->fd >= 0 && close(o->fd) < 0 && ok) {
+			set_failed(o->path);
+			ok = 0;
+		}
+		free(o->eng);
+	}
+	for (m = 0; ok && cache_dir && m < job->outputs; m++)
+		if (wah_cache_put(&cache, job->out[m].key, job->out[m].path) < 0)
+			printf("\nwarning: not caching %s: %s\n", job->out[m].path, strerror(errno));
+	if (ok)
+		__atomic_fetch_add(&done_jobs, job->outputs, __ATOMIC_RELAXED);
+	for (i = 0; i < job->segs; i++) {
+		free(job->seg[i].filter);
+		free(job->seg[i].entry);
+	}
+	pthread_mutex_destroy(&job->lock);
+	free(job->seg);
+	free(job->out);
+	free(job);
+	if (pool)
+		start_job(pool);
+}
+
+static int same_state(const struct wah_engine *a, const struct wah_engine *b, unsigned channels){
+	unsigned c;
+
+	for (c = 0; c < channels; c++)
+		if (a[c].lfo.acc != b[c].lfo.acc || a[c].lfo.dir != b[c].lfo.dir ||
+		    a[c].svf.yb != b[c].svf.yb || a[c].svf.yl != b[c].svf.yl)
+			return 0;
+	return 1;
+}
+
+/*
+ * verify() - Verify finished segments in order; repair any that are off.
+ *
+ * A segment whose filter state on reaching its start equals the state
+ * its predecessor ended in rendered exactly what a serial render would
+ * have. One that doesn't is rendered again from the predecessor's end
+ * state, overwriting its output. Called with job->lock held.
+ *
+ * Return: 1 once every segment is verified.
+ */
+static int verify(struct wah_pool *pool, struct job *job){
+	const unsigned channels = job->in->wav.channels;
+
+	while (job->verified < job->segs && job->seg[job->verified].done) {
+		struct segment *v = &job->seg[job->verified];
+		struct segment *prev = v - 1;
+
+		if (!v->exact && !same_state(prev->filter, v->entry, channels)) {
+			memcpy(v->filter, prev->filter, channels * sizeof(struct wah_engine));
+			v->pos = v->start;
+			v->exact = 1;
+			v->done = 0;
+			job->running++;
+			__atomic_fetch_add(&repairs, 1, __ATOMIC_RELAXED);
+			if (queue_chunk(pool, v) < 0)
+				job->running--;
+			break;
+		}
+		job->verified++;
+	}
+	return job->verified == job->segs;
+}
+
+/*
+ * settle() - Whether @job is finished: all of it verified, or, after a
+ * failure (*@ok 0), nothing of it running any more. Called with
+ * job->lock held.
+ */
+static int settle(struct wah_pool *pool, struct job *job, int *ok){
+	int finished = 0;
+
+	if (!__atomic_load_n(&failed, __ATOMIC_RELAXED))
+		finished = verify(pool, job);
+	// verify() fails the run if it can't queue a repair.
+	*ok = !__atomic_load_n(&failed, __ATOMIC_RELAXED);
+	return *ok ? finished : job->running == 0;
+}
+
+/*
+ * segment_done() - Account for a segment whose chain has ended; finish
+ * the job once all of it is verified, or once nothing runs after a
+ * failure.
+ */
+static void segment_done(struct wah_pool *pool, struct segment *sg){
+	struct job *job = sg->job;
+	int finished, ok;
+
+	pthread_mutex_lock(&job->lock);
+	sg->done = 1;
+	job->running--;
+	finished = settle(pool, job, &ok);
+	pthread_mutex_unlock(&job->lock);
+
+	if (finished)
+		finish_job(pool, job, ok);
+}
+
+/*
+ * render_chunk() - Render the next chunk of a segment, then queue the rest.
+ *
+ * The chunk is filtered once (or read from the stem) and mixed once per
+ * output. While prerolling only the filter runs.
+ */
+static void render_chunk(struct wah_pool *pool, void *arg, unsigned worker){
+	struct segment *sg = arg;
+	struct job *job = sg->job;
+	const struct wah_wav *w = &job->in->wav;
+	struct scratch *s = &scratch[worker];
+	const uint64_t until = sg->pos < sg->start ? sg->start : sg->end;
+	size_t n = until - sg->pos < chunk ? (size_t)(until - sg->pos) : chunk;
+	size_t bytes = n * w->channels * WAH_WAV_OUT_BYTES;
+	uint64_t m;
+	unsigned c;
+	int last;
+
+	wah_wav_decode(w, sg->pos, n, s->in);
+	for (c = 0; c < w->channels; c++) {
+		if (job->stem) {
+			s->mixWet[c] = job->stem + c * w->frames + sg->pos;
+			continue;
+		}
+		wah_engine_filter(&sg->filter[c], s->in[c], s->wet[c], n);
+		s->mixWet[c] = s->wet[c];
+		if (sg->pos >= sg->start && job->stemFd >= 0 &&
+		    !__atomic_load_n(&job->stemBad, __ATOMIC_RELAXED) &&
+		    write_all(job->stemFd, s->wet[c], n * sizeof(int32_t),
+				STEM_DATA + (c * w->frames + sg->pos) * sizeof(int32_t)) < 0) {
+			printf("\nwarning: not keeping stem %s: %s\n", job->stemPath, strerror(errno));
+			__atomic_store_n(&job->stemBad, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	if (sg->pos < sg->start) {
+		sg->pos += n;
+		if (sg->pos == sg->start)
+			memcpy(sg->entry, sg->filter, w->channels * sizeof(struct wah_engine));
+		if (queue_chunk(pool, sg) < 0)
+			segment_done(pool, sg);
+		return;
+	}
+
+	for (m = 0; m < job->outputs; m++) {
+		struct output *o = &job->out[m];
+
+		for (c = 0; c < w->channels; c++)
+			wah_engine_mix(&o->eng[c], s->in[c], s->mixWet[c], s->out[c], n);
+		wah_wav_encode((const int32_t *const *)s->out, w->channels, n, s->bytes);
+		if (write_all(o->fd, s->bytes, bytes,
+				WAH_WAV_HEADER + sg->pos * w->channels * WAH_WAV_OUT_BYTES) < 0) {
+			set_failed(o->path);
+			segment_done(pool, sg);
+			return;
+		}
+	}
+	sg->pos += n;
+	if (sg->pos > sg->counted) {
+		__atomic_fetch_add(&done_samples, (sg->pos - sg->counted) * w->channels *
+			job->outputs, __ATOMIC_RELAXED);
+		sg->counted = sg->pos;
+	}
+	last = sg->pos == sg->end;
+	// A segment done before its first checkpoint is cheaper to redo
+	// than to sync.
+	if (ckpt_s > 0 && (last ? sg->seq > 0 : now_s() - sg->saved >= ckpt_s))
+		ckpt_save(sg, worker, last);
+
+	if (last || __atomic_load_n(&failed, __ATOMIC_RELAXED) || queue_chunk(pool, sg) < 0)
+		segment_done(pool, sg);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Driver                                                                */
+/*-----------------------------------------------------------------------*/
+static void usage(const char *prog){
+	printf("usage: %s [-j threads] [-c chunk] [-S seconds] [-P ms] [-o dir] [-s stem_dir]\n", prog);
+	printf("       [-k seconds] [-C cache_dir [-L MB]] [-q] manifest\n");
+	printf("  -j  worker threads (default: one per CPU)\n");
+	printf("  -c  frames per task (default: %d)\n", RENDER_CHUNK);
+	printf("  -S  split inputs into segments of this many seconds that render in\n");
+	printf("      parallel (default: %d, 0 to render each input in one piece)\n", RENDER_SEGMENT_S);
+	printf("  -P  filter preroll before each segment in ms (default: %d)\n", RENDER_PREROLL_MS);
+	printf("  -o  output directory (overrides the manifest)\n");
+	printf("  -k  checkpoint each segment every this many seconds, so an interrupted\n");
+	printf("      run resumes where it stopped when started again with -k (default: off)\n");
+	printf("  -s  keep filtered (wet) stems in stem_dir and reuse them when only\n");
+	printf("      enable, volume or wetDry change\n");
+	printf("  -C  serve renders from, and add them to, the render cache in cache_dir\n");
+	printf("  -L  cache size limit in MB; least recently used renders are evicted\n");
+	printf("      (default: %d, 0 for no limit)\n", RENDER_CACHE_MB);
+	printf("  -q  no progress output\n");
+}
+
+int main(int argc, char **argv){
+	struct wah_pool pool;
+	const char *dir = NULL;
+	unsigned channels = 0, i, c, open;
+	uint64_t total_samples = 0, cache_mb = RENDER_CACHE_MB;
+	double t0, t;
+	int opt, quiet = 0;
+
+	while ((opt = getopt(argc, argv, "j:c:S:P:o:k:s:C:L:qh")) != -1) {
+		switch (opt) {
+		case 'j':
+			workers = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			chunk = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			seg_frames = strtoull(optarg, NULL, 0) * WAH_SAMPLE_RATE;
+			break;
+		case 'P':
+			preroll = strtoull(optarg, NULL, 0) * WAH_SAMPLE_RATE / 1000;
+			break;
+		case 'o':
+			dir = optarg;
+			break;
+		case 'k':
+			ckpt_s = strtod(optarg, NULL);
+			break;
+		case 's':
+			stem_dir = optarg;
+			break;
+		case 'C':
+			cache_dir = optarg;
+			break;
+		case 'L':
+			cache_mb = strtoull(optarg, NULL, 0);
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		exit(1);
+	}
+	if (chunk == 0) {
+		printf("chunk must be at least one frame\n");
+		exit(1);
+	}
+	if (workers == 0)
+		workers = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+
+	read_manifest(argv[optind]);
+	if (dir)
+		out_dir = dir;
+	if (cache_dir && wah_cache_open(&cache, cache_dir, cache_mb << 20) < 0) {
+		printf("failed to open cache %s: %s\n", cache_dir, strerror(errno));
+		exit(1);
+	}
+	open_inputs();
+	for (i = 0; i < input_count; i++) {
+		if (inputs[i].wav.channels > channels)
+			channels = inputs[i].wav.channels;
+		total_samples += inputs[i].wav.frames * inputs[i].wav.channels;
+	}
+	total_jobs = input_count * grid.filterSets * grid.mixSets;
+	total_samples *= grid.filterSets * grid.mixSets;
+
+	scratch = calloc(workers, sizeof(*scratch));
+	for (i = 0; i < workers; i++) {
+		scratch[i].in = malloc(channels * sizeof(int32_t *));
+		scratch[i].wet = malloc(channels * sizeof(int32_t *));
+		scratch[i].out = malloc(channels * sizeof(int32_t *));
+		scratch[i].mixWet = malloc(channels * sizeof(int32_t *));
+		for (c = 0; c < channels; c++) {
+			scratch[i].in[c] = malloc(chunk * sizeof(int32_t));
+			scratch[i].wet[c] = malloc(chunk * sizeof(int32_t));
+			scratch[i].out[c] = malloc(chunk * sizeof(int32_t));
+		}
+		scratch[i].bytes = malloc(chunk * channels * WAH_WAV_OUT_BYTES);
+		scratch[i].ckpt = malloc(ckpt_slot_size(channels));
+	}
+
+	if (wah_pool_start(&pool, workers) < 0) {
+		printf("failed to start %u workers: %s\n", workers, strerror(errno));
+		exit(1);
+	}
+	if (!quiet)
+		printf("%llu renders (%u inputs x %llu filter x %llu mix settings) on %u threads\n",
+			(unsigned long long)total_jobs, input_count,
+			(unsigned long long)grid.filterSets, (unsigned long long)grid.mixSets, workers);
+	fflush(stdout);
+
+	t0 = now_s();
+	open = workers * RENDER_OPEN_PER_WORKER;
+	for (i = 0; i < open && i < total_jobs / grid.mixSets; i++)
+		start_job(&pool);
+
+	while (!wah_pool_wait(&pool, RENDER_PROGRESS_MS)) {
+		uint64_t samples = __atomic_load_n(&done_samples, __ATOMIC_RELAXED);
+		uint64_t kept = __atomic_load_n(&resumed_samples, __ATOMIC_RELAXED);
+		double rate;
+
+		if (quiet)
+			continue;
+		t = now_s() - t0;
+		rate = samples / t;
+		samples += kept;
+		fprintf(stderr, "\r%5.1f%%  %llu/%llu renders  %7.2f Msamples/s  eta %.0fs   ",
+			total_samples ? 100.0 * samples / total_samples : 100.0,
+			(unsigned long long)__atomic_load_n(&done_jobs, __ATOMIC_RELAXED),
+			(unsigned long long)total_jobs, rate * 1e-6,
+			rate > 0 ? (total_samples - samples) / rate : 0.0);
+	}
+	t = now_s() - t0;
+	wah_pool_stop(&pool);
+
+	if (!quiet) {
+		fprintf(stderr, "\r%78s\r", "");
+		printf("%llu renders, %.1f Msamples in %.2fs: %.2f Msamples/s (%.1fx real time), %llu steals\n",
+			(unsigned long long)done_jobs, done_samples * 1e-6, t,
+			done_samples / t * 1e-6, done_samples / t / WAH_SAMPLE_RATE,
+			(unsigned long long)pool.steals);
+		if (repairs)
+			printf("%llu segments re-rendered after their preroll had not converged\n",
+				(unsigned long long)repairs);
+		if (resumed)
+			printf("%llu renders resumed from checkpoints, %.1f Msamples kept\n",
+				(unsigned long long)resumed, resumed_samples * 1e-6);
+		if (stem_dir)
+			printf("stems: %llu reused, %llu written\n",
+				(unsigned long long)stems_used, (unsigned long long)stems_written);
+		if (cache_dir)
+			printf("cache: %llu hits, %llu misses, %llu evicted, %.1f MB\n",
+				(unsigned long long)cache.hits, (unsigned long long)cache.misses,
+				(unsigned long long)cache.evictions, cache.used / 1048576.0);
+	}
+	if (cache_dir)
+		wah_cache_close(&cache);
+
+	for (i = 0; i < input_count; i++)
+		wah_wav_close(&inputs[i].wav);
+	wah_cycles_free();
+	return failed ? 1 : 0;
+}
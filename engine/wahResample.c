@@ -0,0 +1,259 @@
+/*-------------------------------------------------------------------------
+ * Description:  Streaming polyphase sample rate converter.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#include "wahResample.h"
+
+/* Cutoff as a fraction of the lower Nyquist frequency: the transition
+ * band straddles it, so only the top of the band can alias              */
+#define RESAMPLE_ROLLOFF 0.95
+/* Kaiser window shape: about 80 dB stopband                            */
+#define RESAMPLE_BETA 8.0
+
+static uint32_t gcd(uint32_t a, uint32_t b){
+	while (b) {
+		uint32_t t = a % b;
+
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* Zeroth order modified Bessel function of the first kind              */
+static double bessel_i0(double x){
+	double sum = 1, term = 1;
+	unsigned k;
+
+	for (k = 1; k < 64 && term > sum * 1e-17; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+/*
+ * design_bank() - Fill @r->coef with the polyphase bank.
+ *
+ * The prototype is up * taps points long at the upsampled rate, centred
+ * on point up * taps / 2. Phase p, tap j is prototype point p + j * up;
+ * taps are stored reversed and each phase is scaled to unity DC gain.
+ */
+static void design_bank(struct wah_resample *r)
+{
+	const unsigned up = r->up, taps = r->taps;
+	const double centre = up * taps / 2.0;
+	const double fc = 0.5 * RESAMPLE_ROLLOFF / (up > r->down ? up : r->down);
+	const double norm = bessel_i0(RESAMPLE_BETA);
+	unsigned p, j;
+
+	for (p = 0; p < up; p++) {
+		float *c = r->coef + (size_t)p * taps;
+		double sum = 0;
+
+		for (j = 0; j < taps; j++) {
+			const double t = p + (double)j * up - centre, u = t / centre;
+			double h = 2 * fc;
+
+			if (t != 0)
+				h = sin(2 * M_PI * fc * t) / (M_PI * t);
+			h *= u * u < 1 ? bessel_i0(RESAMPLE_BETA * sqrt(1 - u * u)) / norm : 0;
+			c[taps - 1 - j] = (float)h;
+			sum += h;
+		}
+		for (j = 0; j < taps; j++)
+			c[j] = (float)(c[j] / sum);
+	}
+}
+
+/*
+ * wah_resample_init() - Design the bank and reset a converter for
+ * @channels channels from @from Hz to @to Hz.
+ *
+ * Return: 0 on success, -1 with errno set (EINVAL for a ratio that
+ * doesn't reduce to factors of WAH_RESAMPLE_FACTOR_MAX or less).
+ */
+int wah_resample_init(struct wah_resample *r, unsigned channels, uint32_t from, uint32_t to)
+{
+	const uint32_t g = from && to ? gcd(from, to) : 1;
+	unsigned p, c;
+
+	memset(r, 0, sizeof(*r));
+	if (channels == 0 || from == 0 || to == 0 ||
+	    to / g > WAH_RESAMPLE_FACTOR_MAX || from / g > WAH_RESAMPLE_FACTOR_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	r->from = from;
+	r->to = to;
+	r->channels = channels;
+	r->up = to / g;
+	r->down = from / g;
+	// Decimating narrows the passband, so the filter needs to be longer
+	// by the same factor for the same transition band.
+	r->taps = WAH_RESAMPLE_TAPS;
+	if (r->down > r->up)
+		r->taps = (unsigned)(WAH_RESAMPLE_TAPS * r->down / r->up + 7) & ~7u;
+
+	r->coef = aligned_alloc(32, (size_t)r->up * r->taps * sizeof(float));
+	r->next = malloc(r->up * sizeof(uint32_t));
+	r->adv = malloc(r->up * sizeof(uint32_t));
+	r->hist = calloc(channels, sizeof(float *));
+	if (r->coef == NULL || r->next == NULL || r->adv == NULL || r->hist == NULL)
+		goto nomem;
+	for (c = 0; c < channels; c++) {
+		r->hist[c] = malloc((r->taps - 1 + WAH_RESAMPLE_BLOCK) * sizeof(float));
+		if (r->hist[c] == NULL)
+			goto nomem;
+	}
+
+	design_bank(r);
+	for (p = 0; p < r->up; p++) {
+		r->next[p] = (p + r->down) % r->up;
+		r->adv[p] = (p + r->down) / r->up;
+	}
+	wah_resample_reset(r);
+	return 0;
+
+nomem:
+	wah_resample_free(r);
+	errno = ENOMEM;
+	return -1;
+}
+
+void wah_resample_free(struct wah_resample *r)
+{
+	unsigned c;
+
+	for (c = 0; r->hist && c < r->channels; c++)
+		free(r->hist[c]);
+	free(r->hist);
+	free(r->coef);
+	free(r->next);
+	free(r->adv);
+	memset(r, 0, sizeof(*r));
+}
+
+/*
+ * wah_resample_reset() - Back to silence at the start of a stream.
+ *
+ * The first output is centred on the first input frame: its window
+ * starts taps / 2 frames into the history, which is taps - 1 frames of
+ * silence ahead of the input.
+ */
+void wah_resample_reset(struct wah_resample *r)
+{
+	unsigned c;
+
+	for (c = 0; c < r->channels; c++)
+		memset(r->hist[c], 0, (r->taps - 1) * sizeof(float));
+	r->phase = 0;
+	r->pos = r->taps / 2;
+}
+
+/*
+ * wah_resample_max_out() - Most output frames for @n input frames.
+ */
+size_t wah_resample_max_out(const struct wah_resample *r, size_t n)
+{
+	return (n * r->up + r->down - 1) / r->down + 1;
+}
+
+/*
+ * wah_resample_tail() - Frames of silence that push a whole stream out.
+ */
+unsigned wah_resample_tail(const struct wah_resample *r)
+{
+	return r->taps / 2 + 1;
+}
+
+/*
+ * wah_resample_length() - Length of @frames frames at @from Hz once
+ * converted to @to Hz.
+ */
+uint64_t wah_resample_length(uint64_t frames, uint32_t from, uint32_t to)
+{
+	return (frames * to + from / 2) / from;
+}
+
+/* @taps is a multiple of 8 and @c is 32-byte aligned                    */
+static inline float dot(const float *c, const float *x, unsigned taps){
+#if defined(__AVX2__) && defined(__FMA__)
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	__m128 s;
+	unsigned j;
+
+	for (j = 0; j + 16 <= taps; j += 16) {
+		s0 = _mm256_fmadd_ps(_mm256_load_ps(c + j), _mm256_loadu_ps(x + j), s0);
+		s1 = _mm256_fmadd_ps(_mm256_load_ps(c + j + 8), _mm256_loadu_ps(x + j + 8), s1);
+	}
+	if (j < taps)
+		s0 = _mm256_fmadd_ps(_mm256_load_ps(c + j), _mm256_loadu_ps(x + j), s0);
+	s0 = _mm256_add_ps(s0, s1);
+	s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_movehdup_ps(s));
+	return _mm_cvtss_f32(s);
+#else
+	float s = 0;
+	unsigned j;
+
+	for (j = 0; j < taps; j++)
+		s += c[j] * x[j];
+	return s;
+#endif
+}
+
+static inline int32_t to_sample(float v){
+	v += v < 0 ? -0.5f : 0.5f;
+	if (v >= 0x7fffff)
+		return 0x7fffff;
+	return v <= -0x800000 ? -0x800000 : (int32_t)v;
+}
+
+/*
+ * wah_resample_process() - Convert @n frames.
+ * @in: One buffer per channel.
+ * @out: One buffer per channel with room for wah_resample_max_out(@n).
+ *
+ * Return: Frames written to @out.
+ */
+size_t wah_resample_process(struct wah_resample *r, const int32_t *const *in, size_t n,
+	int32_t *const *out)
+{
+	const unsigned taps = r->taps;
+	size_t done, m, total = 0, pos = r->pos, k, i;
+	unsigned c, phase = r->phase;
+
+	for (done = 0; done < n; done += m) {
+		m = n - done < WAH_RESAMPLE_BLOCK ? n - done : WAH_RESAMPLE_BLOCK;
+
+		for (c = 0, k = 0; c < r->channels; c++) {
+			float *h = r->hist[c];
+			int32_t *o = out[c] + total;
+
+			for (i = 0; i < m; i++)
+				h[taps - 1 + i] = (float)in[c][done + i];
+			// Every channel walks the same phases from the same start.
+			phase = r->phase;
+			pos = r->pos;
+			for (k = 0; pos < m; k++) {
+				o[k] = to_sample(dot(r->coef + (size_t)phase * taps, h + pos, taps));
+				pos += r->adv[phase];
+				phase = r->next[phase];
+			}
+			memmove(h, h + m, (taps - 1) * sizeof(float));
+		}
+		r->phase = phase;
+		r->pos = pos - m;
+		total += k;
+	}
+	return total;
+}
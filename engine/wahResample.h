@@ -0,0 +1,75 @@
+/*-------------------------------------------------------------------------
+ * Description:  Streaming polyphase sample rate converter.
+ *
+ *               The engine runs at WAH_SAMPLE_RATE only, and getAudio.m
+ *               gets other material there by calling resample() on the
+ *               whole file. This converts a block at a time instead, so
+ *               the stream tools can take 44.1, 88.2 or 96 kHz input to
+ *               the engine and bring its output back without holding the
+ *               file.
+ *
+ *               The ratio is reduced to up/down (147/160 for 44.1 kHz to
+ *               48 kHz) and a Kaiser-windowed sinc of up * taps points is
+ *               designed at init and split into @up phases of @taps
+ *               coefficients, stored reversed so each output is one
+ *               contiguous dot product over the input history (AVX2 with
+ *               FMA when built for it). The phase sequence repeats, so the
+ *               phase step is a table lookup rather than a divide.
+ *
+ *               The filter's delay is taken out at init: output frame k
+ *               lines up with input time k * from / to, so a stream of n
+ *               frames converts to round(n * to / from) frames once
+ *               wah_resample_tail() frames of silence have been fed after
+ *               it. Samples are sfix24_En23 in int32_t on both sides, as
+ *               in the engine. Nothing is allocated after init.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_RESAMPLE_H
+#define WAH_RESAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Input frames converted per inner pass                                 */
+#define WAH_RESAMPLE_BLOCK 256
+/* Coefficients per phase when not decimating (a multiple of 8)          */
+#define WAH_RESAMPLE_TAPS 48
+/* Largest reduced up or down factor (bank of up * taps coefficients)    */
+#define WAH_RESAMPLE_FACTOR_MAX 1024
+
+/*
+ * struct wah_resample - Converter state.
+ * @from, @to: Rates (Hz).
+ * @up, @down: Reduced ratio.
+ * @taps: Coefficients per phase.
+ * @coef: @up phases of @taps coefficients, each reversed.
+ * @next: Phase after each phase.
+ * @adv: Input frames to advance after each phase.
+ * @hist: Per channel, @taps - 1 frames of history then one block.
+ * @phase: Phase of the next output.
+ * @pos: Start in @hist of the next output's window.
+ */
+struct wah_resample {
+	uint32_t from;
+	uint32_t to;
+	unsigned channels;
+	unsigned up;
+	unsigned down;
+	unsigned taps;
+	float *coef;
+	uint32_t *next;
+	uint32_t *adv;
+	float **hist;
+	unsigned phase;
+	size_t pos;
+};
+
+int wah_resample_init(struct wah_resample *r, unsigned channels, uint32_t from, uint32_t to);
+void wah_resample_free(struct wah_resample *r);
+void wah_resample_reset(struct wah_resample *r);
+size_t wah_resample_max_out(const struct wah_resample *r, size_t n);
+unsigned wah_resample_tail(const struct wah_resample *r);
+uint64_t wah_resample_length(uint64_t frames, uint32_t from, uint32_t to);
+size_t wah_resample_process(struct wah_resample *r, const int32_t *const *in, size_t n,
+	int32_t *const *out);
+
+#endif
@@ -0,0 +1,78 @@
+/*-------------------------------------------------------------------------
+ * Description:  SPSC slot ring: allocation and the futex sleep/wake path.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "wahRing.h"
+
+/*
+ * wah_ring_init() - Allocate @slots slots (rounded up to a power of two)
+ * of @size bytes (rounded up to a cache line).
+ *
+ * Return: 0 on success, -1 with errno set.
+ */
+int wah_ring_init(struct wah_ring *r, uint32_t slots, size_t size)
+{
+	uint32_t n = 1;
+
+	memset(r, 0, sizeof(*r));
+	if (slots == 0 || slots > (1u << 31) || size == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	while (n < slots)
+		n <<= 1;
+	size = (size + 63) & ~(size_t)63;
+	r->mem = aligned_alloc(64, n * size);
+	if (r->mem == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	// Touch every page now rather than on the first pass of the ring.
+	memset(r->mem, 0, n * size);
+	r->slots = n;
+	r->size = size;
+	return 0;
+}
+
+void wah_ring_free(struct wah_ring *r)
+{
+	free(r->mem);
+	memset(r, 0, sizeof(*r));
+}
+
+/*
+ * wah_ring_wait() - Sleep until the ring has a full slot (consumer).
+ * @timeoutNs: Give up after this long.
+ *
+ * Return: 1 if a slot is ready, 0 on timeout or a signal.
+ */
+int wah_ring_wait(struct wah_ring *r, uint64_t timeoutNs)
+{
+	struct timespec ts = { (time_t)(timeoutNs / 1000000000), (long)(timeoutNs % 1000000000) };
+	uint32_t head = r->tail;
+
+	if (wah_ring_read_slot(r))
+		return 1;
+	__atomic_store_n(&r->waiting, 1, __ATOMIC_SEQ_CST);
+	// A push between the check above and the sleep changes @head, and
+	// the kernel then returns at once instead of sleeping.
+	if (__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) == head)
+		syscall(SYS_futex, &r->head, FUTEX_WAIT_PRIVATE, head, &ts, NULL, 0);
+	__atomic_store_n(&r->waiting, 0, __ATOMIC_RELAXED);
+	return wah_ring_read_slot(r) != NULL;
+}
+
+/*
+ * wah_ring_wake() - Wake a consumer sleeping in wah_ring_wait().
+ */
+void wah_ring_wake(struct wah_ring *r)
+{
+	syscall(SYS_futex, &r->head, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
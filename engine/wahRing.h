@@ -0,0 +1,120 @@
+/*-------------------------------------------------------------------------
+ * Description:  Lock-free single-producer/single-consumer ring of
+ *               fixed-size slots, for handing audio blocks between an I/O
+ *               thread and the DSP thread.
+ *
+ *               The producer fills the slot wah_ring_write_slot() hands
+ *               it in place and publishes it with wah_ring_push(); the
+ *               consumer reads wah_ring_read_slot() in place and frees it
+ *               with wah_ring_pop(). Neither side ever waits on the other,
+ *               copies a block or enters the kernel: a full or empty ring
+ *               shows up as NULL, and what to do about it (drop the block,
+ *               play silence) is the caller's decision. Each side keeps
+ *               its own index on its own cache line plus a cached copy of
+ *               the other's, so the lines only move when the cached copy
+ *               runs out.
+ *
+ *               A consumer with nothing else to do can sleep in
+ *               wah_ring_wait() (a futex on the producer's index). The
+ *               producer then pays for one system call per push to wake
+ *               it, and only while it is asleep.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_RING_H
+#define WAH_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * struct wah_ring - A ring of @slots slots of @size bytes.
+ * @head: Slots pushed so far (producer).
+ * @tailSeen: Producer's copy of @tail.
+ * @waiting: Set while the consumer sleeps on @head.
+ * @tail: Slots popped so far (consumer).
+ * @headSeen: Consumer's copy of @head.
+ * @slots: Slot count, a power of two.
+ * @size: Bytes per slot, a multiple of 64.
+ * @mem: The slots.
+ *
+ * The indices run freely and wrap at 2^32; @head - @tail is the fill.
+ */
+struct wah_ring {
+	uint32_t head __attribute__((aligned(64)));
+	uint32_t tailSeen;
+	uint32_t waiting;
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t headSeen;
+	uint32_t slots __attribute__((aligned(64)));
+	size_t size;
+	uint8_t *mem;
+};
+
+int wah_ring_init(struct wah_ring *r, uint32_t slots, size_t size);
+void wah_ring_free(struct wah_ring *r);
+int wah_ring_wait(struct wah_ring *r, uint64_t timeoutNs);
+void wah_ring_wake(struct wah_ring *r);
+
+/*
+ * wah_ring_write_slot() - The next free slot (producer).
+ *
+ * Return: The slot, or NULL if the ring is full.
+ */
+static inline void *wah_ring_write_slot(struct wah_ring *r)
+{
+	if (r->head - r->tailSeen == r->slots) {
+		r->tailSeen = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+		if (r->head - r->tailSeen == r->slots)
+			return NULL;
+	}
+	return r->mem + (size_t)(r->head & (r->slots - 1)) * r->size;
+}
+
+/*
+ * wah_ring_push() - Publish the slot from wah_ring_write_slot() (producer).
+ *
+ * Sequentially consistent against the consumer's @waiting flag, so a
+ * consumer going to sleep either sees the new slot or gets woken.
+ */
+static inline void wah_ring_push(struct wah_ring *r)
+{
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&r->waiting, __ATOMIC_SEQ_CST))
+		wah_ring_wake(r);
+}
+
+/*
+ * wah_ring_read_slot() - The oldest full slot (consumer).
+ *
+ * Return: The slot, or NULL if the ring is empty.
+ */
+static inline void *wah_ring_read_slot(struct wah_ring *r)
+{
+	if (r->headSeen == r->tail) {
+		r->headSeen = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		if (r->headSeen == r->tail)
+			return NULL;
+	}
+	return r->mem + (size_t)(r->tail & (r->slots - 1)) * r->size;
+}
+
+/*
+ * wah_ring_pop() - Hand the slot from wah_ring_read_slot() back (consumer).
+ */
+static inline void wah_ring_pop(struct wah_ring *r)
+{
+	__atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * wah_ring_fill() - Full slots, as the consumer sees them.
+ *
+ * The consumer may wah_ring_pop() that many slots without reading them,
+ * e.g. to drop a backlog.
+ */
+static inline uint32_t wah_ring_fill(struct wah_ring *r)
+{
+	r->headSeen = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	return r->headSeen - r->tail;
+}
+
+#endif
@@ -0,0 +1,276 @@
+/*-------------------------------------------------------------------------
+ * Description:  Quarter-wave sine table of the F1 coefficient generator.
+ *
+ *               Copied from Look_Up_Table_data in
+ *               Quartus/ip/wahWahEffect/Sine_HDL_Optimized.vhd (sfix67_En48,
+ *               entry k = sin(2*pi*k/4096)). Kept verbatim rather than
+ *               recomputed, because libm rounding differs from the HDL
+ *               Coder table in the last bit for a handful of entries.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_SINE_TABLE_H
+#define WAH_SINE_TABLE_H
+
+#include <stdint.h>
+
+#define WAH_SINE_TABLE_SIZE 1024
+
+static const int64_t wah_sine_table[WAH_SINE_TABLE_SIZE] = {
+	0LL, 431777037209LL, 863553058405LL, 1295327047577LL,
+	1727097988720LL, 2158864865834LL, 2590626662931LL, 3022382364033LL,
+	3454130953177LL, 3885871414417LL, 4317602731827LL, 4749323889500LL,
+	5181033871556LL, 5612731662138LL, 6044416245421LL, 6476086605608LL,
+	6907741726938LL, 7339380593684LL, 7771002190159LL, 8202605500715LL,
+	8634189509748LL, 9065753201699LL, 9497295561057LL, 9928815572361LL,
+	10360312220203LL, 10791784489229LL, 11223231364145LL, 11654651829712LL,
+	12086044870759LL, 12517409472174LL, 12948744618915LL, 13380049296010LL,
+	13811322488556LL, 14242563181726LL, 14673770360770LL, 15104943011014LL,
+	15536080117868LL, 15967180666825LL, 16398243643463LL, 16829268033451LL,
+	17260252822544LL, 17691196996596LL, 18122099541552LL, 18552959443458LL,
+	18983775688458LL, 19414547262800LL, 19845273152836LL, 20275952345028LL,
+	20706583825946LL, 21137166582272LL, 21567699600803LL, 21998181868453LL,
+	22428612372257LL, 22858990099369LL, 23289314037069LL, 23719583172764LL,
+	24149796493988LL, 24579952988408LL, 25010051643825LL, 25440091448174LL,
+	25870071389531LL, 26299990456111LL, 26729847636273LL, 27159641918521LL,
+	27589372291508LL, 28019037744037LL, 28448637265064LL, 28878169843700LL,
+	29307634469212LL, 29737030131029LL, 30166355818742LL, 30595610522106LL,
+	31024793231043LL, 31453902935644LL, 31882938626174LL, 32311899293069LL,
+	32740783926944LL, 33169591518591LL, 33598321058986LL, 34026971539286LL,
+	34455541950835LL, 34884031285166LL, 35312438534001LL, 35740762689257LL,
+	36169002743046LL, 36597157687678LL, 37025226515663LL, 37453208219713LL,
+	37881101792747LL, 38308906227889LL, 38736620518474LL, 39164243658049LL,
+	39591774640376LL, 40019212459432LL, 40446556109416LL, 40873804584746LL,
+	41300956880066LL, 41728011990245LL, 42154968910381LL, 42581826635803LL,
+	43008584162074LL, 43435240484992LL, 43861794600593LL, 44288245505155LL,
+	44714592195197LL, 45140833667484LL, 45566968919029LL, 45992996947095LL,
+	46418916749196LL, 46844727323102LL, 47270427666840LL, 47696016778695LL,
+	48121493657216LL, 48546857301213LL, 48972106709766LL, 49397240882221LL,
+	49822258818197LL, 50247159517586LL, 50671941980554LL, 51096605207548LL,
+	51521148199294LL, 51945569956802LL, 52369869481366LL, 52794045774569LL,
+	53218097838282LL, 53642024674670LL, 54065825286192LL, 54489498675605LL,
+	54913043845964LL, 55336459800627LL, 55759745543254LL, 56182900077814LL,
+	56605922408583LL, 57028811540148LL, 57451566477412LL, 57874186225589LL,
+	58296669790217LL, 58719016177149LL, 59141224392563LL, 59563293442964LL,
+	59985222335182LL, 60407010076378LL, 60828655674043LL, 61250158136006LL,
+	61671516470431LL, 62092729685820LL, 62513796791018LL, 62934716795213LL,
+	63355488707941LL, 63776111539084LL, 64196584298876LL, 64616905997904LL,
+	65037075647110LL, 65457092257795LL, 65876954841619LL, 66296662410605LL,
+	66716213977140LL, 67135608553979LL, 67554845154247LL, 67973922791438LL,
+	68392840479422LL, 68811597232447LL, 69230192065136LL, 69648623992496LL,
+	70066892029916LL, 70484995193171LL, 70902932498423LL, 71320702962227LL,
+	71738305601527LL, 72155739433664LL, 72573003476376LL, 72990096747801LL,
+	73407018266478LL, 73823767051350LL, 74240342121767LL, 74656742497488LL,
+	75072967198682LL, 75489015245932LL, 75904885660238LL, 76320577463015LL,
+	76736089676102LL, 77151421321757LL, 77566571422665LL, 77981539001938LL,
+	78396323083117LL, 78810922690175LL, 79225336847519LL, 79639564579993LL,
+	80053604912878LL, 80467456871898LL, 80881119483219LL, 81294591773453LL,
+	81707872769660LL, 82120961499350LL, 82533856990485LL, 82946558271481LL,
+	83359064371214LL, 83771374319016LL, 84183487144683LL, 84595401878472LL,
+	85007117551109LL, 85418633193787LL, 85829947838171LL, 86241060516396LL,
+	86651970261075LL, 87062676105298LL, 87473177082634LL, 87883472227135LL,
+	88293560573336LL, 88703441156261LL, 89113113011420LL, 89522575174816LL,
+	89931826682945LL, 90340866572799LL, 90749693881868LL, 91158307648140LL,
+	91566706910110LL, 91974890706773LL, 92382858077633LL, 92790608062705LL,
+	93198139702513LL, 93605452038095LL, 94012544111007LL, 94419414963321LL,
+	94826063637631LL, 95232489177054LL, 95638690625231LL, 96044667026330LL,
+	96450417425050LL, 96855940866622LL, 97261236396808LL, 97666303061910LL,
+	98071139908767LL, 98475745984758LL, 98880120337807LL, 99284262016381LL,
+	99688170069496LL, 100091843546718LL, 100495281498163LL, 100898482974503LL,
+	101301447026966LL, 101704172707340LL, 102106659067970LL, 102508905161769LL,
+	102910910042212LL, 103312672763343LL, 103714192379775LL, 104115467946694LL,
+	104516498519860LL, 104917283155609LL, 105317820910856LL, 105718110843097LL,
+	106118152010411LL, 106517943471463LL, 106917484285505LL, 107316773512379LL,
+	107715810212518LL, 108114593446950LL, 108513122277301LL, 108911395765793LL,
+	109309412975251LL, 109707172969101LL, 110104674811375LL, 110501917566714LL,
+	110898900300367LL, 111295622078196LL, 111692081966674LL, 112088279032895LL,
+	112484212344568LL, 112879880970024LL, 113275283978216LL, 113670420438723LL,
+	114065289421750LL, 114459889998133LL, 114854221239339LL, 115248282217468LL,
+	115642072005256LL, 116035589676078LL, 116428834303948LL, 116821804963526LL,
+	117214500730111LL, 117606920679654LL, 117999063888752LL, 118390929434655LL,
+	118782516395264LL, 119173823849139LL, 119564850875494LL, 119955596554205LL,
+	120346059965811LL, 120736240191513LL, 121126136313178LL, 121515747413345LL,
+	121905072575220LL, 122294110882684LL, 122682861420291LL, 123071323273275LL,
+	123459495527548LL, 123847377269701LL, 124234967587013LL, 124622265567445LL,
+	125009270299648LL, 125395980872963LL, 125782396377422LL, 126168515903752LL,
+	126554338543377LL, 126939863388419LL, 127325089531701LL, 127710016066747LL,
+	128094642087789LL, 128478966689766LL, 128862988968322LL, 129246708019819LL,
+	129630122941326LL, 130013232830633LL, 130396036786243LL, 130778533907384LL,
+	131160723294001LL, 131542604046767LL, 131924175267079LL, 132305436057064LL,
+	132686385519577LL, 133067022758208LL, 133447346877281LL, 133827356981856LL,
+	134207052177732LL, 134586431571451LL, 134965494270296LL, 135344239382296LL,
+	135722666016227LL, 136100773281615LL, 136478560288736LL, 136856026148621LL,
+	137233169973058LL, 137609990874589LL, 137986487966519LL, 138362660362913LL,
+	138738507178603LL, 139114027529184LL, 139489220531019LL, 139864085301245LL,
+	140238620957768LL, 140612826619269LL, 140986701405207LL, 141360244435817LL,
+	141733454832118LL, 142106331715908LL, 142478874209773LL, 142851081437084LL,
+	143222952522001LL, 143594486589476LL, 143965682765254LL, 144336540175873LL,
+	144707057948671LL, 145077235211784LL, 145447071094148LL, 145816564725505LL,
+	146185715236399LL, 146554521758184LL, 146922983423023LL, 147291099363890LL,
+	147658868714572LL, 148026290609673LL, 148393364184614LL, 148760088575634LL,
+	149126462919796LL, 149492486354986LL, 149858158019915LL, 150223477054122LL,
+	150588442597977LL, 150953053792680LL, 151317309780266LL, 151681209703606LL,
+	152044752706407LL, 152407937933219LL, 152770764529430LL, 153133231641275LL,
+	153495338415834LL, 153857084001035LL, 154218467545655LL, 154579488199324LL,
+	154940145112526LL, 155300437436599LL, 155660364323742LL, 156019924927011LL,
+	156379118400326LL, 156737943898470LL, 157096400577092LL, 157454487592708LL,
+	157812204102705LL, 158169549265342LL, 158526522239751LL, 158883122185940LL,
+	159239348264795LL, 159595199638081LL, 159950675468447LL, 160305774919423LL,
+	160660497155425LL, 161014841341758LL, 161368806644617LL, 161722392231085LL,
+	162075597269143LL, 162428420927665LL, 162780862376422LL, 163132920786086LL,
+	163484595328229LL, 163835885175328LL, 164186789500763LL, 164537307478822LL,
+	164887438284703LL, 165237181094515LL, 165586535085278LL, 165935499434929LL,
+	166284073322321LL, 166632255927226LL, 166980046430337LL, 167327444013269LL,
+	167674447858562LL, 168021057149682LL, 168367271071025LL, 168713088807915LL,
+	169058509546611LL, 169403532474303LL, 169748156779119LL, 170092381650125LL,
+	170436206277328LL, 170779629851673LL, 171122651565052LL, 171465270610303LL,
+	171807486181209LL, 172149297472504LL, 172490703679873LL, 172831703999955LL,
+	173172297630342LL, 173512483769585LL, 173852261617193LL, 174191630373636LL,
+	174530589240346LL, 174869137419721LL, 175207274115124LL, 175544998530887LL,
+	175882309872311LL, 176219207345670LL, 176555690158212LL, 176891757518161LL,
+	177227408634718LL, 177562642718062LL, 177897458979356LL, 178231856630745LL,
+	178565834885359LL, 178899392957314LL, 179232530061717LL, 179565245414664LL,
+	179897538233242LL, 180229407735536LL, 180560853140624LL, 180891873668583LL,
+	181222468540490LL, 181552636978423LL, 181882378205464LL, 182211691445699LL,
+	182540575924224LL, 182869030867141LL, 183197055501564LL, 183524649055619LL,
+	183851810758447LL, 184178539840205LL, 184504835532068LL, 184830697066231LL,
+	185156123675909LL, 185481114595343LL, 185805669059797LL, 186129786305564LL,
+	186453465569965LL, 186776706091350LL, 187099507109104LL, 187421867863644LL,
+	187743787596426LL, 188065265549939LL, 188386300967717LL, 188706893094331LL,
+	189027041175397LL, 189346744457576LL, 189666002188575LL, 189984813617150LL,
+	190303177993107LL, 190621094567303LL, 190938562591650LL, 191255581319116LL,
+	191572150003724LL, 191888267900559LL, 192203934265763LL, 192519148356544LL,
+	192833909431172LL, 193148216748984LL, 193462069570384LL, 193775467156848LL,
+	194088408770919LL, 194400893676216LL, 194712921137432LL, 195024490420336LL,
+	195335600791775LL, 195646251519677LL, 195956441873051LL, 196266171121988LL,
+	196575438537666LL, 196884243392349LL, 197192584959388LL, 197500462513227LL,
+	197807875329401LL, 198114822684535LL, 198421303856356LL, 198727318123681LL,
+	199032864766430LL, 199337943065623LL, 199642552303381LL, 199946691762928LL,
+	200250360728596LL, 200553558485821LL, 200856284321150LL, 201158537522241LL,
+	201460317377861LL, 201761623177895LL, 202062454213340LL, 202362809776311LL,
+	202662689160044LL, 202962091658892LL, 203261016568334LL, 203559463184969LL,
+	203857430806525LL, 204154918731854LL, 204451926260938LL, 204748452694891LL,
+	205044497335956LL, 205340059487513LL, 205635138454075LL, 205929733541293LL,
+	206223844055955LL, 206517469305992LL, 206810608600475LL, 207103261249619LL,
+	207395426564783LL, 207687103858475LL, 207978292444351LL, 208268991637214LL,
+	208559200753021LL, 208848919108884LL, 209138146023066LL, 209426880814988LL,
+	209715122805230LL, 210002871315530LL, 210290125668788LL, 210576885189068LL,
+	210863149201596LL, 211148917032765LL, 211434188010136LL, 211718961462439LL,
+	212003236719574LL, 212287013112615LL, 212570289973808LL, 212853066636575LL,
+	213135342435515LL, 213417116706407LL, 213698388786208LL, 213979158013057LL,
+	214259423726278LL, 214539185266379LL, 214818441975053LL, 215097193195182LL,
+	215375438270838LL, 215653176547283LL, 215930407370973LL, 216207130089556LL,
+	216483344051877LL, 216759048607979LL, 217034243109100LL, 217308926907683LL,
+	217583099357370LL, 217856759813006LL, 218129907630643LL, 218402542167536LL,
+	218674662782150LL, 218946268834160LL, 219217359684450LL, 219487934695117LL,
+	219757993229472LL, 220027534652042LL, 220296558328568LL, 220565063626013LL,
+	220833049912557LL, 221100516557603LL, 221367462931777LL, 221633888406926LL,
+	221899792356128LL, 222165174153683LL, 222430033175123LL, 222694368797210LL,
+	222958180397935LL, 223221467356524LL, 223484229053439LL, 223746464870375LL,
+	224008174190266LL, 224269356397285LL, 224530010876845LL, 224790137015600LL,
+	225049734201449LL, 225308801823535LL, 225567339272246LL, 225825345939218LL,
+	226082821217338LL, 226339764500741LL, 226596175184814LL, 226852052666199LL,
+	227107396342791LL, 227362205613741LL, 227616479879460LL, 227870218541614LL,
+	228123421003133LL, 228376086668206LL, 228628214942287LL, 228879805232094LL,
+	229130856945610LL, 229381369492086LL, 229631342282043LL, 229880774727270LL,
+	230129666240828LL, 230378016237052LL, 230625824131550LL, 230873089341207LL,
+	231119811284182LL, 231365989379917LL, 231611623049129LL, 231856711713820LL,
+	232101254797271LL, 232345251724050LL, 232588701920008LL, 232831604812283LL,
+	233073959829301LL, 233315766400778LL, 233557023957719LL, 233797731932421LL,
+	234037889758477LL, 234277496870771LL, 234516552705484LL, 234755056700096LL,
+	234993008293383LL, 235230406925421LL, 235467252037590LL, 235703543072570LL,
+	235939279474345LL, 236174460688204LL, 236409086160743LL, 236643155339867LL,
+	236876667674788LL, 237109622616028LL, 237342019615422LL, 237573858126117LL,
+	237805137602576LL, 238035857500575LL, 238266017277208LL, 238495616390886LL,
+	238724654301342LL, 238953130469626LL, 239181044358112LL, 239408395430496LL,
+	239635183151801LL, 239861406988371LL, 240087066407881LL, 240312160879333LL,
+	240536689873056LL, 240760652860714LL, 240984049315298LL, 241206878711137LL,
+	241429140523890LL, 241650834230554LL, 241871959309463LL, 242092515240288LL,
+	242312501504039LL, 242531917583068LL, 242750762961067LL, 242969037123072LL,
+	243186739555463LL, 243403869745964LL, 243620427183648LL, 243836411358935LL,
+	244051821763591LL, 244266657890737LL, 244480919234841LL, 244694605291727LL,
+	244907715558569LL, 245120249533900LL, 245332206717606LL, 245543586610931LL,
+	245754388716479LL, 245964612538211LL, 246174257581450LL, 246383323352882LL,
+	246591809360554LL, 246799715113879LL, 247007040123635LL, 247213783901965LL,
+	247419945962381LL, 247625525819765LL, 247830522990368LL, 248034936991810LL,
+	248238767343086LL, 248442013564563LL, 248644675177984LL, 248846751706466LL,
+	249048242674504LL, 249249147607970LL, 249449466034115LL, 249649197481570LL,
+	249848341480349LL, 250046897561846LL, 250244865258839LL, 250442244105491LL,
+	250639033637352LL, 250835233391355LL, 251030842905825LL, 251225861720472LL,
+	251420289376400LL, 251614125416100LL, 251807369383458LL, 252000020823753LL,
+	252192079283656LL, 252383544311236LL, 252574415455957LL, 252764692268680LL,
+	252954374301667LL, 253143461108576LL, 253331952244469LL, 253519847265807LL,
+	253707145730456LL, 253893847197683LL, 254079951228163LL, 254265457383974LL,
+	254450365228604LL, 254634674326944LL, 254818384245300LL, 255001494551383LL,
+	255184004814317LL, 255365914604637LL, 255547223494294LL, 255727931056648LL,
+	255908036866479LL, 256087540499979LL, 256266441534759LL, 256444739549848LL,
+	256622434125693LL, 256799524844162LL, 256976011288543LL, 257151893043546LL,
+	257327169695306LL, 257501840831378LL, 257675906040745LL, 257849364913815LL,
+	258022217042422LL, 258194462019828LL, 258366099440724LL, 258537128901231LL,
+	258707549998900LL, 258877362332714LL, 259046565503088LL, 259215159111870LL,
+	259383142762344LL, 259550516059227LL, 259717278608674LL, 259883430018278LL,
+	260048969897066LL, 260213897855509LL, 260378213505514LL, 260541916460432LL,
+	260705006335052LL, 260867482745610LL, 261029345309782LL, 261190593646690LL,
+	261351227376901LL, 261511246122428LL, 261670649506733LL, 261829437154723LL,
+	261987608692755LL, 262145163748637LL, 262302101951627LL, 262458422932433LL,
+	262614126323218LL, 262769211757596LL, 262923678870636LL, 263077527298862LL,
+	263230756680255LL, 263383366654250LL, 263535356861741LL, 263686726945081LL,
+	263837476548081LL, 263987605316014LL, 264137112895611LL, 264285998935066LL,
+	264434263084037LL, 264581904993644LL, 264728924316471LL, 264875320706567LL,
+	265021093819447LL, 265166243312094LL, 265310768842956LL, 265454670071951LL,
+	265597946660465LL, 265740598271355LL, 265882624568948LL, 266024025219042LL,
+	266164799888908LL, 266304948247289LL, 266444469964403LL, 266583364711941LL,
+	266721632163072LL, 266859271992438LL, 266996283876159LL, 267132667491833LL,
+	267268422518537LL, 267403548636825LL, 267538045528733LL, 267671912877777LL,
+	267805150368954LL, 267937757688743LL, 268069734525107LL, 268201080567491LL,
+	268331795506824LL, 268461879035524LL, 268591330847489LL, 268720150638108LL,
+	268848338104256LL, 268975892944294LL, 269102814858074LL, 269229103546936LL,
+	269354758713711LL, 269479780062720LL, 269604167299776LL, 269727920132184LL,
+	269851038268740LL, 269973521419738LL, 270095369296961LL, 270216581613689LL,
+	270337158084700LL, 270457098426263LL, 270576402356150LL, 270695069593624LL,
+	270813099859452LL, 270930492875897LL, 271047248366720LL, 271163366057187LL,
+	271278845674059LL, 271393686945603LL, 271507889601587LL, 271621453373279LL,
+	271734377993454LL, 271846663196389LL, 271958308717866LL, 272069314295173LL,
+	272179679667102LL, 272289404573954LL, 272398488757534LL, 272506931961158LL,
+	272614733929647LL, 272721894409335LL, 272828413148060LL, 272934289895176LL,
+	273039524401543LL, 273144116419534LL, 273248065703035LL, 273351372007442LL,
+	273454035089667LL, 273556054708132LL, 273657430622776LL, 273758162595052LL,
+	273858250387927LL, 273957693765885LL, 274056492494926LL, 274154646342568LL,
+	274252155077845LL, 274349018471309LL, 274445236295032LL, 274540808322603LL,
+	274635734329132LL, 274730014091250LL, 274823647387107LL, 274916633996375LL,
+	275008973700247LL, 275100666281439LL, 275191711524190LL, 275282109214261LL,
+	275371859138937LL, 275460961087030LL, 275549414848872LL, 275637220216325LL,
+	275724376982772LL, 275810884943127LL, 275896743893827LL, 275981953632838LL,
+	276066513959654LL, 276150424675295LL, 276233685582311LL, 276316296484783LL,
+	276398257188318LL, 276479567500054LL, 276560227228662LL, 276640236184340LL,
+	276719594178820LL, 276798301025365LL, 276876356538769LL, 276953760535362LL,
+	277030512833003LL, 277106613251088LL, 277182061610544LL, 277256857733835LL,
+	277331001444957LL, 277404492569444LL, 277477330934364LL, 277549516368320LL,
+	277621048701455LL, 277691927765445LL, 277762153393504LL, 277831725420386LL,
+	277900643682381LL, 277968908017317LL, 278036518264561LL, 278103474265021LL,
+	278169775861142LL, 278235422896911LL, 278300415217853LL, 278364752671035LL,
+	278428435105065LL, 278491462370092LL, 278553834317807LL, 278615550801442LL,
+	278676611675774LL, 278737016797119LL, 278796766023338LL, 278855859213837LL,
+	278914296229562LL, 278972076933006LL, 279029201188206LL, 279085668860742LL,
+	279141479817740LL, 279196633927873LL, 279251131061356LL, 279304971089954LL,
+	279358153886975LL, 279410679327274LL, 279462547287256LL, 279513757644868LL,
+	279564310279609LL, 279614205072523LL, 279663441906203LL, 279712020664789LL,
+	279759941233972LL, 279807203500989LL, 279853807354628LL, 279899752685226LL,
+	279945039384668LL, 279989667346391LL, 280033636465381LL, 280076946638174LL,
+	280119597762857LL, 280161589739068LL, 280202922467996LL, 280243595852381LL,
+	280283609796515LL, 280322964206240LL, 280361658988952LL, 280399694053599LL,
+	280437069310680LL, 280473784672248LL, 280509840051908LL, 280545235364818LL,
+	280579970527690LL, 280614045458788LL, 280647460077931LL, 280680214306491LL,
+	280712308067394LL, 280743741285120LL, 280774513885704LL, 280804625796736LL,
+	280834076947358LL, 280862867268270LL, 280890996691725LL, 280918465151531LL,
+	280945272583053LL, 280971418923211LL, 280996904110479LL, 281021728084889LL,
+	281045890788027LL, 281069392163036LL, 281092232154615LL, 281114410709019LL,
+	281135927774060LL, 281156783299106LL, 281176977235083LL, 281196509534472LL,
+	281215380151311LL, 281233589041196LL, 281251136161281LL, 281268021470274LL,
+	281284244928443LL, 281299806497613LL, 281314706141165LL, 281328943824041LL,
+	281342519512736LL, 281355433175306LL, 281367684781364LL, 281379274302080LL,
+	281390201710184LL, 281400466979963LL, 281410070087260LL, 281419011009479LL,
+	281427289725581LL, 281434906216086LL, 281441860463071LL, 281448152450171LL,
+	281453782162583LL, 281458749587057LL, 281463054711906LL, 281466697526999LL,
+	281469678023765LL, 281471996195188LL, 281473652035816LL, 281474645541751LL,
+};
+
+#endif
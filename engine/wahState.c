@@ -0,0 +1,164 @@
+/*-------------------------------------------------------------------------
+ * Description:  Engine state snapshots.
+ *-------------------------------------------------------------------------*/
+#include <string.h>
+
+#include "wahState.h"
+
+/* Cursor over a blob being written or read                              */
+struct cursor {
+	uint8_t *p;
+	const uint8_t *end;
+	int bad;
+};
+
+static void put(struct cursor *c, uint64_t v, unsigned bytes)
+{
+	unsigned i;
+
+	if (c->end - c->p < (ptrdiff_t)bytes) {
+		c->bad = 1;
+		return;
+	}
+	for (i = 0; i < bytes; i++)
+		*c->p++ = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t get(struct cursor *c, unsigned bytes)
+{
+	uint64_t v = 0;
+	unsigned i;
+
+	if (c->end - c->p < (ptrdiff_t)bytes) {
+		c->bad = 1;
+		return 0;
+	}
+	for (i = 0; i < bytes; i++)
+		v |= (uint64_t)*c->p++ << (8 * i);
+	return v;
+}
+
+static uint32_t fnv1a(const uint8_t *p, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	while (len--)
+		h = (h ^ *p++) * 16777619u;
+	return h;
+}
+
+static void put_ramp(struct cursor *c, const struct wah_ramp *r)
+{
+	put(c, (uint64_t)r->cur, 8);
+	put(c, (uint64_t)r->target, 8);
+	put(c, (uint64_t)r->inc, 8);
+	put(c, (uint64_t)r->coef, 8);
+	put(c, r->left, 4);
+	put(c, r->shape, 1);
+}
+
+static void get_ramp(struct cursor *c, struct wah_ramp *r)
+{
+	r->cur = (int64_t)get(c, 8);
+	r->target = (int64_t)get(c, 8);
+	r->inc = (int64_t)get(c, 8);
+	r->coef = (int64_t)get(c, 8);
+	r->left = (uint32_t)get(c, 4);
+	r->shape = (uint32_t)get(c, 1);
+}
+
+/*
+ * wah_state_save() - Snapshot @eng into @buf.
+ * @len: Size of @buf; WAH_STATE_MAX is always enough.
+ *
+ * Return: Bytes written, or 0 if @buf is too small.
+ */
+size_t wah_state_save(const struct wah_engine *eng, uint8_t *buf, size_t len)
+{
+	struct cursor c = { buf, buf + len, 0 };
+	const uint32_t *regs = (const uint32_t *)&eng->params;
+	uint32_t i;
+
+	put(&c, WAH_STATE_MAGIC, 4);
+	put(&c, WAH_STATE_VERSION, 2);
+	put(&c, WAH_ENGINE_VERSION, 2);
+	put(&c, 0, 4);			// length and checksum, filled in below
+	put(&c, 0, 4);
+
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		put(&c, regs[i], 4);
+	put(&c, (uint64_t)eng->lfo.acc, 8);
+	put(&c, eng->lfo.dir != 0, 1);
+	put(&c, (uint64_t)eng->svf.yb, 8);
+	put(&c, (uint64_t)eng->svf.yl, 8);
+	put(&c, eng->rampShape, 1);
+	put(&c, eng->rampSamples, 4);
+	put(&c, (uint64_t)eng->rampCoef, 8);
+	put_ramp(&c, &eng->volume);
+	put_ramp(&c, &eng->wetDry);
+	put(&c, eng->events.count, 2);
+	for (i = 0; i < eng->events.count; i++) {
+		put(&c, eng->events.ev[i].offset, 4);
+		put(&c, eng->events.ev[i].param, 1);
+		put(&c, eng->events.ev[i].value, 4);
+	}
+	if (c.bad)
+		return 0;
+
+	len = c.p - buf;
+	c.p = buf + 8;
+	put(&c, len, 4);
+	put(&c, fnv1a(buf + 16, len - 16), 4);
+	return len;
+}
+
+/*
+ * wah_state_load() - Restore @eng from a wah_state_save() blob.
+ *
+ * @eng is only written if the blob is whole, from this format and from
+ * an engine that renders identically (same WAH_ENGINE_VERSION).
+ *
+ * Return: Bytes consumed, or -1 if the blob is unusable.
+ */
+int wah_state_load(struct wah_engine *eng, const uint8_t *buf, size_t len)
+{
+	struct cursor c = { (uint8_t *)buf, buf + len, 0 };
+	struct wah_engine e;
+	uint32_t *regs = (uint32_t *)&e.params;
+	uint32_t size, sum, i;
+
+	if (get(&c, 4) != WAH_STATE_MAGIC || get(&c, 2) != WAH_STATE_VERSION ||
+	    get(&c, 2) != WAH_ENGINE_VERSION)
+		return -1;
+	size = (uint32_t)get(&c, 4);
+	sum = (uint32_t)get(&c, 4);
+	if (c.bad || size < WAH_STATE_FIXED || size > len || fnv1a(buf + 16, size - 16) != sum)
+		return -1;
+	c.end = buf + size;
+
+	memset(&e, 0, sizeof(e));
+	for (i = 0; i < WAH_PARAM_COUNT; i++)
+		regs[i] = (uint32_t)get(&c, 4);
+	e.lfo.acc = (int64_t)get(&c, 8);
+	e.lfo.dir = (int32_t)get(&c, 1);
+	e.svf.yb = (int64_t)get(&c, 8);
+	e.svf.yl = (int64_t)get(&c, 8);
+	e.rampShape = (uint32_t)get(&c, 1);
+	e.rampSamples = (uint32_t)get(&c, 4);
+	e.rampCoef = (int64_t)get(&c, 8);
+	get_ramp(&c, &e.volume);
+	get_ramp(&c, &e.wetDry);
+	e.events.count = (uint32_t)get(&c, 2);
+	if (e.events.count > WAH_EVENT_MAX)
+		return -1;
+	for (i = 0; i < e.events.count; i++) {
+		e.events.ev[i].offset = (uint32_t)get(&c, 4);
+		e.events.ev[i].param = (uint32_t)get(&c, 1);
+		e.events.ev[i].value = (uint32_t)get(&c, 4);
+	}
+	if (c.bad || c.p != buf + size)
+		return -1;
+
+	*eng = e;
+	return (int)size;
+}
@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------------
+ * Description:  Engine state snapshots.
+ *
+ *               wah_state_save() writes everything a wah_engine carries
+ *               from one sample to the next (registers, Fc triangle, state
+ *               variable filter, ramps and pending events) into a compact
+ *               little-endian blob; wah_state_load() restores it, and the
+ *               engine then continues bit-exactly as the saved one would
+ *               have. Blobs don't depend on the host's endianness or
+ *               struct layout, so a render can move to another machine.
+ *
+ *               Layout (all fields little-endian):
+ *                 u32 magic "WAHS", u16 format version, u16 engine version,
+ *                 u32 length of the whole blob, u32 FNV-1a of the rest,
+ *                 7 x u32 registers, s64 acc, u8 dir, s64 yb, s64 yl,
+ *                 u8 ramp shape, u32 ramp samples, s64 ramp coefficient,
+ *                 2 x ramp (s64 cur, target, inc, coef; u32 left; u8 shape),
+ *                 u16 event count, count x (u32 offset, u8 param, u32 value)
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_STATE_H
+#define WAH_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahEngine.h"
+
+#define WAH_STATE_MAGIC 0x53484157	/* "WAHS" */
+#define WAH_STATE_VERSION 1
+
+/* Blob size without events, and the most any engine needs               */
+#define WAH_STATE_FIXED (16 + WAH_PARAM_COUNT * 4 + 9 + 16 + 13 + 2 * 37 + 2)
+#define WAH_STATE_MAX (WAH_STATE_FIXED + WAH_EVENT_MAX * 9)
+
+size_t wah_state_save(const struct wah_engine *eng, uint8_t *buf, size_t len);
+int wah_state_load(struct wah_engine *eng, const uint8_t *buf, size_t len);
+
+#endif
@@ -0,0 +1,418 @@
+/*-------------------------------------------------------------------------
+ * Description:  Streaming render of one recording in bounded memory.
+ *
+ *                 wahStream [-m uring|read|mmap] [-b frames] [-d depth] [-c] [-q]
+ *                           [-O factor | -f] [-R rate] [-l dB [-g dB] [-p]] in.wav
+ *                           out.wav [field=value ...]
+ *
+ *               Runs in.wav through the engine with the given register
+ *               values (createSimParams.m defaults otherwise) and writes
+ *               24-bit out.wav, using the streaming pipeline in wahPipe.c:
+ *               reads, the engine and writes overlap, and memory use is
+ *               fixed by the block size and depth however long the
+ *               recording is. -m picks the pipeline so the io_uring path
+ *               can be compared with plain reads and a mapped input; -c
+ *               drops the input from the page cache first, so the
+ *               comparison is against the disk rather than memory.
+ *
+ *               Input at another rate (44.1, 88.2, 96 kHz, ...) goes
+ *               through the polyphase converter in wahResample.c on its
+ *               way into the engine, and the engine's output is converted
+ *               back to the input rate, or to the rate given with -R, on
+ *               its way out. Both run block by block inside the pipeline
+ *               callback, so nothing more is buffered; getAudio.m instead
+ *               resamples the whole file first.
+ *
+ *               -O 2 or -O 4 runs the filter core oversampled
+ *               (wahOversample.c), for maxf settings too high for the
+ *               filter at 48 kHz. Its delay is taken out like the
+ *               limiter's.
+ *
+ *               -f renders with the float32 engine (wahFloat.c) instead
+ *               of the bit-exact one, all channels in one pass, for
+ *               previews; wahFloatCheck.c reports how far apart the two
+ *               are.
+ *
+ *               -l puts the lookahead limiter (wahLimit.c) after the
+ *               engine instead of normalizing in a second pass like
+ *               wahwah.m: the output stays under the given ceiling in dB
+ *               (true peak, or sample peak with -p), optionally driven
+ *               with -g dB of gain first. The limiter's delay is taken out
+ *               again, so the output lines up with the input.
+ *
+ * Build:        gcc -O3 -march=native -pthread -o wahStream wahStream.c wahPipe.c wahLimit.c
+ *                   wahResample.c wahOversample.c wahFloat.c wahWav.c wahEngine.c
+ *                   wahCycle.c -lm
+ *-------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wahEngine.h"
+#include "wahFloat.h"
+#include "wahLimit.h"
+#include "wahOversample.h"
+#include "wahPipe.h"
+#include "wahResample.h"
+#include "wahWav.h"
+
+/*
+ * struct stream - What the pipeline callback needs.
+ * @eng: One engine per channel.
+ * @engSkip: Oversampling delay still to drop from the engine output.
+ * @flt: Float32 engine for all channels, used instead of @eng; or NULL.
+ * @up: Converter from the input rate to the engine's, or NULL.
+ * @down: Converter from the engine's rate to the output rate, or NULL.
+ * @limit: Output limiter, or NULL.
+ * @skip: Limiter delay still to drop from the start of the output.
+ * @left: Output frames still to write.
+ * @tail: Input frames of silence that push everything held back out.
+ * @ch: Planar scratch at the input rate, one block (at least @tail).
+ * @mid: Planar scratch at the engine rate, for @up's output.
+ * @last: Planar scratch at the output rate, for @down's output.
+ * @at: Pointers past the dropped frames.
+ */
+struct stream {
+	const struct wah_wav *wav;
+	struct wah_os *eng;
+	size_t engSkip;
+	struct wah_float *flt;
+	struct wah_resample *up;
+	struct wah_resample *down;
+	struct wah_limit *limit;
+	size_t skip;
+	uint64_t left;
+	size_t tail;
+	int32_t **ch;
+	int32_t **mid;
+	int32_t **last;
+	const int32_t **at;
+	size_t frameBytes;
+};
+
+static double now_s(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * render_frames() - Run @n decoded frames in @s->ch through the stages
+ * and encode what comes out to @dst.
+ *
+ * Return: Bytes encoded.
+ */
+static size_t render_frames(struct stream *s, size_t n, uint8_t *dst){
+	int32_t **x = s->ch;
+	size_t drop;
+	unsigned c;
+
+	if (s->up) {
+		n = wah_resample_process(s->up, (const int32_t *const *)x, n, s->mid);
+		x = s->mid;
+	}
+	if (s->flt)
+		wah_float_process_s24(s->flt, (const int32_t *const *)x, x, n);
+	else
+		for (c = 0; c < s->wav->channels; c++)
+			wah_os_process(&s->eng[c], x[c], x[c], n);
+	if (s->engSkip) {
+		drop = s->engSkip < n ? s->engSkip : n;
+		s->engSkip -= drop;
+		n -= drop;
+		for (c = 0; c < s->wav->channels; c++)
+			memmove(x[c], x[c] + drop, n * sizeof(int32_t));
+	}
+	if (s->down) {
+		n = wah_resample_process(s->down, (const int32_t *const *)x, n, s->last);
+		x = s->last;
+	}
+	if (s->limit)
+		wah_limit_process(s->limit, (const int32_t *const *)x, x, n);
+
+	// Drop the limiter's delay and anything past the end.
+	drop = s->skip < n ? s->skip : n;
+	s->skip -= drop;
+	n -= drop;
+	if (n > s->left)
+		n = s->left;
+	s->left -= n;
+	for (c = 0; c < s->wav->channels; c++)
+		s->at[c] = x[c] + drop;
+	wah_wav_encode(s->at, s->wav->channels, n, dst);
+	return n * s->wav->channels * WAH_WAV_OUT_BYTES;
+}
+
+/*
+ * render_block() - Pipeline callback: decode, process in place, encode.
+ *
+ * The flush call pushes out what the converters and the limiter still
+ * hold with silence.
+ */
+static size_t render_block(void *arg, const uint8_t *src, size_t len, uint8_t *dst){
+	struct stream *s = arg;
+	size_t out = 0;
+	unsigned c;
+
+	if (src) {
+		wah_wav_decode_from(s->wav, src, len / s->frameBytes, s->ch);
+		return render_frames(s, len / s->frameBytes, dst);
+	}
+	while (s->left) {
+		for (c = 0; c < s->wav->channels; c++)
+			memset(s->ch[c], 0, s->tail * sizeof(int32_t));
+		out += render_frames(s, s->tail, dst + out);
+	}
+	return out;
+}
+
+static void usage(const char *prog){
+	printf("usage: %s [-m uring|read|mmap] [-b frames] [-d depth] [-c] [-q]\n", prog);
+	printf("       [-O factor | -f] [-R rate] [-l dB [-g dB] [-p]] in.wav out.wav\n");
+	printf("       [field=value ...]\n");
+	printf("  -m  pipeline (default: uring)\n");
+	printf("  -b  frames per block (default: %d KiB of input)\n", WAH_PIPE_BLOCK >> 10);
+	printf("  -d  blocks in flight for uring (default: %d)\n", WAH_PIPE_DEPTH);
+	printf("  -c  evict the input from the page cache first\n");
+	printf("  -O  oversample the filter 1, 2 or 4 times (default: 1)\n");
+	printf("  -f  float32 engine: faster, not bit-exact with the hardware\n");
+	printf("  -R  output sample rate (default: the input's)\n");
+	printf("  -l  limit the output to this ceiling (dBFS true peak)\n");
+	printf("  -g  gain into the limiter in dB (default: 0)\n");
+	printf("  -p  limit sample peaks only\n");
+	printf("  -q  no summary\n");
+}
+
+int main(int argc, char **argv){
+	struct wah_resample up, down;
+	struct wah_limit_config lcfg;
+	struct wah_limit limit;
+	struct wah_float flt;
+	struct wah_pipe pipe;
+	struct wah_params p;
+	struct stream s;
+	struct wah_wav wav;
+	uint32_t *regs = (uint32_t *)&p;
+	uint8_t hdr[WAH_WAV_HEADER];
+	enum wah_pipe_mode mode = WAH_PIPE_URING;
+	size_t frames = 0, scratch, engFrames;
+	uint32_t rate = 0;
+	unsigned depth = WAH_PIPE_DEPTH, factor = 1, c;
+	int opt, cold = 0, quiet = 0, limiting = 0, truePeak = 1, useFloat = 0, in, out, i, j;
+	double t, ceiling_db = 0, gain_db = 0;
+
+	while ((opt = getopt(argc, argv, "m:b:d:O:fR:l:g:pcqh")) != -1) {
+		switch (opt) {
+		case 'm':
+			for (i = 0; i < 3 && strcmp(optarg, wah_pipe_mode_names[i]); i++)
+				;
+			if (i == 3) {
+				printf("unknown pipeline %s\n", optarg);
+				exit(1);
+			}
+			mode = (enum wah_pipe_mode)i;
+			break;
+		case 'b':
+			frames = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'O':
+			factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			useFloat = 1;
+			break;
+		case 'R':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			ceiling_db = strtod(optarg, NULL);
+			limiting = 1;
+			break;
+		case 'g':
+			gain_db = strtod(optarg, NULL);
+			break;
+		case 'p':
+			truePeak = 0;
+			break;
+		case 'c':
+			cold = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (argc - optind < 2) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	wah_params_default(&p);
+	for (i = optind + 2; i < argc; i++) {
+		char *eq = strchr(argv[i], '=');
+
+		j = eq ? wah_param_lookup(argv[i], eq - argv[i]) : -1;
+		if (j < 0) {
+			printf("unknown setting %s\n", argv[i]);
+			exit(1);
+		}
+		regs[j] = strtoul(eq + 1, NULL, 0);
+	}
+
+	in = open(argv[optind], O_RDONLY);
+	if (in < 0 || wah_wav_probe(&wav, in) < 0) {
+		printf("failed to open %s: %s\n", argv[optind],
+			errno == EINVAL ? "not a supported WAV file" : strerror(errno));
+		exit(1);
+	}
+	if (rate == 0)
+		rate = wav.rate;
+	if (cold)
+		posix_fadvise(in, 0, 0, POSIX_FADV_DONTNEED);
+
+	s.wav = &wav;
+	s.frameBytes = wav.channels * (wav.bits / 8);
+	if (frames == 0)
+		frames = WAH_PIPE_BLOCK / s.frameBytes;
+	s.up = NULL;
+	s.down = NULL;
+	s.limit = NULL;
+	s.skip = 0;
+	s.left = wah_resample_length(wav.frames, wav.rate, rate);
+	s.eng = malloc(wav.channels * sizeof(struct wah_os));
+	for (c = 0; c < wav.channels; c++)
+		if (wah_os_init(&s.eng[c], factor, &p) < 0) {
+			printf("can't oversample %u times\n", factor);
+			exit(1);
+		}
+	s.engSkip = wah_os_latency(&s.eng[0]);
+	s.flt = NULL;
+	if (useFloat) {
+		if (factor != 1 || wah_float_init(&flt, wav.channels, &p) < 0) {
+			printf("-f runs without oversampling, on at most %d channels\n",
+				WAH_FLOAT_LANES);
+			exit(1);
+		}
+		s.flt = &flt;
+	}
+	s.tail = s.engSkip;
+	if (wav.rate != WAH_SAMPLE_RATE) {
+		if (wah_resample_init(&up, wav.channels, wav.rate, WAH_SAMPLE_RATE) < 0) {
+			printf("can't convert %u Hz to %u Hz\n", wav.rate, WAH_SAMPLE_RATE);
+			exit(1);
+		}
+		s.up = &up;
+	}
+	if (rate != WAH_SAMPLE_RATE) {
+		if (wah_resample_init(&down, wav.channels, WAH_SAMPLE_RATE, rate) < 0) {
+			printf("can't convert %u Hz to %u Hz\n", WAH_SAMPLE_RATE, rate);
+			exit(1);
+		}
+		s.down = &down;
+		// The engine-rate silence that pushes the output converter out
+		s.tail += wah_resample_tail(&down);
+	}
+	if (limiting) {
+		wah_limit_config_default(&lcfg, rate);
+		lcfg.truePeak = truePeak;
+		lcfg.ceiling = (uint32_t)fmin(0x7fffff, 0x7fffff * pow(10.0, ceiling_db / 20));
+		lcfg.gain = (uint32_t)(65536 * pow(10.0, gain_db / 20) + 0.5);
+		if (wah_limit_init(&limit, wav.channels, &lcfg) < 0) {
+			printf("bad limiter settings: ceiling %.1f dB, gain %.1f dB\n", ceiling_db, gain_db);
+			exit(1);
+		}
+		s.limit = &limit;
+		s.skip = wah_limit_latency(&limit);
+		s.tail += ((uint64_t)s.skip * WAH_SAMPLE_RATE + rate - 1) / rate;
+	}
+	// Silence at the input rate that gets all of that through, so the
+	// flush call finishes in one pass.
+	s.tail = ((uint64_t)s.tail * wav.rate + WAH_SAMPLE_RATE - 1) / WAH_SAMPLE_RATE + 1;
+	if (s.up)
+		s.tail += wah_resample_tail(&up);
+	if (!s.up && !s.down)
+		s.tail = s.engSkip + s.skip;
+
+	scratch = frames > s.tail ? frames : s.tail;
+	engFrames = s.up ? wah_resample_max_out(&up, scratch) : scratch;
+	s.ch = malloc(wav.channels * sizeof(int32_t *));
+	s.mid = malloc(wav.channels * sizeof(int32_t *));
+	s.last = malloc(wav.channels * sizeof(int32_t *));
+	s.at = malloc(wav.channels * sizeof(int32_t *));
+	for (c = 0; c < wav.channels; c++) {
+		s.ch[c] = malloc(scratch * sizeof(int32_t));
+		s.mid[c] = s.up ? malloc(engFrames * sizeof(int32_t)) : NULL;
+		s.last[c] = s.down ? malloc(wah_resample_max_out(&down, engFrames) * sizeof(int32_t)) :
+			NULL;
+	}
+	if (s.down)
+		scratch = wah_resample_max_out(&down, engFrames);
+	else
+		scratch = engFrames;
+
+	out = open(argv[optind + 1], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	wah_wav_header(hdr, rate, wav.channels, s.left);
+	if (out < 0 || write(out, hdr, sizeof(hdr)) != sizeof(hdr)) {
+		printf("failed to write %s: %s\n", argv[optind + 1], strerror(errno));
+		exit(1);
+	}
+
+	memset(&pipe, 0, sizeof(pipe));
+	pipe.in = in;
+	pipe.out = out;
+	pipe.inOffset = wav.offset;
+	pipe.inBytes = wav.frames * s.frameBytes;
+	pipe.outOffset = WAH_WAV_HEADER;
+	pipe.block = frames * s.frameBytes;
+	pipe.outBlock = scratch * wav.channels * WAH_WAV_OUT_BYTES;
+	pipe.depth = depth;
+	pipe.process = render_block;
+	pipe.arg = &s;
+
+	t = now_s();
+	if (wah_pipe_run(&pipe, mode) < 0) {
+		printf("failed to render %s: %s\n", argv[optind], strerror(errno));
+		exit(1);
+	}
+	if (close(out) < 0) {
+		printf("failed to write %s: %s\n", argv[optind + 1], strerror(errno));
+		exit(1);
+	}
+	t = now_s() - t;
+	close(in);
+
+	if (!quiet && useFloat)
+		printf("float32 engine: %llu samples where the hardware would wrap around\n",
+			(unsigned long long)flt.wraps);
+	if (!quiet && factor > 1)
+		printf("oversampled: %ux, %u frames delay\n", factor, wah_os_latency(&s.eng[0]));
+	if (!quiet && (s.up || s.down))
+		printf("resampled: %u Hz in, %u Hz engine, %u Hz out\n", wav.rate,
+			WAH_SAMPLE_RATE, rate);
+	if (!quiet && limiting)
+		printf("limiter: %.1f dB ceiling (%s peak), %.1f dB gain, %u frames delay\n",
+			ceiling_db, truePeak ? "true" : "sample", gain_db,
+			wah_limit_latency(&limit));
+	if (!quiet)
+		printf("%s: %.1f MB in, %.1f MB out in %.3fs: %.1f MB/s, %.1f Msamples/s "
+			"(%.0fx real time), %zu KiB buffers, %llu stalls (%.1f ms)\n",
+			wah_pipe_mode_names[mode], pipe.inBytes * 1e-6, pipe.outBytes * 1e-6, t,
+			pipe.inBytes * 1e-6 / t, wav.frames * wav.channels * 1e-6 / t,
+			wav.frames / t / wav.rate, pipe.memory >> 10,
+			(unsigned long long)pipe.stalls, pipe.stallNs * 1e-6);
+	return 0;
+}
@@ -0,0 +1,320 @@
+/*-------------------------------------------------------------------------
+ * Description:  Stress run of the real-time process path.
+ *
+ *                 wahStress [-n blocks] [-b frames] [-s seed] [-k]
+ *
+ *               An audio thread runs millions of blocks of random size
+ *               (1 to -b frames) of full-scale noise through everything a
+ *               real-time host would call per block: the engine behind a
+ *               parameter block, the limiter, a chain, the 2x
+ *               oversampled engine, a resampler and a voice pool. Between
+ *               blocks it schedules random events, changes ramps and
+ *               creates, destroys and retunes voices, while a control
+ *               thread keeps writing random register values into the
+ *               parameter block. Register values are anything that fits
+ *               the register, not just sensible settings.
+ *
+ *               Every output sample must stay in sfix24 range. Built with
+ *               -DWAH_AUDIT (wahAudit.h) the audio thread is audited as
+ *               well, and the run aborts at the first allocation, lock or
+ *               sleep on it; -k counts them instead.
+ *
+ * Build:        gcc -O2 -g -DWAH_AUDIT -pthread -o wahStress wahStress.c wahAudit.c
+ *                   wahEngine.c wahCycle.c wahParamBlock.c wahLimit.c wahChain.c
+ *                   wahOversample.c wahResample.c wahVoices.c -ldl -lm
+ *-------------------------------------------------------------------------*/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wahAudit.h"
+#include "wahChain.h"
+#include "wahEngine.h"
+#include "wahLimit.h"
+#include "wahOversample.h"
+#include "wahParamBlock.h"
+#include "wahResample.h"
+#include "wahVoices.h"
+
+/* Voices in the pool                                                    */
+#define STRESS_VOICES 8
+
+/*
+ * struct stress - Everything the audio thread uses, set up beforehand.
+ */
+struct stress {
+	uint64_t blocks;
+	size_t maxBlock;
+	uint64_t seed;
+	struct wah_param_block blk;
+	volatile int done;
+
+	struct wah_engine eng;
+	struct wah_limit limit;
+	struct wah_chain chain;
+	struct wah_os os;
+	struct wah_resample rs;
+	struct wah_voices voices;
+	int32_t *in, *out, *rsOut, *vin, *vout;
+
+	uint64_t frames;
+	uint64_t outOfRange;
+	uint64_t longestNs;
+};
+
+static uint64_t xorshift(uint64_t *s){
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+/*
+ * random_reg() - Any value register @param can hold.
+ */
+static uint32_t random_reg(uint64_t *s, unsigned param){
+	return (uint32_t)xorshift(s) & (param == WAH_ENABLE ? 0x1 : 0xffff);
+}
+
+static void random_params(uint64_t *s, struct wah_params *p){
+	uint32_t *regs = (uint32_t *)p;
+	unsigned r;
+
+	for (r = 0; r < WAH_PARAM_COUNT; r++)
+		regs[r] = random_reg(s, r);
+}
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void check_range(struct stress *st, const int32_t *x, size_t n){
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		if (x[i] < -(1 << 23) || x[i] >= (1 << 23))
+			st->outOfRange++;
+}
+
+/*
+ * control() - Keep writing random register values, as a control surface
+ * would, until the audio thread is done.
+ */
+static void *control(void *arg){
+	struct stress *st = arg;
+	const struct timespec pause = { 0, 50000 };
+	uint64_t s = st->seed * 31 + 7;
+	struct wah_params p;
+
+	while (!st->done) {
+		random_params(&s, &p);
+		if (wah_param_block_write(&st->blk, &p) < 0)
+			break;
+		nanosleep(&pause, NULL);
+	}
+	return NULL;
+}
+
+/*
+ * churn() - The changes the audio thread makes itself between blocks.
+ */
+static void churn(struct stress *st, uint64_t *s, size_t n){
+	struct wah_params p;
+	unsigned e, events;
+	uint64_t r = xorshift(s);
+
+	if ((r & 3) == 0) {
+		events = 1 + (r >> 2) % 4;
+		for (e = 0; e < events; e++) {
+			uint32_t at = (uint32_t)(xorshift(s) % (2 * n));
+			unsigned param = (unsigned)(xorshift(s) % WAH_PARAM_COUNT);
+			uint32_t value = random_reg(s, param);
+
+			wah_engine_schedule(&st->eng, at, param, value);
+			wah_chain_schedule(&st->chain, at, param, value);
+			wah_os_schedule(&st->os, at, param, value);
+		}
+	}
+	if (((r >> 8) & 63) == 0) {
+		unsigned shape = (r >> 14) & 1;
+		uint32_t samples = (uint32_t)((r >> 16) % 4800);
+
+		wah_engine_set_ramp(&st->eng, shape, samples);
+		wah_engine_set_ramp(&st->chain.eng[0], shape, samples);
+		wah_engine_set_ramp(&st->os.eng, shape, samples);
+	}
+	if (((r >> 32) & 15) == 0) {
+		random_params(s, &p);
+		wah_voice_create(&st->voices, &p);
+	}
+	if (((r >> 36) & 15) == 0)
+		wah_voice_destroy(&st->voices, (uint32_t)(xorshift(s) % STRESS_VOICES));
+	if (((r >> 40) & 7) == 0) {
+		unsigned param = (unsigned)(xorshift(s) % WAH_PARAM_COUNT);
+
+		wah_voice_set(&st->voices, (uint32_t)(xorshift(s) % STRESS_VOICES), param,
+			random_reg(s, param));
+	}
+}
+
+/*
+ * audio() - The audio thread.
+ */
+static void *audio(void *arg){
+	struct stress *st = arg;
+	uint64_t s = st->seed, b;
+	uint32_t seen = 0;
+	size_t i, n, m;
+	unsigned v;
+
+	WAH_AUDIT_BEGIN();
+	for (b = 0; b < st->blocks; b++) {
+		int32_t *out = st->out, *rsOut = st->rsOut;
+		const int32_t *in = st->in;
+		uint64_t t0 = now_ns(), t;
+
+		n = 1 + xorshift(&s) % st->maxBlock;
+		for (i = 0; i < n; i++)
+			st->in[i] = (int32_t)(xorshift(&s) >> 40) - (1 << 23);
+		churn(st, &s, n);
+
+		wah_engine_sync(&st->eng, &st->blk, &seen);
+		wah_engine_process(&st->eng, st->in, st->out, n);
+		wah_limit_process(&st->limit, (const int32_t *const *)&out, &out, n);
+		check_range(st, st->out, n);
+
+		wah_chain_process(&st->chain, &in, &out, n);
+		check_range(st, st->out, n);
+
+		wah_os_process(&st->os, st->in, st->out, n);
+		check_range(st, st->out, n);
+
+		m = wah_resample_process(&st->rs, &in, n, &rsOut);
+		check_range(st, st->rsOut, m);
+
+		for (v = 0; v < STRESS_VOICES; v++)
+			memcpy(st->vin + v * st->maxBlock, st->in, n * sizeof(int32_t));
+		wah_voices_process(&st->voices, st->vin, st->vout, st->maxBlock, n);
+		for (v = 0; v < st->voices.count; v++)
+			check_range(st, st->vout + st->voices.handle[v] * st->maxBlock, n);
+
+		st->frames += n;
+		if ((t = now_ns() - t0) > st->longestNs)
+			st->longestNs = t;
+	}
+	WAH_AUDIT_END();
+	st->done = 1;
+	return NULL;
+}
+
+static void usage(const char *prog){
+	printf("usage: %s [-n blocks] [-b frames] [-s seed] [-k]\n", prog);
+}
+
+int main(int argc, char **argv){
+	struct wah_limit_config lcfg;
+	struct stress st;
+	struct wah_params p;
+	pthread_t ctl, rt;
+	int opt, keepGoing = 0;
+	double t;
+
+	memset(&st, 0, sizeof(st));
+	st.blocks = 2000000;
+	st.maxBlock = 64;
+	st.seed = 1;
+	while ((opt = getopt(argc, argv, "n:b:s:kh")) != -1) {
+		switch (opt) {
+		case 'n':
+			st.blocks = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			st.maxBlock = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			st.seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'k':
+			keepGoing = 1;
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (st.maxBlock == 0 || st.seed == 0) {
+		printf("block size and seed must not be 0\n");
+		exit(1);
+	}
+
+	wah_params_default(&p);
+	wah_param_block_init(&st.blk, &p);
+	wah_engine_init(&st.eng, &p);
+	wah_limit_config_default(&lcfg, WAH_SAMPLE_RATE);
+	if (wah_limit_init(&st.limit, 1, &lcfg) < 0 ||
+	    wah_chain_init(&st.chain, "wah,mixer,volume,limit", 1, &p, NULL) < 0 ||
+	    wah_os_init(&st.os, 2, &p) < 0 ||
+	    wah_resample_init(&st.rs, 1, 44100, WAH_SAMPLE_RATE) < 0 ||
+	    wah_voices_init(&st.voices, STRESS_VOICES) < 0) {
+		perror("wahStress");
+		exit(1);
+	}
+	st.in = malloc(st.maxBlock * sizeof(int32_t));
+	st.out = malloc(st.maxBlock * sizeof(int32_t));
+	st.rsOut = malloc(wah_resample_max_out(&st.rs, st.maxBlock) * sizeof(int32_t));
+	st.vin = malloc(STRESS_VOICES * st.maxBlock * sizeof(int32_t));
+	st.vout = malloc(STRESS_VOICES * st.maxBlock * sizeof(int32_t));
+	if (st.in == NULL || st.out == NULL || st.rsOut == NULL || st.vin == NULL ||
+	    st.vout == NULL) {
+		printf("out of memory\n");
+		exit(1);
+	}
+#ifdef WAH_AUDIT
+	wah_audit_set_fatal(!keepGoing);
+#else
+	(void)keepGoing;
+#endif
+
+	t = now_ns() * 1e-9;
+	if (pthread_create(&ctl, NULL, control, &st) || pthread_create(&rt, NULL, audio, &st)) {
+		printf("can't start threads\n");
+		exit(1);
+	}
+	pthread_join(rt, NULL);
+	pthread_join(ctl, NULL);
+	t = now_ns() * 1e-9 - t;
+
+	printf("%llu blocks, %llu frames in %.1f s, longest block %.1f us\n",
+		(unsigned long long)st.blocks, (unsigned long long)st.frames, t,
+		st.longestNs * 1e-3);
+	printf("samples out of range: %llu\n", (unsigned long long)st.outOfRange);
+#ifdef WAH_AUDIT
+	{
+		const char *first;
+		uint64_t bad = wah_audit_violations(&first);
+
+		printf("audit: %llu violations%s%s\n", (unsigned long long)bad,
+			bad ? ", first " : "", bad ? first : "");
+		if (bad)
+			st.outOfRange++;
+	}
+#endif
+
+	wah_voices_free(&st.voices);
+	wah_resample_free(&st.rs);
+	wah_limit_free(&st.limit);
+	wah_chain_free(&st.chain);
+	free(st.in);
+	free(st.out);
+	free(st.rsOut);
+	free(st.vin);
+	free(st.vout);
+	return st.outOfRange ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/*-------------------------------------------------------------------------
+ * Description:  Many wah instances in one arena.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wahVoices.h"
+
+/* Every array starts on its own cache line                              */
+#define VOICE_ALIGN 64
+
+static size_t align_up(size_t n){
+	return (n + VOICE_ALIGN - 1) & ~(size_t)(VOICE_ALIGN - 1);
+}
+
+/*
+ * wah_voices_init() - Allocate an arena for @capacity instances.
+ *
+ * Return: 0 on success, -1 with errno set.
+ */
+int wah_voices_init(struct wah_voices *v, uint32_t capacity)
+{
+	const size_t n = capacity;
+	size_t size, at = 0;
+	uint8_t *base;
+	unsigned r;
+	uint32_t i;
+
+	memset(v, 0, sizeof(*v));
+	if (capacity == 0 || capacity == WAH_VOICE_NONE) {
+		errno = EINVAL;
+		return -1;
+	}
+	size = 3 * align_up(n * sizeof(int64_t)) + align_up(n * sizeof(int32_t)) +
+		(WAH_PARAM_COUNT + 3) * align_up(n * sizeof(uint32_t));
+	base = aligned_alloc(VOICE_ALIGN, size);
+	if (base == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+#define CARVE(field, count) \
+	do { v->field = (void *)(base + at); at += align_up((count) * sizeof(*v->field)); } while (0)
+	CARVE(acc, n);
+	CARVE(yb, n);
+	CARVE(yl, n);
+	CARVE(dir, n);
+	for (r = 0; r < WAH_PARAM_COUNT; r++)
+		CARVE(regs[r], n);
+	CARVE(handle, n);
+	CARVE(dense, n);
+	CARVE(free, n);
+#undef CARVE
+
+	v->arena = base;
+	v->capacity = capacity;
+	v->wave = wah_f1_wave();
+	// Hand out low handles first.
+	for (i = 0; i < capacity; i++) {
+		v->dense[i] = WAH_VOICE_NONE;
+		v->free[i] = capacity - 1 - i;
+	}
+	return 0;
+}
+
+void wah_voices_free(struct wah_voices *v)
+{
+	free(v->arena);
+	memset(v, 0, sizeof(*v));
+}
+
+/*
+ * wah_voice_create() - Start an instance from reset with registers @p.
+ *
+ * Return: Its handle, or -1 with errno ENOSPC when the arena is full.
+ */
+int64_t wah_voice_create(struct wah_voices *v, const struct wah_params *p)
+{
+	const uint32_t *regs = (const uint32_t *)p;
+	struct wah_params q = { 0 };
+	uint32_t h, d;
+	unsigned r;
+
+	if (v->count == v->capacity) {
+		errno = ENOSPC;
+		return -1;
+	}
+	h = v->free[v->capacity - 1 - v->count];
+	d = v->count++;
+	v->handle[d] = h;
+	v->dense[h] = d;
+	v->acc[d] = 0;
+	v->dir[d] = 0;
+	v->yb[d] = 0;
+	v->yl[d] = 0;
+	for (r = 0; r < WAH_PARAM_COUNT; r++)
+		wah_params_set(&q, r, regs[r]);
+	for (r = 0; r < WAH_PARAM_COUNT; r++)
+		v->regs[r][d] = ((const uint32_t *)&q)[r];
+	return h;
+}
+
+/*
+ * wah_voice_destroy() - End instance @h; the last active one moves into
+ * its place. Unknown handles are ignored.
+ */
+void wah_voice_destroy(struct wah_voices *v, uint32_t h)
+{
+	uint32_t d, last;
+	unsigned r;
+
+	if (h >= v->capacity || v->dense[h] == WAH_VOICE_NONE)
+		return;
+	d = v->dense[h];
+	last = --v->count;
+	if (d != last) {
+		v->acc[d] = v->acc[last];
+		v->dir[d] = v->dir[last];
+		v->yb[d] = v->yb[last];
+		v->yl[d] = v->yl[last];
+		for (r = 0; r < WAH_PARAM_COUNT; r++)
+			v->regs[r][d] = v->regs[r][last];
+		v->handle[d] = v->handle[last];
+		v->dense[v->handle[d]] = d;
+	}
+	v->dense[h] = WAH_VOICE_NONE;
+	v->free[v->capacity - 1 - v->count] = h;
+}
+
+/*
+ * wah_voice_set() - Set one register of instance @h from the next sweep.
+ */
+void wah_voice_set(struct wah_voices *v, uint32_t h, unsigned param, uint32_t value)
+{
+	struct wah_params q = { 0 };
+
+	if (h >= v->capacity || v->dense[h] == WAH_VOICE_NONE || param >= WAH_PARAM_COUNT)
+		return;
+	wah_params_set(&q, param, value);
+	v->regs[param][v->dense[h]] = ((const uint32_t *)&q)[param];
+}
+
+/*
+ * sweep() - @lanes instances from dense index @d over @n samples.
+ *
+ * Inlined with @lanes constant, the lane loop unrolls into independent
+ * filter recursions side by side; the mixer then runs per instance over
+ * the chunk, where it vectorizes. One recursion alone is bound by its
+ * multiply latency, several are bound by instruction count, so F1 comes
+ * unfolded from the 4096-entry wave instead of through wah_f1()'s
+ * quarter-wave branches.
+ */
+static inline __attribute__((always_inline)) void sweep(struct wah_voices *v, uint32_t d,
+	unsigned lanes, const int32_t *in, int32_t *out, size_t stride, size_t n)
+{
+	int32_t wet[WAH_VOICE_LANES][WAH_CHUNK];
+	struct wah_lfo lfo[WAH_VOICE_LANES];
+	struct wah_svf svf[WAH_VOICE_LANES];
+	const int32_t *x[WAH_VOICE_LANES];
+	int32_t *y[WAH_VOICE_LANES];
+	uint32_t minf[WAH_VOICE_LANES], maxf[WAH_VOICE_LANES], delta[WAH_VOICE_LANES];
+	int64_t q1[WAH_VOICE_LANES];
+	const int64_t *wave = v->wave;
+	size_t pos, c, i;
+	unsigned j;
+
+	for (j = 0; j < lanes; j++) {
+		lfo[j].acc = v->acc[d + j];
+		lfo[j].dir = v->dir[d + j];
+		svf[j].yb = v->yb[d + j];
+		svf[j].yl = v->yl[d + j];
+		q1[j] = wah_q1(v->regs[WAH_DAMP][d + j]);
+		minf[j] = v->regs[WAH_MINF][d + j];
+		maxf[j] = v->regs[WAH_MAXF][d + j];
+		delta[j] = v->regs[WAH_DELTA][d + j];
+		x[j] = in + v->handle[d + j] * stride;
+		y[j] = out + v->handle[d + j] * stride;
+	}
+
+	for (pos = 0; pos < n; pos += c) {
+		c = n - pos < WAH_CHUNK ? n - pos : WAH_CHUNK;
+
+		for (i = 0; i < c; i++)
+			for (j = 0; j < lanes; j++) {
+				int64_t f1 = wave[wah_f1_phase(wah_lfo_step(&lfo[j], minf[j], maxf[j],
+					delta[j]))];
+
+				wet[j][i] = wah_wet(wah_svf_step(&svf[j], x[j][pos + i], f1, q1[j]));
+			}
+		for (j = 0; j < lanes; j++) {
+			const uint32_t enable = v->regs[WAH_ENABLE][d + j];
+			const uint32_t volume = v->regs[WAH_VOLUME][d + j];
+			const uint32_t wetDry = v->regs[WAH_WETDRY][d + j];
+			const int32_t *dry = x[j] + pos;
+			int32_t *o = y[j] + pos;
+
+			for (i = 0; i < c; i++)
+				o[i] = wah_output(dry[i], wah_mix(dry[i], wet[j][i], wetDry), enable,
+					volume);
+		}
+	}
+
+	for (j = 0; j < lanes; j++) {
+		v->acc[d + j] = lfo[j].acc;
+		v->dir[d + j] = lfo[j].dir;
+		v->yb[d + j] = svf[j].yb;
+		v->yl[d + j] = svf[j].yl;
+	}
+}
+
+/*
+ * wah_voices_process() - Run every active instance over @n samples.
+ * @in, @out: Instance h reads in[h * stride + i] and writes
+ *            out[h * stride + i]; @out may be @in.
+ */
+void wah_voices_process(struct wah_voices *v, const int32_t *in, int32_t *out, size_t stride,
+	size_t n)
+{
+	uint32_t d = 0;
+
+	for (; d + WAH_VOICE_LANES <= v->count; d += WAH_VOICE_LANES)
+		sweep(v, d, WAH_VOICE_LANES, in, out, stride, n);
+	for (; d < v->count; d++)
+		sweep(v, d, 1, in, out, stride, n);
+}
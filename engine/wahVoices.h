@@ -0,0 +1,76 @@
+/*-------------------------------------------------------------------------
+ * Description:  Many wah instances in one arena.
+ *
+ *               For hosts running an effect per user stream: a struct
+ *               wah_engine each, allocated one by one, scatters a few
+ *               dozen bytes of filter state across the heap. Here every
+ *               instance lives in one block of memory allocated up front,
+ *               one array per field (structure of arrays), and active
+ *               instances are kept packed at the front: destroying one
+ *               moves the last one into its place. Creating and
+ *               destroying are O(1) and never allocate; handles stay
+ *               valid because they go through an index table.
+ *
+ *               A sweep runs the active instances a few at a time
+ *               (WAH_VOICE_LANES), their filter recursions side by side
+ *               over a chunk, then the mixer per instance as in
+ *               wah_engine_mix(). On the x86 build machine wahBench
+ *               voices measured 6-9 ns/sample per instance from 64 to
+ *               4096 instances, against 8.5-11 ns for a heap wah_engine
+ *               each; a lone instance gains only a few percent. Every
+ *               instance renders exactly as a wah_engine with the same
+ *               registers would; register changes take effect at the next
+ *               sweep, without ramps or scheduled events, as on the
+ *               hardware.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_VOICES_H
+#define WAH_VOICES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wahEngine.h"
+
+/* Instances run side by side in a sweep                                 */
+#define WAH_VOICE_LANES 4
+/* Not an active instance (wah_voices.dense)                             */
+#define WAH_VOICE_NONE UINT32_MAX
+
+/*
+ * struct wah_voices - The instance arena.
+ * @capacity: Most instances at once.
+ * @count: Active instances; their state is at dense index 0..@count-1.
+ * @arena: The one allocation everything below points into.
+ * @acc, @dir: Fc triangle state, per dense index.
+ * @yb, @yl: Filter state, per dense index.
+ * @regs: Register values, WAH_PARAM_COUNT arrays of @capacity, per dense
+ *        index and in register order.
+ * @handle: Handle of each dense index.
+ * @dense: Dense index of each handle, or WAH_VOICE_NONE.
+ * @free: Unused handles (a stack of @capacity - @count).
+ * @wave: F1 by sine phase (wah_f1_wave()).
+ */
+struct wah_voices {
+	uint32_t capacity;
+	uint32_t count;
+	void *arena;
+	int64_t *acc;
+	int32_t *dir;
+	int64_t *yb;
+	int64_t *yl;
+	uint32_t *regs[WAH_PARAM_COUNT];
+	uint32_t *handle;
+	uint32_t *dense;
+	uint32_t *free;
+	const int64_t *wave;
+};
+
+int wah_voices_init(struct wah_voices *v, uint32_t capacity);
+void wah_voices_free(struct wah_voices *v);
+int64_t wah_voice_create(struct wah_voices *v, const struct wah_params *p);
+void wah_voice_destroy(struct wah_voices *v, uint32_t h);
+void wah_voice_set(struct wah_voices *v, uint32_t h, unsigned param, uint32_t value);
+void wah_voices_process(struct wah_voices *v, const int32_t *in, int32_t *out, size_t stride,
+	size_t n);
+
+#endif
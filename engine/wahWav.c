@@ -0,0 +1,242 @@
+/*-------------------------------------------------------------------------
+ * Description:  WAV file input and output for the engine tools.
+ *-------------------------------------------------------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wahWav.h"
+
+#define WAVE_FORMAT_EXTENSIBLE 0xfffe
+
+static inline uint32_t get16(const uint8_t *p){
+	return p[0] | p[1] << 8;
+}
+
+static inline uint32_t get32(const uint8_t *p){
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void put16(uint8_t *p, uint32_t v){
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put32(uint8_t *p, uint32_t v){
+	put16(p, v);
+	put16(p + 2, v >> 16);
+}
+
+/*
+ * wah_wav_probe() - Read the format of the WAV file open on @fd and find
+ * its sample data, without mapping it.
+ *
+ * Sets every field except @map and @data, which stay NULL.
+ *
+ * Return: 0 on success, -1 with errno set (EINVAL for files that aren't
+ * WAV or use an unsupported sample format).
+ */
+int wah_wav_probe(struct wah_wav *w, int fd)
+{
+	uint8_t hdr[26];
+	uint64_t pos, end, len;
+	int fmt = 0, data = 0;
+	struct stat st;
+
+	memset(w, 0, sizeof(*w));
+	if (fstat(fd, &st) < 0)
+		return -1;
+	w->size = st.st_size;
+	end = w->size;
+	if (pread(fd, hdr, 12, 0) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4))
+		goto invalid;
+
+	// Walk the chunks; "data" may come before or after "fmt ".
+	for (pos = 12; end - pos >= 8; pos += 8 + len + (len & 1)) {
+		if (pread(fd, hdr, 8, pos) != 8)
+			goto invalid;
+		len = get32(hdr + 4);
+		if (memcmp(hdr, "fmt ", 4) == 0 && len >= 16 && end - pos - 8 >= len) {
+			if (pread(fd, hdr, len >= 26 ? 26 : 16, pos + 8) != (len >= 26 ? 26 : 16))
+				goto invalid;
+			fmt = 1;
+			w->format = get16(hdr);
+			w->channels = get16(hdr + 2);
+			w->rate = get32(hdr + 4);
+			w->bits = get16(hdr + 14);
+			if (w->format == WAVE_FORMAT_EXTENSIBLE && len >= 26)
+				w->format = get16(hdr + 24);
+		} else if (memcmp(hdr, "data", 4) == 0) {
+			data = 1;
+			w->offset = pos + 8;
+			// Recorders that stop early leave the length too long.
+			if (len > end - w->offset)
+				len = end - w->offset;
+			w->frames = len;
+		}
+		if (end - pos - 8 < len)
+			break;
+	}
+	if (!fmt || !data || w->channels == 0)
+		goto invalid;
+	if (!(w->format == WAH_WAV_PCM && (w->bits == 16 || w->bits == 24 || w->bits == 32)) &&
+	    !(w->format == WAH_WAV_FLOAT && w->bits == 32))
+		goto invalid;
+	w->frames /= (uint64_t)w->channels * (w->bits / 8);
+	return 0;
+
+invalid:
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * wah_wav_open() - Map a WAV file and find its sample data.
+ *
+ * Return: 0 on success, -1 with errno set (EINVAL for files that aren't
+ * WAV or use an unsupported sample format).
+ */
+int wah_wav_open(struct wah_wav *w, const char *path)
+{
+	int fd, err;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (wah_wav_probe(w, fd) < 0) {
+		err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+	w->map = mmap(NULL, w->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	err = errno;
+	close(fd);
+	if (w->map == MAP_FAILED) {
+		w->map = NULL;
+		errno = err;
+		return -1;
+	}
+	madvise(w->map, w->size, MADV_SEQUENTIAL);
+	w->data = (const uint8_t *)w->map + w->offset;
+	return 0;
+}
+
+void wah_wav_close(struct wah_wav *w)
+{
+	if (w->map)
+		munmap(w->map, w->size);
+	w->map = NULL;
+}
+
+/*
+ * wah_wav_decode() - Read @n frames starting at @frame.
+ * @ch: One sfix24_En23 buffer of @n samples per channel.
+ */
+void wah_wav_decode(const struct wah_wav *w, uint64_t frame, size_t n, int32_t *const *ch)
+{
+	wah_wav_decode_from(w, w->data + frame * w->channels * (w->bits / 8), n, ch);
+}
+
+/*
+ * wah_wav_decode_from() - Decode @n frames of @w's sample format at @src,
+ * for data read into a buffer rather than mapped.
+ * @ch: One sfix24_En23 buffer of @n samples per channel.
+ *
+ * 32-bit inputs are rounded to 24 bits; float samples are clamped to the
+ * sfix24_En23 range.
+ */
+void wah_wav_decode_from(const struct wah_wav *w, const uint8_t *src, size_t n,
+	int32_t *const *ch)
+{
+	const unsigned bytes = w->bits / 8, stride = w->channels * bytes;
+	unsigned c;
+	size_t i;
+
+	for (c = 0; c < w->channels; c++, src += bytes) {
+		const uint8_t *s = src;
+		int32_t *d = ch[c];
+
+		switch (w->format == WAH_WAV_FLOAT ? 0 : bytes) {
+		case 2:
+			for (i = 0; i < n; i++, s += stride)
+				d[i] = (int32_t)(int16_t)get16(s) * 256;
+			break;
+		case 3:
+			for (i = 0; i < n; i++, s += stride)
+				d[i] = (int32_t)((uint32_t)get16(s) << 8 | (uint32_t)s[2] << 24) >> 8;
+			break;
+		case 4:
+			for (i = 0; i < n; i++, s += stride) {
+				int64_t v = ((int64_t)(int32_t)get32(s) + 128) >> 8;
+
+				d[i] = v > 0x7fffff ? 0x7fffff : (int32_t)v;
+			}
+			break;
+		default: {
+			for (i = 0; i < n; i++, s += stride) {
+				uint32_t u = get32(s);
+				float f;
+
+				memcpy(&f, &u, sizeof(f));
+				f = f * 8388608.0f;
+				d[i] = !(f > -8388608.0f) ? -0x800000 :
+					f >= 8388607.0f ? 0x7fffff : (int32_t)lrintf(f);
+			}
+			break;
+		}
+		}
+	}
+}
+
+/*
+ * wah_wav_header() - Canonical 24-bit PCM header for @frames frames.
+ */
+void wah_wav_header(uint8_t *hdr, uint32_t rate, unsigned channels, uint64_t frames)
+{
+	uint32_t align = channels * WAH_WAV_OUT_BYTES;
+	uint64_t data = frames * align;
+
+	// RIFF sizes are 32 bits; longer files get clamped lengths, which
+	// most readers treat as "read to the end".
+	if (data > 0xffffffffULL - 36)
+		data = 0xffffffffULL - 36;
+
+	memcpy(hdr, "RIFF", 4);
+	put32(hdr + 4, (uint32_t)(36 + data));
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	put32(hdr + 16, 16);
+	put16(hdr + 20, WAH_WAV_PCM);
+	put16(hdr + 22, channels);
+	put32(hdr + 24, rate);
+	put32(hdr + 28, rate * align);
+	put16(hdr + 32, align);
+	put16(hdr + 34, WAH_WAV_OUT_BYTES * 8);
+	memcpy(hdr + 36, "data", 4);
+	put32(hdr + 40, (uint32_t)data);
+}
+
+/*
+ * wah_wav_encode() - Interleave @n frames of sfix24_En23 as 24-bit PCM.
+ */
+void wah_wav_encode(const int32_t *const *ch, unsigned channels, size_t n, uint8_t *dst)
+{
+	const size_t stride = channels * WAH_WAV_OUT_BYTES;
+	unsigned c;
+	size_t i;
+
+	for (c = 0; c < channels; c++) {
+		const int32_t *s = ch[c];
+		uint8_t *d = dst + c * WAH_WAV_OUT_BYTES;
+
+		for (i = 0; i < n; i++, d += stride) {
+			d[0] = (uint8_t)s[i];
+			d[1] = (uint8_t)(s[i] >> 8);
+			d[2] = (uint8_t)(s[i] >> 16);
+		}
+	}
+}
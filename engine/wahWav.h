@@ -0,0 +1,61 @@
+/*-------------------------------------------------------------------------
+ * Description:  WAV file input and output for the engine tools.
+ *
+ *               Inputs are mapped read-only (or probed, for tools that read
+ *               them themselves) and decoded a block at a time
+ *               into one sfix24_En23 buffer per channel, the format the
+ *               engine works in. PCM 16/24/32-bit and 32-bit float files
+ *               are accepted (the Simulink/wav recordings are 16-bit
+ *               stereo). Output is always 24-bit PCM, the width of the
+ *               datapath, so no bits are lost or invented.
+ *-------------------------------------------------------------------------*/
+#ifndef WAH_WAV_H
+#define WAH_WAV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of the canonical header wah_wav_header() writes                  */
+#define WAH_WAV_HEADER 44
+/* Bytes per sample of the output format                                 */
+#define WAH_WAV_OUT_BYTES 3
+
+enum wah_wav_format {
+	WAH_WAV_PCM = 1,
+	WAH_WAV_FLOAT = 3,
+};
+
+/*
+ * struct wah_wav - An input file.
+ * @map: Whole file mapping; NULL if only probed.
+ * @size: File size.
+ * @data: First byte of the sample data in @map.
+ * @offset: File offset of the sample data.
+ * @rate: Sample rate (Hz).
+ * @channels: Interleaved channels.
+ * @bits: Bits per sample.
+ * @format: enum wah_wav_format.
+ * @frames: Samples per channel.
+ */
+struct wah_wav {
+	void *map;
+	size_t size;
+	const uint8_t *data;
+	uint64_t offset;
+	uint32_t rate;
+	uint16_t channels;
+	uint16_t bits;
+	uint16_t format;
+	uint64_t frames;
+};
+
+int wah_wav_probe(struct wah_wav *w, int fd);
+int wah_wav_open(struct wah_wav *w, const char *path);
+void wah_wav_close(struct wah_wav *w);
+void wah_wav_decode(const struct wah_wav *w, uint64_t frame, size_t n, int32_t *const *ch);
+void wah_wav_decode_from(const struct wah_wav *w, const uint8_t *src, size_t n,
+	int32_t *const *ch);
+void wah_wav_header(uint8_t *hdr, uint32_t rate, unsigned channels, uint64_t frames);
+void wah_wav_encode(const int32_t *const *ch, unsigned channels, size_t n, uint8_t *dst);
+
+#endif
@@ -0,0 +1,199 @@
+/*-------------------------------------------------------------------------
+ * Description:  MEX / Octave entry point for the wahwah.m filter.
+ *
+ *                 yb = wahwahMex(x, Fs, damp, minf, maxf, Fw)
+ *                 [yb, yl, yh] = wahwahMex(...)
+ *                 [yb, yl] = wahwahMex(..., 'fixed')
+ *
+ *               The same inputs and outputs as the loop in
+ *               Simulink/wahwah.m, in compiled code: the Fc triangle is
+ *               built the same way (minf:delta:maxf, then maxf:-delta:minf,
+ *               repeated), F1 lags Fc by one sample as it does there, and
+ *               the difference equation runs in double precision in the
+ *               same order, so yb matches the script to the last bit
+ *               except where MATLAB's colon operator rounds a triangle
+ *               value differently. Like the script, only the first
+ *               length(x) elements of x are filtered and the outputs
+ *               have the size of x; yb is not normalized.
+ *
+ *               With 'fixed' the HDL datapath of wahFixed.h runs instead
+ *               (Fs must be 48000): x is quantized to sfix24_En23, the
+ *               parameters to their register formats, and yb and yl are
+ *               the En48 filter state scaled back to doubles.
+ *
+ * Build:        mkoctfile --mex -O2 wahwahMex.c        (GNU Octave)
+ *               mex -O wahwahMex.c                      (MATLAB)
+ *               then addpath() the engine directory, or copy the result
+ *               next to wahwah.m
+ *-------------------------------------------------------------------------*/
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mex.h"
+
+#include "wahFixed.h"
+
+// The script's rounding, one operation at a time: no fused multiply-adds.
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/*
+ * struct tri - The Fc triangle of wahwah.m, one value at a time.
+ *
+ * Each leg is an Octave range: base + k * step for k < count - 1, then
+ * the limit's side of the last value.
+ */
+struct tri {
+	double minf, maxf, delta;
+	double count;
+	double k;
+	int down;
+};
+
+static double range_count(double base, double limit, double step){
+	double n = (limit - base) / step;
+
+	// The colon operator's tolerance for a limit a rounding error away.
+	return n < 0 ? 0 : floor(n + 3 * 2.220446049250313e-16 * fabs(n)) + 1;
+}
+
+static double tri_next(struct tri *t){
+	double base = t->down ? t->maxf : t->minf, step = t->down ? -t->delta : t->delta, v;
+
+	while (t->k >= t->count) {
+		t->down = !t->down;
+		t->k = 0;
+		base = t->down ? t->maxf : t->minf;
+		step = t->down ? -t->delta : t->delta;
+		t->count = range_count(base, t->down ? t->minf : t->maxf, step);
+	}
+	v = base + t->k * step;
+	if (t->k == t->count - 1 && (t->down ? v < t->minf : v > t->maxf))
+		v = t->down ? t->minf : t->maxf;
+	t->k++;
+	return v;
+}
+
+/*
+ * filter_script() - The loop of wahwah.m over @n samples.
+ * @yl, @yh: May be NULL.
+ */
+static void filter_script(const double *x, size_t n, double fs, double damp, double minf,
+	double maxf, double fw, double *yb, double *yl, double *yh)
+{
+	struct tri t = { minf, maxf, fw / fs, 0, 0, 1 };
+	const double q1 = 2 * damp;
+	double f1, b, l, h;
+	size_t i;
+
+	if (n == 0)
+		return;
+	// t starts at the end of a down leg, so the first leg is
+	// minf:delta:maxf.
+	f1 = 2 * sin((M_PI * tri_next(&t)) / fs);
+	h = x[0];
+	b = f1 * h;
+	l = f1 * b;
+	yb[0] = b;
+	if (yl)
+		yl[0] = l;
+	if (yh)
+		yh[0] = h;
+
+	for (i = 1; i < n; i++) {
+		h = x[i] - l - q1 * b;
+		b = f1 * h + b;
+		l = f1 * b + l;
+		f1 = 2 * sin((M_PI * tri_next(&t)) / fs);
+		yb[i] = b;
+		if (yl)
+			yl[i] = l;
+		if (yh)
+			yh[i] = h;
+	}
+}
+
+static uint32_t reg16(double v){
+	v = floor(v + 0.5);
+	return v < 0 ? 0 : v > 0xffff ? 0xffff : (uint32_t)v;
+}
+
+/*
+ * filter_fixed() - The HDL datapath over @n samples.
+ */
+static void filter_fixed(const double *x, size_t n, double fs, double damp, double minf,
+	double maxf, double fw, double *yb, double *yl)
+{
+	const uint32_t rminf = reg16(minf), rmaxf = reg16(maxf);
+	const uint32_t delta = reg16(fw / fs * WAH_ONE_EN16);
+	const int64_t q1 = wah_q1(reg16(damp * WAH_ONE_EN16));
+	struct wah_lfo lfo = { 0, 0 };
+	struct wah_svf svf = { 0, 0 };
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		int64_t f1 = wah_f1(wah_lfo_step(&lfo, rminf, rmaxf, delta));
+		int32_t s = (int32_t)wah_sat((int64_t)floor(x[i] * (1 << 23) + 0.5), 24);
+
+		wah_svf_step(&svf, s, f1, q1);
+		yb[i] = ldexp((double)svf.yb, -48);
+		if (yl)
+			yl[i] = ldexp((double)svf.yl, -48);
+	}
+}
+
+static double scalar_arg(const mxArray *a, const char *name){
+	if (!mxIsDouble(a) || mxIsComplex(a) || mxGetNumberOfElements(a) != 1)
+		mexErrMsgIdAndTxt("wahwahMex:arg", "%s must be a real double scalar", name);
+	return mxGetScalar(a);
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	static const char *const names[] = { "Fs", "damp", "minf", "maxf", "Fw" };
+	double v[5], *out[3] = { NULL, NULL, NULL };
+	size_t m, k, n, i;
+	int fixed = 0;
+	char mode[8];
+
+	if (nrhs == 7) {
+		if (!mxIsChar(prhs[6]) || mxGetString(prhs[6], mode, sizeof(mode)) ||
+		    strcmp(mode, "fixed"))
+			mexErrMsgIdAndTxt("wahwahMex:arg", "the 7th argument can only be 'fixed'");
+		fixed = 1;
+	} else if (nrhs != 6) {
+		mexErrMsgIdAndTxt("wahwahMex:nargin",
+			"usage: [yb, yl, yh] = wahwahMex(x, Fs, damp, minf, maxf, Fw [, 'fixed'])");
+	}
+	if (nlhs > (fixed ? 2 : 3))
+		mexErrMsgIdAndTxt("wahwahMex:nargout", "too many outputs");
+	if (!mxIsDouble(prhs[0]) || mxIsComplex(prhs[0]))
+		mexErrMsgIdAndTxt("wahwahMex:arg", "x must be a real double array");
+	for (i = 0; i < 5; i++)
+		v[i] = scalar_arg(prhs[i + 1], names[i]);
+	if (!(v[0] > 0) || !(v[4] > 0) || !(v[3] >= v[2]))
+		mexErrMsgIdAndTxt("wahwahMex:arg", "need Fs > 0, Fw > 0 and maxf >= minf");
+	if (fixed && v[0] != 48000)
+		mexErrMsgIdAndTxt("wahwahMex:arg", "'fixed' runs at Fs = 48000 only");
+
+	// length(x): the largest dimension, taken from the start in
+	// column-major order as x(n) does.
+	m = mxGetM(prhs[0]);
+	k = mxGetN(prhs[0]);
+	n = m == 0 || k == 0 ? 0 : m > k ? m : k;
+	for (i = 0; i < 3; i++)
+		if (i < (size_t)(nlhs > 1 ? nlhs : 1)) {
+			plhs[i] = mxCreateDoubleMatrix(m, k, mxREAL);
+			out[i] = mxGetPr(plhs[i]);
+		}
+
+	if (fixed)
+		filter_fixed(mxGetPr(prhs[0]), n, v[0], v[1], v[2], v[3], v[4], out[0], out[1]);
+	else
+		filter_script(mxGetPr(prhs[0]), n, v[0], v[1], v[2], v[3], v[4], out[0],
+			out[1], out[2]);
+}
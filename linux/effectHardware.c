@@ -1,8 +1,22 @@
+/*-------------------------------------------------------------------------
+ * Description:  Control daemon: polls the adc_0 pots and writes the
+ *               resulting settings to the wahWahEffectProcessor registers.
+ *               Loop latency histograms and update counters are served in
+ *               Prometheus text format on a local Unix socket. Pot moves can
+ *               be spread over a ramp of register updates (-r).
+ *
+ * Build:        gcc -O2 -pthread -o effectHardware effectHardware.c effectMetrics.c
+ *-------------------------------------------------------------------------*/
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "effectMetrics.h"
 
 #define REG0_enable_OFFSET 0x00
 #define REG1_volume_OFFSET 0x04
@@ -12,6 +26,18 @@
 #define REG5_delta_OFFSET 0x14
 #define REG6_wetDry_OFFSET 0x18
 
+/* Default Unix socket for the Prometheus metrics endpoint               */
+#define METRICS_SOCKET "/run/effectHardware.sock"
+/* Publish the loop metrics to the exporter this often (ns)              */
+#define METRICS_PUBLISH_NS 100000000ULL
+
+/* Pot-driven registers, in the order they are ramped                    */
+#define POT_VOLUME 0
+#define POT_MINF 1
+#define POT_MAXF 2
+#define POT_DELTA 3
+#define POT_REGS 4
+
 uint32_t enable, volume, damp, minf, maxf, delta, wetDry;
 
 void read_wah_reg(FILE *file){
@@ -85,8 +111,118 @@ void write_reg(FILE *file, uint32_t duty_0, uint32_t duty_1, uint32_t duty_2,uin
 	ret = fseek(file, 0, SEEK_SET);
 }
 
-int main () {
+static volatile sig_atomic_t running = 1;
+
+static void stop_handler(int sig){
+	(void)sig;
+	running = 0;
+}
+
+/*
+ * struct pot_ramp - Spreads a pot-driven register change over time.
+ * @pos: Ramp position in register units, 32.32 fixed point, so steps
+ *       smaller than one unit per loop pass add up instead of being lost.
+ * @rate: Slew rate in @pos units per ns; 0 once @pos has arrived.
+ * @to: Latest pot value.
+ * @cur: @pos rounded, the value for this loop iteration.
+ * @last: Time of the previous update (ns).
+ */
+struct pot_ramp {
+	int64_t pos;
+	int64_t rate;
+	uint32_t to;
+	uint32_t cur;
+	uint64_t last;
+};
+
+static void ramp_init(struct pot_ramp *r, uint32_t value, uint64_t now){
+	r->pos = (int64_t)value << 32;
+	r->rate = 0;
+	r->to = r->cur = value;
+	r->last = now;
+}
+
+/*
+ * ramp_update() - Move @r towards @target; 0 @ramp_ns jumps.
+ *
+ * The position slews towards the latest pot value at a steady rate,
+ * enough to cover the distance within @ramp_ns of the last change. A new
+ * value only ever raises the rate and never restarts the ramp, so ADC
+ * noise on a resting pot can't stall it, and a pot that keeps moving
+ * never causes a step.
+ *
+ * Return: 1 if @target is a new pot value.
+ */
+static int ramp_update(struct pot_ramp *r, uint32_t target, uint64_t now, uint64_t ramp_ns){
+	const int64_t goal = (int64_t)target << 32;
+	uint64_t dt = now - r->last;
+	int moved = target != r->to;
+	const int64_t gap = goal - r->pos, dist = gap < 0 ? -gap : gap;
+	int64_t step;
+
+	r->to = target;
+	r->last = now;
+	if (ramp_ns == 0) {
+		r->pos = goal;
+	} else {
+		if (moved && dist / (int64_t)ramp_ns + 1 > r->rate)
+			r->rate = dist / (int64_t)ramp_ns + 1;
+		// Past ramp_ns every ramp has arrived; this also bounds the product.
+		step = r->rate * (int64_t)(dt < ramp_ns ? dt : ramp_ns);
+		if (dist <= step) {
+			r->pos = goal;
+			r->rate = 0;
+		} else {
+			r->pos += gap < 0 ? -step : step;
+		}
+	}
+	r->cur = (uint32_t)((r->pos + ((int64_t)1 << 31)) >> 32);
+	return moved;
+}
+
+static inline uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void usage(const char *prog){
+	printf("usage: %s [-p period_us] [-r ramp_ms] [-s metrics_socket]\n", prog);
+	printf("  -p  poll the pots every period_us microseconds (default: free-running)\n");
+	printf("  -r  spread each pot change over ramp_ms milliseconds of register\n");
+	printf("      updates instead of jumping (default: 0, jump)\n");
+	printf("  -s  Unix socket for Prometheus metrics (default: %s, \"\" disables)\n",
+		METRICS_SOCKET);
+}
+
+int main (int argc, char **argv) {
 	FILE *adc, *wah;
+	static struct loop_metrics m;
+	static struct metrics_exporter ex;
+	const char *socket_path = METRICS_SOCKET;
+	uint64_t period_ns = 0, ramp_ns = 0, next = 0, last_publish = 0;
+	uint64_t t_start, t_read, t_done, prev_start = 0, prev_read = 0;
+	struct pot_ramp ramp[POT_REGS];
+	uint32_t committed[POT_REGS];
+	int opt, j, moved, exporting = 0;
+
+	while ((opt = getopt(argc, argv, "p:r:s:h")) != -1) {
+		switch (opt) {
+		case 'p':
+			period_ns = strtoull(optarg, NULL, 0) * 1000ULL;
+			break;
+		case 'r':
+			ramp_ns = strtoull(optarg, NULL, 0) * 1000000ULL;
+			break;
+		case 's':
+			socket_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
 
 	wah = fopen ("/dev/wahWahEffectProcessor" , "rb+" );
 	if (wah == NULL) {
@@ -99,15 +235,93 @@ int main () {
 		printf("failed to open adc_0 file\n");
 		exit(1);
 	}
-	
+
+	if (socket_path[0] != '\0') {
+		if (metrics_start(&ex, socket_path) < 0)
+			printf("failed to open metrics socket %s: %s\n", socket_path, strerror(errno));
+		else
+			exporting = 1;
+	}
+
+	signal(SIGINT, stop_handler);
+	signal(SIGTERM, stop_handler);
+
 		read_wah_reg(wah);
 		// write_reg(wah, enable, volume, damp, minf, maxf, delta, wetDry);
 
-	while(1){
+	// Start from what the device holds, so a ramp begins without a step.
+	committed[POT_VOLUME] = volume;
+	committed[POT_MINF] = minf;
+	committed[POT_MAXF] = maxf;
+	committed[POT_DELTA] = delta;
+	next = now_ns();
+	for (j = 0; j < POT_REGS; j++)
+		ramp_init(&ramp[j], committed[j], next);
+
+	while(running){
+		if (period_ns) {
+			struct timespec ts = {
+				.tv_sec = next / 1000000000ULL,
+				.tv_nsec = next % 1000000000ULL,
+			};
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		}
+
+		t_start = now_ns();
 		read_adc_reg(adc);
-		write_reg(wah, enable, volume, damp, minf, maxf, delta, wetDry);
+		t_read = now_ns();
+
+		hist_record(&m.hist[HIST_ADC_READ], t_read - t_start);
+		if (prev_start)
+			hist_record(&m.hist[HIST_PERIOD], t_start - prev_start);
+		m.counter[CNT_LOOPS]++;
+
+		moved = ramp_update(&ramp[POT_VOLUME], volume, t_read, ramp_ns);
+		moved |= ramp_update(&ramp[POT_MINF], minf, t_read, ramp_ns);
+		moved |= ramp_update(&ramp[POT_MAXF], maxf, t_read, ramp_ns);
+		moved |= ramp_update(&ramp[POT_DELTA], delta, t_read, ramp_ns);
+
+		// Only touch the device when the registers actually change.
+		for (j = 0; j < POT_REGS && ramp[j].cur == committed[j]; j++)
+			;
+		if (j == POT_REGS) {
+			m.counter[CNT_REDUNDANT]++;
+		} else {
+			write_reg(wah, enable, ramp[POT_VOLUME].cur, damp, ramp[POT_MINF].cur,
+				ramp[POT_MAXF].cur, ramp[POT_DELTA].cur, wetDry);
+			t_done = now_ns();
+			hist_record(&m.hist[HIST_COMMIT], t_done - t_read);
+			// The pot moved some time after the previous read still saw
+			// the old position, so measure from there (worst case).
+			if (moved && prev_read)
+				hist_record(&m.hist[HIST_END_TO_END], t_done - prev_read);
+			m.counter[CNT_COMMITS]++;
+			for (j = 0; j < POT_REGS; j++)
+				committed[j] = ramp[j].cur;
+		}
+		prev_start = t_start;
+		prev_read = t_read;
+
+		if (period_ns) {
+			// Missed deadlines: resynchronise instead of bursting.
+			next += period_ns;
+			t_done = now_ns();
+			if (t_done > next) {
+				uint64_t missed = (t_done - next) / period_ns + 1;
+
+				m.counter[CNT_SKIPPED] += missed;
+				next += missed * period_ns;
+			}
+		}
+
+		if (exporting && t_start - last_publish >= METRICS_PUBLISH_NS) {
+			metrics_publish(&ex, &m);
+			last_publish = t_start;
+		}
 	}
 
+	if (exporting)
+		metrics_stop(&ex);
 	fclose(adc);
 	fclose(wah);
 
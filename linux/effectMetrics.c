@@ -0,0 +1,311 @@
+/*-------------------------------------------------------------------------
+ * Description:  Loop metrics for the effectHardware control daemon.
+ *
+ *               The control loop records into its own struct loop_metrics
+ *               and publishes a copy every so often under a sequence
+ *               counter, so recording costs a few plain stores and the
+ *               exporter thread never takes a lock the loop could wait on.
+ *
+ *               Scrape with:
+ *                 curl --unix-socket /run/effectHardware.sock http://x/metrics
+ *-------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "effectMetrics.h"
+
+/* Scrapes are answered from this buffer; ~4 KB per histogram is plenty  */
+#define FORMAT_SIZE 32768
+
+/* Smallest and largest le boundary exported, as powers of two in ns     */
+#define LE_MIN_BITS 10
+#define LE_MAX_BITS HIST_MAX_BITS
+
+static const char *hist_name[HIST_COUNT] = {
+	[HIST_ADC_READ]   = "effect_adc_read_seconds",
+	[HIST_COMMIT]     = "effect_commit_seconds",
+	[HIST_PERIOD]     = "effect_loop_period_seconds",
+	[HIST_END_TO_END] = "effect_end_to_end_seconds",
+};
+
+static const char *hist_help[HIST_COUNT] = {
+	[HIST_ADC_READ]   = "Time to read the adc_0 registers.",
+	[HIST_COMMIT]     = "Time to write the wahWahEffectProcessor registers.",
+	[HIST_PERIOD]     = "Time between consecutive adc_0 reads.",
+	[HIST_END_TO_END] = "Time from the last adc_0 read before a pot move to the completed register write.",
+};
+
+static const char *counter_name[CNT_COUNT] = {
+	[CNT_LOOPS]     = "effect_loops_total",
+	[CNT_COMMITS]   = "effect_commits_total",
+	[CNT_REDUNDANT] = "effect_redundant_updates_total",
+	[CNT_SKIPPED]   = "effect_skipped_updates_total",
+};
+
+static const char *counter_help[CNT_COUNT] = {
+	[CNT_LOOPS]     = "Control loop iterations.",
+	[CNT_COMMITS]   = "Register commits written to the device.",
+	[CNT_REDUNDANT] = "adc_0 samples that would not have changed any register.",
+	[CNT_SKIPPED]   = "Loop periods missed because an iteration overran.",
+};
+
+static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+/*-----------------------------------------------------------------------*/
+/* Histogram helpers                                                     */
+/*-----------------------------------------------------------------------*/
+/*
+ * hist_bucket_upper() - Largest value that lands in bucket @idx.
+ */
+uint64_t hist_bucket_upper(unsigned idx)
+{
+	unsigned e;
+
+	if (idx < 2 * HIST_SUB_COUNT)
+		return idx;
+
+	e = idx / HIST_SUB_COUNT - 1;
+	return (((uint64_t)HIST_SUB_COUNT + idx % HIST_SUB_COUNT) << e) + (1ULL << e) - 1;
+}
+
+/*
+ * hist_quantile() - Value at quantile @q, within one bucket's resolution.
+ *
+ * Return: The upper bound of the bucket holding the quantile, clamped to
+ * the largest recorded value, or 0 for an empty histogram.
+ */
+uint64_t hist_quantile(const struct hdr_hist *h, double q)
+{
+	uint64_t rank, seen = 0;
+	unsigned i;
+
+	if (h->total == 0)
+		return 0;
+
+	rank = (uint64_t)(q * (double)h->total + 0.5);
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->counts[i];
+		if (seen >= rank) {
+			uint64_t v = hist_bucket_upper(i);
+			return v < h->max ? v : h->max;
+		}
+	}
+	return h->max;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Prometheus text formatting                                            */
+/*-----------------------------------------------------------------------*/
+static int format_hist(const struct hdr_hist *h, const char *name,
+	const char *help, char *buf, int size)
+{
+	int n = 0;
+	unsigned i, bits, idx = 0;
+	uint64_t cumulative = 0;
+
+	n += snprintf(buf + n, size - n, "# HELP %s %s\n# TYPE %s histogram\n",
+		name, help, name);
+
+	// Buckets line up with powers of two, so each le boundary is exact.
+	for (bits = LE_MIN_BITS; bits <= LE_MAX_BITS && n < size; bits++) {
+		unsigned end = hist_index(1ULL << bits);
+
+		if (bits == HIST_MAX_BITS)
+			end = HIST_BUCKETS;
+		for (; idx < end; idx++)
+			cumulative += h->counts[idx];
+		n += snprintf(buf + n, size - n, "%s_bucket{le=\"%.9g\"} %llu\n",
+			name, (double)(1ULL << bits) * 1e-9,
+			(unsigned long long)cumulative);
+	}
+	if (n < size)
+		n += snprintf(buf + n, size - n,
+			"%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9f\n%s_count %llu\n",
+			name, (unsigned long long)h->total,
+			name, (double)h->sum * 1e-9,
+			name, (unsigned long long)h->total);
+
+	// Percentiles straight from the HDR buckets, for dashboards without
+	// histogram_quantile().
+	if (n < size)
+		n += snprintf(buf + n, size - n, "# TYPE %s_quantile gauge\n", name);
+	for (i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]) && n < size; i++)
+		n += snprintf(buf + n, size - n, "%s_quantile{quantile=\"%g\"} %.9f\n",
+			name, quantiles[i], (double)hist_quantile(h, quantiles[i]) * 1e-9);
+	if (n < size)
+		n += snprintf(buf + n, size - n, "# TYPE %s_max gauge\n%s_max %.9f\n",
+			name, name, (double)h->max * 1e-9);
+
+	return n < size ? n : size;
+}
+
+/*
+ * metrics_format() - Render @m in the Prometheus text exposition format.
+ *
+ * Return: The number of bytes written to @buf (truncated at @size).
+ */
+int metrics_format(const struct loop_metrics *m, char *buf, int size)
+{
+	int n = 0;
+	unsigned i;
+
+	for (i = 0; i < CNT_COUNT && n < size; i++)
+		n += snprintf(buf + n, size - n, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+			counter_name[i], counter_help[i], counter_name[i],
+			counter_name[i], (unsigned long long)m->counter[i]);
+
+	for (i = 0; i < HIST_COUNT && n < size; i++)
+		n += format_hist(&m->hist[i], hist_name[i], hist_help[i],
+			buf + n, size - n);
+
+	return n < size ? n : size;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Snapshot publication                                                  */
+/*-----------------------------------------------------------------------*/
+/*
+ * metrics_publish() - Make @m visible to the exporter thread.
+ *
+ * Called from the control loop only. The copy is a single memcpy between
+ * two sequence bumps; the loop never waits on the reader.
+ */
+void metrics_publish(struct metrics_exporter *ex, const struct loop_metrics *m)
+{
+	uint32_t seq = __atomic_load_n(&ex->seq, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&ex->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(&ex->snapshot, m, sizeof(*m));
+	__atomic_store_n(&ex->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void metrics_read(struct metrics_exporter *ex, struct loop_metrics *m)
+{
+	uint32_t seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&ex->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+		memcpy(m, &ex->snapshot, sizeof(*m));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&ex->seq, __ATOMIC_RELAXED) == seq)
+			return;
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* Unix socket server                                                    */
+/*-----------------------------------------------------------------------*/
+static void write_all(int fd, const char *buf, int len)
+{
+	while (len > 0) {
+		ssize_t ret = write(fd, buf, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return;
+		buf += ret;
+		len -= ret;
+	}
+}
+
+static void *metrics_thread(void *arg)
+{
+	struct metrics_exporter *ex = arg;
+	static struct loop_metrics copy;
+	static char body[FORMAT_SIZE];
+	struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+	char request[1024], header[128];
+	int fd, len, hlen;
+	ssize_t got;
+
+	for (;;) {
+		fd = accept(ex->fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break;	// listening socket was shut down
+		}
+
+		// Accept both HTTP scrapers and plain "socat -" style readers;
+		// the latter send nothing, so don't wait on them for long.
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		got = read(fd, request, sizeof(request) - 1);
+
+		metrics_read(ex, &copy);
+		len = metrics_format(&copy, body, sizeof(body));
+
+		if (got >= 4 && strncmp(request, "GET ", 4) == 0) {
+			hlen = snprintf(header, sizeof(header),
+				"HTTP/1.0 200 OK\r\n"
+				"Content-Type: text/plain; version=0.0.4\r\n"
+				"Content-Length: %d\r\n\r\n", len);
+			write_all(fd, header, hlen);
+		}
+		write_all(fd, body, len);
+		close(fd);
+	}
+	return NULL;
+}
+
+/*
+ * metrics_start() - Bind @path and start answering scrapes.
+ *
+ * Return: 0 on success, -1 with errno set otherwise.
+ */
+int metrics_start(struct metrics_exporter *ex, const char *path)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	ex->path = path;
+	ex->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (ex->fd < 0)
+		return -1;
+
+	unlink(path);
+	if (bind(ex->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(ex->fd, 4) < 0) {
+		close(ex->fd);
+		return -1;
+	}
+
+	errno = pthread_create(&ex->thread, NULL, metrics_thread, ex);
+	if (errno) {
+		close(ex->fd);
+		unlink(path);
+		return -1;
+	}
+	return 0;
+}
+
+void metrics_stop(struct metrics_exporter *ex)
+{
+	shutdown(ex->fd, SHUT_RDWR);
+	pthread_join(ex->thread, NULL);
+	close(ex->fd);
+	unlink(ex->path);
+}
@@ -0,0 +1,123 @@
+/*-------------------------------------------------------------------------
+ * Description:  Loop metrics for the effectHardware control daemon.
+ *               HDR-style latency histograms, update counters and a
+ *               Prometheus text exporter on a local Unix socket.
+ *-------------------------------------------------------------------------*/
+#ifndef EFFECT_METRICS_H
+#define EFFECT_METRICS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*-----------------------------------------------------------------------*/
+/* DEFINE STATEMENTS                                                     */
+/*-----------------------------------------------------------------------*/
+/* 16 linear sub-buckets per power of two (~6% resolution)               */
+#define HIST_SUB_BITS 4
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+/* Largest recordable value is 2^36 ns (~68 s); larger values saturate   */
+#define HIST_MAX_BITS 36
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+/* Histograms kept by the daemon                                         */
+enum metrics_hist {
+	HIST_ADC_READ,		/* time to read the adc_0 registers          */
+	HIST_COMMIT,		/* time to write the wah registers           */
+	HIST_PERIOD,		/* time between consecutive adc reads        */
+	HIST_END_TO_END,	/* pot move to completed register write      */
+	HIST_COUNT
+};
+
+/* Counters kept by the daemon                                           */
+enum metrics_counter {
+	CNT_LOOPS,		/* loop iterations                           */
+	CNT_COMMITS,		/* register commits issued                   */
+	CNT_REDUNDANT,		/* adc samples that changed no register      */
+	CNT_SKIPPED,		/* loop periods missed because of overruns   */
+	CNT_COUNT
+};
+
+/*
+ * struct hdr_hist - Log-linear latency histogram in nanoseconds.
+ * @counts: Bucket counts, see hist_index() for the bucket layout.
+ * @total: Number of recorded values.
+ * @sum: Sum of the recorded values.
+ * @max: Largest recorded value.
+ */
+struct hdr_hist {
+	uint64_t counts[HIST_BUCKETS];
+	uint64_t total;
+	uint64_t sum;
+	uint64_t max;
+};
+
+/*
+ * struct loop_metrics - Everything the control loop records.
+ *
+ * The loop owns one of these exclusively and updates it with plain
+ * stores; metrics_publish() copies it to the exporter now and then.
+ */
+struct loop_metrics {
+	struct hdr_hist hist[HIST_COUNT];
+	uint64_t counter[CNT_COUNT];
+};
+
+/*
+ * struct metrics_exporter - Published snapshot and the socket serving it.
+ * @seq: Sequence counter; odd while a snapshot is being written.
+ * @snapshot: Last published copy of the loop metrics.
+ * @path: Unix socket path.
+ * @fd: Listening socket.
+ * @thread: Thread answering scrapes.
+ */
+struct metrics_exporter {
+	uint32_t seq;
+	struct loop_metrics snapshot;
+	const char *path;
+	int fd;
+	pthread_t thread;
+};
+
+/*-----------------------------------------------------------------------*/
+/* Recording (control loop side)                                         */
+/*-----------------------------------------------------------------------*/
+/*
+ * hist_index() - Map a value to its bucket.
+ *
+ * Values below 2*HIST_SUB_COUNT get a bucket each. Above that, every
+ * power of two is split into HIST_SUB_COUNT equal sub-buckets.
+ */
+static inline unsigned hist_index(uint64_t v)
+{
+	unsigned e;
+
+	if (v >= (1ULL << HIST_MAX_BITS))
+		v = (1ULL << HIST_MAX_BITS) - 1;
+	if (v < 2 * HIST_SUB_COUNT)
+		return (unsigned)v;
+
+	e = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+	return (e + 1) * HIST_SUB_COUNT + (unsigned)(v >> e) - HIST_SUB_COUNT;
+}
+
+static inline void hist_record(struct hdr_hist *h, uint64_t v)
+{
+	h->counts[hist_index(v)]++;
+	h->total++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+}
+
+uint64_t hist_bucket_upper(unsigned idx);
+uint64_t hist_quantile(const struct hdr_hist *h, double q);
+
+/*-----------------------------------------------------------------------*/
+/* Exporter                                                              */
+/*-----------------------------------------------------------------------*/
+int metrics_start(struct metrics_exporter *ex, const char *path);
+void metrics_stop(struct metrics_exporter *ex);
+void metrics_publish(struct metrics_exporter *ex, const struct loop_metrics *m);
+int metrics_format(const struct loop_metrics *m, char *buf, int size);
+
+#endif
@@ -1,8 +1,21 @@
+/*-------------------------------------------------------------------------
+ * Description:  Show/apply the wahWahEffectProcessor settings, and watch or
+ *               record every wah and adc_0 register at up to several kHz
+ *               into a delta-encoded trace that -x decodes to CSV.
+ *
+ * Build:        gcc -O2 -o effectShow effectShow.c
+ *-------------------------------------------------------------------------*/
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define REG0_enable_OFFSET 0x00
 #define REG1_volume_OFFSET 0x04
@@ -12,8 +25,18 @@
 #define REG5_delta_OFFSET 0x14
 #define REG6_wetDry_OFFSET 0x18
 
+/* adc_0 exposes six 32-bit registers, p0 .. p5                          */
+#define ADC_REGS 6
+#define WAH_REGS 7
+#define TRACE_REGS (WAH_REGS + ADC_REGS)
+
+/* Trace file format version written by record mode                      */
+#define TRACE_MAGIC "WTRC"
+#define TRACE_VERSION 1
+/* Worst case record: 10 byte time varint + 3 byte mask + 5 bytes/reg    */
+#define TRACE_MAX_RECORD (10 + 3 + 5 * TRACE_REGS)
+#define TRACE_DEFAULT_MB 64
 
- 
 uint32_t enable, volume, damp, minf, maxf, delta, wetDry;
 
 void read_reg(FILE *file){
@@ -68,8 +91,350 @@ void write_reg(FILE *file, uint32_t duty_0, uint32_t duty_1, uint32_t duty_2,uin
 	ret = fseek(file, 0, SEEK_SET);
 }
 
-int main () {
+/*-----------------------------------------------------------------------*/
+/* Register trace recorder                                               */
+/*-----------------------------------------------------------------------*/
+/*
+ * Trace file layout (little endian):
+ *
+ *   struct trace_header
+ *   record * samples
+ *
+ * Every record is
+ *   varint  ns since the previous sample (CLOCK_MONOTONIC; t0_ns for the first)
+ *   varint  bit mask of the registers that changed
+ *   varint  zigzag(new - old) for every set bit, lowest bit first
+ *
+ * Registers start out as zero, so the first record carries every non-zero
+ * value. Order: the seven wah registers, then adc_0 p0 .. p5.
+ */
+struct trace_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t regs;
+	uint32_t rate_hz;
+	uint32_t reserved;
+	uint64_t t0_ns;
+	uint64_t samples;
+	uint64_t bytes;
+};
+
+static const char *trace_names[TRACE_REGS] = {
+	"enable", "volume", "damp", "minf", "maxf", "delta", "wetDry",
+	"p0", "p1", "p2", "p3", "p4", "p5",
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void stop_handler(int sig){
+	(void)sig;
+	running = 0;
+}
+
+static inline uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint8_t *put_varint(uint8_t *p, uint64_t v){
+	while (v >= 0x80) {
+		*p++ = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v){
+	int shift = 0;
+
+	*v = 0;
+	while (p < end && shift < 64) {
+		*v |= (uint64_t)(*p & 0x7f) << shift;
+		if (!(*p++ & 0x80))
+			return p;
+		shift += 7;
+	}
+	return NULL;
+}
+
+/*
+ * read_all_regs() - Sample every wah and adc register with pread().
+ *
+ * pread() keeps the file offset out of the picture, so no seeks are
+ * needed between samples.
+ */
+static void read_all_regs(int wah, int adc, uint32_t *regs){
+	int i;
+
+	for (i = 0; i < WAH_REGS; i++)
+		if (pread(wah, &regs[i], 4, i * 4) != 4)
+			regs[i] = 0;
+	for (i = 0; i < ADC_REGS; i++)
+		if (pread(adc, &regs[WAH_REGS + i], 4, i * 4) != 4)
+			regs[WAH_REGS + i] = 0;
+}
+
+/*
+ * record_trace() - Sample the registers at @rate_hz into @path.
+ * @seconds: Recording length; 0 records until interrupted or the file is full.
+ * @megabytes: File size to preallocate when @seconds is 0.
+ * @watch: Also print every sample that changed a register.
+ *
+ * With a NULL @path nothing is kept; the records go to a scratch mapping
+ * that is reused, which is what watch mode runs on.
+ *
+ * The file is preallocated and mapped up front so the sampling loop only
+ * reads registers and stores bytes; nothing is written through the page
+ * cache API until the mapping is synced at the end.
+ */
+static int record_trace(const char *path, uint32_t rate_hz, double seconds,
+	uint64_t megabytes, int watch){
+	struct trace_header *hdr;
+	uint32_t regs[TRACE_REGS], prev[TRACE_REGS];
+	uint64_t size, period, next, t, t_prev, samples = 0;
+	uint8_t *map, *p, *end;
+	int wah, adc, out, i;
+
+	wah = open("/dev/wahWahEffectProcessor", O_RDONLY);
+	if (wah < 0) {
+		printf("failed to open wahWahEffectProcessor file\n");
+		return 1;
+	}
+	adc = open("/dev/adc_0", O_RDONLY);
+	if (adc < 0) {
+		printf("failed to open adc_0 file\n");
+		return 1;
+	}
+
+	if (seconds > 0)
+		size = (uint64_t)(seconds * rate_hz + 1) * TRACE_MAX_RECORD;
+	else
+		size = megabytes << 20;
+	size += sizeof(*hdr);
+
+	if (path == NULL) {
+		out = -1;
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	} else {
+		out = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (out < 0 || posix_fallocate(out, 0, size) != 0) {
+			printf("failed to preallocate %s\n", path);
+			return 1;
+		}
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, out, 0);
+	}
+	if (map == MAP_FAILED) {
+		printf("failed to map %s\n", path);
+		return 1;
+	}
+
+	hdr = (struct trace_header *)map;
+	memcpy(hdr->magic, TRACE_MAGIC, 4);
+	hdr->version = TRACE_VERSION;
+	hdr->regs = TRACE_REGS;
+	hdr->rate_hz = rate_hz;
+	p = map + sizeof(*hdr);
+	end = map + size - TRACE_MAX_RECORD;
+
+	signal(SIGINT, stop_handler);
+	signal(SIGTERM, stop_handler);
+
+	memset(prev, 0, sizeof(prev));
+	period = 1000000000ULL / rate_hz;
+	next = now_ns();
+	hdr->t0_ns = t_prev = next;
+
+	while (running && p <= end) {
+		struct timespec ts = {
+			.tv_sec = next / 1000000000ULL,
+			.tv_nsec = next % 1000000000ULL,
+		};
+		uint32_t mask = 0;
+
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		t = now_ns();
+		read_all_regs(wah, adc, regs);
+
+		for (i = 0; i < TRACE_REGS; i++)
+			if (regs[i] != prev[i])
+				mask |= 1u << i;
+
+		p = put_varint(p, t - t_prev);
+		p = put_varint(p, mask);
+		for (i = 0; i < TRACE_REGS; i++) {
+			if (mask & (1u << i)) {
+				int32_t d = (int32_t)(regs[i] - prev[i]);
+
+				p = put_varint(p, ((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+				if (watch)
+					printf("%.6f %s=%u\n", (t - hdr->t0_ns) * 1e-9,
+						trace_names[i], regs[i]);
+				prev[i] = regs[i];
+			}
+		}
+		t_prev = t;
+		samples++;
+		if (out < 0 && p > end)
+			p = map + sizeof(*hdr);
+
+		if (seconds > 0 && (t - hdr->t0_ns) >= (uint64_t)(seconds * 1e9))
+			break;
+		// Don't try to catch up on missed samples; the timestamps
+		// record the gap.
+		next += period;
+		if (t > next)
+			next = t + period - (t - next) % period;
+	}
+
+	hdr->samples = samples;
+	hdr->bytes = p - (map + sizeof(*hdr));
+	if (out >= 0) {
+		msync(map, size, MS_SYNC);
+		if (ftruncate(out, sizeof(*hdr) + hdr->bytes) < 0)
+			printf("failed to trim %s\n", path);
+		close(out);
+		fprintf(stderr, "recorded %llu samples to %s\n",
+			(unsigned long long)samples, path);
+	}
+	munmap(map, size);
+	close(adc);
+	close(wah);
+
+	return 0;
+}
+
+/*
+ * decode_trace() - Print a recorded trace as CSV on stdout.
+ *
+ * One row per sample: time in seconds since the first sample followed by
+ * every register value. Plot it with e.g.
+ *   gnuplot -e "set datafile separator ','; plot 'x.csv' using 1:5 with steps"
+ *
+ * Only what the file holds is read, whatever the header says. A recording
+ * that never got to finish (killed, or the board lost power) has 0 bytes
+ * and samples in its header and the rest of the preallocated file after
+ * its records; it is decoded until a record fails to parse or the zeros
+ * of the unused space begin (a real record is never 0 ns after the one
+ * before).
+ */
+static int decode_trace(const char *path){
+	struct trace_header hdr;
+	uint32_t regs[TRACE_REGS];
+	uint64_t v, t = 0, n;
+	const uint8_t *p, *end;
+	uint8_t *map;
+	size_t size;
+	struct stat st;
+	int fd, i, unfinished;
+	FILE *file;
+
+	file = fopen(path, "rb");
+	if (file == NULL || fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+	    memcmp(hdr.magic, TRACE_MAGIC, 4) != 0 || hdr.version != TRACE_VERSION ||
+	    hdr.regs != TRACE_REGS) {
+		printf("%s is not a register trace\n", path);
+		return 1;
+	}
+	fd = fileno(file);
+	if (fstat(fd, &st) < 0) {
+		printf("failed to stat %s\n", path);
+		return 1;
+	}
+	unfinished = hdr.bytes == 0;
+	size = (size_t)st.st_size;
+	if (!unfinished && hdr.bytes < size - sizeof(hdr))
+		size = sizeof(hdr) + hdr.bytes;
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		printf("failed to map %s\n", path);
+		return 1;
+	}
+
+	printf("time");
+	for (i = 0; i < TRACE_REGS; i++)
+		printf(",%s", trace_names[i]);
+	printf("\n");
+
+	memset(regs, 0, sizeof(regs));
+	p = map + sizeof(hdr);
+	end = map + size;
+	for (n = 0; unfinished || n < hdr.samples; n++) {
+		uint64_t mask;
+
+		if (!(p = get_varint(p, end, &v)))
+			break;
+		t += v;
+		if (!(p = get_varint(p, end, &mask)) || (unfinished && v == 0 && mask == 0))
+			break;
+		for (i = 0; i < TRACE_REGS && p; i++) {
+			if (mask & (1u << i)) {
+				p = get_varint(p, end, &v);
+				regs[i] += (uint32_t)(v >> 1) ^ -(uint32_t)(v & 1);
+			}
+		}
+		if (!p)
+			break;
+
+		printf("%.9f", t * 1e-9);
+		for (i = 0; i < TRACE_REGS; i++)
+			printf(",%u", regs[i]);
+		printf("\n");
+	}
+	if (unfinished)
+		fprintf(stderr, "%s: unfinished recording, %llu samples recovered\n", path,
+			(unsigned long long)n);
+	else if (n != hdr.samples)
+		fprintf(stderr, "%s: truncated after %llu of %llu samples\n", path,
+			(unsigned long long)n, (unsigned long long)hdr.samples);
+
+	munmap(map, size);
+	fclose(file);
+	return 0;
+}
+
+static void usage(const char *prog){
+	printf("usage: %s                       apply the default settings\n", prog);
+	printf("       %s -r trace [-f hz] [-d seconds] [-m MB] [-w]\n", prog);
+	printf("       %s -w [-f hz] [-d seconds]   print register changes\n", prog);
+	printf("       %s -x trace                  decode a trace to CSV\n", prog);
+}
+
+int main (int argc, char **argv) {
 	FILE *wah;
+	const char *record = NULL, *decode = NULL;
+	uint32_t rate_hz = 1000;
+	uint64_t megabytes = TRACE_DEFAULT_MB;
+	double seconds = 0;
+	int opt, watch = 0;
+
+	while ((opt = getopt(argc, argv, "r:x:f:d:m:wh")) != -1) {
+		switch (opt) {
+		case 'r': record = optarg; break;
+		case 'x': decode = optarg; break;
+		case 'f': rate_hz = strtoul(optarg, NULL, 0); break;
+		case 'd': seconds = strtod(optarg, NULL); break;
+		case 'm': megabytes = strtoull(optarg, NULL, 0); break;
+		case 'w': watch = 1; break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (rate_hz == 0 || rate_hz > 100000) {
+		printf("sample rate must be between 1 and 100000 Hz\n");
+		exit(1);
+	}
+
+	if (decode)
+		return decode_trace(decode);
+	if (record)
+		return record_trace(record, rate_hz, seconds, megabytes, watch);
+	if (watch)
+		return record_trace(NULL, rate_hz, seconds, 1, 1);
 
 	wah = fopen ("/dev/wahWahEffectProcessor" , "rb+" );
 	if (wah == NULL) {
@@ -79,7 +444,8 @@ int main () {
 
 	read_reg(wah);
 	write_reg(wah, enable, volume, damp, minf, maxf, delta, wetDry);
-
+	printf("enable=%u volume=%u damp=%u minf=%u maxf=%u delta=%u wetDry=%u\n",
+		enable, volume, damp, minf, maxf, delta, wetDry);
 
 	fclose(wah);
 	return 0;
@@ -20,6 +20,10 @@
 #include <linux/fs.h>
 #include <linux/kernel.h>
 #include <linux/uaccess.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 /*#include "fp_conversions.h"*/
 
 /*-----------------------------------------------------------------------*/
@@ -38,6 +42,24 @@
 /* component wahWahEffectProcessor                                            */
 #define SPAN 0x1C
 
+/* A write at this offset queues a timed stream of register updates     */
+#define STREAM_OFFSET 0x100
+/* Most updates one stream can hold                                      */
+#define STREAM_MAX 4096
+
+/*
+ * struct stream_write - One update of a timed register stream.
+ * @at_us: When to write it, in microseconds after the stream was queued;
+ *         never less than the update before it.
+ * @offset: Register offset, REG0_enable_OFFSET to REG6_wetDry_OFFSET.
+ * @value: Value to write.
+ */
+struct stream_write {
+	u32 at_us;
+	u32 offset;
+	u32 value;
+};
+
 /*-----------------------------------------------------------------------*/
 /* wahWahEffectProcessor device structure                                     */
 /*-----------------------------------------------------------------------*/
@@ -48,6 +70,11 @@
  * @base_addr: Base address of the wahWahEffectProcessor component
  * @lock: mutex used to prevent concurrent writes
  *        to the wahWahEffectProcessor component
+ * @timer: Plays the queued stream
+ * @stream: Queued stream of register updates, or NULL
+ * @stream_len: Updates in @stream
+ * @stream_pos: Next update to write
+ * @stream_start: When the stream was queued
  *
  * An wahWahEffectProcessor_dev struct gets created for each wahWahEffectProcessor
  * component in the system.
@@ -56,6 +83,11 @@ struct wahWahEffectProcessor_dev {
 	struct miscdevice miscdev;
 	void __iomem *base_addr;
 	struct mutex lock;
+	struct hrtimer timer;
+	struct stream_write *stream;
+	u32 stream_len;
+	u32 stream_pos;
+	ktime_t stream_start;
 };
 
 /*-----------------------------------------------------------------------*/
@@ -456,6 +488,91 @@ ATTRIBUTE_GROUPS(wahWahEffectProcessor);
 	return sizeof(val);
 }
 
+/*-----------------------------------------------------------------------*/
+/* Timed register streams                                                */
+/*-----------------------------------------------------------------------*/
+/*
+ * stream_timer() - Write the stream updates that are due.
+ * @timer: The device's stream timer.
+ *
+ * Runs in interrupt context. Every update whose time has come is written,
+ * so a late wakeup catches up instead of drifting, and the timer is set
+ * for the next one. Single register writes need no lock; the mutex only
+ * keeps write() calls from racing each other.
+ *
+ * Return: HRTIMER_RESTART while updates are left.
+ */
+static enum hrtimer_restart stream_timer(struct hrtimer *timer)
+{
+	struct wahWahEffectProcessor_dev *priv = container_of(timer,
+	                            struct wahWahEffectProcessor_dev, timer);
+	const struct stream_write *w = priv->stream;
+	ktime_t now = ktime_get();
+	u32 i = priv->stream_pos;
+
+	while (i < priv->stream_len &&
+	       ktime_compare(ktime_add_us(priv->stream_start, w[i].at_us), now) <= 0) {
+		iowrite32(w[i].value, priv->base_addr + w[i].offset);
+		i++;
+	}
+	priv->stream_pos = i;
+	if (i == priv->stream_len)
+		return HRTIMER_NORESTART;
+
+	hrtimer_set_expires(timer, ktime_add_us(priv->stream_start, w[i].at_us));
+	return HRTIMER_RESTART;
+}
+
+/*
+ * stream_queue() - Replace the queued stream with @count bytes of
+ * struct stream_write from user space and start playing it.
+ * @priv: The device.
+ * @buf: User-space buffer holding the stream.
+ * @count: Its size in bytes.
+ *
+ * A morph is sent as one stream instead of one write() per register and
+ * step; the updates then go out from a kernel timer at their own time.
+ * Queueing a stream cancels the one still playing. Plain register writes
+ * don't, so they and a playing stream can overwrite each other.
+ *
+ * Return: @count on success, a negative error value otherwise.
+ */
+static ssize_t stream_queue(struct wahWahEffectProcessor_dev *priv,
+	const char __user *buf, size_t count)
+{
+	struct stream_write *w;
+	size_t n = count / sizeof(*w), i;
+
+	if (count % sizeof(*w) != 0 || n > STREAM_MAX)
+		return -EINVAL;
+
+	w = memdup_user(buf, count);
+	if (IS_ERR(w))
+		return PTR_ERR(w);
+	for (i = 0; i < n; i++) {
+		if (w[i].offset >= SPAN || (w[i].offset % 0x4) != 0 ||
+		    (i > 0 && w[i].at_us < w[i - 1].at_us)) {
+			kfree(w);
+			return -EINVAL;
+		}
+	}
+
+	mutex_lock(&priv->lock);
+	// Once cancelled the timer isn't running anywhere, so the old stream
+	// can go.
+	hrtimer_cancel(&priv->timer);
+	kfree(priv->stream);
+	priv->stream = w;
+	priv->stream_len = n;
+	priv->stream_pos = 0;
+	priv->stream_start = ktime_get();
+	hrtimer_start(&priv->timer, ktime_add_us(priv->stream_start, w[0].at_us),
+		HRTIMER_MODE_ABS);
+	mutex_unlock(&priv->lock);
+
+	return count;
+}
+
 /*-----------------------------------------------------------------------*/
 /* File Operations write()                                               */
 /*-----------------------------------------------------------------------*/
@@ -466,6 +583,9 @@ ATTRIBUTE_GROUPS(wahWahEffectProcessor);
  * @count: The number of bytes being written.
  * @offset: The byte offset in the file being written to.
  *
+ * A write at STREAM_OFFSET queues a timed stream of register updates
+ * instead, see stream_queue(); the offset is left where it is.
+ *
  * Return: On success, the number of bytes written is returned and the
  * offset @offset is advanced by this number. On error, a negative error
  * value is returned.
@@ -493,6 +613,9 @@ ATTRIBUTE_GROUPS(wahWahEffectProcessor);
 		// We can't write to a negative file position.
 		return -EINVAL;
 	}
+	if (pos == STREAM_OFFSET && count > 0) {
+		return stream_queue(priv, buf, count);
+	}
 	if (pos >= SPAN) {
 		// We can't write to a position past the end of our device.
 		return 0;
@@ -601,6 +724,11 @@ static int wahWahEffectProcessor_probe(struct platform_device *pdev)
 		return PTR_ERR(priv->base_addr);
 	}
 
+	// Write lock and the timer that plays register streams
+	mutex_init(&priv->lock);
+	hrtimer_init(&priv->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	priv->timer.function = stream_timer;
+
 	// Initialize the misc device parameters
 	priv->miscdev.minor = MISC_DYNAMIC_MINOR;
 	priv->miscdev.name = "wahWahEffectProcessor";
@@ -643,6 +771,10 @@ static int wahWahEffectProcessor_remove(struct platform_device *pdev)
 	// Deregister the misc device and remove the /dev/wahWahEffectProcessor file.
 	misc_deregister(&priv->miscdev);
 
+	// Stop a stream that is still playing and free it.
+	hrtimer_cancel(&priv->timer);
+	kfree(priv->stream);
+
 	pr_info("wahWahEffectProcessor_remove successful\n");
 
 	return 0;